@@ -116,9 +116,12 @@ else()
 	#
 	check_include_file("alloca.h"    HAVE_ALLOCA_H)
 endif()
+check_function_exists("fopencookie"      HAVE_FOPENCOOKIE)
 check_function_exists("getifaddrs"       HAVE_GETIFADDRS)
 check_function_exists("issetugid"        HAVE_ISSETUGID)
+check_function_exists("memfd_create"     HAVE_MEMFD_CREATE)
 check_function_exists("mkstemps"         HAVE_MKSTEMPS)
+check_function_exists("recvmmsg"         HAVE_RECVMMSG)
 check_function_exists("setresgid"        HAVE_SETRESGID)
 check_function_exists("setresuid"        HAVE_SETRESUID)
 check_function_exists("strptime"         HAVE_STRPTIME)
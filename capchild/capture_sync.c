@@ -286,6 +286,23 @@ sync_pipe_start(capture_options *capture_opts, capture_session *cap_session, inf
             argv = sync_pipe_add_arg(argv, &argc, sring_num_files);
         }
 
+        if (capture_opts->ring_compress) {
+            char sring_compress[ARGV_NUMBER_LEN];
+            argv = sync_pipe_add_arg(argv, &argc, "-b");
+            g_snprintf(sring_compress, ARGV_NUMBER_LEN, "compress:%s",capture_opts->ring_compress);
+            argv = sync_pipe_add_arg(argv, &argc, sring_compress);
+        }
+
+        if (capture_opts->ring_summary) {
+            argv = sync_pipe_add_arg(argv, &argc, "-b");
+            argv = sync_pipe_add_arg(argv, &argc, "summary:1");
+        }
+
+        if (capture_opts->ring_index) {
+            argv = sync_pipe_add_arg(argv, &argc, "-b");
+            argv = sync_pipe_add_arg(argv, &argc, "index:1");
+        }
+
         if (capture_opts->has_autostop_files) {
             char sautostop_files[ARGV_NUMBER_LEN];
             argv = sync_pipe_add_arg(argv, &argc, "-a");
@@ -319,6 +336,10 @@ sync_pipe_start(capture_options *capture_opts, capture_session *cap_session, inf
         argv = sync_pipe_add_arg(argv, &argc, "-g");
     }
 
+    if (prefs.capture_cache_filters) {
+        argv = sync_pipe_add_arg(argv, &argc, "--cache-filters");
+    }
+
     for (j = 0; j < capture_opts->ifaces->len; j++) {
         interface_opts = &g_array_index(capture_opts->ifaces, interface_options, j);
 
@@ -105,6 +105,9 @@ capture_opts_init(capture_options *capture_opts)
     capture_opts->file_packets                    = 0;
     capture_opts->has_ring_num_files              = FALSE;
     capture_opts->ring_num_files                  = RINGBUFFER_MIN_NUM_FILES;
+    capture_opts->ring_compress                   = NULL;
+    capture_opts->ring_summary                    = FALSE;
+    capture_opts->ring_index                      = FALSE;
 
     capture_opts->has_autostop_files              = FALSE;
     capture_opts->autostop_files                  = 1;
@@ -143,6 +146,7 @@ capture_opts_cleanup(capture_options *capture_opts)
         capture_opts->all_ifaces = NULL;
     }
     g_free(capture_opts->save_file);
+    g_free(capture_opts->ring_compress);
 }
 
 /* log content of capture_opts */
@@ -247,6 +251,9 @@ capture_opts_log(const char *log_domain, GLogLevelFlags log_level, capture_optio
     g_log(log_domain, log_level, "FileInterval    (%u) : %u", capture_opts->has_file_interval, capture_opts->file_interval);
     g_log(log_domain, log_level, "FilePackets     (%u) : %u", capture_opts->has_file_packets, capture_opts->file_packets);
     g_log(log_domain, log_level, "RingNumFiles    (%u) : %u", capture_opts->has_ring_num_files, capture_opts->ring_num_files);
+    g_log(log_domain, log_level, "RingCompress        : %s", capture_opts->ring_compress ? capture_opts->ring_compress : "(none)");
+    g_log(log_domain, log_level, "RingSummary         : %u", capture_opts->ring_summary);
+    g_log(log_domain, log_level, "RingIndex           : %u", capture_opts->ring_index);
 
     g_log(log_domain, log_level, "AutostopFiles   (%u) : %u", capture_opts->has_autostop_files, capture_opts->autostop_files);
     g_log(log_domain, log_level, "AutostopPackets (%u) : %u", capture_opts->has_autostop_packets, capture_opts->autostop_packets);
@@ -410,6 +417,20 @@ get_ring_arguments(capture_options *capture_opts, const char *arg)
     } else if (strcmp(arg,"packets") == 0) {
         capture_opts->has_file_packets = TRUE;
         capture_opts->file_packets = get_positive_int(p, "ring buffer packet count");
+    } else if (strcmp(arg,"compress") == 0) {
+#ifdef HAVE_ZLIB
+        if (strcmp(p,"gzip") != 0)
+#endif
+        {
+            *colonp = ':';
+            return FALSE;
+        }
+        g_free(capture_opts->ring_compress);
+        capture_opts->ring_compress = g_strdup(p);
+    } else if (strcmp(arg,"summary") == 0) {
+        capture_opts->ring_summary = get_natural_int(p, "ring buffer summary") != 0;
+    } else if (strcmp(arg,"index") == 0) {
+        capture_opts->ring_index = get_natural_int(p, "ring buffer flow index") != 0;
     }
 
     *colonp = ':';    /* put the colon back */
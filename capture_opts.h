@@ -298,6 +298,12 @@ typedef struct capture_options_tag {
     int                file_packets;          /**< Switch file after n packets */
     gboolean           has_ring_num_files;    /**< TRUE if ring num_files specified */
     guint32            ring_num_files;        /**< Number of multiple buffer files */
+    gchar             *ring_compress;         /**< Compression for finished files
+                                                   ("gzip"), or NULL */
+    gboolean           ring_summary;          /**< TRUE if a summary is to be written
+                                                   for each finished file */
+    gboolean           ring_index;            /**< TRUE if a flow index is to be written
+                                                   for each finished file */
 
     /* autostop conditions */
     gboolean           has_autostop_files;    /**< TRUE if maximum number of capture files
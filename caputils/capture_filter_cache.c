@@ -0,0 +1,337 @@
+/* capture_filter_cache.c
+ * Routines for compiling capture filters, reusing programs compiled earlier
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#ifdef HAVE_LIBPCAP
+
+#include <glib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wspcap.h"
+
+#include <wsutil/filesystem.h>
+#include <wsutil/file_util.h>
+#include <wsutil/privileges.h>
+
+#include "caputils/capture_filter_cache.h"
+
+/* Subdirectory of the personal configuration directory */
+#define CFILTER_CACHE_DIR "cfilter_cache"
+
+#define CFILTER_CACHE_MAGIC 0x31434643	/* "CFC1" */
+
+/* Programs that compile quicker than this aren't kept in files */
+#define CFILTER_CACHE_MIN_COMPILE_TIME (100 * G_TIME_SPAN_MILLISECOND)
+
+/* Seconds after which a program in a file is compiled again */
+#define CFILTER_CACHE_MAX_AGE (60 * 60)
+
+/* The most instructions kept in memory */
+#define CFILTER_CACHE_MAX_INSNS (1024 * 1024)
+
+/*
+ * A file holds this header, the key, and the instructions, in host byte
+ * order; it's named for a hash of the key.
+ */
+typedef struct {
+	guint32 magic;
+	guint32 key_len;
+	guint32 bf_len;
+} cfilter_cache_file_hdr;
+
+/* Programs in memory, by key */
+static GMutex cache_mtx;
+static GHashTable *cache;
+static gsize cache_insns;
+
+/* Whether programs are kept in files too */
+static gboolean cache_files;
+
+/*
+ * libpcap can compile a filter differently for a live capture than for
+ * a dead pcap_t; on Linux, "vlan" then checks the VLAN tag the kernel
+ * took off the packet.
+ */
+static gchar *
+cfilter_cache_key(pcap_t *pcap_h, gboolean live, const char *cfilter,
+    bpf_u_int32 netmask)
+{
+	return g_strdup_printf("%c:%d:%d:%u:%s", live ? 'l' : 'd',
+	    pcap_datalink(pcap_h), pcap_snapshot(pcap_h), netmask, cfilter);
+}
+
+static void
+copy_program(struct bpf_program *dst, const struct bpf_insn *insns, u_int len)
+{
+	dst->bf_len = len;
+	dst->bf_insns = (struct bpf_insn *)g_memdup(insns, (guint)(len * sizeof(struct bpf_insn)));
+}
+
+static void
+free_cached_program(gpointer data)
+{
+	struct bpf_program *fcode = (struct bpf_program *)data;
+
+	free_capture_filter_program(fcode);
+	g_free(fcode);
+}
+
+static gboolean
+cache_lookup(const gchar *key, struct bpf_program *fcode)
+{
+	struct bpf_program *cached = NULL;
+
+	g_mutex_lock(&cache_mtx);
+	if (cache != NULL)
+		cached = (struct bpf_program *)g_hash_table_lookup(cache, key);
+	if (cached != NULL)
+		copy_program(fcode, cached->bf_insns, cached->bf_len);
+	g_mutex_unlock(&cache_mtx);
+	return cached != NULL;
+}
+
+static void
+cache_insert(const gchar *key, const struct bpf_program *fcode)
+{
+	struct bpf_program *cached = g_new(struct bpf_program, 1);
+
+	copy_program(cached, fcode->bf_insns, fcode->bf_len);
+	g_mutex_lock(&cache_mtx);
+	if (cache == NULL) {
+		cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		    free_cached_program);
+	}
+	/* Start again rather than hold on to too much */
+	if (cache_insns + fcode->bf_len > CFILTER_CACHE_MAX_INSNS) {
+		g_hash_table_remove_all(cache);
+		cache_insns = 0;
+	}
+	if (!g_hash_table_contains(cache, key))
+		cache_insns += fcode->bf_len;
+	g_hash_table_replace(cache, g_strdup(key), cached);
+	g_mutex_unlock(&cache_mtx);
+}
+
+/* The path of the file for a key: a 64-bit FNV-1a hash of it, in hex */
+static gchar *
+cache_file_path(const gchar *dir, const gchar *key)
+{
+	guint64 hash = G_GUINT64_CONSTANT(14695981039346656037);
+	gchar name[17];
+	const guchar *p;
+
+	for (p = (const guchar *)key; *p != '\0'; p++) {
+		hash ^= *p;
+		hash *= G_GUINT64_CONSTANT(1099511628211);
+	}
+	g_snprintf(name, sizeof name, "%016" G_GINT64_MODIFIER "x", hash);
+	return g_build_filename(dir, name, NULL);
+}
+
+static gboolean
+cache_file_expired(const gchar *path)
+{
+	ws_statb64 statb;
+
+	return ws_stat64(path, &statb) != 0 ||
+	    time(NULL) - statb.st_mtime > CFILTER_CACHE_MAX_AGE;
+}
+
+static gboolean
+cache_file_lookup(const gchar *key, struct bpf_program *fcode)
+{
+	gchar *dir = get_persconffile_path(CFILTER_CACHE_DIR, FALSE);
+	gchar *path = cache_file_path(dir, key);
+	gchar *contents = NULL;
+	gsize len;
+	cfilter_cache_file_hdr hdr;
+	gboolean found = FALSE;
+
+	if (!cache_file_expired(path) &&
+	    g_file_get_contents(path, &contents, &len, NULL) &&
+	    len >= sizeof hdr) {
+		memcpy(&hdr, contents, sizeof hdr);
+		if (hdr.magic == CFILTER_CACHE_MAGIC &&
+		    hdr.key_len == strlen(key) &&
+		    hdr.bf_len <= (len - sizeof hdr) / sizeof(struct bpf_insn) &&
+		    len == sizeof hdr + hdr.key_len + (gsize)hdr.bf_len * sizeof(struct bpf_insn) &&
+		    memcmp(contents + sizeof hdr, key, hdr.key_len) == 0) {
+			copy_program(fcode,
+			    (const struct bpf_insn *)(contents + sizeof hdr + hdr.key_len),
+			    hdr.bf_len);
+			found = TRUE;
+		}
+	}
+	g_free(contents);
+	g_free(path);
+	g_free(dir);
+	return found;
+}
+
+/* Removes the files that are too old to use */
+static void
+cache_file_prune(const gchar *dir)
+{
+	GDir *gdir;
+	const gchar *name;
+	gchar *path;
+
+	gdir = g_dir_open(dir, 0, NULL);
+	if (gdir == NULL)
+		return;
+	while ((name = g_dir_read_name(gdir)) != NULL) {
+		path = g_build_filename(dir, name, NULL);
+		if (cache_file_expired(path))
+			ws_unlink(path);
+		g_free(path);
+	}
+	g_dir_close(gdir);
+}
+
+static void
+cache_file_store(const gchar *key, const struct bpf_program *fcode)
+{
+	gchar *dir = get_persconffile_path(CFILTER_CACHE_DIR, FALSE);
+	gchar *path;
+	GByteArray *contents;
+	cfilter_cache_file_hdr hdr;
+
+	if (g_mkdir_with_parents(dir, 0755) != 0) {
+		g_free(dir);
+		return;
+	}
+	cache_file_prune(dir);
+
+	hdr.magic = CFILTER_CACHE_MAGIC;
+	hdr.key_len = (guint32)strlen(key);
+	hdr.bf_len = fcode->bf_len;
+	contents = g_byte_array_new();
+	g_byte_array_append(contents, (const guint8 *)&hdr, sizeof hdr);
+	g_byte_array_append(contents, (const guint8 *)key, hdr.key_len);
+	g_byte_array_append(contents, (const guint8 *)fcode->bf_insns,
+	    (guint)(fcode->bf_len * sizeof(struct bpf_insn)));
+
+	/* Written to a temporary file and renamed, so no reader sees half of it */
+	path = cache_file_path(dir, key);
+	g_file_set_contents(path, (const gchar *)contents->data, contents->len, NULL);
+
+	g_free(path);
+	g_byte_array_free(contents, TRUE);
+	g_free(dir);
+}
+
+void
+capture_filter_cache_use_files(gboolean use_files)
+{
+	cache_files = use_files;
+}
+
+gboolean
+compile_capture_filter_cached(const char *iface, pcap_t *pcap_h,
+    gboolean live, const char *cfilter, struct bpf_program *fcode)
+{
+	bpf_u_int32 netnum, netmask;
+	gchar       lookup_net_err_str[PCAP_ERRBUF_SIZE];
+	struct bpf_program compiled;
+	gchar      *key;
+	gint64      start;
+	gboolean    use_files;
+
+	if (!live) {
+		/*
+		 * A check of the filter, which shouldn't look the interface
+		 * up every time; filters that check for IP broadcast addresses
+		 * are rejected, as without the cache.
+		 */
+#ifdef PCAP_NETMASK_UNKNOWN
+		netmask = PCAP_NETMASK_UNKNOWN;
+#else
+		netmask = 0;
+#endif
+	} else if (iface == NULL ||
+	    pcap_lookupnet(iface, &netnum, &netmask, lookup_net_err_str) < 0) {
+		/*
+		 * Well, we can't get the netmask for this interface; it's used
+		 * only for filters that check for broadcast IP addresses, so
+		 * we just punt and use 0.  It might be nice to warn the user,
+		 * but that's a pain in a GUI application, as it'd involve popping
+		 * up a message box, and it's not clear how often this would make
+		 * a difference (only filters that check for IP broadcast addresses
+		 * use the netmask).
+		 */
+		netmask = 0;
+	}
+
+	/*
+	 * Only programs for live captures are kept in files, for the next
+	 * capture.  With special privileges, don't leave files behind that
+	 * the user can't remove, or trust files the user could have written.
+	 */
+	use_files = cache_files && live && !running_with_special_privs();
+
+	key = cfilter_cache_key(pcap_h, live, cfilter, netmask);
+	if (cache_lookup(key, fcode)) {
+		g_free(key);
+		return TRUE;
+	}
+	if (use_files && cache_file_lookup(key, fcode)) {
+		cache_insert(key, fcode);
+		g_free(key);
+		return TRUE;
+	}
+
+	/*
+	 * Sigh.  Older versions of libpcap don't properly declare the
+	 * third argument to pcap_compile() as a const pointer.  Cast
+	 * away the warning.
+	 */
+	start = g_get_monotonic_time();
+DIAG_OFF(cast-qual)
+	if (pcap_compile(pcap_h, &compiled, (char *)cfilter, 1, netmask) < 0) {
+		g_free(key);
+		return FALSE;
+	}
+DIAG_ON(cast-qual)
+	copy_program(fcode, compiled.bf_insns, compiled.bf_len);
+#ifdef HAVE_PCAP_FREECODE
+	pcap_freecode(&compiled);
+#endif
+
+	cache_insert(key, fcode);
+	if (use_files && g_get_monotonic_time() - start >= CFILTER_CACHE_MIN_COMPILE_TIME)
+		cache_file_store(key, fcode);
+	g_free(key);
+	return TRUE;
+}
+
+void
+free_capture_filter_program(struct bpf_program *fcode)
+{
+	g_free(fcode->bf_insns);
+	fcode->bf_insns = NULL;
+	fcode->bf_len = 0;
+}
+
+#endif /* HAVE_LIBPCAP */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
@@ -0,0 +1,64 @@
+/* capture_filter_cache.h
+ * Declarations of routines for compiling capture filters, reusing
+ * programs compiled earlier
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __CAPTURE_FILTER_CACHE_H__
+#define __CAPTURE_FILTER_CACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef HAVE_LIBPCAP
+
+#include "wspcap.h"
+
+/*
+ * Compiled capture filters are kept, keyed by the filter, whether the
+ * pcap_t is live or dead, its link-layer header type and snapshot length,
+ * and the netmask of the interface, so that the same filter isn't
+ * compiled again for another interface.  Filters for dead pcap_ts are
+ * compiled without a netmask.
+ *
+ * If capture_filter_cache_use_files() turns it on, programs for live
+ * captures that took a while to compile are also kept in files in the
+ * personal configuration directory, for the next capture.  Host names
+ * and port names in a filter are then resolved when it's first compiled,
+ * not when each capture starts; files are compiled again after an hour.
+ *
+ * Programs for dead pcap_ts, such as those of Wireshark's capture filter
+ * check, are only kept in memory: libpcap can compile a filter
+ * differently for a live capture, so they're of no use to dumpcap.
+ */
+
+/* Keep programs for live captures in files too, or don't (the default). */
+extern void capture_filter_cache_use_files(gboolean use_files);
+
+/*
+ * Compile a capture filter for a pcap_t opened on the given interface, or
+ * on no interface if "iface" is NULL, or get the program compiled earlier.
+ * "live" is whether the pcap_t captures, rather than being opened with
+ * pcap_open_dead().  Returns TRUE on success; on failure, pcap_geterr()
+ * gives the error.  The program must be freed with
+ * free_capture_filter_program(), not pcap_freecode().
+ */
+extern gboolean compile_capture_filter_cached(const char *iface, pcap_t *pcap_h,
+    gboolean live, const char *cfilter, struct bpf_program *fcode);
+
+/* Free a program from compile_capture_filter_cached(). */
+extern void free_capture_filter_program(struct bpf_program *fcode);
+
+#endif /* HAVE_LIBPCAP */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __CAPTURE_FILTER_CACHE_H__ */
@@ -90,6 +90,8 @@ typedef struct _capture_file {
   dfilter_t                  *rfcode;               /* Compiled read filter program */
   dfilter_t                  *dfcode;               /* Compiled display filter program */
   gchar                      *dfilter;              /* Display filter string */
+  dfilter_index_t            *dfindex;              /* Field value index built on the first pass, or NULL */
+  guint64                     routing_hash;         /* dissector_routing_hash() when the first pass started */
   gboolean                    redissecting;         /* TRUE if currently redissecting (cf_redissect_packets) */
   gboolean                    read_lock;            /* TRUE if currently processing a file (cf_read) */
   rescan_type                 redissection_queued;  /* Queued redissection type. */
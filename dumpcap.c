@@ -39,6 +39,10 @@
 
 #include <wsutil/socket.h>
 
+#ifdef __linux__
+#include <linux/if_packet.h>    /* PACKET_FANOUT */
+#endif
+
 #ifndef HAVE_GETOPT_LONG
 #include "wsutil/wsgetopt.h"
 #endif
@@ -53,11 +57,15 @@
 #include "caputils/capture_ifinfo.h"
 #include "caputils/capture-pcap-util.h"
 #include "caputils/capture-pcap-util-int.h"
+#include "caputils/capture_filter_cache.h"
 #ifdef _WIN32
 #include "caputils/capture-wpcap.h"
 #endif /* _WIN32 */
 
 #include "writecap/pcapio.h"
+#include "writecap/async_writer.h"
+#include "writecap/flow_index.h"
+#include "writecap/flow_policy.h"
 
 #ifndef _WIN32
 #include <sys/un.h>
@@ -280,6 +288,7 @@ typedef struct _saved_idb {
     guint interface_id; /* capture_src->interface_id for the associated SHB */
     guint8 *idb;        /* If non-NULL, IDB read from capture_src. This is an interface specified on the command line otherwise. */
     guint idb_len;
+    guint64 ts_units;   /* Time stamp units per second of the EPBs of an IDB read from capture_src; 0 if we can't convert them */
 } saved_idb_t;
 
 /*
@@ -291,6 +300,8 @@ typedef struct _loop_data {
     int       err;                 /**< if non-zero, error seen while capturing */
     gint      packets_captured;    /**< Number of packets we have already captured */
     guint     inpkts_to_sync_pipe; /**< Packets not already send out to the sync_pipe */
+    guint     inpkts_unwritten;    /**< Packets counted but not yet written out by the writer thread */
+    guint64   unwritten_bytes;     /**< Bytes the writer thread must write out before inpkts_unwritten are reported */
 #ifdef SIGINFO
     gboolean  report_packet_count; /**< Set by SIGINFO handler; print packet count */
 #endif
@@ -311,6 +322,12 @@ typedef struct _loop_data {
     GTimer  *file_duration_timer;
     time_t   next_interval_time;
     int      interval_s;
+    /* ring buffer file summary */
+    guint64  file_first_ts;        /**< First packet in the current file, in ns since the Epoch; 0 if unknown */
+    guint64  file_last_ts;         /**< Last packet in the current file, in ns since the Epoch */
+    flow_index_t *flow_index;      /**< Flows in the current file, or NULL */
+    /* flow policy */
+    flow_policy_t *flow_policy;    /**< Which packets of which flows to write, or NULL */
 } loop_data;
 
 typedef struct _pcap_queue_element {
@@ -373,6 +390,44 @@ static gboolean quiet = FALSE;
 static gboolean use_threads = FALSE;
 static guint64 start_time;
 
+/*
+ * Long options for the writer thread.
+ */
+#define LONGOPT_WRITE_BUFFERS (65536+1000)
+#define LONGOPT_DIRECT_IO     (65536+1001)
+#define LONGOPT_FANOUT        (65536+1002)
+
+/*
+ * Long options for the flow policy.
+ */
+#define LONGOPT_FLOW_PACKETS    (65536+1003)
+#define LONGOPT_FLOW_BYTES      (65536+1004)
+#define LONGOPT_FLOW_SAMPLE     (65536+1005)
+#define LONGOPT_FLOW_TABLE_SIZE (65536+1006)
+
+#define LONGOPT_CACHE_FILTERS   (65536+1007)
+
+/* Size of each of the writer thread's buffers */
+#define WRITE_BUFFER_SIZE (1024 * 1024)
+
+static guint write_buffers = 0;  /* 0 = write from the capture loop */
+static gboolean direct_io = FALSE;
+
+#ifdef PACKET_FANOUT
+/* Most sockets in a fanout group; the kernel allows more, but we start a
+   thread per socket. */
+#define MAX_FANOUT_SOCKETS 64
+
+static guint fanout_sockets = 0;  /* 0 = one socket per interface */
+#endif
+
+#define DEFAULT_FLOW_TABLE_SIZE 65536
+
+static guint32 flow_max_packets = 0;  /* 0 = no limit */
+static guint32 flow_max_bytes = 0;    /* 0 = no limit */
+static guint32 flow_sample_rate = 0;  /* 0 = every flow */
+static guint32 flow_table_size = DEFAULT_FLOW_TABLE_SIZE;
+
 static void capture_loop_write_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
                                          const u_char *pd);
 static void capture_loop_queue_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
@@ -406,6 +461,8 @@ print_usage(FILE *output)
                     "                               rpcap://<host>/<interface>\n"
                     "                               TCP@<host>:<port>\n");
     fprintf(output, "  -f <capture filter>      packet filter in libpcap filter syntax\n");
+    fprintf(output, "  --cache-filters          keep filters that are slow to compile, compiled, for\n");
+    fprintf(output, "                           the next capture (names resolve as when compiled)\n");
 #ifdef HAVE_PCAP_CREATE
     fprintf(output, "  -s <snaplen>             packet snapshot length (def: appropriate maximum)\n");
 #else
@@ -457,17 +514,41 @@ print_usage(FILE *output)
     fprintf(output, "                           filesize:NUM - switch to next file after NUM kB\n");
     fprintf(output, "                              files:NUM - ringbuffer: replace after NUM files\n");
     fprintf(output, "                            packets:NUM - ringbuffer: replace after NUM packets\n");
+#ifdef HAVE_ZLIB
+    fprintf(output, "                          compress:gzip - compress each finished file\n");
+#endif
+    fprintf(output, "                              summary:1 - write a summary of each finished file\n");
+    fprintf(output, "                                index:1 - write an index of the flows in each\n");
+    fprintf(output, "                                          finished file\n");
     fprintf(output, "  -n                       use pcapng format instead of pcap (default)\n");
     fprintf(output, "  -P                       use libpcap format instead of pcapng\n");
     fprintf(output, "  --capture-comment <comment>\n");
     fprintf(output, "                           add a capture comment to the output file\n");
     fprintf(output, "                           (only for pcapng)\n");
     fprintf(output, "\n");
+    fprintf(output, "Flow policy:\n");
+    fprintf(output, "  --flow-packets <count>   write only the first <count> packets of each flow\n");
+    fprintf(output, "  --flow-bytes <count>     write only the packets of each flow until <count>\n");
+    fprintf(output, "                           bytes have been written\n");
+    fprintf(output, "  --flow-sample <count>    write only 1 in <count> flows\n");
+    fprintf(output, "  --flow-table-size <count>\n");
+    fprintf(output, "                           track at most <count> flows at once for\n");
+    fprintf(output, "                           --flow-packets and --flow-bytes (def: %d)\n", DEFAULT_FLOW_TABLE_SIZE);
+    fprintf(output, "\n");
     fprintf(output, "Miscellaneous:\n");
     fprintf(output, "  -N <packet_limit>        maximum number of packets buffered within dumpcap\n");
     fprintf(output, "  -C <byte_limit>          maximum number of bytes used for buffering packets\n");
     fprintf(output, "                           within dumpcap\n");
     fprintf(output, "  -t                       use a separate thread per interface\n");
+    fprintf(output, "  --write-buffers <count>  write the capture file from a separate thread, through\n");
+    fprintf(output, "                           <count> buffers of %d MB\n", WRITE_BUFFER_SIZE / (1024 * 1024));
+    fprintf(output, "  --direct-io              with --write-buffers, bypass the page cache where\n");
+    fprintf(output, "                           supported\n");
+#ifdef PACKET_FANOUT
+    fprintf(output, "  --fanout <count>         capture on each interface with <count> sockets, each\n");
+    fprintf(output, "                           read by its own thread, spreading packets over them\n");
+    fprintf(output, "                           by flow\n");
+#endif
     fprintf(output, "  -q                       don't report packet capture counts\n");
     fprintf(output, "  -v                       print version information and exit\n");
     fprintf(output, "  -h                       display this help and exit\n");
@@ -682,40 +763,6 @@ get_capture_device_open_failure_messages(cap_device_open_err open_err,
                get_pcap_failure_secondary_error_message(open_err, open_err_str));
 }
 
-static gboolean
-compile_capture_filter(const char *iface, pcap_t *pcap_h,
-                       struct bpf_program *fcode, const char *cfilter)
-{
-    bpf_u_int32 netnum, netmask;
-    gchar       lookup_net_err_str[PCAP_ERRBUF_SIZE];
-
-    if (pcap_lookupnet(iface, &netnum, &netmask, lookup_net_err_str) < 0) {
-        /*
-         * Well, we can't get the netmask for this interface; it's used
-         * only for filters that check for broadcast IP addresses, so
-         * we just punt and use 0.  It might be nice to warn the user,
-         * but that's a pain in a GUI application, as it'd involve popping
-         * up a message box, and it's not clear how often this would make
-         * a difference (only filters that check for IP broadcast addresses
-         * use the netmask).
-         */
-        /*cmdarg_err(
-          "Warning:  Couldn't obtain netmask info (%s).", lookup_net_err_str);*/
-        netmask = 0;
-    }
-
-    /*
-     * Sigh.  Older versions of libpcap don't properly declare the
-     * third argument to pcap_compile() as a const pointer.  Cast
-     * away the warning.
-     */
-DIAG_OFF(cast-qual)
-    if (pcap_compile(pcap_h, fcode, (char *)cfilter, 1, netmask) < 0)
-        return FALSE;
-DIAG_ON(cast-qual)
-    return TRUE;
-}
-
 #ifdef HAVE_BPF_IMAGE
 static gboolean
 show_filter_code(capture_options *capture_opts)
@@ -757,8 +804,8 @@ show_filter_code(capture_options *capture_opts)
         }
 
         /* OK, try to compile the capture filter. */
-        if (!compile_capture_filter(interface_opts->name, pcap_h, &fcode,
-                                    interface_opts->cfilter)) {
+        if (!compile_capture_filter_cached(interface_opts->name, pcap_h, TRUE,
+                                           interface_opts->cfilter, &fcode)) {
             g_snprintf(errmsg, sizeof(errmsg), "%s", pcap_geterr(pcap_h));
             pcap_close(pcap_h);
             report_cfilter_error(capture_opts, j, errmsg);
@@ -771,6 +818,7 @@ show_filter_code(capture_options *capture_opts)
 
         for (i = 0; i < fcode.bf_len; insn++, i++)
             printf("%s\n", bpf_image(insn, i));
+        free_capture_filter_program(&fcode);
     }
     /* If not using libcap: we now can now set euid/egid to ruid/rgid         */
     /*  to remove any suid privileges.                                        */
@@ -1099,6 +1147,85 @@ report_capture_count(gboolean reportit)
     }
 }
 
+static void
+report_write_buffers(void)
+{
+    async_writer_stats stats;
+
+    if (!async_writer_is_running())
+        return;
+
+    async_writer_get_stats(&stats);
+    g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
+          "Write buffers: at most %u of %u queued, %" G_GUINT64_FORMAT " written, %" G_GUINT64_FORMAT " waits",
+          stats.max_queued, stats.buffer_count, stats.buffers_written, stats.waits);
+
+    /* Don't print this if we're a capture child. */
+    if (!capture_child) {
+        fprintf(stderr, "Write buffers: at most %u of %u waiting to be written", stats.max_queued, stats.buffer_count);
+        if (stats.waits != 0)
+            fprintf(stderr, ", capture waited %" G_GUINT64_FORMAT " time%s for a free one",
+                    stats.waits, plurality(stats.waits, "", "s"));
+        fprintf(stderr, "\n");
+        fflush(stderr);
+    }
+}
+
+static void
+report_flow_policy(void)
+{
+    flow_policy_stats stats;
+
+    if (global_ld.flow_policy == NULL)
+        return;
+
+    flow_policy_get_stats(global_ld.flow_policy, &stats);
+    g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
+          "Flow policy: %" G_GUINT64_FORMAT " packets kept, %" G_GUINT64_FORMAT " in flows not sampled, %"
+          G_GUINT64_FORMAT " over flow limits, %" G_GUINT64_FORMAT " flows forgotten",
+          stats.packets_kept, stats.packets_sampled_out, stats.packets_over_limit, stats.flows_forgotten);
+
+    /* Don't print this if we're a capture child. */
+    if (!capture_child) {
+        fprintf(stderr, "Flow policy: %" G_GUINT64_FORMAT " packet%s left out",
+                stats.packets_sampled_out + stats.packets_over_limit,
+                plurality(stats.packets_sampled_out + stats.packets_over_limit, "", "s"));
+        if (flow_sample_rate > 1)
+            fprintf(stderr, ", %" G_GUINT64_FORMAT " in flows not sampled", stats.packets_sampled_out);
+        if (stats.flows_forgotten != 0)
+            fprintf(stderr, "; %" G_GUINT64_FORMAT " flow%s forgotten for lack of room",
+                    stats.flows_forgotten, plurality(stats.flows_forgotten, "", "s"));
+        fprintf(stderr, "\n");
+        fflush(stderr);
+    }
+}
+
+#ifdef PACKET_FANOUT
+/*
+ * Reports the counts of one socket of an interface captured with --fanout,
+ * to show how evenly the packets were spread over the sockets and which
+ * of their threads fell behind.
+ */
+static void
+report_fanout_socket_drops(guint socket_num, guint32 received, guint32 pcap_drops,
+                           guint32 drops, guint32 flushed, const gchar *name)
+{
+    guint32 total_drops = pcap_drops + drops + flushed;
+
+    g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
+          "Packets received/dropped on interface '%s' socket %u: %u/%u (pcap:%u/dumpcap:%u/flushed:%u)",
+          name, socket_num, received, total_drops, pcap_drops, drops, flushed);
+
+    /* Don't print this if we're a capture child. */
+    if (!capture_child) {
+        fprintf(stderr,
+            "Packets received/dropped on interface '%s' socket %u: %u/%u (pcap:%u/dumpcap:%u/flushed:%u)\n",
+            name, socket_num, received, total_drops, pcap_drops, drops, flushed);
+        fflush(stderr);
+    }
+}
+#endif
+
 
 #ifdef SIGINFO
 static void
@@ -1138,6 +1265,8 @@ exit_main(int status)
 
 #endif /* _WIN32 */
 
+    async_writer_cleanup();
+
     if (ringbuf_is_initialized()) {
         /* save_file is managed by ringbuffer, be sure to release the memory and
          * avoid capture_opts_cleanup from double-freeing 'save_file'. */
@@ -2091,6 +2220,46 @@ pcapng_read_shb(capture_src *pcap_src,
     return 0;
 }
 
+/*
+ * Returns the time stamp units per second that an IDB's if_tsresol option
+ * sets, or 0 if there are too many to count in a guint64.
+ */
+static guint64
+pcapng_idb_ts_units(const guint8 *idb, guint idb_len)
+{
+    /* The options follow the link type, a reserved field and the snap length. */
+    guint offset = sizeof(pcapng_block_header_t) + 8;
+    guint16 opt_code, opt_len;
+    guint8 tsresol;
+    guint64 units = 1;
+
+    if (idb_len < offset + 4) {
+        return 1000000;
+    }
+    while (offset + 4 <= idb_len - 4) {
+        memcpy(&opt_code, idb + offset, 2);
+        memcpy(&opt_len, idb + offset + 2, 2);
+        if (opt_code == OPT_EOFOPT) {
+            break;
+        }
+        if (opt_code == OPT_IDB_TSRESOL && opt_len >= 1 && offset + 5 <= idb_len - 4) {
+            tsresol = idb[offset + 4];
+            if (tsresol & 0x80) {
+                return (tsresol & 0x7f) < 64 ? G_GUINT64_CONSTANT(1) << (tsresol & 0x7f) : 0;
+            }
+            if (tsresol > 19) {
+                return 0;
+            }
+            while (tsresol-- > 0) {
+                units *= 10;
+            }
+            return units;
+        }
+        offset += 4 + ((opt_len + 3) & ~3);
+    }
+    return 1000000;
+}
+
 /*
  * Save IDB blocks for playback whenever we change output files.
  * Rewrite EPB and ISB interface IDs.
@@ -2149,6 +2318,7 @@ pcapng_adjust_block(capture_src *pcap_src, const pcapng_block_header_t *bh, u_ch
         idb_source.interface_id = pcap_src->interface_id;
         idb_source.idb_len = bh->block_total_length;
         idb_source.idb = (guint8 *) g_memdup(pd, idb_source.idb_len);
+        idb_source.ts_units = pcapng_idb_ts_units(idb_source.idb, idb_source.idb_len);
         g_array_append_val(global_ld.saved_idbs, idb_source);
         guint32 iface_id = global_ld.saved_idbs->len - 1;
         g_array_append_val(pcap_src->cap_pipe_info.pcapng.src_iface_to_global, iface_id);
@@ -2477,6 +2647,12 @@ pcap_pipe_dispatch(loop_data *ld, capture_src *pcap_src, char *errmsg, size_t er
     return -1;
 }
 
+/*
+ * Every block is read into our buffer and written out from there.  Moving
+ * the bodies of blocks from the pipe to the output with splice() instead
+ * takes more system calls per block, and measured slower for blocks under
+ * about 64 KiB, which is nearly all of them, so it isn't done.
+ */
 static int
 pcapng_pipe_dispatch(loop_data *ld, capture_src *pcap_src, char *errmsg, size_t errmsgl)
 {
@@ -2693,6 +2869,142 @@ pcapng_pipe_dispatch(loop_data *ld, capture_src *pcap_src, char *errmsg, size_t
     return -1;
 }
 
+#ifdef PACKET_FANOUT
+/*
+ * Joins the socket of a capture device to a PACKET_FANOUT group; the
+ * kernel hands each packet on the interface to one socket of the group,
+ * choosing it by a hash of the packet's flow.
+ *
+ * If "create" is TRUE, the group is a new one, with an ID the kernel
+ * picks so that no other process's group has it, and *group_id is set
+ * to it; otherwise the socket joins the group with ID *group_id.
+ */
+static gboolean
+capture_loop_join_fanout(pcap_t *pcap_h, gboolean create, guint16 *group_id,
+                         char *errmsg, size_t errmsg_len)
+{
+    /* Reassemble IP fragments first, so that they all go to one socket. */
+    int       fanout_flags = PACKET_FANOUT_FLAG_DEFRAG;
+    int       fanout_arg;
+    socklen_t fanout_arg_len = sizeof fanout_arg;
+
+    if (create) {
+#ifdef PACKET_FANOUT_FLAG_UNIQUEID
+        fanout_flags |= PACKET_FANOUT_FLAG_UNIQUEID;
+        *group_id = 0;
+#else
+        /* Any ID we picked could be another process's group's. */
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "This system can't create fanout groups with unique IDs.");
+        return FALSE;
+#endif
+    }
+
+    fanout_arg = *group_id | ((PACKET_FANOUT_HASH | fanout_flags) << 16);
+    if (setsockopt(pcap_fileno(pcap_h), SOL_PACKET, PACKET_FANOUT,
+                   &fanout_arg, sizeof fanout_arg) == -1) {
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "The capture socket couldn't join a fanout group: %s.",
+                   g_strerror(errno));
+        return FALSE;
+    }
+
+    if (create) {
+        if (getsockopt(pcap_fileno(pcap_h), SOL_PACKET, PACKET_FANOUT,
+                       &fanout_arg, &fanout_arg_len) == -1) {
+            g_snprintf(errmsg, (gulong) errmsg_len,
+                       "The ID of the capture socket's fanout group couldn't be found: %s.",
+                       g_strerror(errno));
+            return FALSE;
+        }
+        *group_id = (guint16)(fanout_arg & 0xffff);
+    }
+    return TRUE;
+}
+
+/*
+ * For --fanout: opens fanout_sockets - 1 more capture devices on the
+ * interface the capture device of "first_src" is on, puts them all in a
+ * fanout group, and adds the new ones to ld->pcaps.  They all have the
+ * interface ID of "first_src", so their packets go into the output as
+ * one interface's.
+ *
+ * XXX - until a socket has joined the group, it gets every packet on the
+ * interface, so a few packets that arrive before the capture file is
+ * reported may be captured twice.
+ */
+static gboolean
+capture_loop_open_fanout(capture_options *capture_opts, loop_data *ld,
+                         capture_src *first_src,
+                         char *errmsg, size_t errmsg_len,
+                         char *secondary_errmsg, size_t secondary_errmsg_len)
+{
+    interface_options  *interface_opts;
+    cap_device_open_err open_err;
+    gchar               open_err_str[PCAP_ERRBUF_SIZE];
+    capture_src        *pcap_src;
+    guint16             group_id;
+    guint               i;
+
+    interface_opts = &g_array_index(capture_opts->ifaces, interface_options, first_src->interface_id);
+
+    /* Group IDs are shared by everybody capturing on the system. */
+    if (!capture_loop_join_fanout(first_src->pcap_h, TRUE, &group_id, errmsg, errmsg_len))
+        return FALSE;
+
+    for (i = 1; i < fanout_sockets; i++) {
+        pcap_src = (capture_src *)g_malloc0(sizeof (capture_src));
+#ifdef MUST_DO_SELECT
+        pcap_src->pcap_fd = -1;
+#endif
+        pcap_src->interface_id = first_src->interface_id;
+        pcap_src->linktype = -1;
+        pcap_src->cap_pipe_fd = -1;
+        pcap_src->cap_pipe_dispatch = pcap_pipe_dispatch;
+        pcap_src->cap_pipe_state = STATE_EXPECT_REC_HDR;
+        pcap_src->cap_pipe_err = PIPOK;
+        g_array_append_val(ld->pcaps, pcap_src);
+
+        g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG, "capture_loop_open_fanout : %s socket %u",
+              interface_opts->name, i + 1);
+        pcap_src->pcap_h = open_capture_device(capture_opts, interface_opts,
+            CAP_READ_TIMEOUT, &open_err, &open_err_str);
+        if (pcap_src->pcap_h == NULL) {
+            get_capture_device_open_failure_messages(open_err,
+                                                     open_err_str,
+                                                     interface_opts->name,
+                                                     errmsg,
+                                                     errmsg_len,
+                                                     secondary_errmsg,
+                                                     secondary_errmsg_len);
+            return FALSE;
+        }
+
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+        pcap_src->ts_nsec = have_high_resolution_timestamp(pcap_src->pcap_h);
+#endif
+        if (!set_pcap_datalink(pcap_src->pcap_h, interface_opts->linktype,
+                               interface_opts->name,
+                               errmsg, errmsg_len,
+                               secondary_errmsg, secondary_errmsg_len)) {
+            return FALSE;
+        }
+        pcap_src->linktype = get_pcap_datalink(pcap_src->pcap_h, interface_opts->name);
+#ifdef MUST_DO_SELECT
+#ifdef HAVE_PCAP_GET_SELECTABLE_FD
+        pcap_src->pcap_fd = pcap_get_selectable_fd(pcap_src->pcap_h);
+#else
+        pcap_src->pcap_fd = pcap_fileno(pcap_src->pcap_h);
+#endif
+#endif
+
+        if (!capture_loop_join_fanout(pcap_src->pcap_h, FALSE, &group_id, errmsg, errmsg_len))
+            return FALSE;
+    }
+    return TRUE;
+}
+#endif /* PACKET_FANOUT */
+
 /** Open the capture input file (pcap or capture pipe).
  *  Returns TRUE if it succeeds, FALSE otherwise. */
 static gboolean
@@ -2889,6 +3201,26 @@ capture_loop_open_input(capture_options *capture_opts, loop_data *ld,
         g_rw_lock_writer_unlock (&ld->saved_shb_idb_lock);
     }
 
+#ifdef PACKET_FANOUT
+    /*
+     * Open the other sockets of the fanout groups.  They go after all the
+     * interfaces' first sources, so that ld->pcaps[i] is still interface
+     * i's first source.
+     */
+    if (fanout_sockets > 1) {
+        for (i = 0; i < capture_opts->ifaces->len; i++) {
+            pcap_src = g_array_index(ld->pcaps, capture_src *, i);
+            if (pcap_src->pcap_h == NULL)
+                continue;       /* fanout is only for capture devices */
+            if (!capture_loop_open_fanout(capture_opts, ld, pcap_src,
+                                          errmsg, errmsg_len,
+                                          secondary_errmsg, secondary_errmsg_len)) {
+                return FALSE;
+            }
+        }
+    }
+#endif
+
     /* If not using libcap: we now can now set euid/egid to ruid/rgid         */
     /*  to remove any suid privileges.                                        */
     /* If using libcap: we can now remove NET_RAW and NET_ADMIN capabilities  */
@@ -2960,21 +3292,17 @@ capture_loop_init_filter(pcap_t *pcap_h, gboolean from_cap_pipe,
     /* capture filters only work on real interfaces */
     if (cfilter && !from_cap_pipe) {
         /* A capture filter was specified; set it up. */
-        if (!compile_capture_filter(name, pcap_h, &fcode, cfilter)) {
+        if (!compile_capture_filter_cached(name, pcap_h, TRUE, cfilter, &fcode)) {
             /* Treat this specially - our caller might try to compile this
                as a display filter and, if that succeeds, warn the user that
                the display and capture filter syntaxes are different. */
             return INITFILTER_BAD_FILTER;
         }
         if (pcap_setfilter(pcap_h, &fcode) < 0) {
-#ifdef HAVE_PCAP_FREECODE
-            pcap_freecode(&fcode);
-#endif
+            free_capture_filter_program(&fcode);
             return INITFILTER_OTHER_ERROR;
         }
-#ifdef HAVE_PCAP_FREECODE
-        pcap_freecode(&fcode);
-#endif
+        free_capture_filter_program(&fcode);
     }
 
     return INITFILTER_NO_ERROR;
@@ -3110,6 +3438,8 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
     /* Set up to write to the capture file. */
     if (capture_opts->multi_files_on) {
         ld->pdh = ringbuf_init_libpcap_fdopen(&err);
+    } else if (async_writer_is_running() && !capture_opts->output_to_pipe) {
+        ld->pdh = async_writer_fdopen(ld->save_file_fd, &err);
     } else {
         ld->pdh = ws_fdopen(ld->save_file_fd, "wb");
         if (ld->pdh == NULL) {
@@ -3173,6 +3503,168 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
     return TRUE;
 }
 
+/*
+ * Gets the received and dropped counts of an interface, adding up those of
+ * all its sources if it's captured with --fanout.  Returns FALSE if the
+ * dropped count isn't known.
+ */
+static gboolean
+capture_loop_get_if_counts(loop_data *ld, guint interface_id,
+                           guint32 *received, guint32 *dropped)
+{
+    capture_src *pcap_src;
+    struct pcap_stat stats;
+    gboolean drops_known = TRUE;
+    guint i;
+
+    *received = 0;
+    *dropped = 0;
+    for (i = 0; i < ld->pcaps->len; i++) {
+        pcap_src = g_array_index(ld->pcaps, capture_src *, i);
+        if (pcap_src->interface_id != interface_id)
+            continue;
+        *received += pcap_src->received;
+        if (!pcap_src->from_cap_pipe && pcap_stats(pcap_src->pcap_h, &stats) >= 0) {
+            *dropped += stats.ps_drop + pcap_src->dropped + pcap_src->flushed;
+        } else {
+            drops_known = FALSE;
+        }
+    }
+    return drops_known;
+}
+
+/*
+ * Gives the ring buffer a summary of the file we're about to close, for
+ * "-b summary:1"; it's written next to the file once that's closed.
+ */
+static void
+capture_loop_set_file_summary(capture_options *capture_opts, loop_data *ld)
+{
+    GString *summary;
+    interface_options *interface_opts;
+    guint32 received, dropped;
+    guint i;
+
+    if (!capture_opts->ring_summary)
+        return;
+
+    summary = g_string_new(NULL);
+    g_string_append_printf(summary, "File: %s\n", ringbuf_current_filename());
+    g_string_append_printf(summary, "Packets: %d\n", ld->packets_written);
+    g_string_append_printf(summary, "Bytes: %" G_GUINT64_FORMAT "\n", ld->bytes_written);
+    if (ld->file_first_ts != 0) {
+        g_string_append_printf(summary, "First packet: %" G_GUINT64_FORMAT ".%09u\n",
+                               ld->file_first_ts / 1000000000, (guint)(ld->file_first_ts % 1000000000));
+        g_string_append_printf(summary, "Last packet: %" G_GUINT64_FORMAT ".%09u\n",
+                               ld->file_last_ts / 1000000000, (guint)(ld->file_last_ts % 1000000000));
+    }
+    /* The interface counters are for the whole capture so far */
+    for (i = 0; i < capture_opts->ifaces->len; i++) {
+        interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
+        if (capture_loop_get_if_counts(ld, i, &received, &dropped)) {
+            g_string_append_printf(summary, "Interface %u (%s): %u received, %u dropped\n", i,
+                                   interface_opts->display_name, received, dropped);
+        } else {
+            g_string_append_printf(summary, "Interface %u (%s): %u received\n", i,
+                                   interface_opts->display_name, received);
+        }
+    }
+    ringbuf_set_summary(g_string_free(summary, FALSE));
+}
+
+/*
+ * Gives the ring buffer the flow index of the file we're about to close,
+ * for "-b index:1"; it's written next to the file once that's closed.
+ */
+static void
+capture_loop_set_file_flow_index(capture_options *capture_opts, loop_data *ld)
+{
+    if (!capture_opts->ring_index)
+        return;
+
+    /* A file without packets gets an empty index */
+    ringbuf_set_flow_index(ld->flow_index != NULL ? ld->flow_index : flow_index_new());
+    ld->flow_index = NULL;
+}
+
+/*
+ * Waits for the writer thread, if there is one, to finish writing and
+ * closing the capture file, and picks up any error it got doing so.
+ */
+static gboolean
+capture_loop_wait_output(gboolean success, int *err_close)
+{
+    int err = async_writer_sync();
+
+    if (err != 0 && success) {
+        if (err_close != NULL)
+            *err_close = err;
+        return FALSE;
+    }
+    return success;
+}
+
+/*
+ * Makes sure that the packets written so far are in the capture file
+ * before we tell our parent, which reads the file, about them.
+ */
+static void
+capture_loop_flush_output(loop_data *ld)
+{
+    int err;
+
+    fflush(ld->pdh);
+    if (capture_child && (err = async_writer_sync()) != 0 && ld->err == 0) {
+        ld->go = FALSE;
+        ld->err = err;
+    }
+    ld->inpkts_to_sync_pipe += ld->inpkts_unwritten;
+    ld->inpkts_unwritten = 0;
+}
+
+/*
+ * Tells our parent about the packets written since the last report.
+ *
+ * With the writer thread, the capture loop doesn't wait for the disk: at
+ * each report interval ("interval" TRUE) the packets counted so far are
+ * handed to the writer thread, and they're reported, at this or a later
+ * call, once it has written them out.
+ */
+static void
+capture_loop_report_packets(loop_data *ld, gboolean interval)
+{
+    guint64 written;
+    int     err;
+
+    if (!capture_child || !async_writer_is_running()) {
+        if (interval && ld->inpkts_to_sync_pipe) {
+            capture_loop_flush_output(ld);
+            if (!quiet)
+                report_packet_count(ld->inpkts_to_sync_pipe);
+            ld->inpkts_to_sync_pipe = 0;
+        }
+        return;
+    }
+
+    if (interval && ld->inpkts_to_sync_pipe) {
+        if ((err = async_writer_flush()) != 0 && ld->err == 0) {
+            ld->go = FALSE;
+            ld->err = err;
+        }
+        ld->inpkts_unwritten += ld->inpkts_to_sync_pipe;
+        ld->inpkts_to_sync_pipe = 0;
+        ld->unwritten_bytes = async_writer_get_bytes(&written);
+    }
+    if (ld->inpkts_unwritten) {
+        async_writer_get_bytes(&written);
+        if (written >= ld->unwritten_bytes) {
+            if (!quiet)
+                report_packet_count(ld->inpkts_unwritten);
+            ld->inpkts_unwritten = 0;
+        }
+    }
+}
+
 static gboolean
 capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err_close)
 {
@@ -3181,32 +3673,39 @@ capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err
     capture_src *pcap_src;
     guint64      end_time = create_timestamp();
     gboolean success;
+    guint32      received, dropped;
 
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG, "capture_loop_close_output");
 
     if (capture_opts->multi_files_on) {
-        return ringbuf_libpcap_dump_close(&capture_opts->save_file, err_close);
+        capture_loop_set_file_summary(capture_opts, ld);
+        capture_loop_set_file_flow_index(capture_opts, ld);
+        return capture_loop_wait_output(ringbuf_libpcap_dump_close(&capture_opts->save_file, err_close),
+                                        err_close);
     } else {
         if (capture_opts->use_pcapng) {
-            for (i = 0; i < global_ld.pcaps->len; i++) {
+            for (i = 0; i < capture_opts->ifaces->len; i++) {
                 pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
                 if (!pcap_src->from_cap_pipe) {
                     guint64 isb_ifrecv, isb_ifdrop;
-                    struct pcap_stat stats;
+                    /* In the time stamp resolution of the interface's IDB */
+                    guint   ts_mul = pcap_src->ts_nsec ? 1000000000 : 1000000;
+                    guint64 ts_scale = pcap_src->ts_nsec ? 1000 : 1;
 
-                    if (pcap_stats(pcap_src->pcap_h, &stats) >= 0) {
-                        isb_ifrecv = pcap_src->received;
-                        isb_ifdrop = stats.ps_drop + pcap_src->dropped + pcap_src->flushed;
+                    if (capture_loop_get_if_counts(ld, i, &received, &dropped)) {
+                        isb_ifrecv = received;
+                        isb_ifdrop = dropped;
                    } else {
                         isb_ifrecv = G_MAXUINT64;
                         isb_ifdrop = G_MAXUINT64;
                     }
                     pcapng_write_interface_statistics_block(ld->pdh,
                                                             i,
+                                                            ts_mul,
                                                             &ld->bytes_written,
                                                             "Counters provided by dumpcap",
-                                                            start_time,
-                                                            end_time,
+                                                            start_time * ts_scale,
+                                                            end_time * ts_scale,
                                                             isb_ifrecv,
                                                             isb_ifdrop,
                                                             err_close);
@@ -3223,7 +3722,7 @@ capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err
         }
         g_free(ld->io_buffer);
         ld->io_buffer = NULL;
-        return success;
+        return capture_loop_wait_output(success, err_close);
     }
 }
 
@@ -3493,7 +3992,8 @@ capture_loop_open_output(capture_options *capture_opts, int *save_file_fd,
                 /* ringbuffer is enabled */
                 *save_file_fd = ringbuf_init(capfile_name,
                                              (capture_opts->has_ring_num_files) ? capture_opts->ring_num_files : 0,
-                                             capture_opts->group_read_access);
+                                             capture_opts->group_read_access,
+                                             capture_opts->ring_compress != NULL);
 
                 /* capfile_name is unused as the ringbuffer provides its own filename. */
                 if (*save_file_fd != -1) {
@@ -3643,12 +4143,16 @@ do_file_switch_or_stop(capture_options *capture_opts)
         }
 
         /* Switch to the next ringbuffer file */
+        capture_loop_set_file_summary(capture_opts, &global_ld);
+        capture_loop_set_file_flow_index(capture_opts, &global_ld);
         if (ringbuf_switch_file(&global_ld.pdh, &capture_opts->save_file,
                                 &global_ld.save_file_fd, &global_ld.err)) {
 
             /* File switch succeeded: reset the conditions */
             global_ld.bytes_written = 0;
             global_ld.packets_written = 0;
+            global_ld.file_first_ts = 0;
+            global_ld.file_last_ts = 0;
             if (capture_opts->use_pcapng) {
                 successful = capture_loop_init_pcapng_output(capture_opts, &global_ld);
             } else {
@@ -3672,7 +4176,7 @@ do_file_switch_or_stop(capture_options *capture_opts)
             if (global_ld.next_interval_time) {
                 global_ld.next_interval_time = get_next_time_interval(global_ld.interval_s);
             }
-            fflush(global_ld.pdh);
+            capture_loop_flush_output(&global_ld);
             if (!quiet)
                 report_packet_count(global_ld.inpkts_to_sync_pipe);
             global_ld.inpkts_to_sync_pipe = 0;
@@ -3773,7 +4277,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     char              secondary_errmsg[MSG_MAX_LENGTH+1];
     capture_src      *pcap_src;
     interface_options *interface_opts;
-    guint             i, error_index        = 0;
+    guint             i, j, error_index     = 0;
 
     *errmsg           = '\0';
     *secondary_errmsg = '\0';
@@ -3785,6 +4289,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     global_ld.report_packet_count = FALSE;
 #endif
     global_ld.inpkts_to_sync_pipe = 0;
+    global_ld.inpkts_unwritten    = 0;
     global_ld.err                 = 0;  /* no error seen yet */
     global_ld.pdh                 = NULL;
     global_ld.save_file_fd        = -1;
@@ -3793,6 +4298,14 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     global_ld.file_duration_timer = NULL;
     global_ld.next_interval_time  = 0;
     global_ld.interval_s          = 0;
+    global_ld.file_first_ts       = 0;
+    global_ld.file_last_ts        = 0;
+    global_ld.flow_index          = NULL;
+    global_ld.flow_policy         = NULL;
+    if (flow_max_packets != 0 || flow_max_bytes != 0 || flow_sample_rate > 1) {
+        global_ld.flow_policy = flow_policy_new(flow_max_packets, flow_max_bytes,
+                                                flow_sample_rate, flow_table_size);
+    }
 
     /* We haven't yet gotten the capture statistics. */
     *stats_known      = FALSE;
@@ -3805,9 +4318,9 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
                                  secondary_errmsg, sizeof(secondary_errmsg))) {
         goto error;
     }
-    for (i = 0; i < capture_opts->ifaces->len; i++) {
+    for (i = 0; i < global_ld.pcaps->len; i++) {
         pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
-        interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
+        interface_opts = &g_array_index(capture_opts->ifaces, interface_options, pcap_src->interface_id);
         /* init the input filter from the network interface (capture pipe will do nothing) */
         /*
          * When remote capturing WinPCap crashes when the capture filter
@@ -3823,7 +4336,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
 
         case INITFILTER_BAD_FILTER:
             cfilter_error = TRUE;
-            error_index = i;
+            error_index = pcap_src->interface_id;
             g_snprintf(errmsg, sizeof(errmsg), "%s", pcap_geterr(pcap_src->pcap_h));
             goto error;
 
@@ -3961,6 +4474,9 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             }
         } /* inpkts */
 
+        /* Report packets the writer thread has written out since the last update */
+        capture_loop_report_packets(&global_ld, FALSE);
+
         /* Only update once every 500ms so as not to overload slow displays.
          * This also prevents too much context-switching between the dumpcap
          * and wireshark processes.
@@ -3985,17 +4501,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             }
 #endif
             /* Let the parent process know. */
-            if (global_ld.inpkts_to_sync_pipe) {
-                /* do sync here */
-                fflush(global_ld.pdh);
-
-                /* Send our parent a message saying we've written out
-                   "global_ld.inpkts_to_sync_pipe" packets to the capture file. */
-                if (!quiet)
-                    report_packet_count(global_ld.inpkts_to_sync_pipe);
-
-                global_ld.inpkts_to_sync_pipe = 0;
-            }
+            capture_loop_report_packets(&global_ld, TRUE);
 
             /* check capture duration condition */
             if (autostop_duration_timer != NULL && g_timer_elapsed(autostop_duration_timer, NULL) >= capture_opts->autostop_duration) {
@@ -4051,7 +4557,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
         g_timer_destroy(autostop_duration_timer);
 
     /* did we have a pcap (input) error? */
-    for (i = 0; i < capture_opts->ifaces->len; i++) {
+    for (i = 0; i < global_ld.pcaps->len; i++) {
         pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
         if (pcap_src->pcap_err) {
             /* On Linux, if an interface goes down while you're capturing on it,
@@ -4121,6 +4627,8 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
 
     /* there might be packets not yet notified to the parent */
     /* (do this after closing the file, so all packets are already flushed) */
+    global_ld.inpkts_to_sync_pipe += global_ld.inpkts_unwritten;
+    global_ld.inpkts_unwritten = 0;
     if (global_ld.inpkts_to_sync_pipe) {
         if (!quiet)
             report_packet_count(global_ld.inpkts_to_sync_pipe);
@@ -4146,35 +4654,62 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
      */
 
     report_capture_count(TRUE);
+    report_write_buffers();
+    report_flow_policy();
 
     /* get packet drop statistics from pcap */
     for (i = 0; i < capture_opts->ifaces->len; i++) {
-        guint32 received;
+        guint32 received = 0;
         guint32 pcap_dropped = 0;
+        guint32 dropped = 0;
+        guint32 flushed = 0;
+#ifdef PACKET_FANOUT
+        guint   socket_num = 0;
+#endif
 
-        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
         interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
-        received = pcap_src->received;
-        if (pcap_src->pcap_h != NULL) {
-            g_assert(!pcap_src->from_cap_pipe);
-            /* Get the capture statistics, so we know how many packets were dropped. */
-            if (pcap_stats(pcap_src->pcap_h, stats) >= 0) {
-                *stats_known = TRUE;
-                /* Let the parent process know. */
-                pcap_dropped += stats->ps_drop;
-            } else {
-                g_snprintf(errmsg, sizeof(errmsg),
-                           "Can't get packet-drop statistics: %s",
-                           pcap_geterr(pcap_src->pcap_h));
-                report_capture_error(errmsg, please_report_bug());
+        /* With --fanout, add up the counts of the interface's sockets. */
+        for (j = 0; j < global_ld.pcaps->len; j++) {
+            guint32 src_pcap_dropped = 0;
+
+            pcap_src = g_array_index(global_ld.pcaps, capture_src *, j);
+            if (pcap_src->interface_id != i)
+                continue;
+            if (pcap_src->pcap_h != NULL) {
+                g_assert(!pcap_src->from_cap_pipe);
+                /* Get the capture statistics, so we know how many packets were dropped. */
+                if (pcap_stats(pcap_src->pcap_h, stats) >= 0) {
+                    *stats_known = TRUE;
+                    /* Let the parent process know. */
+                    src_pcap_dropped = stats->ps_drop;
+                } else {
+                    g_snprintf(errmsg, sizeof(errmsg),
+                               "Can't get packet-drop statistics: %s",
+                               pcap_geterr(pcap_src->pcap_h));
+                    report_capture_error(errmsg, please_report_bug());
+                }
+#ifdef PACKET_FANOUT
+                if (fanout_sockets > 1) {
+                    report_fanout_socket_drops(++socket_num, pcap_src->received, src_pcap_dropped,
+                                               pcap_src->dropped, pcap_src->flushed,
+                                               interface_opts->display_name);
+                }
+#endif
             }
+            received += pcap_src->received;
+            pcap_dropped += src_pcap_dropped;
+            dropped += pcap_src->dropped;
+            flushed += pcap_src->flushed;
         }
-        report_packet_drops(received, pcap_dropped, pcap_src->dropped, pcap_src->flushed, stats->ps_ifdrop, interface_opts->display_name);
+        report_packet_drops(received, pcap_dropped, dropped, flushed, stats->ps_ifdrop, interface_opts->display_name);
     }
 
     /* close the input file (pcap or capture pipe) */
     capture_loop_close_input(&global_ld);
 
+    flow_policy_free(global_ld.flow_policy);
+    global_ld.flow_policy = NULL;
+
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO, "Capture loop stopped.");
 
     /* ok, if the write and the close were successful. */
@@ -4205,6 +4740,9 @@ error:
     /* close the input file (pcap or cap_pipe) */
     capture_loop_close_input(&global_ld);
 
+    flow_policy_free(global_ld.flow_policy);
+    global_ld.flow_policy = NULL;
+
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO, "Capture loop stopped with error");
 
     return FALSE;
@@ -4319,6 +4857,8 @@ static void
 capture_loop_write_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t *bh, u_char *pd)
 {
     int          err;
+    guint32      iface_id, ts_high, ts_low;
+    guint64      ts_units, ts;
 
     /*
      * This should never be called if we're not writing pcapng.
@@ -4371,6 +4911,22 @@ capture_loop_write_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t
                   "Wrote a pcapng block type %u of length %d captured on interface %u.",
                    bh->block_type, bh->block_total_length, pcap_src->interface_id);
 #endif
+            if (global_capture_opts.ring_summary && bh->block_type == BLOCK_TYPE_EPB) {
+                /* The interface ID has been rewritten to the index of its saved IDB. */
+                memcpy(&iface_id, pd + sizeof(pcapng_block_header_t), 4);
+                memcpy(&ts_high, pd + sizeof(pcapng_block_header_t) + 4, 4);
+                memcpy(&ts_low, pd + sizeof(pcapng_block_header_t) + 8, 4);
+                ts_units = iface_id < global_ld.saved_idbs->len ?
+                    g_array_index(global_ld.saved_idbs, saved_idb_t, iface_id).ts_units : 0;
+                if (ts_units != 0) {
+                    ts = ((guint64)ts_high << 32) | ts_low;
+                    ts = (ts / ts_units) * 1000000000 +
+                         (guint64)((double)(ts % ts_units) * 1000000000 / ts_units);
+                    global_ld.file_last_ts = ts;
+                    if (global_ld.file_first_ts == 0)
+                        global_ld.file_first_ts = ts;
+                }
+            }
             capture_loop_wrote_one_packet(pcap_src);
         }
     }
@@ -4384,6 +4940,8 @@ capture_loop_write_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
     capture_src *pcap_src = (capture_src *) (void *) pcap_src_p;
     int          err;
     guint        ts_mul    = pcap_src->ts_nsec ? 1000000000 : 1000000;
+    guint64      offset    = global_ld.bytes_written;
+    guint64      ts;
 
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG, "capture_loop_write_packet_cb");
 
@@ -4395,6 +4953,14 @@ capture_loop_write_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
         return;
     }
 
+    /* Packets the flow policy leaves out were received, not dropped. */
+    if (global_ld.flow_policy != NULL &&
+        !flow_policy_keep_packet(global_ld.flow_policy, pcap_src->linktype, pd,
+                                 phdr->caplen, phdr->len)) {
+        pcap_src->received++;
+        return;
+    }
+
     if (global_ld.pdh) {
         gboolean successful;
 
@@ -4427,6 +4993,19 @@ capture_loop_write_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
                   "Wrote a pcap packet of length %d captured on interface %u.",
                    phdr->caplen, pcap_src->interface_id);
 #endif
+            ts = (guint64)phdr->ts.tv_sec * 1000000000 +
+                 (guint64)phdr->ts.tv_usec * (pcap_src->ts_nsec ? 1 : 1000);
+            if (global_capture_opts.ring_summary) {
+                global_ld.file_last_ts = ts;
+                if (global_ld.file_first_ts == 0)
+                    global_ld.file_first_ts = ts;
+            }
+            if (global_capture_opts.multi_files_on && global_capture_opts.ring_index) {
+                if (global_ld.flow_index == NULL)
+                    global_ld.flow_index = flow_index_new();
+                flow_index_add_packet(global_ld.flow_index, pcap_src->linktype, pd,
+                                      phdr->caplen, phdr->len, ts, offset);
+            }
             capture_loop_wrote_one_packet(pcap_src);
         }
     }
@@ -4634,6 +5213,16 @@ main(int argc, char *argv[])
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'v'},
         LONGOPT_CAPTURE_COMMON
+        {"write-buffers", required_argument, NULL, LONGOPT_WRITE_BUFFERS},
+        {"direct-io", no_argument, NULL, LONGOPT_DIRECT_IO},
+#ifdef PACKET_FANOUT
+        {"fanout", required_argument, NULL, LONGOPT_FANOUT},
+#endif
+        {"flow-packets", required_argument, NULL, LONGOPT_FLOW_PACKETS},
+        {"flow-bytes", required_argument, NULL, LONGOPT_FLOW_BYTES},
+        {"flow-sample", required_argument, NULL, LONGOPT_FLOW_SAMPLE},
+        {"flow-table-size", required_argument, NULL, LONGOPT_FLOW_TABLE_SIZE},
+        {"cache-filters", no_argument, NULL, LONGOPT_CACHE_FILTERS},
         {0, 0, 0, 0 }
     };
 
@@ -5084,6 +5673,36 @@ main(int argc, char *argv[])
         case 'N':
             pcap_queue_packet_limit = get_positive_int(optarg, "packet_limit");
             break;
+        case LONGOPT_WRITE_BUFFERS:
+            write_buffers = get_positive_int(optarg, "number of write buffers");
+            break;
+        case LONGOPT_DIRECT_IO:
+            direct_io = TRUE;
+            break;
+#ifdef PACKET_FANOUT
+        case LONGOPT_FANOUT:
+            fanout_sockets = get_positive_int(optarg, "number of fanout sockets");
+            if (fanout_sockets > MAX_FANOUT_SOCKETS) {
+                cmdarg_err("At most %u fanout sockets can be used.", MAX_FANOUT_SOCKETS);
+                arg_error = TRUE;
+            }
+            break;
+#endif
+        case LONGOPT_FLOW_PACKETS:
+            flow_max_packets = get_nonzero_guint32(optarg, "number of packets per flow");
+            break;
+        case LONGOPT_FLOW_BYTES:
+            flow_max_bytes = get_nonzero_guint32(optarg, "number of bytes per flow");
+            break;
+        case LONGOPT_FLOW_SAMPLE:
+            flow_sample_rate = get_nonzero_guint32(optarg, "flow sampling rate");
+            break;
+        case LONGOPT_FLOW_TABLE_SIZE:
+            flow_table_size = get_nonzero_guint32(optarg, "flow table size");
+            break;
+        case LONGOPT_CACHE_FILTERS:
+            capture_filter_cache_use_files(TRUE);
+            break;
         default:
             cmdarg_err("Invalid Option: %s", argv[optind-1]);
             /* FALLTHROUGH */
@@ -5114,6 +5733,12 @@ main(int argc, char *argv[])
     if ((pcap_queue_byte_limit > 0) || (pcap_queue_packet_limit > 0)) {
         use_threads = TRUE;
     }
+#ifdef PACKET_FANOUT
+    if (fanout_sockets > 1) {
+        /* Each socket gets its own thread */
+        use_threads = TRUE;
+    }
+#endif
     if ((pcap_queue_byte_limit == 0) && (pcap_queue_packet_limit == 0)) {
         /* Use some default if the user hasn't specified some */
         /* XXX: Are these defaults good enough? */
@@ -5164,6 +5789,13 @@ main(int argc, char *argv[])
             if (global_capture_opts.save_file == NULL) {
                 cmdarg_err("Ring buffer requested, but capture isn't being saved to a permanent file.");
                 global_capture_opts.multi_files_on = FALSE;
+                if (global_capture_opts.ring_compress != NULL ||
+                    global_capture_opts.ring_summary ||
+                    global_capture_opts.ring_index) {
+                    /* Nothing would be written for them */
+                    cmdarg_err("Ring buffer compression, summaries and flow indexes need a ring buffer.");
+                    exit_main(1);
+                }
             }
             if (!global_capture_opts.has_autostop_filesize &&
                 !global_capture_opts.has_file_duration &&
@@ -5362,6 +5994,19 @@ main(int argc, char *argv[])
     /* We're supposed to do a capture.  Process the ring buffer arguments. */
     capture_opts_trim_ring_num_files(&global_capture_opts);
 
+    if (write_buffers > 0) {
+        int err;
+
+        if (!async_writer_init(write_buffers, WRITE_BUFFER_SIZE, direct_io, &err)) {
+            cmdarg_err("The capture file can't be written from a separate thread: %s.",
+                       g_strerror(err));
+            exit_main(1);
+        }
+    } else if (direct_io) {
+        cmdarg_err("--direct-io requires --write-buffers.");
+        exit_main(1);
+    }
+
     /* flush stderr prior to starting the main capture loop */
     fflush(stderr);
 
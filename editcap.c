@@ -102,21 +102,50 @@ struct select_item {
 
 /*
  * Duplicate frame detection
+ *
+ * The frames in the window are kept in a ring, oldest first, each with a
+ * copy of the bytes that are compared.  Every entry is also in a chain,
+ * picked by its hash, of the entries with that hash, so a frame is only
+ * compared with the frames that are likely to be the same.
+ *
+ * The copies are limited to MAX_DUP_DATA_BYTES in all; the frames added to
+ * a window holding that much are kept without one, and match the frames
+ * with the same length and 128-bit hash.
  */
 typedef struct _fd_hash_t {
-    guint8     digest[16];
+    guint64    hash[2];     /* of the compared bytes */
     guint32    len;
+    guint8    *data;        /* the compared bytes, or NULL */
+    guint32    data_len;
     nstime_t   frame_time;
+    int        prev;        /* neighbours in the chain, or -1 */
+    int        next;
 } fd_hash_t;
 
-#define DEFAULT_DUP_DEPTH       5   /* Used with -d */
-#define MAX_DUP_DEPTH     1000000   /* the maximum window (and actual size of fd_hash[]) for de-duplication */
-
-static fd_hash_t fd_hash[MAX_DUP_DEPTH];
-static int       dup_window    = DEFAULT_DUP_DEPTH;
-static int       cur_dup_entry = 0;
+/* Bytes left out of the comparison, counted from the start of the frame */
+typedef struct _ignored_range_t {
+    guint32    offset;
+    guint32    len;
+} ignored_range_t;
 
-static guint32   ignored_bytes  = 0;  /* Used with -I */
+#define DEFAULT_DUP_DEPTH       5   /* Used with -d */
+#define MAX_DUP_DEPTH     1000000   /* the maximum window (and size of fd_hash[]) for de-duplication */
+#define MAX_DUP_DATA_BYTES (64 * 1024 * 1024) /* the most memory the copies of the frames in the window use */
+
+static fd_hash_t *fd_hash          = NULL;  /* the ring */
+static int        dup_slots        = 0;     /* size of fd_hash[] */
+static int        dup_entries      = 0;     /* entries in use */
+static int        oldest_dup_entry = 0;
+static int        cur_dup_entry    = 0;     /* the newest entry */
+static int       *dup_chains       = NULL;  /* first entry of each chain, or -1 */
+static guint32    dup_chain_mask   = 0;
+static int        dup_window       = DEFAULT_DUP_DEPTH;
+static guint8     cur_dup_md5[16];          /* of the current frame, with -v */
+static GByteArray *dup_scratch     = NULL;  /* compared bytes, ignored ranges zeroed */
+static gsize      dup_data_bytes   = 0;     /* bytes of the copies in the window */
+
+static guint32   ignored_bytes  = 0;     /* Used with -I */
+static GArray   *ignored_ranges = NULL;  /* Used with --ignore-bytes */
 
 #define ONE_BILLION 1000000000
 
@@ -586,165 +615,273 @@ remove_vlan_info(const wtap_packet_header *phdr, guint8* fd, guint32* len) {
     }
 }
 
-static gboolean
-is_duplicate(guint8* fd, guint32 len) {
-    int i;
-    const struct ieee80211_radiotap_header* tap_header;
-
-    /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
-    guint32 offset = ignored_bytes;
-    guint32 new_len;
-    guint8 *new_fd;
-
-    if (len <= ignored_bytes) {
-        offset = 0;
-    }
+static void
+dup_window_init(void)
+{
+    guint32 chains;
+    guint32 i;
+
+    dup_slots = MAX(dup_window, 1);
+    fd_hash = g_new0(fd_hash_t, dup_slots);
+    dup_entries = 0;
+    oldest_dup_entry = 0;
+    cur_dup_entry = dup_slots - 1;
+
+    /* A power of two, at least twice the window, so the hash can be masked */
+    for (chains = 16; chains < (guint32)dup_slots * 2; chains *= 2)
+        ;
+    dup_chains = g_new(int, chains);
+    for (i = 0; i < chains; i++)
+        dup_chains[i] = -1;
+    dup_chain_mask = chains - 1;
+
+    if (ignored_ranges != NULL)
+        dup_scratch = g_byte_array_new();
+}
 
-    /* Get the size of radiotap header and use that as offset (-p option) */
-    if (skip_radiotap == TRUE) {
-        tap_header = (const struct ieee80211_radiotap_header*)fd;
-        offset = pletoh16(&tap_header->it_len);
-        if (offset >= len)
-            offset = 0;
+/* Removes the oldest frame from the window */
+static void
+dup_evict_oldest(void)
+{
+    fd_hash_t *entry = &fd_hash[oldest_dup_entry];
+
+    if (entry->prev != -1)
+        fd_hash[entry->prev].next = entry->next;
+    else
+        dup_chains[entry->hash[0] & dup_chain_mask] = entry->next;
+    if (entry->next != -1)
+        fd_hash[entry->next].prev = entry->prev;
+    if (entry->data != NULL) {
+        dup_data_bytes -= entry->data_len;
+        g_free(entry->data);
+        entry->data = NULL;
     }
 
-    new_fd  = &fd[offset];
-    new_len = len - (offset);
-
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
+    oldest_dup_entry = (oldest_dup_entry + 1) % dup_slots;
+    dup_entries--;
+}
 
-    /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
+static void
+dup_window_cleanup(void)
+{
+    while (dup_entries > 0)
+        dup_evict_oldest();
+    g_free(fd_hash);
+    fd_hash = NULL;
+    g_free(dup_chains);
+    dup_chains = NULL;
+    if (dup_scratch != NULL) {
+        g_byte_array_free(dup_scratch, TRUE);
+        dup_scratch = NULL;
+    }
+}
 
-    fd_hash[cur_dup_entry].len = len;
+static inline guint64
+dup_rotl64(guint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
 
-    /* Look for duplicates */
-    for (i = 0; i < dup_window; i++) {
-        if (i == cur_dup_entry)
-            continue;
+static inline guint64
+dup_fmix64(guint64 k)
+{
+    k ^= k >> 33;
+    k *= G_GUINT64_CONSTANT(0xff51afd7ed558ccd);
+    k ^= k >> 33;
+    k *= G_GUINT64_CONSTANT(0xc4ceb9fe1a85ec53);
+    k ^= k >> 33;
+    return k;
+}
 
-        if (fd_hash[i].len == fd_hash[cur_dup_entry].len
-            && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return TRUE;
+/*
+ * A 128-bit hash of a frame, after MurmurHash3_x64_128: two 64-bit lanes
+ * eat 16 bytes a round, and the last few bytes are padded with zeroes.
+ * It's only used to find frames that might be the same, so it needn't be
+ * the same on hosts with a different byte order.
+ */
+static void
+dup_hash128(const guint8 *data, guint32 len, guint64 hash[2])
+{
+    const guint64 c1 = G_GUINT64_CONSTANT(0x87c37b91114253d5);
+    const guint64 c2 = G_GUINT64_CONSTANT(0x4cf5ad432745937f);
+    guint64 h1 = 0, h2 = 0;
+    guint64 k[2];
+    guint8  tail[16];
+    guint32 off;
+
+    for (off = 0; off < len; off += 16) {
+        if (len - off >= 16) {
+            memcpy(k, data + off, 16);
+        } else {
+            memset(tail, 0, sizeof tail);
+            memcpy(tail, data + off, len - off);
+            memcpy(k, tail, 16);
         }
+
+        k[0] *= c1;
+        k[0] = dup_rotl64(k[0], 31);
+        k[0] *= c2;
+        h1 ^= k[0];
+        h1 = dup_rotl64(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k[1] *= c2;
+        k[1] = dup_rotl64(k[1], 33);
+        k[1] *= c1;
+        h2 ^= k[1];
+        h2 = dup_rotl64(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
     }
 
-    return FALSE;
+    h1 ^= len;
+    h2 ^= len;
+    h1 += h2;
+    h2 += h1;
+    h1 = dup_fmix64(h1);
+    h2 = dup_fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    hash[0] = h1;
+    hash[1] = h2;
 }
 
-static gboolean
-is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
-    int i;
+/*
+ * Gets the bytes of a frame that are compared: all of them but those at
+ * the start skipped with -I or --skip-radiotap-header, with the ranges
+ * given with --ignore-bytes set to zero.
+ */
+static const guint8 *
+dup_compared_bytes(const guint8 *fd, guint32 len, guint32 *compared_len)
+{
+    const struct ieee80211_radiotap_header* tap_header;
+    guint32 base = 0;   /* where --ignore-bytes offsets start */
+    guint32 offset;
+    guint   i;
 
     /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
-    guint32 offset = ignored_bytes;
-    guint32 new_len;
-    guint8 *new_fd;
-
+    offset = ignored_bytes;
     if (len <= ignored_bytes) {
         offset = 0;
     }
 
-    new_fd  = &fd[offset];
-    new_len = len - (offset);
-
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
-
-    /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
-
-    fd_hash[cur_dup_entry].len = len;
-    fd_hash[cur_dup_entry].frame_time.secs = current->secs;
-    fd_hash[cur_dup_entry].frame_time.nsecs = current->nsecs;
-
-    /*
-     * Look for relative time related duplicates.
-     * This is hopefully a reasonably efficient mechanism for
-     * finding duplicates by rel time in the fd_hash[] cache.
-     * We check starting from the most recently added hash
-     * entries and work backwards towards older packets.
-     * This approach allows the dup test to be terminated
-     * when the relative time of a cached entry is found to
-     * be beyond the dup time window.
-     *
-     * Of course this assumes that the input trace file is
-     * "well-formed" in the sense that the packet timestamps are
-     * in strict chronologically increasing order (which is NOT
-     * always the case!!).
-     *
-     * The fd_hash[] table was deliberately created large (1,000,000).
-     * Looking for time related duplicates in large trace files with
-     * non-fractional dup time window values can potentially take
-     * a long time to complete.
-     */
+    /* Get the size of radiotap header and use that as offset (-p option) */
+    if (skip_radiotap == TRUE) {
+        tap_header = (const struct ieee80211_radiotap_header*)fd;
+        offset = pletoh16(&tap_header->it_len);
+        if (offset >= len)
+            offset = 0;
+        base = offset;
+    }
 
-    for (i = cur_dup_entry - 1;; i--) {
-        nstime_t delta;
-        int cmp;
+    *compared_len = len - offset;
+    if (ignored_ranges == NULL)
+        return &fd[offset];
+
+    g_byte_array_set_size(dup_scratch, *compared_len);
+    memcpy(dup_scratch->data, &fd[offset], *compared_len);
+    for (i = 0; i < ignored_ranges->len; i++) {
+        const ignored_range_t *range = &g_array_index(ignored_ranges, ignored_range_t, i);
+        guint64 start = (guint64)base + range->offset;
+        guint64 end = start + range->len;
+
+        if (start < offset)
+            start = offset;
+        if (end > len)
+            end = len;
+        if (start < end)
+            memset(&dup_scratch->data[start - offset], 0, (size_t)(end - start));
+    }
+    return dup_scratch->data;
+}
 
-        if (i < 0)
-            i = dup_window - 1;
+/*
+ * Returns TRUE if a frame is the same as one in the window, and adds it
+ * to the window.  Without a "current" time, the window is the previous
+ * dup_window - 1 frames; with one, it's the frames that arrived no more
+ * than relative_time_window before it.
+ *
+ * Finding duplicates by time assumes that the frames are in
+ * chronological order: frames are dropped from the window, oldest first,
+ * once the current frame arrived more than relative_time_window after
+ * them, and a frame whose time is after the current frame's isn't a
+ * duplicate of it.
+ */
+static gboolean
+is_duplicate(const guint8* fd, guint32 len, const nstime_t *current) {
+    const guint8 *data;
+    guint32 data_len;
+    guint64 hash[2];
+    fd_hash_t *entry;
+    nstime_t delta;
+    int *chain;
+    int i;
+    gboolean dup = FALSE;
 
-        if (i == cur_dup_entry) {
-            /*
-             * We've decremented back to where we started.
-             * Check no more!
-             */
-            break;
-        }
+    data = dup_compared_bytes(fd, len, &data_len);
+    dup_hash128(data, data_len, hash);
 
-        if (nstime_is_unset(&(fd_hash[i].frame_time))) {
-            /*
-             * We've decremented to an unused fd_hash[] entry.
-             * Check no more!
-             */
-            break;
+    /* The MD5 hash is only wanted for the verbose output */
+    if (verbose)
+        gcry_md_hash_buffer(GCRY_MD_MD5, cur_dup_md5, data, data_len);
+
+    /* Make room for the frame, and drop the frames that are too old */
+    if (dup_entries == dup_slots)
+        dup_evict_oldest();
+    if (current != NULL) {
+        while (dup_entries > 0) {
+            nstime_delta(&delta, current, &fd_hash[oldest_dup_entry].frame_time);
+            if (nstime_cmp(&delta, &relative_time_window) <= 0)
+                break;
+            dup_evict_oldest();
         }
+    }
 
-        nstime_delta(&delta, current, &fd_hash[i].frame_time);
-
-        if (delta.secs < 0 || delta.nsecs < 0) {
-            /*
-             * A negative delta implies that the current packet
-             * has an absolute timestamp less than the cached packet
-             * that it is being compared to.  This is NOT a normal
-             * situation since trace files usually have packets in
-             * chronological order (oldest to newest).
-             *
-             * There are several possible ways to deal with this:
-             * 1. 'continue' dup checking with the next cached frame.
-             * 2. 'break' from looking for a duplicate of the current frame.
-             * 3. Take the absolute value of the delta and see if that
-             * falls within the specifed dup time window.
-             *
-             * Currently this code does option 1.  But it would pretty
-             * easy to add yet-another-editcap-option to select one of
-             * the other behaviors for dealing with out-of-sequence
-             * packets.
-             */
+    /* Look for duplicates */
+    chain = &dup_chains[hash[0] & dup_chain_mask];
+    for (i = *chain; i != -1; i = fd_hash[i].next) {
+        entry = &fd_hash[i];
+        if (entry->hash[0] != hash[0] || entry->hash[1] != hash[1]
+            || entry->len != len || entry->data_len != data_len
+            || (entry->data != NULL && memcmp(entry->data, data, data_len) != 0))
             continue;
-        }
 
-        cmp = nstime_cmp(&delta, &relative_time_window);
-
-        if (cmp > 0) {
-            /*
-             * The delta time indicates that we are now looking at
-             * cached packets beyond the specified dup time window.
-             * Check no more!
-             */
-            break;
-        } else if (fd_hash[i].len == fd_hash[cur_dup_entry].len
-                   && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return TRUE;
+        if (current != NULL) {
+            nstime_delta(&delta, current, &entry->frame_time);
+            if (delta.secs < 0 || delta.nsecs < 0
+                || nstime_cmp(&delta, &relative_time_window) > 0)
+                continue;
         }
+        dup = TRUE;
+        break;
     }
 
-    return FALSE;
+    /* Add the frame to the window, whether it's a duplicate or not */
+    cur_dup_entry = (cur_dup_entry + 1) % dup_slots;
+    entry = &fd_hash[cur_dup_entry];
+    entry->hash[0] = hash[0];
+    entry->hash[1] = hash[1];
+    entry->len = len;
+    if (data_len != 0 && dup_data_bytes + data_len <= MAX_DUP_DATA_BYTES) {
+        entry->data = (guint8 *)g_memdup(data, data_len);
+        dup_data_bytes += data_len;
+    } else {
+        entry->data = NULL;
+    }
+    entry->data_len = data_len;
+    if (current != NULL)
+        entry->frame_time = *current;
+    else
+        nstime_set_unset(&entry->frame_time);
+    entry->prev = -1;
+    entry->next = *chain;
+    if (*chain != -1)
+        fd_hash[*chain].prev = cur_dup_entry;
+    *chain = cur_dup_entry;
+    dup_entries++;
+
+    return dup;
 }
 
 static void
@@ -770,6 +907,11 @@ print_usage(FILE *output)
     fprintf(output, "                         Valid <dup window> values are 0 to %d.\n", MAX_DUP_DEPTH);
     fprintf(output, "                         NOTE: A <dup window> of 0 with -v (verbose option) is\n");
     fprintf(output, "                         useful to print MD5 hashes.\n");
+    fprintf(output, "  --ignore-bytes <offset>:<length>\n");
+    fprintf(output, "                         leave <length> bytes at <offset> from the start of\n");
+    fprintf(output, "                         the frame out when checking for duplicates, e.g. the\n");
+    fprintf(output, "                         IPv4 TTL and header checksum of frames captured on\n");
+    fprintf(output, "                         both sides of a router. May be used more than once.\n");
     fprintf(output, "  -w <dup time window>   remove packet if duplicate packet is found EQUAL TO OR\n");
     fprintf(output, "                         LESS THAN <dup time window> prior to current packet.\n");
     fprintf(output, "                         A <dup time window> is specified in relative seconds\n");
@@ -814,7 +956,7 @@ print_usage(FILE *output)
     fprintf(output, "                         the pseudo-random number generator. This allows one to\n");
     fprintf(output, "                         repeat a particular sequence of errors.\n");
     fprintf(output, "  -I <bytes to ignore>   ignore the specified number of bytes at the beginning\n");
-    fprintf(output, "                         of the frame during MD5 hash calculation, unless the\n");
+    fprintf(output, "                         of the frame when checking for duplicates, unless the\n");
     fprintf(output, "                         frame is too short, then the full frame is used.\n");
     fprintf(output, "                         Useful to remove duplicated packets taken on\n");
     fprintf(output, "                         several routers (different mac addresses for\n");
@@ -1022,12 +1164,14 @@ main(int argc, char *argv[])
 #define LONGOPT_SEED                 0x8102
 #define LONGOPT_INJECT_SECRETS       0x8103
 #define LONGOPT_DISCARD_ALL_SECRETS  0x8104
+#define LONGOPT_IGNORE_BYTES         0x8105
     static const struct option long_options[] = {
         {"novlan", no_argument, NULL, LONGOPT_NO_VLAN},
         {"skip-radiotap-header", no_argument, NULL, LONGOPT_SKIP_RADIOTAP_HEADER},
         {"seed", required_argument, NULL, LONGOPT_SEED},
         {"inject-secrets", required_argument, NULL, LONGOPT_INJECT_SECRETS},
         {"discard-all-secrets", no_argument, NULL, LONGOPT_DISCARD_ALL_SECRETS},
+        {"ignore-bytes", required_argument, NULL, LONGOPT_IGNORE_BYTES},
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'V'},
         {0, 0, 0, 0 }
@@ -1167,6 +1311,27 @@ main(int argc, char *argv[])
             break;
         }
 
+        case LONGOPT_IGNORE_BYTES:
+        {
+            ignored_range_t range;
+            gchar **splitted = g_strsplit(optarg, ":", 2);
+            if (splitted[0] == NULL || splitted[1] == NULL
+                || !ws_strtou32(splitted[0], NULL, &range.offset)
+                || !ws_strtou32(splitted[1], NULL, &range.len)
+                || range.len == 0) {
+                fprintf(stderr, "editcap: \"%s\" isn't a valid byte range; expected <offset>:<length>\n",
+                        optarg);
+                g_strfreev(splitted);
+                ret = INVALID_OPTION;
+                goto clean_exit;
+            }
+            if (!ignored_ranges)
+                ignored_ranges = g_array_new(FALSE, FALSE, sizeof(ignored_range_t));
+            g_array_append_val(ignored_ranges, range);
+            g_strfreev(splitted);
+            break;
+        }
+
         case 'a':
         {
             guint frame_number;
@@ -1572,13 +1737,8 @@ main(int argc, char *argv[])
     if (keep_em == FALSE)
         max_packet_number = G_MAXUINT;
 
-    if (dup_detect || dup_detect_by_time) {
-        for (i = 0; i < dup_window; i++) {
-            memset(&fd_hash[i].digest, 0, 16);
-            fd_hash[i].len = 0;
-            nstime_set_unset(&fd_hash[i].frame_time);
-        }
-    }
+    if (dup_detect || dup_detect_by_time)
+        dup_window_init();
 
     /* Read all of the packets in turn */
     wtap_rec_init(&read_rec);
@@ -1859,14 +2019,14 @@ main(int argc, char *argv[])
 
                 /* suppress duplicates by packet window */
                 if (dup_detect) {
-                    if (is_duplicate(buf, rec->rec_header.packet_header.caplen)) {
+                    if (is_duplicate(buf, rec->rec_header.packet_header.caplen, NULL)) {
                         if (verbose) {
                             fprintf(stderr, "Skipped: %u, Len: %u, MD5 Hash: ",
                                     count,
                                     rec->rec_header.packet_header.caplen);
                             for (i = 0; i < 16; i++)
                                 fprintf(stderr, "%02x",
-                                        (unsigned char)fd_hash[cur_dup_entry].digest[i]);
+                                        cur_dup_md5[i]);
                             fprintf(stderr, "\n");
                         }
                         duplicate_count++;
@@ -1879,7 +2039,7 @@ main(int argc, char *argv[])
                                     rec->rec_header.packet_header.caplen);
                             for (i = 0; i < 16; i++)
                                 fprintf(stderr, "%02x",
-                                        (unsigned char)fd_hash[cur_dup_entry].digest[i]);
+                                        cur_dup_md5[i]);
                             fprintf(stderr, "\n");
                         }
                     }
@@ -1893,16 +2053,16 @@ main(int argc, char *argv[])
                         current.secs  = rec->ts.secs;
                         current.nsecs = rec->ts.nsecs;
 
-                        if (is_duplicate_rel_time(buf,
-                                                  rec->rec_header.packet_header.caplen,
-                                                  &current)) {
+                        if (is_duplicate(buf,
+                                         rec->rec_header.packet_header.caplen,
+                                         &current)) {
                             if (verbose) {
                                 fprintf(stderr, "Skipped: %u, Len: %u, MD5 Hash: ",
                                         count,
                                         rec->rec_header.packet_header.caplen);
                                 for (i = 0; i < 16; i++)
                                     fprintf(stderr, "%02x",
-                                            (unsigned char)fd_hash[cur_dup_entry].digest[i]);
+                                            cur_dup_md5[i]);
                                 fprintf(stderr, "\n");
                             }
                             duplicate_count++;
@@ -1915,7 +2075,7 @@ main(int argc, char *argv[])
                                         rec->rec_header.packet_header.caplen);
                                 for (i = 0; i < 16; i++)
                                     fprintf(stderr, "%02x",
-                                            (unsigned char)fd_hash[cur_dup_entry].digest[i]);
+                                            cur_dup_md5[i]);
                                 fprintf(stderr, "\n");
                             }
                         }
@@ -2104,6 +2264,9 @@ main(int argc, char *argv[])
     }
 
 clean_exit:
+    dup_window_cleanup();
+    if (ignored_ranges)
+        g_array_free(ignored_ranges, TRUE);
     if (dsb_filenames) {
         g_array_free(dsb_types, TRUE);
         g_ptr_array_free(dsb_filenames, TRUE);
@@ -0,0 +1,523 @@
+/*
+ * Field value index, and answering display filters from it
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 2001 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include "dfilter-int.h"
+#include "syntax-tree.h"
+#include "sttype-test.h"
+#include <epan/epan.h>
+#include <epan/epan_dissect.h>
+#include <epan/ftypes/ftypes.h>
+
+/*
+ * The index records, for a configured set of fields, in which frames each
+ * field occurs and in which frames it has each of its values.  It is filled
+ * in as frames are dissected for the first time.
+ *
+ * When a display filter is compiled, its syntax tree is checked for being
+ * made up only of existence tests, "==" tests and "in" sets of plain values
+ * against fields, combined with "and", "or" and "not".  If it is, a plan
+ * mirroring that structure is kept with the filter, and the set of frames
+ * matching the filter can be computed from the index without dissecting
+ * anything.
+ *
+ * Only values with a simple notion of equality are indexed: integers,
+ * IPv4 addresses and strings.
+ */
+
+/* Frame numbers are kept in GArrays of guint32, in ascending order. */
+typedef struct {
+	header_field_info	*hfinfo;	/* First field with this name */
+	GArray			*present;	/* Frames in which the field occurs */
+	GHashTable		*values;	/* Index key -> frames with that value */
+} dfilter_index_field_t;
+
+struct epan_dfilter_index {
+	GPtrArray		*fields;	/* dfilter_index_field_t */
+	GHashTable		*by_hfinfo;	/* hfinfo -> dfilter_index_field_t */
+	guint32			num_frames;	/* Highest frame number added */
+};
+
+typedef enum {
+	DF_PLAN_EXISTS,
+	DF_PLAN_EQ,
+	DF_PLAN_NOT,
+	DF_PLAN_AND,
+	DF_PLAN_OR
+} df_plan_op_t;
+
+struct _df_plan_node {
+	df_plan_op_t		op;
+	header_field_info	*hfinfo;	/* EXISTS, EQ: first field with this name */
+	GPtrArray		*keys;		/* EQ: index keys, any of which matches */
+	df_plan_node_t		*left;		/* NOT, AND, OR */
+	df_plan_node_t		*right;		/* AND, OR */
+};
+
+/* Big enough for any integer, and an IPv4 address, in the formats below. */
+#define INDEX_KEY_BUF_LEN	24
+
+/*
+ * Return the index key for a value, formatted into buf if necessary,
+ * or NULL if values of this type (or this particular value, for an IPv4
+ * subnet) can't be looked up in the index.
+ */
+static const gchar *
+index_key(fvalue_t *fv, gchar *buf)
+{
+	ftenum_t ftype = fvalue_type_ftenum(fv);
+
+	if (IS_FT_UINT32(ftype) || ftype == FT_IPXNET) {
+		g_snprintf(buf, INDEX_KEY_BUF_LEN, "%u", fvalue_get_uinteger(fv));
+		return buf;
+	}
+	if (IS_FT_INT32(ftype)) {
+		g_snprintf(buf, INDEX_KEY_BUF_LEN, "%d", fvalue_get_sinteger(fv));
+		return buf;
+	}
+	if (IS_FT_UINT64(ftype)) {
+		g_snprintf(buf, INDEX_KEY_BUF_LEN, "%" G_GINT64_MODIFIER "u",
+		    fvalue_get_uinteger64(fv));
+		return buf;
+	}
+	if (IS_FT_INT64(ftype)) {
+		g_snprintf(buf, INDEX_KEY_BUF_LEN, "%" G_GINT64_MODIFIER "d",
+		    fvalue_get_sinteger64(fv));
+		return buf;
+	}
+	if (ftype == FT_IPv4) {
+		/* "ip.addr == 10.0.0.0/8" matches a range of values. */
+		if (fv->value.ipv4.nmask != 0xffffffff)
+			return NULL;
+		g_snprintf(buf, INDEX_KEY_BUF_LEN, "%08x", fv->value.ipv4.addr);
+		return buf;
+	}
+	if (IS_FT_STRING(ftype) || ftype == FT_UINT_STRING) {
+		return (const gchar *)fvalue_get(fv);
+	}
+	return NULL;
+}
+
+static header_field_info *
+first_field_of_name(header_field_info *hfinfo)
+{
+	while (hfinfo->same_name_prev_id != -1) {
+		hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+	}
+	return hfinfo;
+}
+
+static void
+frame_list_add(GArray *frames, guint32 framenum)
+{
+	/* A field can occur several times in a frame; record the frame once. */
+	if (frames->len == 0 ||
+	    g_array_index(frames, guint32, frames->len - 1) != framenum) {
+		g_array_append_val(frames, framenum);
+	}
+}
+
+static void
+frame_list_free(gpointer data)
+{
+	g_array_free((GArray *)data, TRUE);
+}
+
+static void
+index_field_free(gpointer data)
+{
+	dfilter_index_field_t *field = (dfilter_index_field_t *)data;
+
+	g_array_free(field->present, TRUE);
+	g_hash_table_destroy(field->values);
+	g_free(field);
+}
+
+dfilter_index_t *
+dfilter_index_new(const gchar *fields, gchar **err_msg)
+{
+	dfilter_index_t		*idx;
+	dfilter_index_field_t	*field;
+	header_field_info	*hfinfo;
+	gchar			**names;
+	guint			i;
+
+	idx = g_new0(dfilter_index_t, 1);
+	idx->fields = g_ptr_array_new_with_free_func(index_field_free);
+	idx->by_hfinfo = g_hash_table_new(g_direct_hash, g_direct_equal);
+	idx->num_frames = 0;
+
+	names = g_strsplit_set(fields, " ,\t\r\n", -1);
+	for (i = 0; names[i] != NULL; i++) {
+		if (names[i][0] == '\0')
+			continue;
+
+		hfinfo = proto_registrar_get_byname(names[i]);
+		if (hfinfo == NULL) {
+			if (err_msg != NULL)
+				*err_msg = g_strdup_printf("\"%s\" is not a valid protocol or protocol field.", names[i]);
+			g_strfreev(names);
+			dfilter_index_free(idx);
+			return NULL;
+		}
+		hfinfo = first_field_of_name(hfinfo);
+		if (g_hash_table_lookup(idx->by_hfinfo, hfinfo) != NULL)
+			continue;
+
+		field = g_new(dfilter_index_field_t, 1);
+		field->hfinfo = hfinfo;
+		field->present = g_array_new(FALSE, FALSE, sizeof(guint32));
+		field->values = g_hash_table_new_full(g_str_hash, g_str_equal,
+		    g_free, frame_list_free);
+		g_ptr_array_add(idx->fields, field);
+		g_hash_table_insert(idx->by_hfinfo, hfinfo, field);
+	}
+	g_strfreev(names);
+
+	if (idx->fields->len == 0) {
+		dfilter_index_free(idx);
+		return NULL;
+	}
+	return idx;
+}
+
+void
+dfilter_index_free(dfilter_index_t *idx)
+{
+	if (!idx)
+		return;
+
+	g_hash_table_destroy(idx->by_hfinfo);
+	g_ptr_array_free(idx->fields, TRUE);
+	g_free(idx);
+}
+
+void
+dfilter_index_prime_edt(const dfilter_index_t *idx, struct epan_dissect *edt)
+{
+	header_field_info	*hfinfo;
+	guint			i;
+
+	for (i = 0; i < idx->fields->len; i++) {
+		dfilter_index_field_t *field = (dfilter_index_field_t *)g_ptr_array_index(idx->fields, i);
+
+		for (hfinfo = field->hfinfo; hfinfo; hfinfo = hfinfo->same_name_next) {
+			epan_dissect_prime_with_hfid(edt, hfinfo->id);
+		}
+	}
+}
+
+void
+dfilter_index_add_frame(dfilter_index_t *idx, struct epan_dissect *edt, guint32 framenum)
+{
+	header_field_info	*hfinfo;
+	GPtrArray		*finfos;
+	field_info		*finfo;
+	GArray			*frames;
+	const gchar		*key;
+	gchar			buf[INDEX_KEY_BUF_LEN];
+	guint			i, j;
+
+	/* Frames must be added in order; a frame without any of the fields
+	 * still counts as indexed. */
+	if (framenum <= idx->num_frames)
+		return;
+	idx->num_frames = framenum;
+
+	for (i = 0; i < idx->fields->len; i++) {
+		dfilter_index_field_t *field = (dfilter_index_field_t *)g_ptr_array_index(idx->fields, i);
+
+		for (hfinfo = field->hfinfo; hfinfo; hfinfo = hfinfo->same_name_next) {
+			finfos = proto_get_finfo_ptr_array(edt->tree, hfinfo->id);
+			if (finfos == NULL)
+				continue;
+
+			for (j = 0; j < finfos->len; j++) {
+				finfo = (field_info *)g_ptr_array_index(finfos, j);
+				frame_list_add(field->present, framenum);
+
+				key = index_key(&finfo->value, buf);
+				if (key == NULL)
+					continue;
+				frames = (GArray *)g_hash_table_lookup(field->values, key);
+				if (frames == NULL) {
+					frames = g_array_new(FALSE, FALSE, sizeof(guint32));
+					g_hash_table_insert(field->values, g_strdup(key), frames);
+				}
+				frame_list_add(frames, framenum);
+			}
+		}
+	}
+}
+
+/*
+ * Building the plan.
+ */
+
+static df_plan_node_t *
+plan_node_new(df_plan_op_t op)
+{
+	df_plan_node_t *node = g_new0(df_plan_node_t, 1);
+
+	node->op = op;
+	return node;
+}
+
+void
+df_plan_free(df_plan_node_t *node)
+{
+	if (!node)
+		return;
+
+	df_plan_free(node->left);
+	df_plan_free(node->right);
+	if (node->keys)
+		g_ptr_array_free(node->keys, TRUE);
+	g_free(node);
+}
+
+static gboolean
+plan_add_key(df_plan_node_t *node, stnode_t *st_value)
+{
+	const gchar	*key;
+	gchar		buf[INDEX_KEY_BUF_LEN];
+
+	if (stnode_type_id(st_value) != STTYPE_FVALUE)
+		return FALSE;
+	key = index_key((fvalue_t *)stnode_data(st_value), buf);
+	if (key == NULL)
+		return FALSE;
+	g_ptr_array_add(node->keys, g_strdup(key));
+	return TRUE;
+}
+
+static df_plan_node_t *
+plan_eq(stnode_t *st_field, stnode_t *st_value)
+{
+	df_plan_node_t	*node;
+
+	if (stnode_type_id(st_field) != STTYPE_FIELD) {
+		stnode_t *tmp = st_field;
+		st_field = st_value;
+		st_value = tmp;
+	}
+	if (stnode_type_id(st_field) != STTYPE_FIELD)
+		return NULL;
+
+	node = plan_node_new(DF_PLAN_EQ);
+	node->hfinfo = first_field_of_name((header_field_info *)stnode_data(st_field));
+	node->keys = g_ptr_array_new_with_free_func(g_free);
+	if (!plan_add_key(node, st_value)) {
+		df_plan_free(node);
+		return NULL;
+	}
+	return node;
+}
+
+static df_plan_node_t *
+plan_in(stnode_t *st_field, stnode_t *st_set)
+{
+	df_plan_node_t	*node;
+	GSList		*nodelist;
+
+	if (stnode_type_id(st_field) != STTYPE_FIELD ||
+	    stnode_type_id(st_set) != STTYPE_SET)
+		return NULL;
+
+	node = plan_node_new(DF_PLAN_EQ);
+	node->hfinfo = first_field_of_name((header_field_info *)stnode_data(st_field));
+	node->keys = g_ptr_array_new_with_free_func(g_free);
+
+	/* The set is a list of (lower, upper) pairs, with upper NULL for
+	 * plain values; ranges can't be looked up. */
+	for (nodelist = (GSList *)stnode_data(st_set); nodelist;
+	     nodelist = g_slist_next(g_slist_next(nodelist))) {
+		if (g_slist_next(nodelist)->data != NULL ||
+		    !plan_add_key(node, (stnode_t *)nodelist->data)) {
+			df_plan_free(node);
+			return NULL;
+		}
+	}
+	return node;
+}
+
+df_plan_node_t *
+dfw_index_plan(stnode_t *st_node)
+{
+	test_op_t	st_op;
+	stnode_t	*st_arg1, *st_arg2;
+	df_plan_node_t	*node, *left, *right;
+
+	if (stnode_type_id(st_node) != STTYPE_TEST)
+		return NULL;
+
+	sttype_test_get(st_node, &st_op, &st_arg1, &st_arg2);
+
+	switch (st_op) {
+		case TEST_OP_EXISTS:
+			if (stnode_type_id(st_arg1) != STTYPE_FIELD)
+				return NULL;
+			node = plan_node_new(DF_PLAN_EXISTS);
+			node->hfinfo = first_field_of_name((header_field_info *)stnode_data(st_arg1));
+			return node;
+
+		case TEST_OP_NOT:
+			left = dfw_index_plan(st_arg1);
+			if (left == NULL)
+				return NULL;
+			node = plan_node_new(DF_PLAN_NOT);
+			node->left = left;
+			return node;
+
+		case TEST_OP_AND:
+		case TEST_OP_OR:
+			left = dfw_index_plan(st_arg1);
+			if (left == NULL)
+				return NULL;
+			right = dfw_index_plan(st_arg2);
+			if (right == NULL) {
+				df_plan_free(left);
+				return NULL;
+			}
+			node = plan_node_new(st_op == TEST_OP_AND ? DF_PLAN_AND : DF_PLAN_OR);
+			node->left = left;
+			node->right = right;
+			return node;
+
+		case TEST_OP_EQ:
+			return plan_eq(st_arg1, st_arg2);
+
+		case TEST_OP_IN:
+			return plan_in(st_arg1, st_arg2);
+
+		default:
+			return NULL;
+	}
+}
+
+/*
+ * Running the plan.
+ */
+
+static gboolean
+plan_is_covered(const df_plan_node_t *node, const dfilter_index_t *idx)
+{
+	switch (node->op) {
+		case DF_PLAN_EXISTS:
+		case DF_PLAN_EQ:
+			return g_hash_table_lookup(idx->by_hfinfo, node->hfinfo) != NULL;
+		case DF_PLAN_NOT:
+			return plan_is_covered(node->left, idx);
+		case DF_PLAN_AND:
+		case DF_PLAN_OR:
+			return plan_is_covered(node->left, idx) &&
+			    plan_is_covered(node->right, idx);
+	}
+	return FALSE;
+}
+
+static void
+bitmap_set_frames(guint8 *bitmap, const GArray *frames, guint32 max_frame)
+{
+	guint	i;
+	guint32	framenum;
+
+	for (i = 0; i < frames->len; i++) {
+		framenum = g_array_index(frames, guint32, i);
+		if (framenum > max_frame)
+			break;
+		bitmap[framenum >> 3] |= 1 << (framenum & 7);
+	}
+}
+
+static guint8 *
+plan_eval(const df_plan_node_t *node, const dfilter_index_t *idx,
+    guint32 max_frame, gsize len)
+{
+	dfilter_index_field_t	*field;
+	GArray			*frames;
+	guint8			*bitmap, *other;
+	gsize			i;
+
+	switch (node->op) {
+		case DF_PLAN_EXISTS:
+			field = (dfilter_index_field_t *)g_hash_table_lookup(idx->by_hfinfo, node->hfinfo);
+			bitmap = (guint8 *)g_malloc0(len);
+			bitmap_set_frames(bitmap, field->present, max_frame);
+			return bitmap;
+
+		case DF_PLAN_EQ:
+			field = (dfilter_index_field_t *)g_hash_table_lookup(idx->by_hfinfo, node->hfinfo);
+			bitmap = (guint8 *)g_malloc0(len);
+			for (i = 0; i < node->keys->len; i++) {
+				frames = (GArray *)g_hash_table_lookup(field->values,
+				    g_ptr_array_index(node->keys, i));
+				if (frames != NULL)
+					bitmap_set_frames(bitmap, frames, max_frame);
+			}
+			return bitmap;
+
+		case DF_PLAN_NOT:
+			bitmap = plan_eval(node->left, idx, max_frame, len);
+			for (i = 0; i < len; i++)
+				bitmap[i] = ~bitmap[i];
+			/* There is no frame 0, nor any after max_frame; the
+			   bitmap may be extended for frames read later. */
+			bitmap[0] &= ~1;
+			bitmap[max_frame >> 3] &= (1 << ((max_frame & 7) + 1)) - 1;
+			return bitmap;
+
+		case DF_PLAN_AND:
+		case DF_PLAN_OR:
+			bitmap = plan_eval(node->left, idx, max_frame, len);
+			other = plan_eval(node->right, idx, max_frame, len);
+			if (node->op == DF_PLAN_AND) {
+				for (i = 0; i < len; i++)
+					bitmap[i] &= other[i];
+			} else {
+				for (i = 0; i < len; i++)
+					bitmap[i] |= other[i];
+			}
+			g_free(other);
+			return bitmap;
+	}
+	g_assert_not_reached();
+	return NULL;
+}
+
+gboolean
+dfilter_index_can_answer(const dfilter_t *df, const dfilter_index_t *idx, guint32 max_frame)
+{
+	return df != NULL && df->index_plan != NULL && idx != NULL &&
+	    max_frame <= idx->num_frames && plan_is_covered(df->index_plan, idx);
+}
+
+guint8 *
+dfilter_index_apply(const dfilter_t *df, const dfilter_index_t *idx, guint32 max_frame)
+{
+	if (!dfilter_index_can_answer(df, idx, max_frame))
+		return NULL;
+
+	return plan_eval(df->index_plan, idx, max_frame, DFILTER_INDEX_BITMAP_LEN(max_frame));
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
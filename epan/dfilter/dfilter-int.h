@@ -15,6 +15,9 @@
 #include <epan/proto.h>
 #include <stdio.h>
 
+/* Plan for answering a filter from a field value index (dfilter-index.c) */
+typedef struct _df_plan_node df_plan_node_t;
+
 /* Passed back to user */
 struct epan_dfilter {
 	GPtrArray	*insns;
@@ -27,6 +30,7 @@ struct epan_dfilter {
 	int		*interesting_fields;
 	int		num_interesting_fields;
 	GPtrArray	*deprecated;
+	df_plan_node_t	*index_plan;
 };
 
 typedef struct {
@@ -72,4 +76,13 @@ dfilter_fail(dfwork_t *dfw, const char *format, ...) G_GNUC_PRINTF(2, 3);
 void
 DfilterTrace(FILE *TraceFILE, char *zTracePrompt);
 
+/* Returns a plan for answering the filter from a field value index,
+ * or NULL if the filter can't be answered that way. Must be called
+ * before code generation, which takes the values out of the tree. */
+df_plan_node_t *
+dfw_index_plan(stnode_t *st_node);
+
+void
+df_plan_free(df_plan_node_t *plan);
+
 #endif
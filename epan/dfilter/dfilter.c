@@ -147,6 +147,8 @@ dfilter_free(dfilter_t *df)
 		g_ptr_array_free(df->deprecated, TRUE);
 	}
 
+	df_plan_free(df->index_plan);
+
 	g_free(df->registers);
 	g_free(df->attempted_load);
 	g_free(df->owns_memory);
@@ -210,6 +212,7 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 	guint		i;
 	/* XXX, GHashTable */
 	GPtrArray	*deprecated;
+	df_plan_node_t	*index_plan;
 
 	g_assert(dfp);
 
@@ -334,11 +337,16 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 			goto FAILURE;
 		}
 
+		/* See whether the filter can be answered from a field
+		 * value index, while the values are still in the tree */
+		index_plan = dfw_index_plan(dfw->st_root);
+
 		/* Create bytecode */
 		dfw_gencode(dfw);
 
 		/* Tuck away the bytecode in the dfilter_t */
 		dfilter = dfilter_new();
+		dfilter->index_plan = index_plan;
 		dfilter->insns = dfw->insns;
 		dfilter->consts = dfw->consts;
 		dfw->insns = NULL;
@@ -76,6 +76,58 @@ WS_DLL_PUBLIC
 GPtrArray *
 dfilter_deprecated_tokens(dfilter_t *df);
 
+/* Field value index.
+ *
+ * Records, for a list of fields, the frames in which each field occurs
+ * and the frames in which it has each of its values, so that filters
+ * made up only of "==", "in" and existence tests on those fields,
+ * combined with "and", "or" and "not", can be answered without
+ * dissecting any frames. Frames are added as they are first dissected. */
+typedef struct epan_dfilter_index dfilter_index_t;
+
+/* Number of bytes in the frame bitmap returned by dfilter_index_apply(),
+ * and whether a frame is set in it. */
+#define DFILTER_INDEX_BITMAP_LEN(max_frame) (((max_frame) >> 3) + 1)
+#define DFILTER_INDEX_FRAME_MATCHES(bitmap, framenum) \
+	(((bitmap)[(framenum) >> 3] >> ((framenum) & 7)) & 1)
+
+/* Creates an index for a list of field names separated by commas or
+ * whitespace. Returns NULL, setting *err_msg if a name is not a valid
+ * field, or if the list is empty (leaving *err_msg alone). */
+WS_DLL_PUBLIC
+dfilter_index_t *
+dfilter_index_new(const gchar *fields, gchar **err_msg);
+
+WS_DLL_PUBLIC
+void
+dfilter_index_free(dfilter_index_t *idx);
+
+/* Prime an epan_dissect_t with the indexed fields before dissecting a
+ * frame that will be added to the index. */
+WS_DLL_PUBLIC
+void
+dfilter_index_prime_edt(const dfilter_index_t *idx, struct epan_dissect *edt);
+
+/* Add a dissected frame to the index. Frames must be added in
+ * ascending order. */
+WS_DLL_PUBLIC
+void
+dfilter_index_add_frame(dfilter_index_t *idx, struct epan_dissect *edt, guint32 framenum);
+
+/* Check whether the result of a filter for frames 1 through max_frame
+ * can be determined from an index. */
+WS_DLL_PUBLIC
+gboolean
+dfilter_index_can_answer(const dfilter_t *df, const dfilter_index_t *idx, guint32 max_frame);
+
+/* Determine the result of a filter for frames 1 through max_frame from an
+ * index. Returns a g_malloc()ed bitmap, DFILTER_INDEX_BITMAP_LEN(max_frame)
+ * bytes long, with the bits of matching frames set, or NULL if
+ * dfilter_index_can_answer() is FALSE. */
+WS_DLL_PUBLIC
+guint8 *
+dfilter_index_apply(const dfilter_t *df, const dfilter_index_t *idx, guint32 max_frame);
+
 /* Print bytecode of dfilter to stdout */
 WS_DLL_PUBLIC
 void
@@ -2979,6 +2979,7 @@ proto_register_ip(void)
   ip_handle = register_dissector("ip", dissect_ip, proto_ip);
   reassembly_table_register(&ip_reassembly_table,
                         &addresses_reassembly_table_functions);
+  reassembly_table_set_composite_tvbs(&ip_reassembly_table, TRUE);
   ip_tap = register_tap("ip");
 
   register_decode_as(&ip_da);
@@ -3711,6 +3711,7 @@ proto_register_ipv6(void)
     ipv6_handle = register_dissector("ipv6", dissect_ipv6, proto_ipv6);
     reassembly_table_register(&ipv6_reassembly_table,
                           &addresses_reassembly_table_functions);
+    reassembly_table_set_composite_tvbs(&ipv6_reassembly_table, TRUE);
     ipv6_tap = register_tap("ipv6");
 
     register_decode_as(&ipv6_da);
@@ -7833,6 +7833,7 @@ proto_register_tcp(void)
     register_init_routine(tcp_init);
     reassembly_table_register(&tcp_reassembly_table,
                           &addresses_ports_reassembly_table_functions);
+    reassembly_table_set_composite_tvbs(&tcp_reassembly_table, TRUE);
 
     register_decode_as(&tcp_da);
 
@@ -405,6 +405,8 @@ epan_cleanup(void)
 struct epan_session {
 	struct packet_provider_data *prov;	/* packet provider data for this session */
 	struct packet_provider_funcs funcs;	/* functions using that data */
+	guint8 *called_protocols;		/* bitmap, see epan_note_called_protocols() */
+	int called_protocols_max;		/* highest protocol ID in it */
 };
 
 epan_t *
@@ -463,6 +465,44 @@ epan_get_frame_ts(const epan_t *session, guint32 frame_num)
 	return abs_ts;
 }
 
+void
+epan_note_called_protocols(epan_t *session)
+{
+	void *cookie;
+	int proto_id, max_id = 0;
+
+	for (proto_id = proto_get_first_protocol(&cookie); proto_id != -1;
+	     proto_id = proto_get_next_protocol(&cookie))
+		max_id = MAX(max_id, proto_id);
+
+	g_free(session->called_protocols);
+	session->called_protocols = (guint8 *)g_malloc0(max_id / 8 + 1);
+	session->called_protocols_max = max_id;
+}
+
+/* Called for every dissector call, so it only sets a bit */
+void
+epan_note_called_protocol(const epan_t *session, int proto_id)
+{
+	if (session && session->called_protocols &&
+	    proto_id >= 0 && proto_id <= session->called_protocols_max)
+		session->called_protocols[proto_id / 8] |= 1 << (proto_id % 8);
+}
+
+gboolean
+epan_protocol_may_have_been_called(const epan_t *session, int proto_id)
+{
+	/* Protocols registered since can't have been noted */
+	if (session->called_protocols == NULL ||
+	    proto_id < 0 || proto_id > session->called_protocols_max)
+		return TRUE;
+
+	if (!dissector_called_only_through_handles(proto_id))
+		return TRUE;
+
+	return (session->called_protocols[proto_id / 8] & (1 << (proto_id % 8))) != 0;
+}
+
 void
 epan_free(epan_t *session)
 {
@@ -470,6 +510,7 @@ epan_free(epan_t *session)
 		/* XXX, it should take session as param */
 		cleanup_dissection();
 
+		g_free(session->called_protocols);
 		g_slice_free(epan_t, session);
 	}
 }
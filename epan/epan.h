@@ -159,6 +159,28 @@ WS_DLL_PUBLIC const char *epan_get_interface_description(const epan_t *session,
 
 const nstime_t *epan_get_frame_ts(const epan_t *session, guint32 frame_num);
 
+/**
+ * Start noting the protocols of all the dissectors called in a session,
+ * including those of the dissectors that reject a packet, such as
+ * heuristic dissectors trying one.
+ *
+ * @param session The session.
+ */
+WS_DLL_PUBLIC void epan_note_called_protocols(epan_t *session);
+
+void epan_note_called_protocol(const epan_t *session, int proto_id);
+
+/**
+ * Whether the dissector of a protocol may have been called in a session.
+ * It's FALSE only if its being called would have been noted since
+ * epan_note_called_protocols(), and it wasn't; see
+ * dissector_called_only_through_handles().
+ *
+ * @param session The session.
+ * @param proto_id The protocol.
+ */
+WS_DLL_PUBLIC gboolean epan_protocol_may_have_been_called(const epan_t *session, int proto_id);
+
 WS_DLL_PUBLIC void epan_free(epan_t *session);
 
 WS_DLL_PUBLIC const gchar*
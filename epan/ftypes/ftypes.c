@@ -10,6 +10,7 @@
 
 #include <ftypes-int.h>
 #include <glib.h>
+#include <string.h>
 
 #include "ftypes.h"
 
@@ -384,6 +385,27 @@ fvalue_to_string_repr(wmem_allocator_t *scope, fvalue_t *fv, ftrepr_t rtype, int
 	return buf;
 }
 
+const char *
+fvalue_to_string_repr_buf(GString *buf, fvalue_t *fv, ftrepr_t rtype, int field_display)
+{
+	int len;
+	if (fv->ftype->val_to_string_repr == NULL) {
+		/* no value-to-string-representation function, so the value cannot be represented */
+		return NULL;
+	}
+
+	if ((len = fvalue_string_repr_len(fv, rtype, field_display)) < 0) {
+		/* the value cannot be represented in the given representation type (rtype) */
+		return NULL;
+	}
+
+	g_string_set_size(buf, len);
+	memset(buf->str, 0, len + 1);
+	fv->ftype->val_to_string_repr(fv, rtype, field_display, buf->str, (unsigned int)len+1);
+	g_string_truncate(buf, strlen(buf->str));
+	return buf->str;
+}
+
 typedef struct {
 	fvalue_t	*fv;
 	GByteArray	*bytes;
@@ -283,6 +283,15 @@ fvalue_string_repr_len(fvalue_t *fv, ftrepr_t rtype, int field_display);
 WS_DLL_PUBLIC char *
 fvalue_to_string_repr(wmem_allocator_t *scope, fvalue_t *fv, ftrepr_t rtype, int field_display);
 
+/* Like fvalue_to_string_repr(), but writes the string representation
+ * into buf, growing it if necessary, so that one buffer can be reused
+ * for many values.
+ *
+ * Returns buf->str, or NULL if the string cannot be represented in the
+ * given rtype.*/
+WS_DLL_PUBLIC const char *
+fvalue_to_string_repr_buf(GString *buf, fvalue_t *fv, ftrepr_t rtype, int field_display);
+
 WS_DLL_PUBLIC ftenum_t
 fvalue_type_ftenum(fvalue_t *fv);
 
@@ -161,6 +161,12 @@ struct heur_dissector_list {
 
 static GHashTable *heur_dissector_lists = NULL;
 
+/*
+ * IDs of the protocols that have dissector handles or heuristic
+ * dissectors. (GINT_TO_POINTER(proto_id))
+ */
+static GHashTable *handle_protocols = NULL;
+
 /* Name hashtables for fast detection of duplicate names */
 static GHashTable* heuristic_short_names  = NULL;
 
@@ -212,6 +218,8 @@ packet_init(void)
 			NULL, destroy_heuristic_dissector_list);
 
 	heuristic_short_names  = g_hash_table_new(g_str_hash, g_str_equal);
+
+	handle_protocols = g_hash_table_new(g_direct_hash, g_direct_equal);
 }
 
 void
@@ -259,6 +267,7 @@ packet_cleanup(void)
 	g_hash_table_destroy(depend_dissector_lists);
 	g_hash_table_destroy(heur_dissector_lists);
 	g_hash_table_destroy(heuristic_short_names);
+	g_hash_table_destroy(handle_protocols);
 	g_slist_foreach(shutdown_routines, &call_routine, NULL);
 	g_slist_free(shutdown_routines);
 	if (postdissectors) {
@@ -700,6 +709,8 @@ call_dissector_through_handle(dissector_handle_t handle, tvbuff_t *tvb,
 	if ((handle->protocol != NULL) && (!proto_is_pino(handle->protocol))) {
 		pinfo->current_proto =
 			proto_get_protocol_short_name(handle->protocol);
+		/* Even if it rejects the packet; its preferences may change that */
+		epan_note_called_protocol(pinfo->epan, proto_get_id(handle->protocol));
 	}
 
 	if (handle->dissector_type == DISSECTOR_TYPE_SIMPLE) {
@@ -2338,6 +2349,119 @@ dissector_all_tables_foreach_changed (DATFunc  func,
 	g_hash_table_foreach(dissector_tables, dissector_all_tables_foreach_func, &info);
 }
 
+static guint64
+routing_hash_combine(guint64 hash, guint64 value)
+{
+	return hash ^ (value + G_GUINT64_CONSTANT(0x9e3779b97f4a7c15) + (hash << 6) + (hash >> 2));
+}
+
+typedef struct {
+	dissector_table_t table;
+	guint64 table_hash;
+	guint64 hash;
+} routing_hash_info_t;
+
+static void
+routing_hash_table_entry(gpointer key, gpointer value, gpointer user_data)
+{
+	routing_hash_info_t *info = (routing_hash_info_t *)user_data;
+	dtbl_entry_t *dtbl_entry = (dtbl_entry_t *)value;
+	guint64 entry_hash;
+
+	entry_hash = routing_hash_combine(info->table_hash, info->table->hash_func(key));
+	entry_hash = routing_hash_combine(entry_hash, GPOINTER_TO_SIZE(dtbl_entry->current));
+
+	/* Entries are visited in no particular order, so the order mustn't matter */
+	info->hash += entry_hash;
+}
+
+static void
+routing_hash_table(gpointer key, gpointer value, gpointer user_data)
+{
+	guint64 *hash = (guint64 *)user_data;
+	routing_hash_info_t info;
+
+	info.table = (dissector_table_t)value;
+	info.table_hash = g_str_hash(key);
+	info.hash = 0;
+	g_hash_table_foreach(info.table->hash_table, routing_hash_table_entry, &info);
+
+	*hash += routing_hash_combine(info.table_hash, info.hash);
+}
+
+static void
+routing_hash_heur_list(gpointer key, gpointer value, gpointer user_data)
+{
+	guint64 *hash = (guint64 *)user_data;
+	heur_dissector_list_t sub_dissectors = (heur_dissector_list_t)value;
+	guint64 list_hash = g_str_hash(key);
+	GSList *entry;
+
+	/* Heuristic dissectors are tried in order, so the order matters */
+	for (entry = sub_dissectors->dissectors; entry != NULL; entry = g_slist_next(entry)) {
+		heur_dtbl_entry_t *hdtbl_entry = (heur_dtbl_entry_t *)entry->data;
+
+		list_hash = routing_hash_combine(list_hash, GPOINTER_TO_SIZE(hdtbl_entry));
+		list_hash = routing_hash_combine(list_hash, hdtbl_entry->enabled);
+	}
+
+	*hash += list_hash;
+}
+
+guint64
+dissector_routing_hash(void)
+{
+	guint64 hash = 0;
+	guint64 enabled_hash = 0;
+	void *cookie;
+	int proto_id;
+
+	g_hash_table_foreach(dissector_tables, routing_hash_table, &hash);
+	g_hash_table_foreach(heur_dissector_lists, routing_hash_heur_list, &hash);
+
+	/* A disabled protocol's dissector isn't called, wherever it's registered */
+	for (proto_id = proto_get_first_protocol(&cookie); proto_id != -1;
+	     proto_id = proto_get_next_protocol(&cookie)) {
+		enabled_hash = routing_hash_combine(enabled_hash,
+		    proto_is_protocol_enabled(find_protocol_by_id(proto_id)));
+	}
+
+	return routing_hash_combine(hash, enabled_hash);
+}
+
+static gboolean
+dissector_table_of_protocol(gpointer key _U_, gpointer value, gpointer user_data)
+{
+	return ((dissector_table_t)value)->protocol == (protocol_t *)user_data;
+}
+
+static gboolean
+heur_dissector_list_of_protocol(gpointer key _U_, gpointer value, gpointer user_data)
+{
+	return ((heur_dissector_list_t)value)->protocol == (protocol_t *)user_data;
+}
+
+gboolean
+dissector_called_only_through_handles(const int proto_id)
+{
+	protocol_t *protocol = find_protocol_by_id(proto_id);
+
+	if (protocol == NULL ||
+	    !g_hash_table_contains(handle_protocols, GINT_TO_POINTER(proto_id)))
+		return FALSE;
+
+	/*
+	 * Protocols other protocols build on, such as BER, have
+	 * dissector tables or heuristic dissector lists, and export
+	 * routines that those protocols call directly.
+	 */
+	if (g_hash_table_find(dissector_tables, dissector_table_of_protocol, protocol) != NULL ||
+	    g_hash_table_find(heur_dissector_lists, heur_dissector_list_of_protocol, protocol) != NULL)
+		return FALSE;
+
+	return TRUE;
+}
+
 /*
  * Walk one dissector table calling a user supplied function only on
  * any entry that has been changed from its original state.
@@ -2461,6 +2585,7 @@ register_dissector_table(const char *name, const char *ui_name, const int proto,
 							       &g_free);
 		break;
 	case FT_GUID:
+		sub_dissectors->hash_func = uuid_hash;
 		sub_dissectors->hash_table = g_hash_table_new_full(uuid_hash,
 							       uuid_equal,
 							       NULL,
@@ -2655,6 +2780,8 @@ heur_dissector_add(const char *name, heur_dissector_t dissector, const char *dis
 	hdtbl_entry = g_slice_new(heur_dtbl_entry_t);
 	hdtbl_entry->dissector = dissector;
 	hdtbl_entry->protocol  = find_protocol_by_id(proto);
+	if (hdtbl_entry->protocol != NULL)
+		g_hash_table_add(handle_protocols, GINT_TO_POINTER(proto));
 	hdtbl_entry->display_name = display_name;
 	hdtbl_entry->short_name = g_strdup(short_name);
 	hdtbl_entry->list_name = g_strdup(name);
@@ -2770,6 +2897,8 @@ dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 			   to determine which Lua-based heurisitc dissector to call */
 			pinfo->current_proto =
 				proto_get_protocol_short_name(hdtbl_entry->protocol);
+			/* Even if it rejects the packet; its preferences may change that */
+			epan_note_called_protocol(pinfo->epan, proto_id);
 
 			/*
 			 * Add the protocol name to the layers; we'll remove it
@@ -3069,6 +3198,8 @@ new_dissector_handle(enum dissector_e type, void *dissector, const int proto, co
 	handle->dissector_func	= dissector;
 	handle->dissector_data	= cb_data;
 	handle->protocol	= find_protocol_by_id(proto);
+	if (handle->protocol != NULL)
+		g_hash_table_add(handle_protocols, GINT_TO_POINTER(proto));
 	return handle;
 }
 
@@ -3261,6 +3392,7 @@ void call_heur_dissector_direct(heur_dtbl_entry_t *heur_dtbl_entry, tvbuff_t *tv
 		/* do NOT change this behavior - wslua uses the protocol short name set here in order
 			to determine which Lua-based heuristic dissector to call */
 		pinfo->current_proto = proto_get_protocol_short_name(heur_dtbl_entry->protocol);
+		epan_note_called_protocol(pinfo->epan, proto_get_id(heur_dtbl_entry->protocol));
 		pinfo->curr_layer_num++;
 		wmem_list_append(pinfo->layers, GINT_TO_POINTER(proto_get_id(heur_dtbl_entry->protocol)));
 	}
@@ -140,6 +140,27 @@ WS_DLL_PUBLIC void dissector_table_foreach (const char *table_name, DATFunc func
 WS_DLL_PUBLIC void dissector_all_tables_foreach_changed (DATFunc func,
     gpointer user_data);
 
+/** Get a hash of where packets are handed to by the dissector tables and
+ * heuristic dissector lists.
+ *
+ * The hash changes when a "decode as" setting, the handoff of a protocol,
+ * or the enabling of a protocol or heuristic dissector changes which
+ * dissectors get packets, and is otherwise the same, even if entries were
+ * removed and added back.
+ */
+WS_DLL_PUBLIC guint64 dissector_routing_hash(void);
+
+/** Whether the dissectors of a protocol are only called through dissector
+ * handles or as heuristic dissectors, so that their being called can be
+ * noted (see epan_note_called_protocols()).
+ *
+ * That's assumed of a protocol with handles or heuristic dissectors,
+ * unless it has dissector tables or heuristic dissector lists; protocols
+ * that other protocols build on, and that have routines those call
+ * directly, such as BER, have those.
+ */
+WS_DLL_PUBLIC gboolean dissector_called_only_through_handles(const int proto_id);
+
 /** Iterate over dissectors in a table by handle.
  *
  * Walk one dissector table's list of handles calling a user supplied
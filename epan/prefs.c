@@ -906,6 +906,53 @@ prefs_modules_foreach_submodules(module_t *module, module_cb callback,
     return prefs_module_list_foreach((module)?module->submodules:prefs_top_level_modules, callback, user_data, TRUE);
 }
 
+/*
+ * Protocols whose dissection preferences were applied since
+ * prefs_take_applied_protocols() was last called, and whether the
+ * preferences of other modules were, or anything else that affects
+ * dissection changed.
+ */
+static GArray *applied_protocols = NULL;
+static gboolean applied_other_modules = FALSE;
+
+static void
+note_applied_module(module_t *module)
+{
+    /* Protocol modules are named after the protocol's filter name */
+    int proto_id = proto_get_id_by_filter_name(module->name);
+
+    if (proto_id == -1) {
+        applied_other_modules = TRUE;
+        return;
+    }
+
+    if (applied_protocols == NULL)
+        applied_protocols = g_array_new(FALSE, FALSE, sizeof(int));
+    g_array_append_val(applied_protocols, proto_id);
+}
+
+void
+prefs_note_dissection_changed(void)
+{
+    applied_other_modules = TRUE;
+}
+
+GArray *
+prefs_take_applied_protocols(void)
+{
+    GArray *protocols = applied_protocols;
+
+    if (applied_other_modules && protocols != NULL) {
+        g_array_free(protocols, TRUE);
+        protocols = NULL;
+    }
+
+    applied_protocols = NULL;
+    applied_other_modules = FALSE;
+
+    return protocols;
+}
+
 static gboolean
 call_apply_cb(const void *key _U_, void *value, void *data _U_)
 {
@@ -914,6 +961,8 @@ call_apply_cb(const void *key _U_, void *value, void *data _U_)
     if (module->obsolete)
         return FALSE;
     if (module->prefs_changed_flags) {
+        if (module->prefs_changed_flags & PREF_EFFECT_DISSECTION)
+            note_applied_module(module);
         if (module->apply_cb != NULL)
             (*module->apply_cb)();
         module->prefs_changed_flags = 0;
@@ -3394,6 +3443,20 @@ prefs_register_modules(void)
                                    "Show the intelligent scroll bar (a minimap of packet list colors in the scrollbar)",
                                    &prefs.gui_packet_list_show_minimap);
 
+    prefs_register_uint_preference(gui_module, "rescan_threads",
+                                   "Threads used to read packets when filtering",
+                                   "Number of threads that read packets ahead of dissection when a "
+                                   "display filter is applied or packets are redissected. "
+                                   "0 or 1 reads packets on the main thread",
+                                   10,
+                                   &prefs.gui_rescan_threads);
+
+    register_string_like_preference(gui_module, "filter_index_fields", "Fields to index for display filtering",
+        "A comma-separated list of fields (e.g. ip.addr,tcp.port,tcp.stream) whose values are indexed "
+        "when a file is first read. Display filters made up only of \"==\", \"in\" and existence tests "
+        "on these fields are then applied without dissecting the packets that don't match. "
+        "Fields whose values depend on packets later in the file should not be listed.",
+        &prefs.gui_filter_index_fields, PREF_STRING, NULL, TRUE);
 
     prefs_register_bool_preference(gui_module, "interfaces_show_hidden",
                                    "Show hidden interfaces",
@@ -3521,6 +3584,11 @@ prefs_register_modules(void)
     prefs_register_bool_preference(capture_module, "show_info", "Show capture information dialog while capturing",
         "Show capture information dialog while capturing?", &prefs.capture_show_info);
 
+    prefs_register_bool_preference(capture_module, "cache_filters", "Keep slow capture filters compiled",
+        "Keep capture filters that take a while to compile, compiled, for the next capture"
+        " (dumpcap --cache-filters). Host and port names in them are then resolved when they're"
+        " first compiled, and again after an hour.", &prefs.capture_cache_filters);
+
     prefs_register_obsolete_preference(capture_module, "syntax_check_filter");
 
     custom_cbs.free_cb = capture_column_free_cb;
@@ -4107,6 +4175,9 @@ pre_init_prefs(void)
     prefs.gui_packet_list_elide_mode = ELIDE_RIGHT;
     prefs.gui_packet_list_show_related = TRUE;
     prefs.gui_packet_list_show_minimap = TRUE;
+    prefs.gui_rescan_threads = 1;
+    g_free(prefs.gui_filter_index_fields);
+    prefs.gui_filter_index_fields = g_strdup("");
     g_free (prefs.gui_interfaces_hide_types);
     prefs.gui_interfaces_hide_types = g_strdup("");
     prefs.gui_interfaces_show_hidden = FALSE;
@@ -4142,6 +4213,7 @@ pre_init_prefs(void)
     prefs.capture_no_extcap             = FALSE;
     prefs.capture_auto_scroll           = TRUE;
     prefs.capture_show_info             = FALSE;
+    prefs.capture_cache_filters         = FALSE;
 
     if (!prefs.capture_columns) {
         /* First time through */
@@ -4303,6 +4375,9 @@ prefs_reset(void)
      * Reset the non-UAT dissector preferences.
      */
     wmem_tree_foreach(prefs_modules, reset_module_prefs, NULL);
+
+    /* Everything, UATs and MIBs included, may be different now */
+    applied_other_modules = TRUE;
 }
 
 /* Read the preferences file, fill in "prefs", and return a pointer to it.
@@ -195,6 +195,7 @@ typedef struct _e_prefs {
   gboolean     capture_no_interface_load;
   gboolean     capture_no_extcap;
   gboolean     capture_show_info;
+  gboolean     capture_cache_filters;
   GList       *capture_columns;
   guint        tap_update_interval;
   gboolean     display_hidden_proto_items;
@@ -216,6 +217,8 @@ typedef struct _e_prefs {
   elide_mode_e gui_packet_list_elide_mode;
   gboolean     gui_packet_list_show_related;
   gboolean     gui_packet_list_show_minimap;
+  guint        gui_rescan_threads;
+  gchar       *gui_filter_index_fields;
   gboolean     st_enable_burstinfo;
   gboolean     st_burst_showcount;
   gint         st_burst_resolution;
@@ -357,6 +360,22 @@ WS_DLL_PUBLIC void prefs_apply_all(void);
  */
 WS_DLL_PUBLIC void prefs_apply(module_t *module);
 
+/*
+ * Get the protocols whose preferences affecting dissection have been
+ * applied since the last call, as an array of protocol IDs to be freed
+ * by the caller, and forget them.  Returns NULL if there were none, or
+ * if preferences of modules other than protocol modules were applied,
+ * as the changes can then affect any protocol.
+ */
+WS_DLL_PUBLIC GArray *prefs_take_applied_protocols(void);
+
+/*
+ * Note that something other than preferences that affects dissection has
+ * changed, such as a UAT or a Lua plugin, so that the next call of
+ * prefs_take_applied_protocols() returns NULL.
+ */
+WS_DLL_PUBLIC void prefs_note_dissection_changed(void);
+
 
 struct preference;
 
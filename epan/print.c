@@ -28,6 +28,8 @@
 #include <epan/print.h>
 #include <epan/charsets.h>
 #include <wsutil/json_dumper.h>
+#include <wsutil/arrow_ipc.h>
+#include <wsutil/cbor_writer.h>
 #include <wsutil/filesystem.h>
 #include <version_info.h>
 #include <wsutil/utf8_entities.h>
@@ -63,13 +65,26 @@ typedef struct {
     gboolean        print_text;
     proto_node_children_grouper_func node_children_grouper;
     json_dumper    *dumper;
+    guint           depth;  /* object nesting level, selects the grouping scratch space */
+    GPtrArray      *levels; /* grouping scratch space, by nesting level */
+    GString        *scratch_key;    /* keys and values that are written right away */
+    GString        *scratch_value;
 } write_json_data;
 
+/* Size of the output buffer of the JSON and EK dumpers, which flush it after each packet. */
+#define JSON_OUTPUT_BUFFER_SIZE 65536
+
 typedef struct {
     output_fields_t *fields;
     epan_dissect_t  *edt;
 } write_field_data_t;
 
+typedef struct {
+    output_fields_t *fields;
+    epan_dissect_t  *edt;
+    arrow_writer    *writer;
+} write_arrow_data_t;
+
 struct _output_fields {
     gboolean      print_bom;
     gboolean      print_header;
@@ -81,6 +96,8 @@ struct _output_fields {
     GPtrArray   **field_values;
     gchar         quote;
     gboolean      includes_col_fields;
+    guint         batch_rows;
+    GArray       *prime_hfids;
 };
 
 static gchar *get_field_hex_value(GSList *src_list, field_info *fi);
@@ -101,13 +118,14 @@ static void print_escaped_xml(FILE *fh, const char *unescaped_string);
 static void print_escaped_csv(FILE *fh, const char *unescaped_string);
 
 typedef void (*proto_node_value_writer)(proto_node *, write_json_data *);
+typedef struct json_group_level json_group_level;
 static void write_json_index(json_dumper *dumper, epan_dissect_t *edt);
-static void write_json_proto_node_list(GSList *proto_node_list_head, write_json_data *data);
-static void write_json_proto_node(GSList *node_values_head,
+static void write_json_proto_node_list(json_group_level *level, write_json_data *data);
+static void write_json_proto_node(json_group_level *level, guint group,
                                   const char *suffix,
                                   proto_node_value_writer value_writer,
                                   write_json_data *data);
-static void write_json_proto_node_value_list(GSList *node_values_head,
+static void write_json_proto_node_value_list(json_group_level *level, guint group,
                                              proto_node_value_writer value_writer,
                                              write_json_data *data);
 static void write_json_proto_node_filtered(proto_node *node, write_json_data *data);
@@ -119,6 +137,8 @@ static const char *proto_node_to_json_key(proto_node *node);
 
 static void print_pdml_geninfo(epan_dissect_t *edt, FILE *fh);
 static void write_ek_summary(column_info *cinfo, write_json_data *pdata);
+static void write_json_data_init(write_json_data *data, json_dumper *dumper);
+static void write_json_data_cleanup(write_json_data *data);
 
 static void proto_tree_get_node_field_values(proto_node *node, gpointer data);
 
@@ -354,10 +374,12 @@ write_ek_proto_tree(output_fields_t* fields,
 
     json_dumper dumper = {
         .output_file = fh,
-        .flags = JSON_DUMPER_DOT_TO_UNDERSCORE
+        .flags = JSON_DUMPER_DOT_TO_UNDERSCORE,
+        .output_buffer = (gchar *)g_malloc(JSON_OUTPUT_BUFFER_SIZE),
+        .output_buffer_size = JSON_OUTPUT_BUFFER_SIZE
     };
 
-    data.dumper = &dumper;
+    write_json_data_init(&data, &dumper);
 
     json_dumper_begin_object(&dumper);
     json_dumper_set_member_name(&dumper, "index");
@@ -397,6 +419,9 @@ write_ek_proto_tree(output_fields_t* fields,
     }
     json_dumper_end_object(&dumper);
     json_dumper_finish(&dumper);
+
+    write_json_data_cleanup(&data);
+    g_free(dumper.output_buffer);
 }
 
 void
@@ -681,14 +706,268 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
     }
 }
 
+/*
+ * The JSON and EK writers group the nodes written into an object by their
+ * key, so that nodes with the same key are written as a single array. The
+ * groups of each nesting level are built in scratch space that is reused
+ * for every object written at that level of the packet.
+ *
+ * A key is made up of up to JSON_KEY_MAX_PARTS strings; two keys are equal
+ * if the concatenations of their parts are.
+ */
+#define JSON_KEY_MAX_PARTS  3
+
+typedef void (*json_key_parts_func)(const proto_node *node, const char *parts[JSON_KEY_MAX_PARTS + 1]);
+
+typedef struct {
+    proto_node *node;
+    gint        next;       /* Next member of the same group, or -1 */
+} json_group_member;
+
+typedef struct {
+    gint        first;
+    gint        last;
+    guint       count;
+} json_group;
+
+struct json_group_level {
+    GArray     *members;    /* json_group_member */
+    GArray     *groups;     /* json_group, in the order their keys first appear */
+    GHashTable *lookup;     /* First node of a group -> group index + 1 */
+};
+
+typedef struct {
+    json_key_parts_func key_parts;
+    GHashFunc           key_hash;
+    GEqualFunc          key_equal;
+} json_grouper;
+
+/*
+ * Groups are looked up by comparing keys with those of the groups before;
+ * past this many groups in an object, a hash table is used instead.
+ */
+#define JSON_GROUP_LINEAR_MAX   16
+
+static void
+json_group_level_free(gpointer data)
+{
+    json_group_level *level = (json_group_level *)data;
+
+    g_array_free(level->members, TRUE);
+    g_array_free(level->groups, TRUE);
+    if (level->lookup != NULL)
+        g_hash_table_destroy(level->lookup);
+    g_free(level);
+}
+
+static void
+write_json_data_init(write_json_data *data, json_dumper *dumper)
+{
+    memset(data, 0, sizeof *data);
+    data->dumper = dumper;
+    data->levels = g_ptr_array_new_with_free_func(json_group_level_free);
+    data->scratch_key = g_string_sized_new(256);
+    data->scratch_value = g_string_sized_new(256);
+}
+
+static void
+write_json_data_cleanup(write_json_data *data)
+{
+    g_ptr_array_free(data->levels, TRUE);
+    g_string_free(data->scratch_key, TRUE);
+    g_string_free(data->scratch_value, TRUE);
+}
+
+static GString *
+json_scratch_string(GString *scratch)
+{
+    g_string_truncate(scratch, 0);
+    return scratch;
+}
+
+static guint
+json_key_parts_hash(const char **parts)
+{
+    /* Same as g_str_hash() over the concatenation of the parts */
+    guint32 h = 5381;
+
+    for (; *parts; parts++) {
+        const signed char *p;
+
+        for (p = (const signed char *)*parts; *p; p++)
+            h = (h << 5) + h + *p;
+    }
+    return h;
+}
+
+static gboolean
+json_key_parts_equal(const char **a, const char **b)
+{
+    const char *pa = *a++;
+    const char *pb = *b++;
+
+    for (;;) {
+        /* Move on to the next part at the end of the current one */
+        while (pa && *pa == '\0')
+            pa = *a++;
+        while (pb && *pb == '\0')
+            pb = *b++;
+        if (pa == NULL || pb == NULL)
+            return pa == pb;
+        if (*pa != *pb)
+            return FALSE;
+        pa++;
+        pb++;
+    }
+}
+
+static json_group_level *
+json_grouper_level(write_json_data *pdata)
+{
+    json_group_level *level;
+
+    while (pdata->levels->len <= pdata->depth) {
+        level = g_new0(json_group_level, 1);
+        level->members = g_array_new(FALSE, FALSE, sizeof(json_group_member));
+        level->groups = g_array_new(FALSE, FALSE, sizeof(json_group));
+        g_ptr_array_add(pdata->levels, level);
+    }
+
+    level = (json_group_level *)g_ptr_array_index(pdata->levels, pdata->depth);
+    g_array_set_size(level->members, 0);
+    g_array_set_size(level->groups, 0);
+    if (level->lookup != NULL && g_hash_table_size(level->lookup) > 0)
+        g_hash_table_remove_all(level->lookup);
+    return level;
+}
+
+static json_group_member *
+json_group_member_get(json_group_level *level, gint member)
+{
+    return &g_array_index(level->members, json_group_member, member);
+}
+
+static json_group *
+json_group_get(json_group_level *level, guint group)
+{
+    return &g_array_index(level->groups, json_group, group);
+}
+
+static proto_node *
+json_group_first_node(json_group_level *level, guint group)
+{
+    return json_group_member_get(level, json_group_get(level, group)->first)->node;
+}
+
+/* Adds a node to an existing group. */
+static void
+json_group_append(json_group_level *level, guint group, proto_node *node)
+{
+    json_group_member member = { node, -1 };
+    json_group *g = json_group_get(level, group);
+    gint new_member = (gint)level->members->len;
+
+    g_array_append_val(level->members, member);
+    json_group_member_get(level, g->last)->next = new_member;
+    g->last = new_member;
+    g->count++;
+}
+
+/* Adds a node in a group of its own, and returns the index of the group. */
+static guint
+json_group_append_new(json_group_level *level, proto_node *node)
+{
+    json_group_member member = { node, -1 };
+    json_group group;
+
+    group.first = group.last = (gint)level->members->len;
+    group.count = 1;
+    g_array_append_val(level->members, member);
+    g_array_append_val(level->groups, group);
+    return level->groups->len - 1;
+}
+
+/* Adds a node to the group of its key, creating the group if necessary. */
+static void
+json_group_add(const json_grouper *grouper, json_group_level *level, proto_node *node)
+{
+    gpointer group;
+
+    if (level->groups->len <= JSON_GROUP_LINEAR_MAX) {
+        const char *parts[JSON_KEY_MAX_PARTS + 1];
+        const char *group_parts[JSON_KEY_MAX_PARTS + 1];
+        guint i;
+
+        grouper->key_parts(node, parts);
+        for (i = 0; i < level->groups->len; i++) {
+            grouper->key_parts(json_group_first_node(level, i), group_parts);
+            if (json_key_parts_equal(parts, group_parts)) {
+                json_group_append(level, i, node);
+                return;
+            }
+        }
+
+        i = json_group_append_new(level, node);
+        if (level->groups->len > JSON_GROUP_LINEAR_MAX) {
+            /* Too many to keep searching; index all the groups. */
+            if (level->lookup == NULL)
+                level->lookup = g_hash_table_new(grouper->key_hash, grouper->key_equal);
+            for (i = 0; i < level->groups->len; i++)
+                g_hash_table_insert(level->lookup, json_group_first_node(level, i), GUINT_TO_POINTER(i + 1));
+        }
+        return;
+    }
+
+    group = g_hash_table_lookup(level->lookup, node);
+    if (group != NULL) {
+        json_group_append(level, GPOINTER_TO_UINT(group) - 1, node);
+    } else {
+        g_hash_table_insert(level->lookup, node, GUINT_TO_POINTER(json_group_append_new(level, node) + 1));
+    }
+}
+
+static void
+json_node_key_parts(const proto_node *node, const char *parts[JSON_KEY_MAX_PARTS + 1])
+{
+    parts[0] = proto_node_to_json_key((proto_node *)node);
+    parts[1] = NULL;
+}
+
+static guint
+json_node_key_hash(gconstpointer node)
+{
+    const char *parts[JSON_KEY_MAX_PARTS + 1];
+
+    json_node_key_parts((const proto_node *)node, parts);
+    return json_key_parts_hash(parts);
+}
+
+static gboolean
+json_node_key_equal(gconstpointer a, gconstpointer b)
+{
+    const char *parts_a[JSON_KEY_MAX_PARTS + 1];
+    const char *parts_b[JSON_KEY_MAX_PARTS + 1];
+
+    json_node_key_parts((const proto_node *)a, parts_a);
+    json_node_key_parts((const proto_node *)b, parts_b);
+    return json_key_parts_equal(parts_a, parts_b);
+}
+
+static const json_grouper json_key_grouper = {
+    json_node_key_parts, json_node_key_hash, json_node_key_equal
+};
+
 json_dumper
 write_json_preamble(FILE *fh)
 {
     json_dumper dumper = {
         .output_file = fh,
-        .flags = JSON_DUMPER_FLAGS_PRETTY_PRINT
+        .flags = JSON_DUMPER_FLAGS_PRETTY_PRINT,
+        .output_buffer = (gchar *)g_malloc(JSON_OUTPUT_BUFFER_SIZE),
+        .output_buffer_size = JSON_OUTPUT_BUFFER_SIZE
     };
     json_dumper_begin_array(&dumper);
+    json_dumper_flush(&dumper);
     return dumper;
 }
 
@@ -697,14 +976,16 @@ write_json_finale(json_dumper *dumper)
 {
     json_dumper_end_array(dumper);
     json_dumper_finish(dumper);
+    g_free(dumper->output_buffer);
+    dumper->output_buffer = NULL;
 }
 
 static void
 write_json_index(json_dumper *dumper, epan_dissect_t *edt)
 {
     char ts[30];
+    char index_str[sizeof "packets-" + sizeof ts];
     struct tm * timeinfo;
-    gchar* str;
 
     timeinfo = localtime(&edt->pi.abs_ts.secs);
     if (timeinfo != NULL) {
@@ -712,10 +993,9 @@ write_json_index(json_dumper *dumper, epan_dissect_t *edt)
     } else {
         g_strlcpy(ts, "XXXX-XX-XX", sizeof ts); /* XXX - better way of saying "Not representable"? */
     }
+    g_snprintf(index_str, sizeof index_str, "packets-%s", ts);
     json_dumper_set_member_name(dumper, "_index");
-    str = g_strdup_printf("packets-%s", ts);
-    json_dumper_value_string(dumper, str);
-    g_free(str);
+    json_dumper_value_string(dumper, index_str);
 }
 
 void
@@ -729,7 +1009,7 @@ write_json_proto_tree(output_fields_t* fields,
 {
     write_json_data data;
 
-    data.dumper = dumper;
+    write_json_data_init(&data, dumper);
 
     json_dumper_begin_object(dumper);
     write_json_index(dumper, edt);
@@ -760,55 +1040,52 @@ write_json_proto_tree(output_fields_t* fields,
 
     json_dumper_end_object(dumper);
     json_dumper_end_object(dumper);
+    json_dumper_flush(dumper);
+
+    write_json_data_cleanup(&data);
 }
 
 /**
  * Write a json object containing a list of key:value pairs where each key:value pair corresponds to a different json
  * key and its associated nodes in the proto_tree.
- * @param proto_node_list_head A 2-dimensional list containing a list of values for each different node json key. The
- * elements themselves are a linked list of values associated with the same json key.
+ * @param level The nodes of the object, grouped by json key.
  * @param pdata json writing metadata
  */
 static void
-write_json_proto_node_list(GSList *proto_node_list_head, write_json_data *pdata)
+write_json_proto_node_list(json_group_level *level, write_json_data *pdata)
 {
-    GSList *current_node = proto_node_list_head;
+    GString *value_repr = json_scratch_string(pdata->scratch_value);
+    guint group;
 
     json_dumper_begin_object(pdata->dumper);
 
     // Loop over each list of nodes (differentiated by json key) and write the associated json key:value pair in the
     // output.
-    while (current_node != NULL) {
-        // Get the list of values for the current json key.
-        GSList *node_values_list = (GSList *) current_node->data;
-
+    for (group = 0; group < level->groups->len; group++) {
         // Retrieve the json key from the first value.
-        proto_node *first_value = (proto_node *) node_values_list->data;
+        proto_node *first_value = json_group_first_node(level, group);
         const char *json_key = proto_node_to_json_key(first_value);
         // Check if the current json key is filtered from the output with the "-j" cli option.
         gboolean is_filtered = pdata->filter != NULL && !check_protocolfilter(pdata->filter, json_key);
 
         field_info *fi = first_value->finfo;
-        char *value_string_repr = fvalue_to_string_repr(NULL, &fi->value, FTREPR_DISPLAY, fi->hfinfo->display);
 
         // We assume all values of a json key have roughly the same layout. Thus we can use the first value to derive
         // attributes of all the values.
-        gboolean has_value = value_string_repr != NULL;
+        gboolean has_value = fvalue_to_string_repr_buf(value_repr, &fi->value, FTREPR_DISPLAY, fi->hfinfo->display) != NULL;
         gboolean has_children = first_value->first_child != NULL;
         gboolean is_pseudo_text_field = fi->hfinfo->id == 0;
 
-        wmem_free(NULL, value_string_repr); // fvalue_to_string_repr returns allocated buffer
-
         // "-x" command line option. A "_raw" suffix is added to the json key so the textual value can be printed
         // with the original json key. If both hex and text writing are enabled the raw information of fields whose
         // length is equal to 0 is not written to the output. If the field is a special text pseudo field no raw
         // information is written either.
         if (pdata->print_hex && (!pdata->print_text || fi->length > 0) && !is_pseudo_text_field) {
-            write_json_proto_node(node_values_list, "_raw", write_json_proto_node_hex_dump, pdata);
+            write_json_proto_node(level, group, "_raw", write_json_proto_node_hex_dump, pdata);
         }
 
         if (pdata->print_text && has_value) {
-            write_json_proto_node(node_values_list, "", write_json_proto_node_value, pdata);
+            write_json_proto_node(level, group, "", write_json_proto_node_value, pdata);
         }
 
         if (has_children) {
@@ -818,7 +1095,7 @@ write_json_proto_node_list(GSList *proto_node_list_head, write_json_data *pdata)
             char *suffix = has_value ? "_tree": "";
 
             if (is_filtered) {
-                write_json_proto_node(node_values_list, suffix, write_json_proto_node_filtered, pdata);
+                write_json_proto_node(level, group, suffix, write_json_proto_node_filtered, pdata);
             } else {
                 // Remove protocol filter for children, if children should be included. This functionality is enabled
                 // with the "-J" command line option. We save the filter so it can be reenabled when we are done with
@@ -829,7 +1106,7 @@ write_json_proto_node_list(GSList *proto_node_list_head, write_json_data *pdata)
                     pdata->filter = NULL;
                 }
 
-                write_json_proto_node(node_values_list, suffix, write_json_proto_node_children, pdata);
+                write_json_proto_node(level, group, suffix, write_json_proto_node_children, pdata);
 
                 // Put protocol filter back
                 if ((pdata->filter_flags&PF_INCLUDE_CHILDREN) == PF_INCLUDE_CHILDREN) {
@@ -839,10 +1116,8 @@ write_json_proto_node_list(GSList *proto_node_list_head, write_json_data *pdata)
         }
 
         if (!has_value && !has_children && (pdata->print_text || (pdata->print_hex && is_pseudo_text_field))) {
-            write_json_proto_node(node_values_list, "", write_json_proto_node_no_value, pdata);
+            write_json_proto_node(level, group, "", write_json_proto_node_no_value, pdata);
         }
-
-        current_node = current_node->next;
     }
     json_dumper_end_object(pdata->dumper);
 }
@@ -850,46 +1125,50 @@ write_json_proto_node_list(GSList *proto_node_list_head, write_json_data *pdata)
 /**
  * Writes a single node as a key:value pair. The value_writer param can be used to specify how the node's value should
  * be written.
- * @param node_values_head Linked list containing all nodes associated with the same json key in this object.
+ * @param level The nodes of the current object, grouped by json key.
+ * @param group The group of nodes associated with the same json key.
  * @param suffix Suffix that should be added to the json key.
  * @param value_writer A function which writes the actual values of the node json key.
  * @param pdata json writing metadata
  */
 static void
-write_json_proto_node(GSList *node_values_head,
+write_json_proto_node(json_group_level *level, guint group,
                       const char *suffix,
                       proto_node_value_writer value_writer,
                       write_json_data *pdata)
 {
     // Retrieve json key from first value.
-    proto_node *first_value = (proto_node *) node_values_head->data;
-    const char *json_key = proto_node_to_json_key(first_value);
-    gchar* json_key_suffix = g_strdup_printf("%s%s", json_key, suffix);
-    json_dumper_set_member_name(pdata->dumper, json_key_suffix);
-    g_free(json_key_suffix);
-    write_json_proto_node_value_list(node_values_head, value_writer, pdata);
+    proto_node *first_value = json_group_first_node(level, group);
+    GString *json_key_suffix = json_scratch_string(pdata->scratch_key);
+
+    g_string_append(json_key_suffix, proto_node_to_json_key(first_value));
+    g_string_append(json_key_suffix, suffix);
+    json_dumper_set_member_name(pdata->dumper, json_key_suffix->str);
+    write_json_proto_node_value_list(level, group, value_writer, pdata);
 }
 
 /**
  * Writes a list of values of a single json key. If multiple values are passed they are wrapped in a json array.
- * @param node_values_head Linked list containing all values that should be written.
+ * @param level The nodes of the current object, grouped by json key.
+ * @param group The group of nodes whose values should be written.
  * @param value_writer Function which writes the separate values.
  * @param pdata json writing metadata
  */
 static void
-write_json_proto_node_value_list(GSList *node_values_head, proto_node_value_writer value_writer, write_json_data *pdata)
+write_json_proto_node_value_list(json_group_level *level, guint group, proto_node_value_writer value_writer, write_json_data *pdata)
 {
-    GSList *current_value = node_values_head;
+    json_group *g = json_group_get(level, group);
+    gint member = g->first;
 
     // Write directly if only a single value is passed. Wrap in json array otherwise.
-    if (current_value->next == NULL) {
-        value_writer((proto_node *) current_value->data, pdata);
+    if (g->count == 1) {
+        value_writer(json_group_member_get(level, member)->node, pdata);
     } else {
         json_dumper_begin_array(pdata->dumper);
 
-        while (current_value != NULL) {
-            value_writer((proto_node *) current_value->data, pdata);
-            current_value = current_value->next;
+        while (member != -1) {
+            value_writer(json_group_member_get(level, member)->node, pdata);
+            member = json_group_member_get(level, member)->next;
         }
         json_dumper_end_array(pdata->dumper);
     }
@@ -971,9 +1250,35 @@ write_json_proto_node_hex_dump(proto_node *node, write_json_data *pdata)
 static void
 write_json_proto_node_children(proto_node *node, write_json_data *data)
 {
-    GSList *grouped_children_list = data->node_children_grouper(node);
-    write_json_proto_node_list(grouped_children_list, data);
-    g_slist_free_full(grouped_children_list, (GDestroyNotify) g_slist_free);
+    json_group_level *level = json_grouper_level(data);
+    proto_node *current_child;
+
+    if (data->node_children_grouper == proto_node_group_children_by_json_key) {
+        for (current_child = node->first_child; current_child != NULL; current_child = current_child->next) {
+            json_group_add(&json_key_grouper, level, current_child);
+        }
+    } else if (data->node_children_grouper == proto_node_group_children_by_unique) {
+        for (current_child = node->first_child; current_child != NULL; current_child = current_child->next) {
+            json_group_append_new(level, current_child);
+        }
+    } else {
+        // Some other grouping; copy the groups it makes.
+        GSList *grouped_children_list = data->node_children_grouper(node);
+        GSList *current_group, *current_value;
+
+        for (current_group = grouped_children_list; current_group != NULL; current_group = current_group->next) {
+            current_value = (GSList *) current_group->data;
+            guint group = json_group_append_new(level, (proto_node *) current_value->data);
+            for (current_value = current_value->next; current_value != NULL; current_value = current_value->next) {
+                json_group_append(level, group, (proto_node *) current_value->data);
+            }
+        }
+        g_slist_free_full(grouped_children_list, (GDestroyNotify) g_slist_free);
+    }
+
+    data->depth++;
+    write_json_proto_node_list(level, data);
+    data->depth--;
 }
 
 /**
@@ -984,11 +1289,10 @@ write_json_proto_node_value(proto_node *node, write_json_data *pdata)
 {
     field_info *fi = node->finfo;
     // Get the actual value of the node as a string.
-    char *value_string_repr = fvalue_to_string_repr(NULL, &fi->value, FTREPR_DISPLAY, fi->hfinfo->display);
+    const char *value_string_repr = fvalue_to_string_repr_buf(json_scratch_string(pdata->scratch_value),
+                                                              &fi->value, FTREPR_DISPLAY, fi->hfinfo->display);
 
     json_dumper_value_string(pdata->dumper, value_string_repr);
-
-    wmem_free(NULL, value_string_repr);
 }
 
 /**
@@ -1102,29 +1406,27 @@ proto_node_to_json_key(proto_node *node)
 static gboolean
 ek_check_protocolfilter(gchar **protocolfilter, const char *str)
 {
-    gchar *str_escaped = NULL;
-    gboolean check;
-    int i;
+    gchar **ptr;
 
     if (check_protocolfilter(protocolfilter, str))
         return TRUE;
 
+    if (str == NULL || *str == '\0' || protocolfilter == NULL)
+        return FALSE;
+
     /* to to thread the '.' and '_' equally. The '.' is replace by print_escaped_ek for '_' */
-    if (str != NULL && strlen(str) > 0) {
-        str_escaped = g_strdup(str);
+    for (ptr = protocolfilter; *ptr; ptr++) {
+        const char *f = *ptr;
+        const char *c = str;
 
-        i = 0;
-        while (str_escaped[i] != '\0') {
-            if (str_escaped[i] == '.') {
-                str_escaped[i] = '_';
-            }
-            i++;
+        while (*f != '\0' && *f == (*c == '.' ? '_' : *c)) {
+            f++;
+            c++;
         }
+        if (*f == '\0' && *c == '\0')
+            return TRUE;
     }
-
-    check = check_protocolfilter(protocolfilter, str_escaped);
-    g_free(str_escaped);
-    return check;
+    return FALSE;
 }
 
 /**
@@ -1136,49 +1438,78 @@ write_ek_summary(column_info *cinfo, write_json_data* pdata)
     gint i;
 
     for (i = 0; i < cinfo->num_cols; i++) {
+        GString *name;
+        const char *c;
+
         if (!get_column_visible(i))
             continue;
-        json_dumper_set_member_name(pdata->dumper, g_ascii_strdown(cinfo->columns[i].col_title, -1));
+        name = json_scratch_string(pdata->scratch_key);
+        for (c = cinfo->columns[i].col_title; *c != '\0'; c++)
+            g_string_append_c(name, g_ascii_tolower(*c));
+        json_dumper_set_member_name(pdata->dumper, name->str);
         json_dumper_value_string(pdata->dumper, cinfo->columns[i].col_data);
     }
 }
 
+/*
+ * The attributes of an EK object are named after the tree parent and the
+ * field, "parent_field", or just "field" at the top.
+ */
+static void
+ek_attr_key_parts(const proto_node *node, const char *parts[JSON_KEY_MAX_PARTS + 1])
+{
+    field_info *fi        = PNODE_FINFO(node);
+    field_info *fi_parent = PNODE_FINFO(node->parent);
+
+    if (fi_parent == NULL) {
+        parts[0] = fi->hfinfo->abbrev;
+        parts[1] = NULL;
+    } else {
+        parts[0] = fi_parent->hfinfo->abbrev;
+        parts[1] = "_";
+        parts[2] = fi->hfinfo->abbrev;
+        parts[3] = NULL;
+    }
+}
+
+static guint
+ek_attr_key_hash(gconstpointer node)
+{
+    const char *parts[JSON_KEY_MAX_PARTS + 1];
+
+    ek_attr_key_parts((const proto_node *)node, parts);
+    return json_key_parts_hash(parts);
+}
+
+static gboolean
+ek_attr_key_equal(gconstpointer a, gconstpointer b)
+{
+    const char *parts_a[JSON_KEY_MAX_PARTS + 1];
+    const char *parts_b[JSON_KEY_MAX_PARTS + 1];
+
+    ek_attr_key_parts((const proto_node *)a, parts_a);
+    ek_attr_key_parts((const proto_node *)b, parts_b);
+    return json_key_parts_equal(parts_a, parts_b);
+}
+
+static const json_grouper ek_attr_grouper = {
+    ek_attr_key_parts, ek_attr_key_hash, ek_attr_key_equal
+};
+
 /* Write out a tree's data, and any child nodes, as JSON for EK */
 static void
-ek_fill_attr(proto_node *node, GSList **attr_list, GHashTable *attr_table, write_json_data *pdata)
+ek_fill_attr(proto_node *node, json_group_level *level, write_json_data *pdata)
 {
     field_info *fi         = NULL;
-    field_info *fi_parent  = NULL;
-    gchar *node_name       = NULL;
-    GSList *attr_instances = NULL;
 
     proto_node *current_node = node->first_child;
     while (current_node != NULL) {
         fi        = PNODE_FINFO(current_node);
-        fi_parent = PNODE_FINFO(current_node->parent);
 
         /* dissection with an invisible proto tree? */
         g_assert(fi);
 
-        if (fi_parent == NULL) {
-            node_name = g_strdup(fi->hfinfo->abbrev);
-        }
-        else {
-            node_name = g_strconcat(fi_parent->hfinfo->abbrev, "_", fi->hfinfo->abbrev, NULL);
-        }
-
-        attr_instances = (GSList *) g_hash_table_lookup(attr_table, node_name);
-        // First time we encounter this attr
-        if (attr_instances == NULL) {
-            attr_instances = g_slist_append(attr_instances, current_node);
-            *attr_list = g_slist_prepend(*attr_list, attr_instances);
-        }
-        else {
-            attr_instances = g_slist_append(attr_instances, current_node);
-        }
-
-        // Update instance list for this attr in hash table
-        g_hash_table_insert(attr_table, node_name, attr_instances);
+        json_group_add(&ek_attr_grouper, level, current_node);
 
         /* Field, recurse through children*/
         if (fi->hfinfo->type != FT_PROTOCOL && current_node->first_child != NULL) {
@@ -1191,7 +1522,7 @@ ek_fill_attr(proto_node *node, GSList **attr_list, GHashTable *attr_table, write
                         pdata->filter = NULL;
                     }
 
-                    ek_fill_attr(current_node, attr_list, attr_table, pdata);
+                    ek_fill_attr(current_node, level, pdata);
 
                     /* Put protocol filter back */
                     if ((pdata->filter_flags&PF_INCLUDE_CHILDREN) == PF_INCLUDE_CHILDREN) {
@@ -1203,7 +1534,7 @@ ek_fill_attr(proto_node *node, GSList **attr_list, GHashTable *attr_table, write
                 }
             }
             else {
-                ek_fill_attr(current_node, attr_list, attr_table, pdata);
+                ek_fill_attr(current_node, level, pdata);
             }
         }
         else {
@@ -1218,17 +1549,17 @@ static void
 ek_write_name(proto_node *pnode, gchar* suffix, write_json_data* pdata)
 {
     field_info *fi = PNODE_FINFO(pnode);
-    gchar      *str;
+    GString    *str = json_scratch_string(pdata->scratch_key);
 
     if (fi->hfinfo->parent != -1) {
         header_field_info* parent = proto_registrar_get_nth(fi->hfinfo->parent);
-        str = g_strdup_printf("%s_%s%s", parent->abbrev, fi->hfinfo->abbrev, suffix ? suffix : "");
-        json_dumper_set_member_name(pdata->dumper, str);
-    } else {
-        str = g_strdup_printf("%s%s", fi->hfinfo->abbrev, suffix ? suffix : "");
-        json_dumper_set_member_name(pdata->dumper, str);
+        g_string_append(str, parent->abbrev);
+        g_string_append_c(str, '_');
     }
-    g_free(str);
+    g_string_append(str, fi->hfinfo->abbrev);
+    if (suffix)
+        g_string_append(str, suffix);
+    json_dumper_set_member_name(pdata->dumper, str->str);
 }
 
 static void
@@ -1275,7 +1606,7 @@ static void
 ek_write_field_value(field_info *fi, write_json_data* pdata)
 {
     gchar label_str[ITEM_LABEL_LENGTH];
-    char *dfilter_string;
+    const char *dfilter_string;
 
     /* Text label */
     if (fi->hfinfo->id == hf_text_only && fi->rep) {
@@ -1303,66 +1634,68 @@ ek_write_field_value(field_info *fi, write_json_data* pdata)
                 json_dumper_value_anyf(pdata->dumper, "false");
             break;
         default:
-            dfilter_string = fvalue_to_string_repr(NULL, &fi->value, FTREPR_DISPLAY, fi->hfinfo->display);
+            dfilter_string = fvalue_to_string_repr_buf(json_scratch_string(pdata->scratch_value),
+                                                       &fi->value, FTREPR_DISPLAY, fi->hfinfo->display);
             if (dfilter_string != NULL) {
                 json_dumper_value_string(pdata->dumper, dfilter_string);
             }
-            wmem_free(NULL, dfilter_string);
             break;
         }
     }
 }
 
 static void
-ek_write_attr_hex(GSList *attr_instances, write_json_data *pdata)
+ek_write_attr_hex(json_group_level *level, guint group, write_json_data *pdata)
 {
-    GSList *current_node = attr_instances;
-    proto_node *pnode    = (proto_node *) current_node->data;
+    json_group *g        = json_group_get(level, group);
+    gint current_member  = g->first;
+    proto_node *pnode    = json_group_first_node(level, group);
     field_info *fi       = NULL;
 
     // Raw name
     ek_write_name(pnode, "_raw", pdata);
 
-    if (g_slist_length(attr_instances) > 1) {
+    if (g->count > 1) {
         json_dumper_begin_array(pdata->dumper);
     }
 
     // Raw value(s)
-    while (current_node != NULL) {
-        pnode = (proto_node *) current_node->data;
+    while (current_member != -1) {
+        pnode = json_group_member_get(level, current_member)->node;
         fi    = PNODE_FINFO(pnode);
 
         ek_write_hex(fi, pdata);
 
-        current_node = current_node->next;
+        current_member = json_group_member_get(level, current_member)->next;
     }
 
-    if (g_slist_length(attr_instances) > 1) {
+    if (g->count > 1) {
         json_dumper_end_array(pdata->dumper);
     }
 }
 
 static void
-ek_write_attr(GSList *attr_instances, write_json_data *pdata)
+ek_write_attr(json_group_level *level, guint group, write_json_data *pdata)
 {
-    GSList *current_node = attr_instances;
-    proto_node *pnode    = (proto_node *) current_node->data;
+    json_group *g        = json_group_get(level, group);
+    gint current_member  = g->first;
+    proto_node *pnode    = json_group_first_node(level, group);
     field_info *fi       = PNODE_FINFO(pnode);
 
     // Hex dump -x
     if (pdata->print_hex && fi && fi->length > 0 && fi->hfinfo->id != hf_text_only) {
-        ek_write_attr_hex(attr_instances, pdata);
+        ek_write_attr_hex(level, group, pdata);
     }
 
     // Print attr name
     ek_write_name(pnode, NULL, pdata);
 
-    if (g_slist_length(attr_instances) > 1) {
+    if (g->count > 1) {
         json_dumper_begin_array(pdata->dumper);
     }
 
-    while (current_node != NULL) {
-        pnode = (proto_node *) current_node->data;
+    while (current_member != -1) {
+        pnode = json_group_member_get(level, current_member)->node;
         fi    = PNODE_FINFO(pnode);
 
         /* Field */
@@ -1410,10 +1743,10 @@ ek_write_attr(GSList *attr_instances, write_json_data *pdata)
             json_dumper_end_object(pdata->dumper);
         }
 
-        current_node = current_node->next;
+        current_member = json_group_member_get(level, current_member)->next;
     }
 
-    if (g_slist_length(attr_instances) > 1) {
+    if (g->count > 1) {
         json_dumper_end_array(pdata->dumper);
     }
 }
@@ -1422,25 +1755,17 @@ ek_write_attr(GSList *attr_instances, write_json_data *pdata)
 static void
 proto_tree_write_node_ek(proto_node *node, write_json_data *pdata)
 {
-    GSList *attr_list  = NULL;
-    GHashTable *attr_table  = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    json_group_level *level = json_grouper_level(pdata);
+    guint group;
 
-    ek_fill_attr(node, &attr_list, attr_table, pdata);
-
-    g_hash_table_destroy(attr_table);
+    ek_fill_attr(node, level, pdata);
 
     // Print attributes
-    attr_list = g_slist_reverse(attr_list);
-    GSList *current_attr = attr_list;
-    while (current_attr != NULL) {
-        GSList *attr_instances = (GSList *) current_attr->data;
-
-        ek_write_attr(attr_instances, pdata);
-
-        current_attr = current_attr->next;
+    pdata->depth++;
+    for (group = 0; group < level->groups->len; group++) {
+        ek_write_attr(level, group, pdata);
     }
-
-    g_slist_free_full(attr_list, (GDestroyNotify) g_slist_free);
+    pdata->depth--;
 }
 
 /* Print info for a 'geninfo' pseudo-protocol. This is required by
@@ -1843,18 +2168,15 @@ json_write_field_hex_value(write_json_data *pdata, field_info *fi)
 
     if (pd) {
         gint i;
-        guint len = fi->length * 2 + 1;
-        gchar* str = (gchar*)g_malloc0(len);
+        GString *str = json_scratch_string(pdata->scratch_value);
         static const char hex[] = "0123456789abcdef";
         /* Print a simple hex dump */
         for (i = 0; i < fi->length; i++) {
             guint8 c = pd[i];
-            str[2 * i] = hex[c >> 4];
-            str[2 * i + 1] = hex[c & 0xf];
+            g_string_append_c(str, hex[c >> 4]);
+            g_string_append_c(str, hex[c & 0xf]);
         }
-        str[2 * fi->length] = '\0';
-        json_dumper_value_string(pdata->dumper, str);
-        g_free(str);
+        json_dumper_value_string(pdata->dumper, str->str);
     } else {
         json_dumper_value_string(pdata->dumper, "");
     }
@@ -2031,6 +2353,10 @@ void output_fields_free(output_fields_t* fields)
             g_free(fields->field_values);
         }
 
+        if (NULL != fields->prime_hfids) {
+            g_array_free(fields->prime_hfids, TRUE);
+        }
+
         for(i = 0; i < fields->fields->len; ++i) {
             gchar* field = (gchar *)g_ptr_array_index(fields->fields,i);
             g_free(field);
@@ -2192,6 +2518,16 @@ gboolean output_fields_set_option(output_fields_t *info, gchar *option)
         }
         return TRUE;
     }
+    else if (0 == strcmp(option_name, "batch")) {
+        gchar *end;
+        guint64 rows = g_ascii_strtoull(option_value, &end, 10);
+
+        if (*end != '\0' || rows == 0 || rows > G_MAXINT32) {
+            return FALSE;
+        }
+        info->batch_rows = (guint)rows;
+        return TRUE;
+    }
     else if (0 == strcmp(option_name, "bom")) {
         switch (*option_value) {
         case 'n':
@@ -2218,6 +2554,7 @@ void output_fields_list_options(FILE *fh)
     fputs("occurrence=f|l|a  Select the occurrence of a field to use;\n     \"f\" = first, \"l\" = last, \"a\" = all (def: a: all)\n", fh);
     fputs("aggregator=,|/s|<character>   Set the aggregator to use;\n     \",\" = comma, \"/s\" = space (def: ,: comma)\n", fh);
     fputs("quote=d|s|n   Print either d: double-quotes, s: single quotes or \n     n: no quotes around field values (def: n: none)\n", fh);
+    fputs("batch=<rows>  Number of rows in each Arrow record batch (def: 4096)\n", fh);
 }
 
 gboolean output_fields_has_cols(output_fields_t* fields)
@@ -2226,6 +2563,63 @@ gboolean output_fields_has_cols(output_fields_t* fields)
     return fields->includes_col_fields;
 }
 
+gboolean output_fields_can_prime(output_fields_t* fields)
+{
+    header_field_info *hfinfo;
+    GArray *hfids;
+    gsize i;
+
+    g_assert(fields);
+
+    if (NULL != fields->prime_hfids) {
+        return TRUE;
+    }
+    if (NULL == fields->fields) {
+        return FALSE;
+    }
+
+    hfids = g_array_new(FALSE, FALSE, sizeof(int));
+    for (i = 0; i < fields->fields->len; i++) {
+        gchar *field = (gchar *)g_ptr_array_index(fields->fields, i);
+
+        if (!strncmp(field, COLUMN_FIELD_FILTER, strlen(COLUMN_FIELD_FILTER))) {
+            continue;
+        }
+        hfinfo = proto_registrar_get_byname(field);
+        if (NULL == hfinfo) {
+            g_array_free(hfids, TRUE);
+            return FALSE;
+        }
+
+        /* Every field with that name, as the first one found is written */
+        while (hfinfo->same_name_prev_id != -1) {
+            hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+        }
+        for (; hfinfo; hfinfo = hfinfo->same_name_next) {
+            /*
+             * The value of a protocol or a text item is its label, which
+             * is only filled in on a visible tree.
+             */
+            if (hfinfo->type == FT_PROTOCOL || hfinfo->id == hf_text_only) {
+                g_array_free(hfids, TRUE);
+                return FALSE;
+            }
+            g_array_append_val(hfids, hfinfo->id);
+        }
+    }
+
+    fields->prime_hfids = hfids;
+    return TRUE;
+}
+
+void output_fields_prime_edt(output_fields_t* fields, epan_dissect_t *edt)
+{
+    g_assert(fields);
+    g_assert(fields->prime_hfids);
+
+    epan_dissect_prime_with_hfid_array(edt, fields->prime_hfids);
+}
+
 void write_fields_preamble(output_fields_t* fields, FILE *fh)
 {
     gsize i;
@@ -2343,6 +2737,26 @@ static void proto_tree_get_node_field_values(proto_node *node, gpointer data)
     }
 }
 
+static void prepare_field_indicies(output_fields_t *fields)
+{
+    gsize i;
+
+    if (NULL == fields->field_indicies) {
+        /* Prepare a lookup table from string abbreviation for field to its index. */
+        fields->field_indicies = g_hash_table_new(g_str_hash, g_str_equal);
+
+        i = 0;
+        while (i < fields->fields->len) {
+            gchar *field = (gchar *)g_ptr_array_index(fields->fields, i);
+            /* Store field indicies +1 so that zero is not a valid value,
+             * and can be distinguished from NULL as a pointer.
+             */
+            ++i;
+            g_hash_table_insert(fields->field_indicies, field, GUINT_TO_POINTER(i));
+        }
+    }
+}
+
 static void write_specified_fields(fields_format format, output_fields_t *fields, epan_dissect_t *edt, column_info *cinfo, FILE *fh, json_dumper *dumper)
 {
     gsize     i;
@@ -2365,20 +2779,7 @@ static void write_specified_fields(fields_format format, output_fields_t *fields
     data.fields = fields;
     data.edt = edt;
 
-    if (NULL == fields->field_indicies) {
-        /* Prepare a lookup table from string abbreviation for field to its index. */
-        fields->field_indicies = g_hash_table_new(g_str_hash, g_str_equal);
-
-        i = 0;
-        while (i < fields->fields->len) {
-            gchar *field = (gchar *)g_ptr_array_index(fields->fields, i);
-            /* Store field indicies +1 so that zero is not a valid value,
-             * and can be distinguished from NULL as a pointer.
-             */
-            ++i;
-            g_hash_table_insert(fields->field_indicies, field, GUINT_TO_POINTER(i));
-        }
-    }
+    prepare_field_indicies(fields);
 
     /* Array buffer to store values for this packet              */
     /*  Allocate an array for the 'GPtrarray *' the first time   */
@@ -2530,6 +2931,535 @@ void write_fields_finale(output_fields_t* fields _U_ , FILE *fh _U_)
     /* Nothing to do */
 }
 
+/*
+ * The Arrow column type for the values of a field: the type of its
+ * values if all the fields with that name have the same one, strings
+ * otherwise.
+ */
+static arrow_type_e arrow_field_type(const gchar *field)
+{
+    header_field_info *hfinfo;
+    arrow_type_e type, same_name_type;
+    gboolean first = TRUE;
+
+    if (g_str_has_prefix(field, COLUMN_FIELD_FILTER)) {
+        return ARROW_TYPE_UTF8;
+    }
+    hfinfo = proto_registrar_get_byname(field);
+    if (hfinfo == NULL) {
+        return ARROW_TYPE_UTF8;
+    }
+
+    type = ARROW_TYPE_UTF8;
+    for (; hfinfo; hfinfo = hfinfo->same_name_next) {
+        switch (hfinfo->type) {
+        case FT_BOOLEAN:
+            same_name_type = ARROW_TYPE_BOOL;
+            break;
+        case FT_CHAR:
+        case FT_UINT8:
+        case FT_UINT16:
+        case FT_UINT24:
+        case FT_UINT32:
+        case FT_FRAMENUM:
+            same_name_type = ARROW_TYPE_UINT32;
+            break;
+        case FT_INT8:
+        case FT_INT16:
+        case FT_INT24:
+        case FT_INT32:
+            same_name_type = ARROW_TYPE_INT32;
+            break;
+        case FT_UINT40:
+        case FT_UINT48:
+        case FT_UINT56:
+        case FT_UINT64:
+            same_name_type = ARROW_TYPE_UINT64;
+            break;
+        case FT_INT40:
+        case FT_INT48:
+        case FT_INT56:
+        case FT_INT64:
+            same_name_type = ARROW_TYPE_INT64;
+            break;
+        case FT_FLOAT:
+        case FT_DOUBLE:
+            same_name_type = ARROW_TYPE_FLOAT64;
+            break;
+        case FT_ABSOLUTE_TIME:
+            same_name_type = ARROW_TYPE_TIMESTAMP_NS;
+            break;
+        case FT_RELATIVE_TIME:
+            same_name_type = ARROW_TYPE_DURATION_NS;
+            break;
+        default:
+            /* Addresses, strings, bytes, protocols... */
+            return ARROW_TYPE_UTF8;
+        }
+        if (!first && same_name_type != type) {
+            return ARROW_TYPE_UTF8;
+        }
+        type = same_name_type;
+        first = FALSE;
+    }
+    return type;
+}
+
+arrow_writer *write_arrow_preamble(output_fields_t* fields, FILE *fh)
+{
+    arrow_writer *writer;
+    gsize i;
+
+    g_assert(fields);
+    g_assert(fh);
+    g_assert(fields->fields);
+
+    writer = arrow_writer_new(fh, fields->batch_rows);
+    for (i = 0; i < fields->fields->len; ++i) {
+        const gchar* field = (const gchar *)g_ptr_array_index(fields->fields, i);
+        /* Only with all occurrences can there be more than one value. */
+        arrow_writer_add_column(writer, field, arrow_field_type(field),
+                                fields->occurrence == 'a');
+    }
+    return writer;
+}
+
+static void write_arrow_field_value(write_arrow_data_t *data, guint col, field_info *fi)
+{
+    const nstime_t *t;
+    gchar *str;
+
+    /* Keep the first occurrence; the writer keeps the last one otherwise. */
+    if (data->fields->occurrence == 'f' && arrow_writer_has_value(data->writer, col)) {
+        return;
+    }
+
+    switch (arrow_writer_column_type(data->writer, col)) {
+    case ARROW_TYPE_BOOL:
+        arrow_writer_value_bool(data->writer, col, fvalue_get_uinteger64(&fi->value) != 0);
+        break;
+    case ARROW_TYPE_UINT32:
+        arrow_writer_value_uint(data->writer, col, fvalue_get_uinteger(&fi->value));
+        break;
+    case ARROW_TYPE_INT32:
+        arrow_writer_value_int(data->writer, col, fvalue_get_sinteger(&fi->value));
+        break;
+    case ARROW_TYPE_UINT64:
+        arrow_writer_value_uint(data->writer, col, fvalue_get_uinteger64(&fi->value));
+        break;
+    case ARROW_TYPE_INT64:
+        arrow_writer_value_int(data->writer, col, fvalue_get_sinteger64(&fi->value));
+        break;
+    case ARROW_TYPE_FLOAT64:
+        arrow_writer_value_double(data->writer, col, fvalue_get_floating(&fi->value));
+        break;
+    case ARROW_TYPE_TIMESTAMP_NS:
+    case ARROW_TYPE_DURATION_NS:
+        t = (const nstime_t *)fvalue_get(&fi->value);
+        arrow_writer_value_int(data->writer, col, (gint64)t->secs * 1000000000 + t->nsecs);
+        break;
+    default:
+        str = get_node_field_value(fi, data->edt);
+        if (str != NULL) {
+            arrow_writer_value_string(data->writer, col, str);
+            g_free(str);
+        }
+        break;
+    }
+}
+
+static void proto_tree_write_node_arrow(proto_node *node, gpointer data)
+{
+    write_arrow_data_t *call_data = (write_arrow_data_t *)data;
+    field_info *fi = PNODE_FINFO(node);
+    gpointer    field_index;
+
+    /* dissection with an invisible proto tree? */
+    g_assert(fi);
+
+    field_index = g_hash_table_lookup(call_data->fields->field_indicies, fi->hfinfo->abbrev);
+    if (NULL != field_index) {
+        write_arrow_field_value(call_data, GPOINTER_TO_UINT(field_index) - 1, fi);
+    }
+
+    /* Recurse here. */
+    if (node->first_child != NULL) {
+        proto_tree_children_foreach(node, proto_tree_write_node_arrow, call_data);
+    }
+}
+
+void write_arrow_proto_tree(output_fields_t* fields, epan_dissect_t *edt, column_info *cinfo, arrow_writer *writer)
+{
+    write_arrow_data_t data;
+    gint      col;
+    gchar    *col_name;
+    gpointer  field_index;
+
+    g_assert(fields);
+    g_assert(fields->fields);
+    g_assert(edt);
+    g_assert(writer);
+
+    data.fields = fields;
+    data.edt = edt;
+    data.writer = writer;
+
+    prepare_field_indicies(fields);
+
+    proto_tree_children_foreach(edt->tree, proto_tree_write_node_arrow, &data);
+
+    /* Add columns to fields */
+    if (fields->includes_col_fields) {
+        for (col = 0; col < cinfo->num_cols; col++) {
+            if (!get_column_visible(col)) continue;
+            /* Prepend COLUMN_FIELD_FILTER as the field name */
+            col_name = g_strdup_printf("%s%s", COLUMN_FIELD_FILTER, cinfo->columns[col].col_title);
+            field_index = g_hash_table_lookup(fields->field_indicies, col_name);
+            g_free(col_name);
+
+            if (NULL != field_index) {
+                arrow_writer_value_string(writer, GPOINTER_TO_UINT(field_index) - 1,
+                                          cinfo->columns[col].col_data);
+            }
+        }
+    }
+
+    arrow_writer_end_row(writer);
+}
+
+gboolean write_arrow_finale(arrow_writer *writer)
+{
+    return arrow_writer_finish(writer);
+}
+
+/*
+ * CBOR tree output: a CBOR sequence (RFC 8742) starting with a header
+ * map, followed by one item per packet:
+ *
+ *   [frame number, [new keys...], [node...]]
+ *
+ * Field abbreviations are written once, into a key table that lasts for
+ * the whole stream; each packet item carries the keys it added to the
+ * table. A node is [key index, value] or [key index, value, [child...]].
+ */
+#define CBOR_TREE_FORMAT  "wireshark-tree"
+#define CBOR_TREE_VERSION 1
+
+struct _cbor_tree_writer {
+    FILE       *fh;         /* NULL to keep the output in memory */
+    GByteArray *out;        /* output not yet written to fh */
+    GByteArray *nodes;      /* nodes of the current packet */
+    GHashTable *keys;       /* key string -> index in the key table */
+    GArray     *hf_keys;    /* hf id -> key index + 1, or 0 if unknown */
+    GPtrArray  *new_keys;   /* keys added by the current packet */
+};
+
+typedef struct {
+    cbor_tree_writer *writer;
+    gchar           **filter;
+    pf_flags          filter_flags;
+    GString          *repr;
+} write_cbor_data;
+
+cbor_tree_writer *
+write_cbor_preamble(FILE *fh)
+{
+    cbor_tree_writer *writer = g_new(cbor_tree_writer, 1);
+
+    writer->fh = fh;
+    writer->out = g_byte_array_new();
+    writer->nodes = g_byte_array_new();
+    writer->keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    writer->hf_keys = g_array_new(FALSE, TRUE, sizeof(guint));
+    writer->new_keys = g_ptr_array_new();
+
+    /* The self-described CBOR tag lets readers recognise the stream. */
+    cbor_write_tag(writer->out, 55799);
+    cbor_write_map(writer->out, 2);
+    cbor_write_text(writer->out, "format", -1);
+    cbor_write_text(writer->out, CBOR_TREE_FORMAT, -1);
+    cbor_write_text(writer->out, "version", -1);
+    cbor_write_uint(writer->out, CBOR_TREE_VERSION);
+
+    return writer;
+}
+
+/*
+ * Returns the index of the key for a field, adding the abbreviation to
+ * the key table the first time it's seen. Fields that share an
+ * abbreviation share a key.
+ */
+static guint
+cbor_tree_key(cbor_tree_writer *writer, header_field_info *hfinfo)
+{
+    gpointer index;
+    gchar *key;
+
+    if ((guint)hfinfo->id < writer->hf_keys->len) {
+        guint hf_key = g_array_index(writer->hf_keys, guint, hfinfo->id);
+        if (hf_key != 0) {
+            return hf_key - 1;
+        }
+    } else {
+        g_array_set_size(writer->hf_keys, hfinfo->id + 1);
+    }
+
+    if (!g_hash_table_lookup_extended(writer->keys, hfinfo->abbrev, NULL, &index)) {
+        index = GUINT_TO_POINTER(g_hash_table_size(writer->keys));
+        key = g_strdup(hfinfo->abbrev);
+        g_hash_table_insert(writer->keys, key, index);
+        g_ptr_array_add(writer->new_keys, key);
+    }
+    g_array_index(writer->hf_keys, guint, hfinfo->id) = GPOINTER_TO_UINT(index) + 1;
+    return GPOINTER_TO_UINT(index);
+}
+
+/*
+ * Writes a string as text if it's valid UTF-8, and as bytes if it isn't;
+ * CBOR text must be UTF-8.
+ */
+static void
+cbor_write_string_value(GByteArray *out, const char *str)
+{
+    size_t len = strlen(str);
+
+    if (g_utf8_validate(str, len, NULL)) {
+        cbor_write_text(out, str, len);
+    } else {
+        cbor_write_bytes(out, (const guint8 *)str, len);
+    }
+}
+
+static void
+cbor_write_field_value(write_cbor_data *pdata, field_info *fi)
+{
+    GByteArray *out = pdata->writer->nodes;
+    const nstime_t *t;
+    guint32 ipv4;
+    const char *str;
+
+    if (fi->hfinfo->id == hf_text_only) {
+        if (fi->rep) {
+            cbor_write_string_value(out, fi->rep->representation);
+        } else {
+            cbor_write_null(out);
+        }
+        return;
+    }
+
+    switch (fi->hfinfo->type) {
+    case FT_NONE:
+        cbor_write_null(out);
+        break;
+    case FT_PROTOCOL:
+        if (fi->rep) {
+            cbor_write_string_value(out, fi->rep->representation);
+        } else {
+            gchar label_str[ITEM_LABEL_LENGTH];
+            proto_item_fill_label(fi, label_str);
+            cbor_write_string_value(out, label_str);
+        }
+        break;
+    case FT_BOOLEAN:
+        cbor_write_bool(out, fvalue_get_uinteger64(&fi->value) != 0);
+        break;
+    case FT_CHAR:
+    case FT_UINT8:
+    case FT_UINT16:
+    case FT_UINT24:
+    case FT_UINT32:
+    case FT_FRAMENUM:
+    case FT_IPXNET:
+        cbor_write_uint(out, fvalue_get_uinteger(&fi->value));
+        break;
+    case FT_UINT40:
+    case FT_UINT48:
+    case FT_UINT56:
+    case FT_UINT64:
+    case FT_EUI64:
+        cbor_write_uint(out, fvalue_get_uinteger64(&fi->value));
+        break;
+    case FT_INT8:
+    case FT_INT16:
+    case FT_INT24:
+    case FT_INT32:
+        cbor_write_int(out, fvalue_get_sinteger(&fi->value));
+        break;
+    case FT_INT40:
+    case FT_INT48:
+    case FT_INT56:
+    case FT_INT64:
+        cbor_write_int(out, fvalue_get_sinteger64(&fi->value));
+        break;
+    case FT_FLOAT:
+    case FT_DOUBLE:
+        cbor_write_double(out, fvalue_get_floating(&fi->value));
+        break;
+    case FT_ABSOLUTE_TIME:
+    case FT_RELATIVE_TIME:
+        /* [seconds, nanoseconds] */
+        t = (const nstime_t *)fvalue_get(&fi->value);
+        cbor_write_array(out, 2);
+        cbor_write_int(out, t->secs);
+        cbor_write_int(out, t->nsecs);
+        break;
+    case FT_IPv4:
+        /* Network byte order, as on the wire */
+        ipv4 = fvalue_get_uinteger(&fi->value);
+        cbor_write_bytes(out, (const guint8 *)&ipv4, sizeof ipv4);
+        break;
+    case FT_IPv6:
+        cbor_write_bytes(out, (const guint8 *)fvalue_get(&fi->value), 16);
+        break;
+    case FT_BYTES:
+    case FT_UINT_BYTES:
+    case FT_AX25:
+    case FT_VINES:
+    case FT_ETHER:
+    case FT_SYSTEM_ID:
+    case FT_FCWWN:
+        if (fi->value.value.bytes) {
+            cbor_write_bytes(out, fi->value.value.bytes->data, fi->value.value.bytes->len);
+        } else {
+            cbor_write_null(out);
+        }
+        break;
+    case FT_STRING:
+    case FT_STRINGZ:
+    case FT_UINT_STRING:
+    case FT_STRINGZPAD:
+    case FT_STRINGZTRUNC:
+        str = (const char *)fvalue_get(&fi->value);
+        if (str) {
+            cbor_write_string_value(out, str);
+        } else {
+            cbor_write_null(out);
+        }
+        break;
+    default:
+        /* OIDs, GUIDs and the like are written as they're displayed. */
+        str = fvalue_to_string_repr_buf(pdata->repr, &fi->value, FTREPR_DISPLAY, fi->hfinfo->display);
+        if (str) {
+            cbor_write_string_value(out, str);
+        } else {
+            cbor_write_null(out);
+        }
+        break;
+    }
+}
+
+static void
+write_cbor_proto_node_children(proto_node *node, write_cbor_data *pdata);
+
+static void
+write_cbor_proto_node(proto_node *node, write_cbor_data *pdata)
+{
+    field_info *fi = PNODE_FINFO(node);
+    GByteArray *out = pdata->writer->nodes;
+    gboolean write_children;
+
+    /* Like JSON, a node filtered out by -j is kept, without its children. */
+    write_children = node->first_child != NULL &&
+        (pdata->filter == NULL || check_protocolfilter(pdata->filter, fi->hfinfo->abbrev));
+
+    cbor_write_array(out, write_children ? 3 : 2);
+    cbor_write_uint(out, cbor_tree_key(pdata->writer, fi->hfinfo));
+    cbor_write_field_value(pdata, fi);
+
+    if (write_children) {
+        /* -J includes all the children of the nodes that match */
+        gchar **filter = pdata->filter;
+        if ((pdata->filter_flags&PF_INCLUDE_CHILDREN) == PF_INCLUDE_CHILDREN) {
+            pdata->filter = NULL;
+        }
+        write_cbor_proto_node_children(node, pdata);
+        pdata->filter = filter;
+    }
+}
+
+static void
+write_cbor_proto_node_children(proto_node *node, write_cbor_data *pdata)
+{
+    proto_node *child;
+    guint count = 0;
+
+    /* dissection with an invisible proto tree? */
+    for (child = node->first_child; child != NULL; child = child->next) {
+        g_assert(PNODE_FINFO(child));
+        count++;
+    }
+
+    cbor_write_array(pdata->writer->nodes, count);
+    for (child = node->first_child; child != NULL; child = child->next) {
+        write_cbor_proto_node(child, pdata);
+    }
+}
+
+void
+write_cbor_proto_tree(gchar **protocolfilter, pf_flags protocolfilter_flags,
+                      epan_dissect_t *edt, cbor_tree_writer *writer)
+{
+    write_cbor_data data;
+    guint i;
+
+    g_assert(edt);
+    g_assert(writer);
+
+    data.writer = writer;
+    data.filter = protocolfilter;
+    data.filter_flags = protocolfilter_flags;
+    data.repr = g_string_sized_new(256);
+
+    /* The nodes come after the keys they add, so they're written aside first. */
+    g_byte_array_set_size(writer->nodes, 0);
+    g_ptr_array_set_size(writer->new_keys, 0);
+    write_cbor_proto_node_children(edt->tree, &data);
+
+    cbor_write_array(writer->out, 3);
+    cbor_write_uint(writer->out, edt->pi.num);
+    cbor_write_array(writer->out, writer->new_keys->len);
+    for (i = 0; i < writer->new_keys->len; i++) {
+        cbor_write_text(writer->out, (const char *)g_ptr_array_index(writer->new_keys, i), -1);
+    }
+    g_byte_array_append(writer->out, writer->nodes->data, writer->nodes->len);
+
+    if (writer->fh) {
+        fwrite(writer->out->data, 1, writer->out->len, writer->fh);
+        g_byte_array_set_size(writer->out, 0);
+    }
+
+    g_string_free(data.repr, TRUE);
+}
+
+const guint8 *
+write_cbor_get_output(cbor_tree_writer *writer, size_t *len)
+{
+    *len = writer->out->len;
+    return writer->out->data;
+}
+
+gboolean
+write_cbor_finale(cbor_tree_writer *writer)
+{
+    gboolean ok = TRUE;
+
+    if (writer->fh) {
+        /* Only the header is left if there were no packets. */
+        if (writer->out->len > 0) {
+            fwrite(writer->out->data, 1, writer->out->len, writer->fh);
+        }
+        ok = fflush(writer->fh) == 0 && !ferror(writer->fh);
+    }
+
+    g_byte_array_free(writer->out, TRUE);
+    g_byte_array_free(writer->nodes, TRUE);
+    g_hash_table_destroy(writer->keys);
+    g_array_free(writer->hf_keys, TRUE);
+    g_ptr_array_free(writer->new_keys, TRUE);
+    g_free(writer);
+    return ok;
+}
+
 /* Returns an g_malloced string */
 gchar* get_node_field_value(field_info* fi, epan_dissect_t* edt)
 {
@@ -2667,6 +3597,7 @@ output_fields_t* output_fields_new(void)
     fields->field_values        = NULL;
     fields->quote               ='\0';
     fields->includes_col_fields = FALSE;
+    fields->batch_rows          = 4096;
     return fields;
 }
 
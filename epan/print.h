@@ -20,6 +20,7 @@
 #include <epan/print_stream.h>
 
 #include <wsutil/json_dumper.h>
+#include <wsutil/arrow_ipc.h>
 
 #include "ws_symbol_export.h"
 
@@ -71,6 +72,20 @@ WS_DLL_PUBLIC gboolean output_fields_set_option(output_fields_t* info, gchar* op
 WS_DLL_PUBLIC void output_fields_list_options(FILE *fh);
 WS_DLL_PUBLIC gboolean output_fields_has_cols(output_fields_t* info);
 
+/**
+ * Returns TRUE if the fields can be written from an invisible protocol tree
+ * primed with output_fields_prime_edt().  Only the items for the fields
+ * themselves are then added to the tree; otherwise the tree must be visible,
+ * with an item allocated and labelled for everything dissected.
+ */
+WS_DLL_PUBLIC gboolean output_fields_can_prime(output_fields_t* info);
+
+/**
+ * Primes an epan_dissect_t with the fields; output_fields_can_prime() must
+ * have returned TRUE.  Call it for every packet, before dissecting it.
+ */
+WS_DLL_PUBLIC void output_fields_prime_edt(output_fields_t* info, epan_dissect_t *edt);
+
 /*
  * Higher-level packet-printing code.
  */
@@ -125,6 +140,18 @@ WS_DLL_PUBLIC void write_fields_preamble(output_fields_t* fields, FILE *fh);
 WS_DLL_PUBLIC void write_fields_proto_tree(output_fields_t* fields, epan_dissect_t *edt, column_info *cinfo, FILE *fh);
 WS_DLL_PUBLIC void write_fields_finale(output_fields_t* fields, FILE *fh);
 
+WS_DLL_PUBLIC arrow_writer *write_arrow_preamble(output_fields_t* fields, FILE *fh);
+WS_DLL_PUBLIC void write_arrow_proto_tree(output_fields_t* fields, epan_dissect_t *edt, column_info *cinfo, arrow_writer *writer);
+WS_DLL_PUBLIC gboolean write_arrow_finale(arrow_writer *writer);
+
+/* Writes the protocol tree of each packet as CBOR. If fh is NULL the output
+ * is kept in memory; see write_cbor_get_output(). */
+typedef struct _cbor_tree_writer cbor_tree_writer;
+WS_DLL_PUBLIC cbor_tree_writer *write_cbor_preamble(FILE *fh);
+WS_DLL_PUBLIC void write_cbor_proto_tree(gchar **protocolfilter, pf_flags protocolfilter_flags, epan_dissect_t *edt, cbor_tree_writer *writer);
+WS_DLL_PUBLIC const guint8 *write_cbor_get_output(cbor_tree_writer *writer, size_t *len);
+WS_DLL_PUBLIC gboolean write_cbor_finale(cbor_tree_writer *writer);
+
 WS_DLL_PUBLIC gchar* get_node_field_value(field_info* fi, epan_dissect_t* edt);
 
 extern void print_cache_field_handles(void);
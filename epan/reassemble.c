@@ -16,6 +16,7 @@
 #include <epan/exceptions.h>
 #include <epan/reassemble.h>
 #include <epan/tvbuff-int.h>
+#include <epan/wmem/wmem_tree.h>
 
 #include <wsutil/str_util.h>
 
@@ -315,6 +316,70 @@ reassembled_key_free(gpointer ptr)
 	g_slice_free(reassembled_key, (reassembled_key *)ptr);
 }
 
+/*
+ * Reassemblies by byte offset (fragment_add() and friends) keep their
+ * fragments in a list sorted by offset, which dissectors walk; finding
+ * where a fragment goes in the list, and how much contiguous data there
+ * is, took a walk of the whole list for every fragment added.  Once a
+ * reassembly has enough fragments, it gets an index over the list: a
+ * tree mapping each offset to the last fragment in the list with that
+ * offset, so that a new fragment is linked in after the fragment with
+ * the greatest offset not above its own, and the end of the contiguous
+ * data starting at offset 0, which only moves forward as fragments are
+ * added.
+ */
+#define FRAGMENT_INDEX_MIN_FRAGMENTS	32
+
+typedef struct _fragment_index {
+	wmem_tree_t *by_offset;		/* offset -> last fragment_item with it */
+	fragment_item *contig_last;	/* all fragments up to and including
+					 * this one start within contig_end */
+	guint32 contig_end;		/* amount of contiguous data */
+} fragment_index;
+
+/*
+ * Move the end of the contiguous data forward over the fragments
+ * following the last one known to be within it.
+ */
+static void
+fragment_index_advance(fragment_index *frag_index)
+{
+	fragment_item *fd_i;
+
+	while ((fd_i = frag_index->contig_last->next) != NULL &&
+	    fd_i->offset <= frag_index->contig_end) {
+		if (fd_i->offset + fd_i->len > frag_index->contig_end)
+			frag_index->contig_end = fd_i->offset + fd_i->len;
+		frag_index->contig_last = fd_i;
+	}
+}
+
+static fragment_index *
+fragment_index_new(fragment_head *fd_head)
+{
+	fragment_index *frag_index;
+	fragment_item *fd_i;
+
+	frag_index = g_slice_new(fragment_index);
+	frag_index->by_offset = wmem_tree_new(NULL);
+	for (fd_i = fd_head->next; fd_i; fd_i = fd_i->next)
+		wmem_tree_insert32(frag_index->by_offset, fd_i->offset, fd_i);
+	frag_index->contig_last = fd_head;
+	frag_index->contig_end = 0;
+	fragment_index_advance(frag_index);
+	return frag_index;
+}
+
+static void
+fragment_index_free(fragment_head *fd_head)
+{
+	if (fd_head->frag_index == NULL)
+		return;
+	wmem_tree_destroy(fd_head->frag_index->by_offset, FALSE, FALSE);
+	g_slice_free(fragment_index, fd_head->frag_index);
+	fd_head->frag_index = NULL;
+}
+
 /*
  * For a fragment hash table entry, free the associated fragments.
  * The entry value (fd_chain) is freed herein and the entry is freed
@@ -330,6 +395,7 @@ free_all_fragments(gpointer key_arg _U_, gpointer value, gpointer user_data _U_)
 	/* g_hash_table_new_full() was used to supply a function
 	 * to free the key and anything to which it points
 	 */
+	fragment_index_free((fragment_head *)value);
 	for (fd_head = (fragment_head *)value; fd_head != NULL; fd_head = tmp_fd) {
 		tmp_fd=fd_head->next;
 
@@ -392,6 +458,7 @@ free_fragments(gpointer data, gpointer user_data _U_)
 {
 	fragment_item *fd_head = (fragment_item *) data;
 
+	fragment_index_free(fd_head);
 	if (fd_head->tvb_data)
 		tvb_free(fd_head->tvb_data);
 	g_slice_free(fragment_item, fd_head);
@@ -476,6 +543,13 @@ reassembly_table_init(reassembly_table *table,
 	}
 }
 
+void
+reassembly_table_set_composite_tvbs(reassembly_table *table,
+				    const gboolean composite_tvbs)
+{
+	table->composite_tvbs = composite_tvbs;
+}
+
 /*
  * Destroy a reassembly table.
  */
@@ -614,6 +688,7 @@ fragment_delete(reassembly_table *table, const packet_info *pinfo,
 		g_slice_free(fragment_item, fd);
 		fd=tmp_fd;
 	}
+	fragment_index_free(fd_head);
 	g_slice_free(fragment_head, fd_head);
 	g_hash_table_remove(table->fragment_table, key);
 
@@ -968,6 +1043,41 @@ MERGE_FRAG(fragment_head *fd_head, fragment_item *fd)
 	fd_i->next = fd;
 }
 
+/*
+ * Add a fragment to the list of a reassembly by byte offset, keeping it
+ * sorted, the same way LINK_FRAG() does.
+ */
+static void
+LINK_FRAG_BY_OFFSET(fragment_head *fd_head, fragment_item *fd)
+{
+	fragment_index *frag_index = fd_head->frag_index;
+	fragment_item *fd_i;
+	guint count;
+
+	if (frag_index == NULL) {
+		LINK_FRAG(fd_head, fd);
+		count = 0;
+		for (fd_i = fd_head->next; fd_i; fd_i = fd_i->next)
+			count++;
+		if (count >= FRAGMENT_INDEX_MIN_FRAGMENTS)
+			fd_head->frag_index = fragment_index_new(fd_head);
+		return;
+	}
+
+	fd_i = (fragment_item *)wmem_tree_lookup32_le(frag_index->by_offset, fd->offset);
+	if (fd_i == NULL)
+		fd_i = fd_head;
+	fd->next = fd_i->next;
+	fd_i->next = fd;
+	wmem_tree_insert32(frag_index->by_offset, fd->offset, fd);
+
+	/* The fragment may have been linked in before contig_last. */
+	if (fd->offset <= frag_index->contig_end &&
+	    fd->offset + fd->len > frag_index->contig_end)
+		frag_index->contig_end = fd->offset + fd->len;
+	fragment_index_advance(frag_index);
+}
+
 /*
  * This function adds a new fragment to the fragment hash table.
  * If this is the first fragment seen for this datagram, a new entry
@@ -989,8 +1099,162 @@ MERGE_FRAG(fragment_head *fd_head, fragment_item *fd)
  * with the new fragment. FD_TOOLONGFRAGMENT and FD_MULTIPLETAILS flags
  * are lowered when a new extension process is started.
  */
+/*
+ * The data of a reassembly that is being put together.  Normally the
+ * fragments are copied into a new buffer.  If the reassembly table uses
+ * composite tvbuffs, the reassembled tvbuff is made up of the fragments'
+ * own tvbuffs (or of the parts of them that are used) instead, so their
+ * data isn't copied a second time.
+ *
+ * A reassembly that is extended after it was completed is copied even
+ * then: its earlier fragments refer to the previous reassembled tvbuff,
+ * so a composite would be made of (parts of) that composite, nesting
+ * one level deeper with every extension.
+ */
+typedef struct {
+	gboolean   composite;
+	guint8    *data;	/* the buffer, if copying */
+	GPtrArray *members;	/* the member tvbuffs, if composite */
+	GPtrArray *owned;	/* tvbuffs to free along with the composite */
+	guint32    len;		/* number of bytes added so far */
+} reassembly_data;
+
+static void
+reassembly_data_init(reassembly_data *rd, const reassembly_table *table,
+		     const guint32 size, const tvbuff_t *old_tvb_data)
+{
+	rd->composite = table->composite_tvbs && size > 0 && old_tvb_data == NULL;
+	rd->len = 0;
+	if (rd->composite) {
+		rd->data = NULL;
+		rd->members = g_ptr_array_new();
+		rd->owned = g_ptr_array_new();
+	} else {
+		rd->data = (guint8 *) g_malloc(size);
+		rd->members = NULL;
+		rd->owned = NULL;
+	}
+}
+
+/*
+ * Add len bytes of a fragment's tvbuff, starting at offset, to the end
+ * of the reassembled data.
+ */
+static void
+reassembly_data_append(reassembly_data *rd, tvbuff_t *tvb,
+		       const guint32 offset, const guint32 len)
+{
+	if (len == 0)
+		return;
+	if (!rd->composite) {
+		memcpy(rd->data + rd->len, tvb_get_ptr(tvb, offset, len), len);
+	} else if (offset == 0 && len == tvb_captured_length(tvb)) {
+		g_ptr_array_add(rd->members, tvb);
+	} else {
+		/* The subset is chained to the fragment's tvbuff, which
+		 * is kept as long as the composite. */
+		g_ptr_array_add(rd->members, tvb_new_subset_length(tvb, offset, len));
+	}
+	rd->len += len;
+}
+
+/*
+ * Check whether the first len bytes of a fragment's tvbuff differ from
+ * the reassembled data already added at offset.
+ */
 static gboolean
-fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
+reassembly_data_differs(const reassembly_data *rd, const guint32 offset,
+			tvbuff_t *tvb, const guint32 len)
+{
+	tvbuff_t *member;
+	guint32 start, member_len, member_offset, cmp_len, pos;
+	guint i;
+
+	if (!rd->composite)
+		return memcmp(rd->data + offset, tvb_get_ptr(tvb, 0, len), len) != 0;
+
+	/* Overlaps are with the end of what has been added so far, so
+	 * look for the first member involved from the last one back. */
+	start = rd->len;
+	i = rd->members->len;
+	while (i > 0 && start > offset) {
+		i--;
+		start -= tvb_captured_length((tvbuff_t *)g_ptr_array_index(rd->members, i));
+	}
+
+	for (pos = 0; pos < len && i < rd->members->len; i++) {
+		member = (tvbuff_t *)g_ptr_array_index(rd->members, i);
+		member_len = tvb_captured_length(member);
+		member_offset = offset + pos - start;
+		cmp_len = MIN(member_len - member_offset, len - pos);
+		if (tvb_memeql(member, member_offset, tvb_get_ptr(tvb, pos, cmp_len), cmp_len))
+			return TRUE;
+		pos += cmp_len;
+		start += member_len;
+	}
+	return FALSE;
+}
+
+/*
+ * A fragment's tvbuff (or a previous reassembly's) isn't needed any more
+ * once the data has been added.  Free it, unless the reassembled data
+ * refers to it.
+ */
+static void
+reassembly_data_release(reassembly_data *rd, tvbuff_t *tvb)
+{
+	if (rd->composite)
+		g_ptr_array_add(rd->owned, tvb);
+	else
+		tvb_free(tvb);
+}
+
+/*
+ * Create the tvbuff for the reassembled data, of size bytes.
+ */
+static tvbuff_t *
+reassembly_data_finish(reassembly_data *rd, const guint32 size)
+{
+	tvbuff_t *tvb;
+	guint i;
+
+	if (!rd->composite) {
+		tvb = tvb_new_real_data(rd->data, size, size);
+		tvb_set_free_cb(tvb, g_free);
+		return tvb;
+	}
+
+	if (rd->len < size) {
+		/*
+		 * Some fragments couldn't be added because of an
+		 * error; pad the data so that it's the expected
+		 * size, as it would be if it had been copied.
+		 */
+		guint8 *pad = (guint8 *) g_malloc0(size - rd->len);
+		tvbuff_t *pad_tvb = tvb_new_real_data(pad, size - rd->len, size - rd->len);
+
+		tvb_set_free_cb(pad_tvb, g_free);
+		g_ptr_array_add(rd->members, pad_tvb);
+		g_ptr_array_add(rd->owned, pad_tvb);
+	}
+
+	tvb = tvb_new_composite();
+	for (i = 0; i < rd->members->len; i++)
+		tvb_composite_append(tvb, (tvbuff_t *)g_ptr_array_index(rd->members, i));
+	tvb_composite_finalize_unchained(tvb);
+
+	/* The composite owns its members from now on. */
+	for (i = 0; i < rd->owned->len; i++)
+		tvb_add_to_chain(tvb, (tvbuff_t *)g_ptr_array_index(rd->owned, i));
+
+	g_ptr_array_free(rd->members, TRUE);
+	g_ptr_array_free(rd->owned, TRUE);
+	return tvb;
+}
+
+static gboolean
+fragment_add_work(reassembly_table *table, fragment_head *fd_head,
+		 tvbuff_t *tvb, const int offset,
 		 const packet_info *pinfo, const guint32 frag_offset,
 		 const guint32 frag_data_len, const gboolean more_frags)
 {
@@ -998,7 +1262,7 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	fragment_item *fd_i;
 	guint32 max, dfpos, fraglen;
 	tvbuff_t *old_tvb_data;
-	guint8 *data;
+	reassembly_data rd;
 
 	/* create new fd describing this fragment */
 	fd = g_slice_new(fragment_item);
@@ -1010,6 +1274,7 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	fd->len  = frag_data_len;
 	fd->tvb_data = NULL;
 	fd->error = NULL;
+	fd->frag_index = NULL;
 
 	/*
 	 * Are we adding to an already-completed reassembly?
@@ -1127,7 +1392,7 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 			fd_head->flags |= FD_OVERLAPCONFLICT;
 		}
 		/* it was just an overlap, link it and return */
-		LINK_FRAG(fd_head,fd);
+		LINK_FRAG_BY_OFFSET(fd_head,fd);
 		return TRUE;
 	}
 
@@ -1141,7 +1406,7 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 		THROW(BoundsError);
 	}
 	fd->tvb_data = tvb_clone_offset_len(tvb, offset, fd->len);
-	LINK_FRAG(fd_head,fd);
+	LINK_FRAG_BY_OFFSET(fd_head,fd);
 
 
 	if( !(fd_head->flags & FD_DATALEN_SET) ){
@@ -1160,13 +1425,18 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	 * available.  (The check for fd_i->offset <= max rules out
 	 * fragments that don't start before or at the end of the
 	 * previous fragment, i.e. fragments that have a gap between
-	 * them and the previous fragment.)
+	 * them and the previous fragment.)  If the reassembly has an
+	 * index, it already keeps track of that.
 	 */
-	max = 0;
-	for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
-		if ( ((fd_i->offset)<=max) &&
-			((fd_i->offset+fd_i->len)>max) ){
-			max = fd_i->offset+fd_i->len;
+	if (fd_head->frag_index) {
+		max = fd_head->frag_index->contig_end;
+	} else {
+		max = 0;
+		for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
+			if ( ((fd_i->offset)<=max) &&
+				((fd_i->offset+fd_i->len)>max) ){
+				max = fd_i->offset+fd_i->len;
+			}
 		}
 	}
 
@@ -1184,9 +1454,7 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	 */
 	/* store old data just in case */
 	old_tvb_data=fd_head->tvb_data;
-	data = (guint8 *) g_malloc(fd_head->datalen);
-	fd_head->tvb_data = tvb_new_real_data(data, fd_head->datalen, fd_head->datalen);
-	tvb_set_free_cb(fd_head->tvb_data, g_free);
+	reassembly_data_init(&rd, table, fd_head->datalen, old_tvb_data);
 
 	/* add all data fragments */
 	for (dfpos=0,fd_i=fd_head;fd_i;fd_i=fd_i->next) {
@@ -1206,7 +1474,7 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 			 *
 			 * Note that the "overlap" compare must only be
 			 * done for fragments with (offset+len) <= fd_head->datalen
-			 * and thus within the newly g_malloc'd buffer.
+			 * and thus within the reassembled data.
 			 */
 			if (fd_i->offset + fd_i->len > dfpos) {
 				if (fd_i->offset >= fd_head->datalen) {
@@ -1242,8 +1510,6 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 					fd_head->error = "dfpos < offset";
 				} else if (dfpos - fd_i->offset > fd_i->len)
 					fd_head->error = "dfpos - offset > len";
-				else if (!fd_head->tvb_data)
-					fd_head->error = "no data";
 				else {
 					fraglen = fd_i->len;
 					if (fd_i->offset + fraglen > fd_head->datalen) {
@@ -1270,10 +1536,8 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 
 						fd_i->flags    |= FD_OVERLAP;
 						fd_head->flags |= FD_OVERLAP;
-						if ( memcmp(data + fd_i->offset,
-								tvb_get_ptr(fd_i->tvb_data, 0, cmp_len),
-								cmp_len)
-								 ) {
+						if (reassembly_data_differs(&rd, fd_i->offset,
+								fd_i->tvb_data, cmp_len)) {
 							fd_i->flags    |= FD_OVERLAPCONFLICT;
 							fd_head->flags |= FD_OVERLAPCONFLICT;
 						}
@@ -1284,9 +1548,8 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 						 */
 						fd_head->error = "fraglen < dfpos - offset";
 					} else {
-						memcpy(data+dfpos,
-							tvb_get_ptr(fd_i->tvb_data, (dfpos-fd_i->offset), fraglen-(dfpos-fd_i->offset)),
-							fraglen-(dfpos-fd_i->offset));
+						reassembly_data_append(&rd, fd_i->tvb_data,
+							(dfpos-fd_i->offset), fraglen-(dfpos-fd_i->offset));
 						dfpos=MAX(dfpos, (fd_i->offset + fraglen));
 					}
 				}
@@ -1300,7 +1563,7 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 			if (fd_i->flags & FD_SUBSET_TVB)
 				fd_i->flags &= ~FD_SUBSET_TVB;
 			else if (fd_i->tvb_data)
-				tvb_free(fd_i->tvb_data);
+				reassembly_data_release(&rd, fd_i->tvb_data);
 
 			fd_i->tvb_data=NULL;
 		}
@@ -1308,6 +1571,7 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 
 	if (old_tvb_data)
 		tvb_add_to_chain(tvb, old_tvb_data);
+	fd_head->tvb_data = reassembly_data_finish(&rd, fd_head->datalen);
 	/* mark this packet as defragmented.
 	   allows us to skip any trailing fragments */
 	fd_head->flags |= FD_DEFRAGMENTED;
@@ -1498,7 +1762,7 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 		insert_fd_head(table, fd_head, pinfo, id, data);
 	}
 
-	if (fragment_add_work(fd_head, tvb, offset, pinfo, frag_offset,
+	if (fragment_add_work(table, fd_head, tvb, offset, pinfo, frag_offset,
 		frag_data_len, more_frags)) {
 		/*
 		 * Reassembly is complete.
@@ -1581,7 +1845,7 @@ fragment_add_check(reassembly_table *table, tvbuff_t *tvb, const int offset,
 	if (tvb_reported_length(tvb) > tvb_captured_length(tvb))
 		return NULL;
 
-	if (fragment_add_work(fd_head, tvb, offset, pinfo, frag_offset,
+	if (fragment_add_work(table, fd_head, tvb, offset, pinfo, frag_offset,
 		frag_data_len, more_frags)) {
 		/*
 		 * Reassembly is complete.
@@ -1610,13 +1874,14 @@ fragment_add_check(reassembly_table *table, tvbuff_t *tvb, const int offset,
 }
 
 static void
-fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
+fragment_defragment_and_free (reassembly_table *table, fragment_head *fd_head,
+			      const packet_info *pinfo)
 {
 	fragment_item *fd_i = NULL;
 	fragment_item *last_fd = NULL;
-	guint32  dfpos = 0, size = 0;
+	guint32  size = 0;
 	tvbuff_t *old_tvb_data = NULL;
-	guint8 *data;
+	reassembly_data rd;
 
 	for(fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
 		if(!last_fd || last_fd->offset!=fd_i->offset){
@@ -1627,9 +1892,7 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 
 	/* store old data in case the fd_i->data pointers refer to it */
 	old_tvb_data=fd_head->tvb_data;
-	data = (guint8 *) g_malloc(size);
-	fd_head->tvb_data = tvb_new_real_data(data, size, size);
-	tvb_set_free_cb(fd_head->tvb_data, g_free);
+	reassembly_data_init(&rd, table, size, old_tvb_data);
 	fd_head->len = size;		/* record size for caller	*/
 
 	/* add all data fragments */
@@ -1638,8 +1901,7 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 		if (fd_i->len) {
 			if(!last_fd || last_fd->offset != fd_i->offset) {
 				/* First fragment or in-sequence fragment */
-				memcpy(data+dfpos, tvb_get_ptr(fd_i->tvb_data, 0, fd_i->len), fd_i->len);
-				dfpos += fd_i->len;
+				reassembly_data_append(&rd, fd_i->tvb_data, 0, fd_i->len);
 			} else {
 				/* duplicate/retransmission/overlap */
 				fd_i->flags    |= FD_OVERLAP;
@@ -1659,11 +1921,12 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 		if (fd_i->flags & FD_SUBSET_TVB)
 			fd_i->flags &= ~FD_SUBSET_TVB;
 		else if (fd_i->tvb_data)
-			tvb_free(fd_i->tvb_data);
+			reassembly_data_release(&rd, fd_i->tvb_data);
 		fd_i->tvb_data=NULL;
 	}
 	if (old_tvb_data)
 		tvb_free(old_tvb_data);
+	fd_head->tvb_data = reassembly_data_finish(&rd, size);
 
 	/* mark this packet as defragmented.
 	 * allows us to skip any trailing fragments.
@@ -1686,7 +1949,8 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
  * The bsn for the first block is 0.
  */
 static gboolean
-fragment_add_seq_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
+fragment_add_seq_work(reassembly_table *table, fragment_head *fd_head,
+		 tvbuff_t *tvb, const int offset,
 		 const packet_info *pinfo, const guint32 frag_number,
 		 const guint32 frag_data_len, const gboolean more_frags)
 {
@@ -1741,6 +2005,7 @@ fragment_add_seq_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	fd->len  = frag_data_len;
 	fd->tvb_data = NULL;
 	fd->error = NULL;
+	fd->frag_index = NULL;
 
 	/* fd_head->frame is the maximum of the frame numbers of all the
 	 * fragments added to the reassembly. */
@@ -1916,7 +2181,7 @@ fragment_add_seq_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	/* we have received an entire packet, defragment it and
 	 * free all fragments
 	 */
-	fragment_defragment_and_free(fd_head, pinfo);
+	fragment_defragment_and_free(table, fd_head, pinfo);
 
 	return TRUE;
 }
@@ -2014,7 +2279,7 @@ fragment_add_seq_common(reassembly_table *table, tvbuff_t *tvb,
 		}
 	}
 
-	if (fragment_add_seq_work(fd_head, tvb, offset, pinfo,
+	if (fragment_add_seq_work(table, fd_head, tvb, offset, pinfo,
 				  frag_number, frag_data_len, more_frags)) {
 		/*
 		 * Reassembly is complete.
@@ -2498,6 +2763,7 @@ fragment_start_seq_check(reassembly_table *table, const packet_info *pinfo,
 		fd_head->flags = FD_BLOCKSEQUENCE|FD_DATALEN_SET;
 		fd_head->tvb_data = NULL;
 		fd_head->error = NULL;
+		fd_head->frag_index = NULL;
 
 		insert_fd_head(table, fd_head, pinfo, id, data);
 	}
@@ -2528,7 +2794,7 @@ fragment_end_seq_next(reassembly_table *table, const packet_info *pinfo,
 		fd_head->datalen = fd_head->offset;
 		fd_head->flags |= FD_DATALEN_SET;
 
-		fragment_defragment_and_free (fd_head, pinfo);
+		fragment_defragment_and_free (table, fd_head, pinfo);
 
 		/*
 		 * Remove this from the table of in-progress reassemblies,
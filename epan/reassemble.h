@@ -83,6 +83,12 @@ typedef struct _fragment_item {
 	 * reassembly and for the fragments in a reassembly.
 	 */
 	const char *error;
+	/**
+	 * Internal to reassemble.c: the index over the fragments of a
+	 * byte-offset reassembly with many fragments, only in the
+	 * reassembly head.
+	 */
+	struct _fragment_index *frag_index;
 } fragment_item, fragment_head;
 
 
@@ -130,6 +136,7 @@ typedef struct {
 	fragment_temporary_key temporary_key_func;
 	fragment_persistent_key persistent_key_func;
 	GDestroyNotify free_temporary_key_func;		/* temporary key destruction function */
+	gboolean composite_tvbs;			/* back reassembled data with composite tvbuffs */
 } reassembly_table;
 
 /*
@@ -175,6 +182,24 @@ reassembly_table_init(reassembly_table *table,
 WS_DLL_PUBLIC void
 reassembly_table_destroy(reassembly_table *table);
 
+/*
+ * Normally, when a reassembly completes, the data of all its fragments
+ * is copied into a new buffer.  With composite tvbuffs enabled, the
+ * reassembled tvbuff is instead a composite of the tvbuffs holding the
+ * fragments, so no data is copied again; when the capture file can be
+ * read randomly, those don't even hold a copy of the data, which is
+ * read from the file when needed.  Accessing data that spans fragments
+ * through a pointer (tvb_get_ptr() and friends) still makes one
+ * contiguous copy of the whole reassembled data.  A reassembly that is
+ * extended after it completed (see fragment_set_partial_reassembly())
+ * is copied again, as without composite tvbuffs.
+ *
+ * Can be called once the table has been registered or initialized.
+ */
+WS_DLL_PUBLIC void
+reassembly_table_set_composite_tvbs(reassembly_table *table,
+				    const gboolean composite_tvbs);
+
 /*
  * This function adds a new fragment to the reassembly table
  * If this is the first fragment seen for this datagram, a new entry
@@ -46,6 +46,7 @@
 #include <epan/packet_info.h>
 #include <epan/proto.h>
 #include <epan/tvbuff.h>
+#include <epan/tvbuff-int.h>
 #include <epan/reassemble.h>
 
 static int failure = 0;
@@ -1511,6 +1512,212 @@ test_missing_data_fragment_add_seq_next_3(void)
 #endif
 
 
+/**********************************************************************************
+ *
+ * composite tvbs
+ *
+ *********************************************************************************/
+
+/* Reassembles three fragments, out of order and with an overlap, into a
+ * composite tvb, then extends the reassembly with a fourth fragment (which
+ * makes the data of the first three a subset of the previous composite).
+ */
+/*   visit  id  frame  frag_offset  len  more  tvb_offset
+       0    12     1       100       30   F      110
+       0    12     2        40       60   T       50
+       0    12     3         0       50   T       10
+       0    12     4       130       20   F      140
+*/
+static void
+test_fragment_add_composite(void)
+{
+    fragment_head *fd_head;
+    const guint8 *ptr;
+
+    printf("Starting test test_fragment_add_composite\n");
+
+    reassembly_table_set_composite_tvbs(&test_reassembly_table, TRUE);
+
+    pinfo.num = 1;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 110, &pinfo, 12, NULL,
+                         100, 30, FALSE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 2;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 50, &pinfo, 12, NULL,
+                         40, 60, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 3;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 10, &pinfo, 12, NULL,
+                         0, 50, TRUE);
+
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_EQ(0,g_hash_table_size(test_reassembly_table.reassembled_table));
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(130,fd_head->datalen);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET|FD_OVERLAP,fd_head->flags);
+    ASSERT_NE_POINTER(NULL,fd_head->tvb_data);
+    ASSERT_EQ(130,tvb_captured_length(fd_head->tvb_data));
+
+    /* test the actual reassembly, both per fragment and across them */
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,50,data+60,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,100,data+110,30));
+    ptr = tvb_get_ptr(fd_head->tvb_data,0,130);
+    ASSERT(!memcmp(ptr,data+10,130));
+    ASSERT_EQ(data[10+99],tvb_get_guint8(fd_head->tvb_data,99));
+    ASSERT_EQ(data[10+100],tvb_get_guint8(fd_head->tvb_data,100));
+
+    /* now we announce that the reassembly wasn't complete after all. */
+    fragment_set_partial_reassembly(&test_reassembly_table, &pinfo, 12, NULL);
+
+    pinfo.num = 4;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 140, &pinfo, 12, NULL,
+                         130, 20, FALSE);
+
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(150,fd_head->datalen);
+    ASSERT_EQ(150,tvb_captured_length(fd_head->tvb_data));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,150));
+
+    reassembly_table_set_composite_tvbs(&test_reassembly_table, FALSE);
+}
+
+/* The test_fragment_add_seq_check_1 test, reassembling into a composite tvb.
+ */
+static void
+test_fragment_add_seq_check_composite(void)
+{
+    reassembly_table_set_composite_tvbs(&test_reassembly_table, TRUE);
+    test_fragment_add_seq_check_1();
+    reassembly_table_set_composite_tvbs(&test_reassembly_table, FALSE);
+}
+
+#define EXTEND_TIMES 200
+
+/* Extends a reassembly into a composite tvb one byte at a time, the way TCP
+ * does for a PDU that spans many segments.  Only the first reassembly may
+ * be a composite; every extension must be copied, so that the data of an
+ * extension doesn't refer to a composite of the previous one.
+ */
+static void
+test_fragment_add_composite_extend(void)
+{
+    fragment_head *fd_head;
+    guint32 i;
+
+    printf("Starting test test_fragment_add_composite_extend\n");
+
+    reassembly_table_set_composite_tvbs(&test_reassembly_table, TRUE);
+
+    pinfo.num = 1;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 10, &pinfo, 12, NULL,
+                         0, 20, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(20,tvb_captured_length(fd_head->tvb_data));
+
+    for (i = 0; i < EXTEND_TIMES; i++) {
+        fragment_set_partial_reassembly(&test_reassembly_table, &pinfo, 12, NULL);
+
+        pinfo.num = i + 2;
+        fd_head=fragment_add(&test_reassembly_table, tvb, 30 + i, &pinfo, 12, NULL,
+                             20 + i, 1, FALSE);
+
+        ASSERT_NE_POINTER(NULL,fd_head);
+        ASSERT_EQ(21 + i,fd_head->datalen);
+        ASSERT_EQ(21 + i,tvb_captured_length(fd_head->tvb_data));
+        /* a plain buffer, not a composite nesting the previous ones */
+        ASSERT_EQ_POINTER(tvb->ops,fd_head->tvb_data->ops);
+        ASSERT_EQ((guint8)data[30 + i],tvb_get_guint8(fd_head->tvb_data,20 + i));
+    }
+
+    /* test the actual reassembly */
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET,fd_head->flags);
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,20 + EXTEND_TIMES));
+
+    reassembly_table_set_composite_tvbs(&test_reassembly_table, FALSE);
+}
+
+
+/**********************************************************************************
+ *
+ * stress tests
+ *
+ *********************************************************************************/
+
+#define STRESS_FRAGMENTS 10000
+#define STRESS_FRAG_LEN  8
+
+/* Reassembles a PDU from 10000 fragments added in a scrambled order, with
+ * every tenth fragment retransmitted, and reports how long it took.  The
+ * PDU must only be reassembled once the last missing fragment is added.
+ */
+static void
+test_fragment_add_many_fragments(void)
+{
+    fragment_head *fd_head = NULL;
+    guint8 *stress_data;
+    tvbuff_t *stress_tvb;
+    guint32 i, frag, added = 0;
+    gint64 start;
+
+    printf("Starting test test_fragment_add_many_fragments\n");
+
+    stress_data = (guint8 *)g_malloc(STRESS_FRAGMENTS * STRESS_FRAG_LEN);
+    for (i = 0; i < STRESS_FRAGMENTS * STRESS_FRAG_LEN; i++) {
+        stress_data[i] = (i * 7) & 0xFF;
+    }
+    stress_tvb = tvb_new_real_data(stress_data, STRESS_FRAGMENTS * STRESS_FRAG_LEN,
+                                   STRESS_FRAGMENTS * STRESS_FRAG_LEN);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < STRESS_FRAGMENTS; i++) {
+        /* 7919 is prime, so this visits every fragment once */
+        frag = (i * 7919) % STRESS_FRAGMENTS;
+        pinfo.num = i + 1;
+        fd_head = fragment_add(&test_reassembly_table, stress_tvb,
+                               frag * STRESS_FRAG_LEN, &pinfo, 12, NULL,
+                               frag * STRESS_FRAG_LEN, STRESS_FRAG_LEN,
+                               frag != STRESS_FRAGMENTS - 1);
+        added++;
+        if (i < STRESS_FRAGMENTS - 1) {
+            ASSERT_EQ_POINTER(NULL,fd_head);
+            if (i % 10 == 0 && i > 0) {
+                /* retransmit the fragment before this one */
+                frag = ((i - 1) * 7919) % STRESS_FRAGMENTS;
+                fd_head = fragment_add(&test_reassembly_table, stress_tvb,
+                                       frag * STRESS_FRAG_LEN, &pinfo, 12, NULL,
+                                       frag * STRESS_FRAG_LEN, STRESS_FRAG_LEN,
+                                       frag != STRESS_FRAGMENTS - 1);
+                added++;
+                ASSERT_EQ_POINTER(NULL,fd_head);
+            }
+        }
+    }
+    printf("  %u fragments added in %" G_GINT64_FORMAT " ms\n", added,
+           (g_get_monotonic_time() - start) / 1000);
+
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(STRESS_FRAGMENTS * STRESS_FRAG_LEN,fd_head->datalen);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET|FD_OVERLAP,fd_head->flags);
+    ASSERT_EQ_POINTER(NULL,fd_head->error);
+
+    /* the list of fragments must still be sorted by offset */
+    frag = 0;
+    for (fragment_item *fd = fd_head->next; fd; fd = fd->next) {
+        ASSERT(fd->offset >= frag);
+        frag = fd->offset;
+    }
+
+    /* test the actual reassembly */
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,stress_data,STRESS_FRAGMENTS * STRESS_FRAG_LEN));
+
+    tvb_free(stress_tvb);
+    g_free(stress_data);
+}
+
+
 /**********************************************************************************
  *
  * main
@@ -1535,6 +1742,10 @@ main(int argc _U_, char **argv _U_)
         test_fragment_add_seq_802_11_0,
         test_fragment_add_seq_802_11_1,
         test_simple_fragment_add_seq_next,
+        test_fragment_add_composite,               /* composite tvbs    */
+        test_fragment_add_seq_check_composite,
+        test_fragment_add_composite_extend,
+        test_fragment_add_many_fragments,          /* stress            */
 #if 0
         test_missing_data_fragment_add_seq_next,
         test_missing_data_fragment_add_seq_next_2,
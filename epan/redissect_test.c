@@ -0,0 +1,266 @@
+/* redissect_test.c
+ * Tests for noting what a preference change can affect
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include <wiretap/wtap.h>
+
+#include "epan.h"
+#include "epan_dissect.h"
+#include "packet.h"
+#include "prefs.h"
+#include "prefs-int.h"
+
+/* Ethernet, IPv4 and UDP from 192.0.2.1:40000 to 192.0.2.2:40001, with a
+   payload no dissector is registered for. */
+static const guint8 udp_frame[] = {
+    0x00, 0x00, 0x5e, 0x00, 0x53, 0x02, 0x00, 0x00, 0x5e, 0x00, 0x53, 0x01, 0x08, 0x00,
+    0x45, 0x00, 0x00, 0x24, 0x00, 0x01, 0x00, 0x00, 0x40, 0x11, 0xf6, 0xc4,
+    0xc0, 0x00, 0x02, 0x01, 0xc0, 0x00, 0x02, 0x02,
+    0x9c, 0x40, 0x9c, 0x41, 0x00, 0x10, 0x00, 0x00,
+    'n', 'o', 't', 'h', 'i', 'n', 'g', '!'
+};
+
+static epan_t *session;
+static wmem_list_t *frame_layers;
+
+/* A heuristic dissector that was tried on the frame and rejected it */
+static int rejecting_heur_proto = -1;
+
+/* A protocol only called through handles, and not for the frame */
+static int unseen_proto = -1;
+
+static const nstime_t *
+test_get_frame_ts(struct packet_provider_data *prov _U_, guint32 frame_num _U_)
+{
+    static nstime_t empty;
+
+    return &empty;
+}
+
+static void
+find_rejecting_heur(const gchar *table_name _U_, struct heur_dtbl_entry *entry, gpointer user_data _U_)
+{
+    int proto_id;
+
+    if (rejecting_heur_proto != -1 || !entry->enabled || entry->protocol == NULL)
+        return;
+    proto_id = proto_get_id(entry->protocol);
+    if (wmem_list_find(frame_layers, GINT_TO_POINTER(proto_id)) != NULL)
+        return;
+    /* Only one with preferences to change will do */
+    if (prefs_find_module(proto_get_protocol_filter_name(proto_id)) == NULL)
+        return;
+    rejecting_heur_proto = proto_id;
+}
+
+static void
+find_unseen_proto(void)
+{
+    void *cookie;
+    int proto_id;
+
+    for (proto_id = proto_get_first_protocol(&cookie); proto_id != -1;
+         proto_id = proto_get_next_protocol(&cookie)) {
+        if (wmem_list_find(frame_layers, GINT_TO_POINTER(proto_id)) != NULL)
+            continue;
+        if (!dissector_called_only_through_handles(proto_id))
+            continue;
+        /* Disabled by redissect_test_other_changes() */
+        if (!proto_can_toggle_protocol(proto_id) || proto_is_pino(find_protocol_by_id(proto_id)))
+            continue;
+        /* Only one with preferences to change will do */
+        if (prefs_find_module(proto_get_protocol_filter_name(proto_id)) == NULL)
+            continue;
+        unseen_proto = proto_id;
+        return;
+    }
+}
+
+/* Dissects the frame, noting the protocols called */
+static void
+dissect_udp_frame(void)
+{
+    static const struct packet_provider_funcs funcs = {
+        test_get_frame_ts,
+        NULL,
+        NULL,
+        NULL
+    };
+    epan_dissect_t *edt;
+    wtap_rec rec;
+    frame_data fdata;
+
+    session = epan_new(NULL, &funcs);
+    epan_note_called_protocols(session);
+    edt = epan_dissect_new(session, TRUE, FALSE);
+
+    memset(&rec, 0, sizeof rec);
+    rec.rec_type = REC_TYPE_PACKET;
+    rec.rec_header.packet_header.caplen = sizeof udp_frame;
+    rec.rec_header.packet_header.len = sizeof udp_frame;
+    rec.rec_header.packet_header.pkt_encap = WTAP_ENCAP_ETHERNET;
+    rec.presence_flags = WTAP_HAS_TS | WTAP_HAS_CAP_LEN;
+
+    frame_data_init(&fdata, 1, &rec, 0, 0);
+    epan_dissect_run(edt, WTAP_FILE_TYPE_SUBTYPE_UNKNOWN, &rec,
+                     tvb_new_real_data(udp_frame, sizeof udp_frame, sizeof udp_frame),
+                     &fdata, NULL);
+
+    frame_layers = edt->pi.layers;
+    heur_dissector_table_foreach("udp", find_rejecting_heur, NULL);
+    find_unseen_proto();
+    frame_layers = NULL;
+
+    frame_data_destroy(&fdata);
+    epan_dissect_free(edt);
+}
+
+/* Applies a change of the dissection preferences of a protocol */
+static void
+apply_protocol_prefs(const char *name)
+{
+    module_t *module = prefs_find_module(name);
+
+    g_assert_nonnull(module);
+    module->prefs_changed_flags |= PREF_EFFECT_DISSECTION;
+    prefs_apply(module);
+}
+
+/* Whether the protocols whose preferences were applied may have been
+   called, as cf_redissect_packets() decides */
+static gboolean
+applied_protocols_called(void)
+{
+    GArray *applied = prefs_take_applied_protocols();
+    gboolean called = FALSE;
+    guint i;
+
+    g_assert_nonnull(applied);
+    for (i = 0; i < applied->len; i++) {
+        if (epan_protocol_may_have_been_called(session, g_array_index(applied, int, i)))
+            called = TRUE;
+    }
+    g_array_free(applied, TRUE);
+    return called;
+}
+
+static void
+redissect_test_called_protocols(void)
+{
+    g_assert_true(epan_protocol_may_have_been_called(session, proto_get_id_by_filter_name("eth")));
+    g_assert_true(epan_protocol_may_have_been_called(session, proto_get_id_by_filter_name("udp")));
+    g_assert_cmpint(unseen_proto, !=, -1);
+    g_assert_false(epan_protocol_may_have_been_called(session, unseen_proto));
+
+    /* Tried, even if it isn't in the frame's layers */
+    g_assert_cmpint(rejecting_heur_proto, !=, -1);
+    g_assert_true(epan_protocol_may_have_been_called(session, rejecting_heur_proto));
+}
+
+static void
+redissect_test_seen_protocol(void)
+{
+    apply_protocol_prefs("udp");
+    g_assert_true(applied_protocols_called());
+}
+
+static void
+redissect_test_unseen_protocol(void)
+{
+    apply_protocol_prefs(proto_get_protocol_filter_name(unseen_proto));
+    g_assert_false(applied_protocols_called());
+}
+
+/* Other dissectors, such as LDAP's, call BER's routines directly */
+static void
+redissect_test_library_protocol(void)
+{
+    int ber_id = proto_get_id_by_filter_name("ber");
+
+    g_assert_false(dissector_called_only_through_handles(ber_id));
+    apply_protocol_prefs("ber");
+    g_assert_true(applied_protocols_called());
+}
+
+static void
+redissect_test_heuristic_protocol(void)
+{
+    /* Its preferences may make it accept the frame. */
+    apply_protocol_prefs(proto_get_protocol_filter_name(rejecting_heur_proto));
+    g_assert_true(applied_protocols_called());
+}
+
+/* Other changes aren't hidden by protocol preferences applied before */
+static void
+redissect_test_other_changes(void)
+{
+    const char *unseen_name = proto_get_protocol_filter_name(unseen_proto);
+    guint64 routing_hash = dissector_routing_hash();
+
+    apply_protocol_prefs(unseen_name);
+    prefs_note_dissection_changed();
+    g_assert_null(prefs_take_applied_protocols());
+
+    /* Nothing is left for the next change. */
+    g_assert_null(prefs_take_applied_protocols());
+    apply_protocol_prefs(unseen_name);
+    g_assert_false(applied_protocols_called());
+
+    proto_set_decoding(unseen_proto, FALSE);
+    g_assert_cmpuint(dissector_routing_hash(), !=, routing_hash);
+    proto_set_decoding(unseen_proto, TRUE);
+    g_assert_cmpuint(dissector_routing_hash(), ==, routing_hash);
+}
+
+int
+main(int argc, char **argv)
+{
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/redissect/called_protocols", redissect_test_called_protocols);
+    g_test_add_func("/redissect/seen_protocol", redissect_test_seen_protocol);
+    g_test_add_func("/redissect/unseen_protocol", redissect_test_unseen_protocol);
+    g_test_add_func("/redissect/heuristic_protocol", redissect_test_heuristic_protocol);
+    g_test_add_func("/redissect/library_protocol", redissect_test_library_protocol);
+    g_test_add_func("/redissect/other_changes", redissect_test_other_changes);
+
+    wtap_init(FALSE);
+    if (!epan_init(NULL, NULL, FALSE))
+        return 2;
+
+    dissect_udp_frame();
+
+    result = g_test_run();
+
+    epan_free(session);
+    epan_cleanup();
+    wtap_cleanup();
+
+    return result;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -81,6 +81,7 @@ typedef struct _tap_listener_t {
 	int tap_id;
 	gboolean needs_redraw;
 	gboolean failed;
+	gboolean up_to_date;	/* has seen every packet since it was last reset */
 	guint flags;
 	gchar *fstring;
 	dfilter_t *code;
@@ -93,6 +94,9 @@ typedef struct _tap_listener_t {
 
 static tap_listener_t *tap_listener_queue=NULL;
 
+/* TRUE between reset_tap_listeners_for_retap() and tap_listeners_retap_finished() */
+static gboolean retap_in_progress=FALSE;
+
 #ifdef HAVE_PLUGINS
 static GSList *tap_plugins = NULL;
 
@@ -325,6 +329,13 @@ tap_push_tapped_queue(epan_dissect_t *edt)
 						 */
 						continue;
 					}
+					if(retap_in_progress && tl->up_to_date){
+						/* An additive listener that
+						 * has already seen this
+						 * packet.
+						 */
+						continue;
+					}
 
 					/* If we have a filter, see if the
 					 * packet passes.
@@ -419,10 +430,81 @@ reset_tap_listeners(void)
 		}
 		tl->needs_redraw=TRUE;
 		tl->failed=FALSE;
+		tl->up_to_date=FALSE;
 	}
 
 }
 
+/* This function is called before retapping all packets; unlike
+   reset_tap_listeners() it leaves additive tap listeners that have already
+   seen every packet alone.
+*/
+void
+reset_tap_listeners_for_retap(void)
+{
+	tap_listener_t *tl;
+
+	for(tl=tap_listener_queue;tl;tl=tl->next){
+		if((tl->flags & TL_IS_ADDITIVE) && tl->up_to_date){
+			continue;
+		}
+		if(tl->reset){
+			tl->reset(tl->tapdata);
+		}
+		tl->needs_redraw=TRUE;
+		tl->failed=FALSE;
+		tl->up_to_date=FALSE;
+	}
+	retap_in_progress=TRUE;
+}
+
+guint8 *
+get_retap_frames(guint32 max_frame, tap_dfilter_frames_cb frames_for_dfilter, void *user_data)
+{
+	tap_listener_t *tl;
+	guint8 *frames, *tl_frames;
+	gsize len, i;
+
+	len = DFILTER_INDEX_BITMAP_LEN(max_frame);
+	frames = (guint8 *)g_malloc0(len);
+
+	for(tl=tap_listener_queue;tl;tl=tl->next){
+		if(tl->up_to_date || (tl->flags & TL_IS_DISSECTOR_HELPER)){
+			/* Won't be called, or doesn't need dissection */
+			continue;
+		}
+		if(!(tl->flags & TL_IS_ADDITIVE) || !tl->code){
+			/* Needs every packet */
+			g_free(frames);
+			return NULL;
+		}
+		tl_frames = frames_for_dfilter(tl->fstring, tl->code, user_data);
+		if(!tl_frames){
+			g_free(frames);
+			return NULL;
+		}
+		for(i=0;i<len;i++){
+			frames[i] |= tl_frames[i];
+		}
+		g_free(tl_frames);
+	}
+
+	return frames;
+}
+
+void
+tap_listeners_retap_finished(gboolean completed)
+{
+	tap_listener_t *tl;
+
+	retap_in_progress=FALSE;
+	if(completed){
+		for(tl=tap_listener_queue;tl;tl=tl->next){
+			tl->up_to_date=TRUE;
+		}
+	}
+}
+
 
 /* This function is called when we need to redraw all tap listeners, for example
    when we open/start a new capture or if we need to rescan the packet list.
@@ -590,6 +672,7 @@ set_tap_dfilter(void *tapdata, const char *fstring)
 			tl->code=NULL;
 		}
 		tl->needs_redraw=TRUE;
+		tl->up_to_date=FALSE;
 		g_free(tl->fstring);
 		if(fstring){
 			if(!dfilter_compile(fstring, &code, &err_msg)){
@@ -624,6 +707,7 @@ tap_listeners_dfilter_recompile(void)
 			tl->code=NULL;
 		}
 		tl->needs_redraw=TRUE;
+		tl->up_to_date=FALSE;
 		code=NULL;
 		if(tl->fstring){
 			if(!dfilter_compile(tl->fstring, &code, &err_msg)){
@@ -669,6 +753,21 @@ remove_tap_listener(void *tapdata)
 	free_tap_listener(tl);
 }
 
+/* this function makes a tap listener see every packet at the next retap
+ */
+void
+invalidate_tap_listener(void *tapdata)
+{
+	tap_listener_t *tl;
+
+	for(tl=tap_listener_queue;tl;tl=tl->next){
+		if(tl->tapdata==tapdata){
+			tl->up_to_date=FALSE;
+			break;
+		}
+	}
+}
+
 /*
  * Return TRUE if we have one or more tap listeners that require dissection,
  * FALSE otherwise.
@@ -13,6 +13,7 @@
 
 #include <epan/epan.h>
 #include <epan/packet_info.h>
+#include <epan/dfilter/dfilter.h>
 #include "ws_symbol_export.h"
 #ifdef HAVE_PLUGINS
 #include "wsutil/plugins.h"
@@ -46,6 +47,9 @@ typedef void (*tap_finish_cb)(void *tapdata);
 /** Flags to indicate what the tap listener does */
 #define TL_IS_DISSECTOR_HELPER	0x00000008	    /**< tap helps a dissector do work
 						                         ** but does not, itself, require dissection */
+#define TL_IS_ADDITIVE		0x00000010	    /**< tap's state is built only from the packets
+						                         ** that pass its filter, and only changes
+						                         ** with them; see reset_tap_listeners_for_retap() */
 
 #ifdef HAVE_PLUGINS
 typedef struct {
@@ -188,6 +192,18 @@ WS_DLL_PUBLIC void draw_tap_listeners(gboolean draw_all);
  *                   	set if your tap listener "packet" routine requires the column
  *                   	strings to be constructed.
  *
+ *                      TL_IS_ADDITIVE
+ *
+ *                   	set if your listener's state is simply accumulated from the
+ *                   	packets passing its filter, so that once it has seen every
+ *                   	packet a retap can leave it alone, and packets that can't
+ *                   	pass its filter needn't be dissected for it. Anything other
+ *                   	than its filter that changes its results must be followed by
+ *                   	invalidate_tap_listener(). Only retaps that go through
+ *                   	reset_tap_listeners_for_retap(), such as cf_retap_packets(),
+ *                   	make use of it; sharkd still resets and refeeds every
+ *                   	listener.
+ *
  *                       If no flags are needed, use TL_REQUIRES_NOTHING.
  *
  * @param tap_reset  void (*reset)(void *tapdata)
@@ -232,6 +248,51 @@ WS_DLL_PUBLIC void tap_listeners_dfilter_recompile(void);
 /** this function removes a tap listener */
 WS_DLL_PUBLIC void remove_tap_listener(void *tapdata);
 
+/**
+ * Mark a tap listener as needing to be reset and see every packet again
+ * at the next retap, even if it is additive.
+ */
+WS_DLL_PUBLIC void invalidate_tap_listener(void *tapdata);
+
+/**
+ * Prepare the tap listeners for a retap of the whole capture. Additive
+ * listeners (TL_IS_ADDITIVE) that have already seen every packet are left
+ * alone and won't be called for packets until tap_listeners_retap_finished();
+ * all other listeners are reset.
+ */
+WS_DLL_PUBLIC void reset_tap_listeners_for_retap(void);
+
+/**
+ * Callback for get_retap_frames(). Returns a g_malloc()ed bitmap of the
+ * frames that can pass a filter (see DFILTER_INDEX_BITMAP_LEN() and
+ * DFILTER_INDEX_FRAME_MATCHES()), or NULL if that isn't known without
+ * dissecting them.
+ */
+typedef guint8 *(*tap_dfilter_frames_cb)(const char *fstring, dfilter_t *code, void *user_data);
+
+/**
+ * Get the frames a retap has to dissect, once reset_tap_listeners_for_retap()
+ * has been called. That's only known if every listener that is going to be
+ * called is additive and has a filter that frames_for_dfilter knows the
+ * result of.
+ *
+ * @param max_frame The number of frames in the capture.
+ * @param frames_for_dfilter Works out which frames can pass a filter.
+ * @param user_data Passed to frames_for_dfilter.
+ * @return A g_malloc()ed bitmap of the frames to dissect, or NULL if all
+ *         of them have to be.
+ */
+WS_DLL_PUBLIC guint8 *get_retap_frames(guint32 max_frame,
+    tap_dfilter_frames_cb frames_for_dfilter, void *user_data);
+
+/**
+ * Finish a retap started with reset_tap_listeners_for_retap().
+ *
+ * @param completed TRUE if every packet was processed, in which case all
+ *                  listeners are now up to date.
+ */
+WS_DLL_PUBLIC void tap_listeners_retap_finished(gboolean completed);
+
 /**
  * Return TRUE if we have one or more tap listeners that require dissection,
  * FALSE otherwise.
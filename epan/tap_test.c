@@ -0,0 +1,248 @@
+/* tap_test.c
+ * Tests for skipping retaps for additive tap listeners
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include <wiretap/wtap.h>
+
+#include "epan.h"
+#include "tap.h"
+
+#define TEST_TAP        "tap_test"
+#define TEST_MAX_FRAME  20
+
+typedef struct {
+    int resets;
+} test_listener_t;
+
+static test_listener_t additive, other, helper;
+
+/* Frames each filter passes, as the field value index would answer */
+static const guint32 udp_frames[] = { 2, 3, 17 };
+static const guint32 tcp_frames[] = { 5, 20 };
+
+static int frames_cb_calls;
+
+static void
+test_reset(void *tapdata)
+{
+    ((test_listener_t *)tapdata)->resets++;
+}
+
+static tap_packet_status
+test_packet(void *tapdata _U_, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *data _U_)
+{
+    return TAP_PACKET_DONT_REDRAW;
+}
+
+static guint8 *
+test_frames_for_dfilter(const char *fstring, dfilter_t *code _U_, void *user_data)
+{
+    const guint32 *frames;
+    size_t count, i;
+    guint8 *bitmap;
+
+    frames_cb_calls++;
+    if (GPOINTER_TO_INT(user_data))
+        return NULL;    /* not known without dissecting */
+
+    if (strcmp(fstring, "udp") == 0) {
+        frames = udp_frames;
+        count = G_N_ELEMENTS(udp_frames);
+    } else if (strcmp(fstring, "tcp") == 0) {
+        frames = tcp_frames;
+        count = G_N_ELEMENTS(tcp_frames);
+    } else {
+        return NULL;
+    }
+
+    bitmap = (guint8 *)g_malloc0(DFILTER_INDEX_BITMAP_LEN(TEST_MAX_FRAME));
+    for (i = 0; i < count; i++)
+        bitmap[frames[i] >> 3] |= 1 << (frames[i] & 7);
+    return bitmap;
+}
+
+static void
+register_listener(test_listener_t *tl, const char *fstring, guint flags)
+{
+    GString *error;
+
+    memset(tl, 0, sizeof *tl);
+    error = register_tap_listener(TEST_TAP, tl, fstring, flags,
+                                  test_reset, test_packet, NULL, NULL);
+    g_assert_null(error);
+}
+
+/* Checks that a bitmap holds exactly the given frames */
+static void
+assert_frames(const guint8 *bitmap, const guint32 *frames, size_t count)
+{
+    guint32 framenum;
+    size_t i;
+    gboolean expected;
+
+    g_assert_nonnull(bitmap);
+    for (framenum = 1; framenum <= TEST_MAX_FRAME; framenum++) {
+        expected = FALSE;
+        for (i = 0; i < count; i++) {
+            if (frames[i] == framenum)
+                expected = TRUE;
+        }
+        g_assert_cmpint(!!DFILTER_INDEX_FRAME_MATCHES(bitmap, framenum), ==, expected);
+    }
+}
+
+/* A listener that has seen every packet is only reset if it isn't additive */
+static void
+tap_test_reset_up_to_date(void)
+{
+    guint8 *frames;
+
+    register_listener(&additive, "udp", TL_IS_ADDITIVE);
+    register_listener(&other, NULL, TL_REQUIRES_NOTHING);
+
+    reset_tap_listeners_for_retap();
+    g_assert_cmpint(additive.resets, ==, 1);
+    g_assert_cmpint(other.resets, ==, 1);
+    tap_listeners_retap_finished(TRUE);
+
+    reset_tap_listeners_for_retap();
+    g_assert_cmpint(additive.resets, ==, 1);
+    g_assert_cmpint(other.resets, ==, 2);
+    /* The other listener needs every packet. */
+    frames = get_retap_frames(TEST_MAX_FRAME, test_frames_for_dfilter, NULL);
+    g_assert_null(frames);
+    tap_listeners_retap_finished(TRUE);
+
+    remove_tap_listener(&other);
+
+    /* Nothing needs a retap, so no frame has to be dissected. */
+    frames_cb_calls = 0;
+    reset_tap_listeners_for_retap();
+    g_assert_cmpint(additive.resets, ==, 1);
+    frames = get_retap_frames(TEST_MAX_FRAME, test_frames_for_dfilter, NULL);
+    assert_frames(frames, NULL, 0);
+    g_assert_cmpint(frames_cb_calls, ==, 0);
+    g_free(frames);
+    tap_listeners_retap_finished(TRUE);
+
+    remove_tap_listener(&additive);
+}
+
+/* Only the frames that can pass the filters of the listeners to be
+   refed are dissected */
+static void
+tap_test_retap_frames(void)
+{
+    static const guint32 both_frames[] = { 2, 3, 5, 17, 20 };
+    guint8 *frames;
+
+    register_listener(&additive, "udp", TL_IS_ADDITIVE);
+    register_listener(&other, "tcp", TL_IS_ADDITIVE);
+    register_listener(&helper, NULL, TL_IS_DISSECTOR_HELPER);
+
+    reset_tap_listeners_for_retap();
+    frames = get_retap_frames(TEST_MAX_FRAME, test_frames_for_dfilter, NULL);
+    assert_frames(frames, both_frames, G_N_ELEMENTS(both_frames));
+    g_free(frames);
+    tap_listeners_retap_finished(TRUE);
+
+    /* Only the invalidated listener is reset and refed. */
+    invalidate_tap_listener(&other);
+    reset_tap_listeners_for_retap();
+    g_assert_cmpint(additive.resets, ==, 1);
+    g_assert_cmpint(other.resets, ==, 2);
+    frames = get_retap_frames(TEST_MAX_FRAME, test_frames_for_dfilter, NULL);
+    assert_frames(frames, tcp_frames, G_N_ELEMENTS(tcp_frames));
+    g_free(frames);
+
+    /* An interrupted retap leaves it out of date. */
+    tap_listeners_retap_finished(FALSE);
+    reset_tap_listeners_for_retap();
+    g_assert_cmpint(additive.resets, ==, 1);
+    g_assert_cmpint(other.resets, ==, 3);
+    tap_listeners_retap_finished(TRUE);
+
+    /* So does a new filter. */
+    g_assert_null(set_tap_dfilter(&additive, "tcp"));
+    reset_tap_listeners_for_retap();
+    g_assert_cmpint(additive.resets, ==, 2);
+    g_assert_cmpint(other.resets, ==, 3);
+    frames = get_retap_frames(TEST_MAX_FRAME, test_frames_for_dfilter, NULL);
+    assert_frames(frames, tcp_frames, G_N_ELEMENTS(tcp_frames));
+    g_free(frames);
+
+    /* If a filter's frames aren't known, every frame is dissected. */
+    frames = get_retap_frames(TEST_MAX_FRAME, test_frames_for_dfilter, GINT_TO_POINTER(1));
+    g_assert_null(frames);
+    tap_listeners_retap_finished(TRUE);
+
+    remove_tap_listener(&helper);
+    remove_tap_listener(&other);
+    remove_tap_listener(&additive);
+}
+
+/* A full reset makes additive listeners see every packet again */
+static void
+tap_test_full_reset(void)
+{
+    register_listener(&additive, "udp", TL_IS_ADDITIVE);
+
+    reset_tap_listeners_for_retap();
+    tap_listeners_retap_finished(TRUE);
+    reset_tap_listeners();
+    g_assert_cmpint(additive.resets, ==, 2);
+
+    reset_tap_listeners_for_retap();
+    g_assert_cmpint(additive.resets, ==, 3);
+    tap_listeners_retap_finished(TRUE);
+
+    remove_tap_listener(&additive);
+}
+
+int
+main(int argc, char **argv)
+{
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/tap/retap/reset_up_to_date", tap_test_reset_up_to_date);
+    g_test_add_func("/tap/retap/frames", tap_test_retap_frames);
+    g_test_add_func("/tap/retap/full_reset", tap_test_full_reset);
+
+    wtap_init(FALSE);
+    if (!epan_init(NULL, NULL, FALSE))
+        return 2;
+    register_tap(TEST_TAP);
+
+    result = g_test_run();
+
+    epan_cleanup();
+    wtap_cleanup();
+
+    return result;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
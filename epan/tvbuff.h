@@ -208,6 +208,12 @@ WS_DLL_PUBLIC tvbuff_t *tvb_new_composite(void);
  * occur, data access can finally happen after this finalization. */
 WS_DLL_PUBLIC void tvb_composite_finalize(tvbuff_t *tvb);
 
+/** Like tvb_composite_finalize(), but don't add the composite tvbuff to
+ * the chain of its first member.  The caller is responsible for keeping
+ * the members around as long as the composite, e.g. by adding them to
+ * the composite's own chain. */
+WS_DLL_PUBLIC void tvb_composite_finalize_unchained(tvbuff_t *tvb);
+
 
 /* Get amount of captured data in the buffer (which is *NOT* necessarily the
  * length of the packet). You probably want tvb_reported_length instead. */
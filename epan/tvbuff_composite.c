@@ -18,9 +18,11 @@
 typedef struct {
 	GSList		*tvbs;
 
-	/* Used for quick testing to see if this
-	 * is the tvbuff that a COMPOSITE is
-	 * interested in. */
+	/* Filled in when the composite is finalized: the members in
+	 * order, and where each of them starts and ends, so the member
+	 * holding an offset can be found with a binary search. */
+	guint		num_members;
+	tvbuff_t	**members;
 	guint		*start_offsets;
 	guint		*end_offsets;
 
@@ -40,6 +42,7 @@ composite_free(tvbuff_t *tvb)
 
 	g_slist_free(composite->tvbs);
 
+	g_free(composite->members);
 	g_free(composite->start_offsets);
 	g_free(composite->end_offsets);
 	if (tvb->real_data) {
@@ -56,30 +59,40 @@ composite_offset(const tvbuff_t *tvb _U_, const guint counter)
 	return counter;
 }
 
+/* Index of the first member that ends at or after abs_offset, or
+ * num_members if there's none. */
+static guint
+composite_find_member(const tvb_comp_t *composite, guint abs_offset)
+{
+	guint lo = 0, hi = composite->num_members, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (composite->end_offsets[mid] < abs_offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 static const guint8*
 composite_get_ptr(tvbuff_t *tvb, guint abs_offset, guint abs_length)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
 	tvbuff_t   *member_tvb = NULL;
 	guint	    member_offset;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
 	/* Maybe the range specified by offset/length
 	 * is contiguous inside one of the member tvbuffs */
 	composite = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	i = composite_find_member(composite, abs_offset);
+	if (i < composite->num_members)
+		member_tvb = composite->members[i];
 
 	/* special case */
 	if (!member_tvb) {
@@ -113,26 +126,19 @@ composite_memcpy(tvbuff_t *tvb, void* _target, guint abs_offset, guint abs_lengt
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	guint8 *target = (guint8 *) _target;
 
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
 	tvbuff_t   *member_tvb = NULL;
 	guint	    member_offset, member_length;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
 	/* Maybe the range specified by offset/length
 	 * is contiguous inside one of the member tvbuffs */
 	composite   = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	i = composite_find_member(composite, abs_offset);
+	if (i < composite->num_members)
+		member_tvb = composite->members[i];
 
 	/* special case */
 	if (!member_tvb) {
@@ -152,18 +158,26 @@ composite_memcpy(tvbuff_t *tvb, void* _target, guint abs_offset, guint abs_lengt
 		 * then iterate across the other member tvb's, copying their portions
 		 * until we have copied all data.
 		 */
-		member_length = tvb_captured_length_remaining(member_tvb, member_offset);
-
-		/* composite_memcpy() can't handle a member_length of zero. */
-		DISSECTOR_ASSERT(member_length > 0);
-
-		tvb_memcpy(member_tvb, target, member_offset, member_length);
-		abs_offset	+= member_length;
-		abs_length	-= member_length;
-
-		/* Recurse */
-		if (abs_length > 0) {
-			composite_memcpy(tvb, target + member_length, abs_offset, abs_length);
+		guint8 *dst = target;
+
+		for (;;) {
+			member_length = tvb_captured_length_remaining(member_tvb, member_offset);
+
+			/* composite_memcpy() can't handle a member_length of zero. */
+			DISSECTOR_ASSERT(member_length > 0);
+
+			member_length = MIN(member_length, abs_length);
+			tvb_memcpy(member_tvb, dst, member_offset, member_length);
+			dst		+= member_length;
+			abs_length	-= member_length;
+			if (abs_length == 0)
+				break;
+
+			/* Continue at the start of the next member */
+			i++;
+			DISSECTOR_ASSERT(i < composite->num_members);
+			member_tvb = composite->members[i];
+			member_offset = 0;
 		}
 
 		return target;
@@ -200,6 +214,8 @@ tvb_new_composite(void)
 	tvb_comp_t *composite = &composite_tvb->composite;
 
 	composite->tvbs		 = NULL;
+	composite->num_members	 = 0;
+	composite->members	 = NULL;
 	composite->start_offsets = NULL;
 	composite->end_offsets	 = NULL;
 
@@ -242,8 +258,8 @@ tvb_composite_prepend(tvbuff_t *tvb, tvbuff_t *member)
 	composite->tvbs = g_slist_prepend(composite->tvbs, member);
 }
 
-void
-tvb_composite_finalize(tvbuff_t *tvb)
+static void
+composite_finalize(tvbuff_t *tvb)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	GSList	   *slist;
@@ -267,12 +283,15 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	 */
 	DISSECTOR_ASSERT(num_members);
 
+	composite->num_members = num_members;
+	composite->members = g_new(tvbuff_t *, num_members);
 	composite->start_offsets = g_new(guint, num_members);
 	composite->end_offsets = g_new(guint, num_members);
 
 	for (slist = composite->tvbs; slist != NULL; slist = slist->next) {
 		DISSECTOR_ASSERT((guint) i < num_members);
 		member_tvb = (tvbuff_t *)slist->data;
+		composite->members[i] = member_tvb;
 		composite->start_offsets[i] = tvb->length;
 		tvb->length += member_tvb->length;
 		tvb->reported_length += member_tvb->reported_length;
@@ -283,11 +302,25 @@ tvb_composite_finalize(tvbuff_t *tvb)
 
 	DISSECTOR_ASSERT(composite->tvbs);
 
-	tvb_add_to_chain((tvbuff_t *)composite->tvbs->data, tvb); /* chain composite tvb to first member */
 	tvb->initialized = TRUE;
 	tvb->ds_tvb = tvb;
 }
 
+void
+tvb_composite_finalize(tvbuff_t *tvb)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+
+	composite_finalize(tvb);
+	tvb_add_to_chain((tvbuff_t *)composite_tvb->composite.tvbs->data, tvb); /* chain composite tvb to first member */
+}
+
+void
+tvb_composite_finalize_unchained(tvbuff_t *tvb)
+{
+	composite_finalize(tvb);
+}
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
@@ -13,6 +13,10 @@
 
 #include "config.h"
 
+#ifdef HAVE_RECVMMSG
+#define _GNU_SOURCE /* Otherwise recvmmsg() won't be declared on Linux */
+#endif
+
 #include <extcap/extcap-base.h>
 
 #include <glib.h>
@@ -51,11 +55,24 @@
 
 #define UDPDUMP_EXTCAP_INTERFACE "udpdump"
 #define UDPDUMP_VERSION_MAJOR "0"
-#define UDPDUMP_VERSION_MINOR "1"
+#define UDPDUMP_VERSION_MINOR "2"
 #define UDPDUMP_VERSION_RELEASE "0"
 
 #define PKT_BUF_SIZE 65535
 
+/* The most datagrams received with one call */
+#ifdef HAVE_RECVMMSG
+#define UDPDUMP_BATCH_SIZE 64
+#else
+#define UDPDUMP_BATCH_SIZE 1
+#endif
+
+/* The output buffer, which holds the blocks of a batch of datagrams */
+#define UDPDUMP_WRITE_BUFFER_SIZE (256 * 1024)
+
+/* The least time between statistics blocks written because of new drops */
+#define UDPDUMP_ISB_INTERVAL G_USEC_PER_SEC
+
 #define UDPDUMP_EXPORT_HEADER_LEN 40
 
 /* Tags (from exported_pdu.h) */
@@ -72,7 +89,8 @@ enum {
 	OPT_HELP,
 	OPT_VERSION,
 	OPT_PORT,
-	OPT_PAYLOAD
+	OPT_PAYLOAD,
+	OPT_SOCKET_BUFFER
 };
 
 static struct option longopts[] = {
@@ -83,6 +101,7 @@ static struct option longopts[] = {
 	/* Interfaces options */
 	{ "port", required_argument, NULL, OPT_PORT},
 	{ "payload", required_argument, NULL, OPT_PAYLOAD},
+	{ "socket-buffer", required_argument, NULL, OPT_SOCKET_BUFFER},
     { 0, 0, 0, 0 }
 };
 
@@ -101,13 +120,35 @@ static int list_config(char *interface)
 	printf("arg {number=%u}{call=--payload}{display=Payload type}"
 		"{type=string}{default=data}{tooltip=The type used to describe the payload in the exported pdu format}\n",
 		inc++);
+	printf("arg {number=%u}{call=--socket-buffer}{display=Socket buffer size}"
+		"{type=unsigned}{default=0}{tooltip=The receive buffer of the socket, in bytes; 0 for the system default}\n",
+		inc++);
 
 	extcap_config_debug(&inc);
 
 	return EXIT_SUCCESS;
 }
 
-static int setup_listener(const guint16 port, socket_handle_t* sock)
+/* Asks for a receive buffer of the given size, warning if we get less */
+static void set_socket_buffer(socket_handle_t sock, const guint32 size)
+{
+	int optval = (int)MIN(size, G_MAXINT);
+	socklen_t optlen = (socklen_t)sizeof(int);
+
+#ifdef SO_RCVBUFFORCE
+	/* Privileged users can go past net.core.rmem_max */
+	if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, (char*)&optval, optlen) == 0)
+		return;
+#endif
+	if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char*)&optval, optlen) < 0) {
+		g_warning("Can't set socket option SO_RCVBUF: %s", strerror(errno));
+		return;
+	}
+	if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char*)&optval, &optlen) == 0 && (guint32)optval < size)
+		g_warning("The socket receive buffer is %d bytes, not the %u asked for; the system limits it", optval, size);
+}
+
+static int setup_listener(const guint16 port, const guint32 socket_buffer, socket_handle_t* sock)
 {
 	int optval;
 	struct sockaddr_in serveraddr;
@@ -135,6 +176,21 @@ static int setup_listener(const guint16 port, socket_handle_t* sock)
 	}
 #endif
 
+	if (socket_buffer != 0)
+		set_socket_buffer(*sock, socket_buffer);
+
+#if defined(HAVE_RECVMMSG) && defined(SO_TIMESTAMPNS)
+	/* Have the kernel tell us when each datagram arrived */
+	if (setsockopt(*sock, SOL_SOCKET, SO_TIMESTAMPNS, (char*)&optval, (socklen_t)sizeof(int)) < 0)
+		g_warning("Can't set socket option SO_TIMESTAMPNS: %s", strerror(errno));
+#endif
+
+#if defined(HAVE_RECVMMSG) && defined(SO_RXQ_OVFL)
+	/* ... and how many datagrams it has dropped because our buffer was full */
+	if (setsockopt(*sock, SOL_SOCKET, SO_RXQ_OVFL, (char*)&optval, (socklen_t)sizeof(int)) < 0)
+		g_warning("Can't set socket option SO_RXQ_OVFL: %s", strerror(errno));
+#endif
+
 	memset(&serveraddr, 0x0, sizeof(serveraddr));
 	serveraddr.sin_family = AF_INET;
 	serveraddr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -163,22 +219,52 @@ static int setup_dumpfile(const char* fifo, FILE** fp)
 {
 	guint64 bytes_written = 0;
 	int err;
+	char *appname;
+	gboolean success;
 
 	if (!g_strcmp0(fifo, "-")) {
 		*fp = stdout;
-		return EXIT_SUCCESS;
+	} else {
+		*fp = fopen(fifo, "wb");
+		if (!(*fp)) {
+			g_warning("Error creating output file: %s", g_strerror(errno));
+			return EXIT_FAILURE;
+		}
 	}
 
-	*fp = fopen(fifo, "wb");
-	if (!(*fp)) {
-		g_warning("Error creating output file: %s", g_strerror(errno));
-		return EXIT_FAILURE;
+	/* Blocks are written a batch at a time, with one flush per batch */
+	setvbuf(*fp, NULL, _IOFBF, UDPDUMP_WRITE_BUFFER_SIZE);
+
+	appname = g_strdup_printf(UDPDUMP_EXTCAP_INTERFACE " (Wireshark) %s.%s.%s",
+		UDPDUMP_VERSION_MAJOR, UDPDUMP_VERSION_MINOR, UDPDUMP_VERSION_RELEASE);
+	success = pcapng_write_section_header_block(*fp,
+						NULL,    /* Comment */
+						NULL,    /* HW */
+						NULL,    /* OS */
+						appname,
+						-1,      /* section_length */
+						&bytes_written,
+						&err);
+	g_free(appname);
+	if (success) {
+		success = pcapng_write_interface_description_block(*fp,
+						NULL,    /* Comment */
+						UDPDUMP_EXTCAP_INTERFACE,
+						NULL,    /* Description */
+						NULL,    /* Filter */
+						NULL,    /* OS */
+						252,
+						PCAP_SNAPLEN,
+						&bytes_written,
+						0,       /* if_speed */
+						9,       /* Nanosecond time stamps */
+						&err);
 	}
-
-	if (!libpcap_write_file_header(*fp, 252, PCAP_SNAPLEN, FALSE, &bytes_written, &err)) {
-		g_warning("Can't write pcap file header: %s", g_strerror(err));
+	if (!success) {
+		g_warning("Can't write pcapng file header: %s", g_strerror(err));
 		return EXIT_FAILURE;
 	}
+	fflush(*fp);
 
 	return EXIT_SUCCESS;
 }
@@ -253,18 +339,115 @@ static void add_end_options(guint8* mbuf, guint* offset)
 	*offset += 4;
 }
 
+#ifdef HAVE_RECVMMSG
+/* Room for a receive time stamp and a drop count */
+#define UDPDUMP_CONTROL_LEN (CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(guint32)))
+#endif
+
+/* The datagrams received with one call, and what the kernel told us about them */
+typedef struct {
+	char* bufs;					/* UDPDUMP_BATCH_SIZE buffers of PKT_BUF_SIZE bytes */
+	ssize_t lens[UDPDUMP_BATCH_SIZE];
+	struct sockaddr_in addrs[UDPDUMP_BATCH_SIZE];
+	guint64 ts[UDPDUMP_BATCH_SIZE];			/* nanoseconds since the Epoch */
+	guint32 drops;					/* datagrams the socket has dropped so far */
+#ifdef HAVE_RECVMMSG
+	struct mmsghdr msgs[UDPDUMP_BATCH_SIZE];
+	struct iovec iovs[UDPDUMP_BATCH_SIZE];
+	char control[UDPDUMP_BATCH_SIZE][UDPDUMP_CONTROL_LEN];
+#endif
+} recv_batch;
+
+static recv_batch* recv_batch_new(void)
+{
+	recv_batch* batch = g_new0(recv_batch, 1);
+#ifdef HAVE_RECVMMSG
+	int i;
+#endif
+
+	batch->bufs = (char*)g_malloc(UDPDUMP_BATCH_SIZE * PKT_BUF_SIZE);
+#ifdef HAVE_RECVMMSG
+	for (i = 0; i < UDPDUMP_BATCH_SIZE; i++) {
+		batch->iovs[i].iov_base = batch->bufs + i * PKT_BUF_SIZE;
+		batch->iovs[i].iov_len = PKT_BUF_SIZE;
+		batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+		batch->msgs[i].msg_hdr.msg_iov = &batch->iovs[i];
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
+		batch->msgs[i].msg_hdr.msg_control = batch->control[i];
+	}
+#endif
+	return batch;
+}
+
+static void recv_batch_free(recv_batch* batch)
+{
+	g_free(batch->bufs);
+	g_free(batch);
+}
+
+/* Waits for datagrams and receives as many as are ready, up to a batch.
+   Returns how many, or -1 on error with errno set. */
+static int receive_batch(socket_handle_t sock, recv_batch* batch)
+{
+#ifdef HAVE_RECVMMSG
+	struct cmsghdr* cmsg;
+	struct timespec ts;
+	guint64 now = 0;
+	int count;
+	int i;
+
+	for (i = 0; i < UDPDUMP_BATCH_SIZE; i++) {
+		batch->msgs[i].msg_hdr.msg_namelen = (socklen_t)sizeof(batch->addrs[i]);
+		batch->msgs[i].msg_hdr.msg_controllen = sizeof(batch->control[i]);
+		batch->msgs[i].msg_hdr.msg_flags = 0;
+	}
+
+	count = recvmmsg(sock, batch->msgs, UDPDUMP_BATCH_SIZE, MSG_WAITFORONE, NULL);
+	for (i = 0; i < count; i++) {
+		batch->lens[i] = batch->msgs[i].msg_len;
+		batch->ts[i] = 0;
+		for (cmsg = CMSG_FIRSTHDR(&batch->msgs[i].msg_hdr); cmsg != NULL;
+				cmsg = CMSG_NXTHDR(&batch->msgs[i].msg_hdr, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET)
+				continue;
+#ifdef SO_TIMESTAMPNS
+			if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+				memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+				batch->ts[i] = (guint64)ts.tv_sec * 1000000000 + (guint64)ts.tv_nsec;
+			}
+#endif
+#ifdef SO_RXQ_OVFL
+			if (cmsg->cmsg_type == SO_RXQ_OVFL)
+				memcpy(&batch->drops, CMSG_DATA(cmsg), sizeof(guint32));
+#endif
+		}
+		/* No time stamp from the kernel; use the time we got the datagram */
+		if (batch->ts[i] == 0) {
+			if (now == 0)
+				now = (guint64)g_get_real_time() * 1000;
+			batch->ts[i] = now;
+		}
+	}
+	return count;
+#else
+	socklen_t clientlen = sizeof(batch->addrs[0]);
+
+	batch->lens[0] = recvfrom(sock, batch->bufs, PKT_BUF_SIZE, 0, (struct sockaddr *)&batch->addrs[0], &clientlen);
+	if (batch->lens[0] < 0)
+		return -1;
+	batch->ts[0] = (guint64)g_get_real_time() * 1000;
+	return 1;
+#endif
+}
+
+/* Writes a datagram as an EPB, with the exported PDU header built in "mbuf" */
 static int dump_packet(const char* proto_name, const guint16 listenport, const char* buf,
-		const ssize_t buflen, const struct sockaddr_in clientaddr, FILE* fp)
+		const ssize_t buflen, const struct sockaddr_in clientaddr, const guint64 ts,
+		guint8* mbuf, FILE* fp)
 {
-	guint8* mbuf;
 	guint offset = 0;
-	time_t curtime = time(NULL);
 	guint64 bytes_written = 0;
 	int err;
-	int ret = EXIT_SUCCESS;
-
-	/* The space we need is the standard header + variable lengths */
-	mbuf = (guint8*)g_malloc0(UDPDUMP_EXPORT_HEADER_LEN + ((strlen(proto_name) + 3) & 0xfffffffc) + buflen);
 
 	add_proto_name(mbuf, &offset, proto_name);
 	add_ip_source_address(mbuf, &offset, clientaddr.sin_addr.s_addr);
@@ -276,25 +459,49 @@ static int dump_packet(const char* proto_name, const guint16 listenport, const c
 	memcpy(mbuf + offset, buf, buflen);
 	offset += (guint)buflen;
 
-	if (!libpcap_write_packet(fp, curtime, (guint32)(curtime / 1000), offset, offset, mbuf, &bytes_written, &err)) {
+	if (!pcapng_write_enhanced_packet_block(fp, NULL, (time_t)(ts / 1000000000), (guint32)(ts % 1000000000),
+			offset, offset, 0, 1000000000, mbuf, 0, &bytes_written, &err)) {
 		g_warning("Can't write packet: %s", g_strerror(err));
-		ret = EXIT_FAILURE;
+		return EXIT_FAILURE;
 	}
 
+	return EXIT_SUCCESS;
+}
+
+/* Writes an ISB with the datagrams received and, if we know it, dropped */
+static int dump_statistics(const guint64 received, const guint32 drops, FILE* fp)
+{
+	guint64 bytes_written = 0;
+	guint64 ifrecv = received;
+	guint64 ifdrop = G_MAXUINT64;
+	int err;
+
+#if defined(HAVE_RECVMMSG) && defined(SO_RXQ_OVFL)
+	ifrecv += drops;
+	ifdrop = drops;
+#else
+	(void)drops;
+#endif
+	if (!pcapng_write_interface_statistics_block(fp, 0, 1000000000, &bytes_written, NULL, 0, 0, ifrecv, ifdrop, &err)) {
+		g_warning("Can't write interface statistics: %s", g_strerror(err));
+		return EXIT_FAILURE;
+	}
 	fflush(fp);
 
-	g_free(mbuf);
-	return ret;
+	return EXIT_SUCCESS;
 }
 
-static void run_listener(const char* fifo, const guint16 port, const char* proto_name)
+static void run_listener(const char* fifo, const guint16 port, const char* proto_name, const guint32 socket_buffer)
 {
-	struct sockaddr_in clientaddr;
-	socklen_t clientlen = sizeof(clientaddr);
 	socket_handle_t sock;
-	char* buf;
-	ssize_t buflen;
+	recv_batch* batch;
+	guint8* mbuf;
 	FILE* fp = NULL;
+	guint64 received = 0;
+	guint32 drops_dumped = 0;
+	gint64 isb_time = 0;
+	int count;
+	int i;
 
 	if (signal(SIGINT, exit_from_loop) == SIG_ERR) {
 		g_warning("Can't set signal handler");
@@ -307,17 +514,17 @@ static void run_listener(const char* fifo, const guint16 port, const char* proto
 		return;
 	}
 
-	if (setup_listener(port, &sock) == EXIT_FAILURE)
+	if (setup_listener(port, socket_buffer, &sock) == EXIT_FAILURE)
 		return;
 
 	g_debug("Listener running on port %u", port);
 
-	buf = (char*)g_malloc(PKT_BUF_SIZE);
+	batch = recv_batch_new();
+	/* The space we need is the standard header + variable lengths */
+	mbuf = (guint8*)g_malloc0(UDPDUMP_EXPORT_HEADER_LEN + ((strlen(proto_name) + 3) & 0xfffffffc) + PKT_BUF_SIZE);
 	while(run_loop == TRUE) {
-		memset(buf, 0x0, PKT_BUF_SIZE);
-
-		buflen = recvfrom(sock, buf, PKT_BUF_SIZE, 0, (struct sockaddr *)&clientaddr, &clientlen);
-		if (buflen < 0) {
+		count = receive_batch(sock, batch);
+		if (count < 0) {
 			switch(errno) {
 				case EAGAIN:
 				case EINTR:
@@ -335,20 +542,39 @@ static void run_listener(const char* fifo, const guint16 port, const char* proto
 						LocalFree(errmsg);
 					}
 #else
-					g_warning("Error in recvfrom: %s (errno=%d)", strerror(errno), errno);
+					g_warning("Error receiving datagrams: %s (errno=%d)", strerror(errno), errno);
 #endif
 					run_loop = FALSE;
 					break;
 			}
-		} else {
-			if (dump_packet(proto_name, port, buf, buflen, clientaddr, fp) == EXIT_FAILURE)
+			continue;
+		}
+
+		for (i = 0; i < count; i++) {
+			if (dump_packet(proto_name, port, batch->bufs + i * PKT_BUF_SIZE, batch->lens[i],
+					batch->addrs[i], batch->ts[i], mbuf, fp) == EXIT_FAILURE) {
+				run_loop = FALSE;
+				break;
+			}
+			received++;
+		}
+		fflush(fp);
+
+		/* Report new drops, but not too often */
+		if (run_loop && batch->drops != drops_dumped &&
+				g_get_monotonic_time() - isb_time >= UDPDUMP_ISB_INTERVAL) {
+			if (dump_statistics(received, batch->drops, fp) == EXIT_FAILURE)
 				run_loop = FALSE;
+			drops_dumped = batch->drops;
+			isb_time = g_get_monotonic_time();
 		}
 	}
+	dump_statistics(received, batch->drops, fp);
 
 	fclose(fp);
 	closesocket(sock);
-	g_free(buf);
+	recv_batch_free(batch);
+	g_free(mbuf);
 }
 
 int main(int argc, char *argv[])
@@ -363,6 +589,7 @@ int main(int argc, char *argv[])
 	char* help_header = NULL;
 	char* payload = NULL;
 	char* port_msg = NULL;
+	guint32 socket_buffer = 0;
 
 	/*
 	 * Get credential information for later use.
@@ -399,6 +626,7 @@ int main(int argc, char *argv[])
 	port_msg = g_strdup_printf("the port to listens on. Default: %u", UDPDUMP_DEFAULT_PORT);
 	extcap_help_add_option(extcap_conf, "--port <port>", port_msg);
 	g_free(port_msg);
+	extcap_help_add_option(extcap_conf, "--socket-buffer <bytes>", "the socket receive buffer size. Default: the system's");
 
 	opterr = 0;
 	optind = 0;
@@ -432,6 +660,13 @@ int main(int argc, char *argv[])
 			payload = g_strdup(optarg);
 			break;
 
+		case OPT_SOCKET_BUFFER:
+			if (!ws_strtou32(optarg, NULL, &socket_buffer)) {
+				g_warning("Invalid socket buffer size: %s", optarg);
+				goto end;
+			}
+			break;
+
 		case ':':
 			/* missing option argument */
 			g_warning("Option '%s' requires an argument", argv[optind - 1]);
@@ -477,7 +712,7 @@ int main(int argc, char *argv[])
 		port = UDPDUMP_DEFAULT_PORT;
 
 	if (extcap_conf->capture)
-		run_listener(extcap_conf->fifo, port, payload);
+		run_listener(extcap_conf->fifo, port, payload, socket_buffer);
 
 end:
 	/* clean up stuff */
@@ -47,6 +47,7 @@
 #include "cfile.h"
 #include "file.h"
 #include "fileset.h"
+#include "file_prefetch.h"
 #include "frame_tvbuff.h"
 
 #include "ui/alert_box.h"
@@ -235,8 +236,12 @@ ws_epan_new(capture_file *cf)
     cap_file_provider_get_interface_description,
     cap_file_provider_get_user_comment
   };
+  epan_t *session = epan_new(&cf->provider, &funcs);
 
-  return epan_new(&cf->provider, &funcs);
+  /* Note every protocol whose dissector is called, including heuristic
+     dissectors that reject the frames they're tried on. */
+  epan_note_called_protocols(session);
+  return session;
 }
 
 cf_status_t
@@ -244,6 +249,7 @@ cf_open(capture_file *cf, const char *fname, unsigned int type, gboolean is_temp
 {
   wtap  *wth;
   gchar *err_info;
+  GArray *applied_protocols;
 
   wth = wtap_open_offline(fname, type, err, &err_info, TRUE);
   if (wth == NULL)
@@ -301,10 +307,20 @@ cf_open(capture_file *cf, const char *fname, unsigned int type, gboolean is_temp
   cf->provider.prev_cap = NULL;
   cf->cum_bytes = 0;
 
+  /* Note what the first pass is done with (see ws_epan_new()), so that
+     preference changes it isn't affected by don't need a redissection. */
+  applied_protocols = prefs_take_applied_protocols();
+  if (applied_protocols != NULL)
+    g_array_free(applied_protocols, TRUE);
+
   /* Create new epan session for dissection.
    * (The old one was freed in cf_close().)
    */
   cf->epan = ws_epan_new(cf);
+  cf->routing_hash = dissector_routing_hash();
+
+  /* Index the configured fields, if any, as the file is read. */
+  cf->dfindex = dfilter_index_new(prefs.gui_filter_index_fields, NULL);
 
   packet_list_queue_draw();
   cf_callback_invoke(cf_cb_file_opened, cf);
@@ -384,6 +400,8 @@ cf_close(capture_file *cf)
 
   dfilter_free(cf->rfcode);
   cf->rfcode = NULL;
+  dfilter_index_free(cf->dfindex);
+  cf->dfindex = NULL;
   if (cf->provider.frames != NULL) {
     free_frame_data_sequence(cf->provider.frames);
     cf->provider.frames = NULL;
@@ -530,11 +548,14 @@ cf_read(capture_file *cf, gboolean reloading)
    *    one of the tap listeners requires a protocol tree;
    *
    *    a postdissector wants field values or protocols on
-   *    the first pass.
+   *    the first pass;
+   *
+   *    we're building a field value index.
    */
   create_proto_tree =
     (dfcode != NULL || have_filtering_tap_listeners() ||
-     (tap_flags & TL_REQUIRES_PROTO_TREE) || postdissectors_want_hfids());
+     (tap_flags & TL_REQUIRES_PROTO_TREE) || postdissectors_want_hfids() ||
+     cf->dfindex != NULL);
 
   reset_tap_listeners();
 
@@ -774,11 +795,14 @@ cf_continue_tail(capture_file *cf, volatile int to_read, wtap_rec *rec,
    *    one of the tap listeners requires a protocol tree;
    *
    *    a postdissector wants field values or protocols on
-   *    the first pass.
+   *    the first pass;
+   *
+   *    we're building a field value index.
    */
   create_proto_tree =
     (dfcode != NULL || have_filtering_tap_listeners() ||
-     (tap_flags & TL_REQUIRES_PROTO_TREE) || postdissectors_want_hfids());
+     (tap_flags & TL_REQUIRES_PROTO_TREE) || postdissectors_want_hfids() ||
+     cf->dfindex != NULL);
 
   *err = 0;
 
@@ -918,11 +942,14 @@ cf_finish_tail(capture_file *cf, wtap_rec *rec, Buffer *buf, int *err)
    *    one of the tap listeners requires a protocol tree;
    *
    *    a postdissector wants field values or protocols on
-   *    the first pass.
+   *    the first pass;
+   *
+   *    we're building a field value index.
    */
   create_proto_tree =
     (dfcode != NULL || have_filtering_tap_listeners() ||
-     (tap_flags & TL_REQUIRES_PROTO_TREE) || postdissectors_want_hfids());
+     (tap_flags & TL_REQUIRES_PROTO_TREE) || postdissectors_want_hfids() ||
+     cf->dfindex != NULL);
 
   if (cf->provider.wth == NULL) {
     cf_close(cf);
@@ -1141,11 +1168,34 @@ void cf_set_rfcode(capture_file *cf, dfilter_t *rfcode)
   cf->rfcode = rfcode;
 }
 
+/* Update the counts and the first, last and previous displayed frames
+   for a frame whose "passed_dfilter" flag has been set. */
+static void
+update_displayed_state(capture_file *cf, frame_data *fdata)
+{
+  if (fdata->passed_dfilter || fdata->ref_time)
+  {
+    cf->displayed_count++;
+
+    frame_data_set_after_dissect(fdata, &cf->cum_bytes);
+    cf->provider.prev_dis = fdata;
+
+    /* If we haven't yet seen the first frame, this is it. */
+    if (cf->first_displayed == 0)
+      cf->first_displayed = fdata->num;
+
+    /* This is the last frame we've seen so far. */
+    cf->last_displayed = fdata->num;
+  }
+}
+
 static void
 add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
     epan_dissect_t *edt, dfilter_t *dfcode, column_info *cinfo,
     wtap_rec *rec, Buffer *buf, gboolean add_to_packet_list)
 {
+  gboolean first_pass;
+
   frame_data_set_before_dissect(fdata, &cf->elapsed_time,
                                 &cf->provider.ref, cf->provider.prev_dis);
   cf->provider.prev_cap = fdata;
@@ -1163,10 +1213,14 @@ add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
   }
 #endif
 
-  if (!fdata->visited) {
+  first_pass = !fdata->visited;
+  if (first_pass) {
     /* This is the first pass, so prime the epan_dissect_t with the
-       hfids postdissectors want on the first pass. */
+       hfids postdissectors want on the first pass, and with the
+       fields we index. */
     prime_epan_dissect_with_postdissector_wanted_hfids(edt);
+    if (cf->dfindex != NULL)
+      dfilter_index_prime_edt(cf->dfindex, edt);
   }
 
   /* Dissect the frame. */
@@ -1174,6 +1228,9 @@ add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
                              frame_tvbuff_new_buffer(&cf->provider, fdata, buf),
                              fdata, cinfo);
 
+  if (first_pass && cf->dfindex != NULL)
+    dfilter_index_add_frame(cf->dfindex, edt, fdata->num);
+
   /* If we don't have a display filter, set "passed_dfilter" to 1. */
   if (dfcode != NULL) {
     fdata->passed_dfilter = dfilter_apply_edt(dfcode, edt) ? 1 : 0;
@@ -1188,28 +1245,30 @@ add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
   } else
     fdata->passed_dfilter = 1;
 
-  if (fdata->passed_dfilter || fdata->ref_time)
-    cf->displayed_count++;
+  update_displayed_state(cf, fdata);
 
   if (add_to_packet_list) {
     /* We fill the needed columns from new_packet_list */
     packet_list_append(cinfo, fdata);
   }
 
-  if (fdata->passed_dfilter || fdata->ref_time)
-  {
-    frame_data_set_after_dissect(fdata, &cf->cum_bytes);
-    cf->provider.prev_dis = fdata;
+  epan_dissect_reset(edt);
+}
 
-    /* If we haven't yet seen the first frame, this is it. */
-    if (cf->first_displayed == 0)
-      cf->first_displayed = fdata->num;
+/*
+ * Account for a frame that the field value index says doesn't pass the
+ * display filter, without reading or dissecting it.
+ */
+static void
+skip_packet_in_packet_list(frame_data *fdata, capture_file *cf)
+{
+  frame_data_set_before_dissect(fdata, &cf->elapsed_time,
+                                &cf->provider.ref, cf->provider.prev_dis);
+  cf->provider.prev_cap = fdata;
 
-    /* This is the last frame we've seen so far. */
-    cf->last_displayed = fdata->num;
-  }
+  fdata->passed_dfilter = 0;
 
-  epan_dissect_reset(edt);
+  update_displayed_state(cf, fdata);
 }
 
 /*
@@ -1529,9 +1588,48 @@ cf_reftime_packets(capture_file *cf)
   ref_time_packets(cf);
 }
 
+/*
+ * Whether what changed can change the dissection of any frame of a file
+ * that has been read completely.
+ *
+ * It can't if all that changed are the preferences of protocols whose
+ * dissectors were provably never called, not even to reject a frame, and
+ * the dissectors packets are handed to are the same as on the first pass.
+ * Redissection throws away the state of all protocols, so it can't be
+ * limited to the frames of affected protocols; it's either skipped or
+ * done for all frames.
+ */
+static gboolean
+redissection_needed(capture_file *cf, GArray *applied_protocols)
+{
+  guint i;
+
+  /* Something other than protocol preferences, or nothing we know of */
+  if (applied_protocols == NULL)
+    return TRUE;
+
+  if (cf->state != FILE_READ_DONE || cf->epan == NULL)
+    return TRUE;
+
+  if (dissector_routing_hash() != cf->routing_hash)
+    return TRUE;
+
+  for (i = 0; i < applied_protocols->len; i++) {
+    int proto_id = g_array_index(applied_protocols, int, i);
+
+    /* Including the ones other dissectors may call directly */
+    if (epan_protocol_may_have_been_called(cf->epan, proto_id))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
 void
 cf_redissect_packets(capture_file *cf)
 {
+  GArray *applied_protocols = prefs_take_applied_protocols();
+
   if (cf->read_lock || cf->redissection_queued == RESCAN_SCAN) {
     /* Dissection in progress, signal redissection rather than rescanning. That
      * would destroy the current (in-progress) dissection in "cf_read" which
@@ -1540,15 +1638,16 @@ cf_redissect_packets(capture_file *cf)
      */
     cf->redissection_queued = RESCAN_REDISSECT;
   }
+
   if (cf->redissection_queued != RESCAN_NONE) {
     /* Redissection is (already) queued, wait for "cf_read" to finish. */
-    return;
-  }
-
-  if (cf->state != FILE_CLOSED) {
+  } else if (cf->state != FILE_CLOSED && redissection_needed(cf, applied_protocols)) {
     /* Restart dissection in case no cf_read is pending. */
     rescan_packets(cf, "Reprocessing", "all packets", TRUE);
   }
+
+  if (applied_protocols != NULL)
+    g_array_free(applied_protocols, TRUE);
 }
 
 gboolean
@@ -1609,6 +1708,10 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   gboolean    compiled;
   guint32     frames_count;
   gboolean    queued_rescan_type = RESCAN_NONE;
+  file_prefetch_t *prefetch = NULL;
+  guint8     *index_matches = NULL;
+  wtap_rec   *recp;
+  Buffer     *bufp;
 
   /* Rescan in progress, clear pending actions. */
   cf->redissection_queued = RESCAN_NONE;
@@ -1684,6 +1787,19 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     cf->epan = ws_epan_new(cf);
     cf->cinfo.epan = cf->epan;
 
+    /* The indexed field values may change along with the state, so
+       rebuild the field value index as we go. */
+    if (cf->dfindex != NULL || prefs.gui_filter_index_fields[0] != '\0') {
+      dfilter_index_free(cf->dfindex);
+      cf->dfindex = dfilter_index_new(prefs.gui_filter_index_fields, NULL);
+      if (cf->dfindex != NULL)
+        create_proto_tree = TRUE;
+    }
+
+    /* Start over noting what the first pass is done with; the new
+       session notes the protocols called. */
+    cf->routing_hash = dissector_routing_hash();
+
     /* A new Lua tap listener may be registered in lua_prime_all_fields()
        called via epan_new() / init_dissection() when reloading Lua plugins. */
     if (!create_proto_tree && have_filtering_tap_listeners()) {
@@ -1749,6 +1865,18 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     wtap_set_cb_new_secrets(cf->provider.wth, secrets_wtap_callback);
   }
 
+  /* If we're only applying a display filter, and no tap listener needs
+     to see every packet, let the field value index rule out the packets
+     that can't pass the filter, so we don't read or dissect them. */
+  if (!redissect && dfcode != NULL && !tap_listeners_require_dissection())
+    index_matches = dfilter_index_apply(dfcode, cf->dfindex, frames_count);
+
+  /* If the file has been read completely, its frames won't change under
+     us, so we can have worker threads read the records ahead of us while
+     we dissect. */
+  if (cf->state == FILE_READ_DONE && index_matches == NULL)
+    prefetch = file_prefetch_start(cf, frames_count, prefs.gui_rescan_threads);
+
   for (framenum = 1; framenum <= frames_count; framenum++) {
     fdata = frame_data_sequence_find(cf->provider.frames, framenum);
 
@@ -1821,9 +1949,6 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     /* Frame dependencies from the previous dissection/filtering are no longer valid. */
     fdata->dependent_of_displayed = 0;
 
-    if (!cf_read_record(cf, fdata, &rec, &buf))
-      break; /* error reading the frame */
-
     /* If the previous frame is displayed, and we haven't yet seen the
        selected frame, remember that frame - it's the closest one we've
        yet seen before the selected frame. */
@@ -1832,9 +1957,28 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
       preceding_frame = prev_frame;
     }
 
-    add_packet_to_packet_list(fdata, cf, &edt, dfcode,
-                                    cinfo, &rec, &buf,
-                                    add_to_packet_list);
+    if (index_matches != NULL &&
+        !DFILTER_INDEX_FRAME_MATCHES(index_matches, framenum)) {
+      /* The field value index says this frame can't pass the filter,
+         so there's no need to read or dissect it. */
+      skip_packet_in_packet_list(fdata, cf);
+    } else {
+      if (prefetch == NULL ||
+          !file_prefetch_get(prefetch, framenum, &recp, &bufp)) {
+        /* Not prefetched, or the worker couldn't read it; read it here, so
+           that any error is reported. */
+        recp = &rec;
+        bufp = &buf;
+        if (!cf_read_record(cf, fdata, recp, bufp))
+          break; /* error reading the frame */
+      }
+
+      add_packet_to_packet_list(fdata, cf, &edt, dfcode,
+                                      cinfo, recp, bufp,
+                                      add_to_packet_list);
+      if (prefetch != NULL)
+        file_prefetch_release(prefetch, framenum);
+    }
 
     /* If this frame is displayed, and this is the first frame we've
        seen displayed after the selected frame, remember this frame -
@@ -1856,6 +2000,9 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     prev_frame = fdata;
   }
 
+  if (prefetch != NULL)
+    file_prefetch_free(prefetch);
+  g_free(index_matches);
   epan_dissect_cleanup(&edt);
   wtap_rec_cleanup(&rec);
   ws_buffer_free(&buf);
@@ -2191,6 +2338,7 @@ process_specified_records(capture_file *cf, packet_range_t *range,
 typedef struct {
   epan_dissect_t edt;
   column_info *cinfo;
+  guint8 *frames;     /* Frames to dissect, or NULL for all of them */
 } retap_callback_args_t;
 
 static gboolean
@@ -2199,6 +2347,11 @@ retap_packet(capture_file *cf, frame_data *fdata, wtap_rec *rec, Buffer *buf,
 {
   retap_callback_args_t *args = (retap_callback_args_t *)argsp;
 
+  if (args->frames != NULL && !DFILTER_INDEX_FRAME_MATCHES(args->frames, fdata->num)) {
+    /* None of the tap listeners that are being retapped wants this one. */
+    return TRUE;
+  }
+
   epan_dissect_run_with_taps(&args->edt, cf->cd_t, rec,
                              frame_tvbuff_new_buffer(&cf->provider, fdata, buf),
                              fdata, args->cinfo);
@@ -2207,6 +2360,44 @@ retap_packet(capture_file *cf, frame_data *fdata, wtap_rec *rec, Buffer *buf,
   return TRUE;
 }
 
+/*
+ * Work out which frames can pass a tap listener's filter without
+ * dissecting them, for get_retap_frames().
+ */
+static guint8 *
+retap_frames_for_dfilter(const char *fstring, dfilter_t *code, void *data)
+{
+  capture_file *cf = (capture_file *)data;
+  guint8       *frames;
+  guint32       framenum;
+  frame_data   *fdata;
+
+  /* A listener limited to the display filter wants the displayed frames. */
+  if (fstring != NULL && cf->dfilter != NULL && strcmp(fstring, cf->dfilter) == 0) {
+    frames = (guint8 *)g_malloc0(DFILTER_INDEX_BITMAP_LEN(cf->count));
+    for (framenum = 1; framenum <= cf->count; framenum++) {
+      fdata = frame_data_sequence_find(cf->provider.frames, framenum);
+      if (fdata->passed_dfilter)
+        frames[framenum >> 3] |= 1 << (framenum & 7);
+    }
+    return frames;
+  }
+
+  return dfilter_index_apply(code, cf->dfindex, cf->count);
+}
+
+static gboolean
+retap_frames_empty(const guint8 *frames, guint32 count)
+{
+  guint32 i;
+
+  for (i = 0; i < DFILTER_INDEX_BITMAP_LEN(count); i++) {
+    if (frames[i] != 0)
+      return FALSE;
+  }
+  return TRUE;
+}
+
 cf_read_status_t
 cf_retap_packets(capture_file *cf)
 {
@@ -2240,8 +2431,13 @@ cf_retap_packets(capture_file *cf)
   create_proto_tree =
     (have_filtering_tap_listeners() || (tap_flags & TL_REQUIRES_PROTO_TREE));
 
-  /* Reset the tap listeners. */
-  reset_tap_listeners();
+  /* Reset the tap listeners; additive ones that have already seen every
+     packet are left alone. */
+  reset_tap_listeners_for_retap();
+
+  /* If the remaining listeners only want packets passing filters whose
+     results we already know, only dissect those. */
+  callback_args.frames = get_retap_frames(cf->count, retap_frames_for_dfilter, cf);
 
   epan_dissect_init(&callback_args.edt, cf->epan, create_proto_tree, FALSE);
 
@@ -2250,12 +2446,21 @@ cf_retap_packets(capture_file *cf)
   packet_range_init(&range, cf);
   packet_range_process_init(&range);
 
-  ret = process_specified_records(cf, &range, "Recalculating statistics on",
-                                  "all packets", TRUE, retap_packet,
-                                  &callback_args, TRUE);
+  if (callback_args.frames != NULL &&
+      retap_frames_empty(callback_args.frames, cf->count)) {
+    /* Every tap listener is up to date; there's nothing to read. */
+    ret = PSP_FINISHED;
+  } else {
+    ret = process_specified_records(cf, &range, "Recalculating statistics on",
+                                    "all packets", TRUE, retap_packet,
+                                    &callback_args, TRUE);
+  }
 
   packet_range_cleanup(&range);
   epan_dissect_cleanup(&callback_args.edt);
+  g_free(callback_args.frames);
+
+  tap_listeners_retap_finished(ret == PSP_FINISHED);
 
   cf_callback_invoke(cf_cb_file_retap_finished, cf);
 
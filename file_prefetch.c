@@ -0,0 +1,253 @@
+/* file_prefetch.c
+ * Read records of a capture file ahead of a sequential pass, using
+ * worker threads
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <glib.h>
+
+#include <epan/frame_data_sequence.h>
+
+#include "file_prefetch.h"
+
+/* Number of records each worker may read ahead of the consumer. */
+#define PREFETCH_SLOTS_PER_THREAD 32
+
+/* Upper bound on the number of reader threads. */
+#define PREFETCH_MAX_THREADS 16
+
+typedef enum {
+  SLOT_EMPTY,       /* Free, or claimed by a worker that is reading into it */
+  SLOT_READ,        /* Holds the record for its frame */
+  SLOT_FAILED       /* The worker couldn't read the record */
+} prefetch_slot_state;
+
+typedef struct {
+  prefetch_slot_state state;
+  wtap_rec            rec;
+  Buffer              buf;
+} prefetch_slot_t;
+
+typedef struct {
+  file_prefetch_t *fp;
+  wtap            *wth;             /* This worker's own wiretap handle */
+  GThread         *thread;
+} prefetch_worker_t;
+
+struct _file_prefetch {
+  frame_data_sequence *frames;
+  guint32              frames_count;
+  guint                n_slots;
+  prefetch_slot_t     *slots;
+  guint                n_workers;
+  prefetch_worker_t   *workers;
+
+  /* Everything below is protected by mutex. */
+  GMutex               mutex;
+  GCond                cond;
+  guint32              next_to_read;      /* Next frame a worker will claim */
+  guint32              next_to_consume;   /* Next frame the consumer will get */
+  gboolean             stop;
+};
+
+static inline prefetch_slot_t *
+prefetch_slot(file_prefetch_t *fp, guint32 framenum)
+{
+  return &fp->slots[(framenum - 1) % fp->n_slots];
+}
+
+static gpointer
+file_prefetch_worker(gpointer data)
+{
+  prefetch_worker_t *worker = (prefetch_worker_t *)data;
+  file_prefetch_t   *fp = worker->fp;
+  prefetch_slot_t   *slot;
+  frame_data        *fdata;
+  guint32            framenum;
+  gboolean           ok;
+  int                err;
+  gchar             *err_info;
+
+  g_mutex_lock(&fp->mutex);
+  for (;;) {
+    /* Don't get more than one window ahead of the consumer. */
+    while (!fp->stop && fp->next_to_read <= fp->frames_count &&
+           fp->next_to_read >= fp->next_to_consume + fp->n_slots)
+      g_cond_wait(&fp->cond, &fp->mutex);
+
+    if (fp->stop || fp->next_to_read > fp->frames_count)
+      break;
+
+    framenum = fp->next_to_read++;
+    slot = prefetch_slot(fp, framenum);
+    g_mutex_unlock(&fp->mutex);
+
+    /*
+     * The slot's previous frame has been released, and nobody else
+     * touches the slot until we mark it as read.  The frame sequence
+     * doesn't change while we're running, so looking up frames without
+     * holding the lock is safe.
+     */
+    fdata = frame_data_sequence_find(fp->frames, framenum);
+    err_info = NULL;
+    ok = wtap_seek_read(worker->wth, fdata->file_off, &slot->rec, &slot->buf,
+                        &err, &err_info);
+    /*
+     * Don't report the error here; the consumer will read the record
+     * again with the capture file's own handle, and report any error
+     * it gets.
+     */
+    g_free(err_info);
+
+    g_mutex_lock(&fp->mutex);
+    slot->state = ok ? SLOT_READ : SLOT_FAILED;
+    g_cond_broadcast(&fp->cond);
+  }
+  g_mutex_unlock(&fp->mutex);
+
+  return NULL;
+}
+
+file_prefetch_t *
+file_prefetch_start(capture_file *cf, guint32 frames_count, guint n_threads)
+{
+  file_prefetch_t *fp;
+  guint            i;
+  int              err;
+  gchar           *err_info;
+
+  if (n_threads < 2 || frames_count == 0 || cf->filename == NULL)
+    return NULL;
+  if (n_threads > PREFETCH_MAX_THREADS)
+    n_threads = PREFETCH_MAX_THREADS;
+
+  fp = g_new0(file_prefetch_t, 1);
+  fp->frames = cf->provider.frames;
+  fp->frames_count = frames_count;
+  fp->workers = g_new0(prefetch_worker_t, n_threads);
+
+  /*
+   * Open the workers' handles up front, so that if the file can't be
+   * reopened (it's been removed, say) the caller can just fall back to
+   * reading it itself.
+   */
+  for (i = 0; i < n_threads; i++) {
+    err_info = NULL;
+    fp->workers[i].wth = wtap_open_offline(cf->filename, cf->open_type,
+                                           &err, &err_info, TRUE);
+    if (fp->workers[i].wth == NULL) {
+      g_free(err_info);
+      break;
+    }
+    fp->workers[i].fp = fp;
+  }
+  fp->n_workers = i;
+  if (fp->n_workers < 2) {
+    file_prefetch_free(fp);
+    return NULL;
+  }
+
+  fp->n_slots = fp->n_workers * PREFETCH_SLOTS_PER_THREAD;
+  fp->slots = g_new0(prefetch_slot_t, fp->n_slots);
+  for (i = 0; i < fp->n_slots; i++) {
+    fp->slots[i].state = SLOT_EMPTY;
+    wtap_rec_init(&fp->slots[i].rec);
+    ws_buffer_init(&fp->slots[i].buf, 1514);
+  }
+
+  g_mutex_init(&fp->mutex);
+  g_cond_init(&fp->cond);
+  fp->next_to_read = 1;
+  fp->next_to_consume = 1;
+  fp->stop = FALSE;
+
+  for (i = 0; i < fp->n_workers; i++) {
+    fp->workers[i].thread = g_thread_new("Record prefetch",
+                                         file_prefetch_worker,
+                                         &fp->workers[i]);
+  }
+
+  return fp;
+}
+
+gboolean
+file_prefetch_get(file_prefetch_t *fp, guint32 framenum,
+                  wtap_rec **rec, Buffer **buf)
+{
+  prefetch_slot_t *slot = prefetch_slot(fp, framenum);
+  gboolean         ok;
+
+  g_mutex_lock(&fp->mutex);
+  g_assert(framenum == fp->next_to_consume && framenum <= fp->frames_count);
+  while (slot->state == SLOT_EMPTY)
+    g_cond_wait(&fp->cond, &fp->mutex);
+  ok = (slot->state == SLOT_READ);
+  g_mutex_unlock(&fp->mutex);
+
+  if (ok) {
+    *rec = &slot->rec;
+    *buf = &slot->buf;
+  }
+  return ok;
+}
+
+void
+file_prefetch_release(file_prefetch_t *fp, guint32 framenum)
+{
+  g_mutex_lock(&fp->mutex);
+  g_assert(framenum == fp->next_to_consume);
+  prefetch_slot(fp, framenum)->state = SLOT_EMPTY;
+  fp->next_to_consume = framenum + 1;
+  g_cond_broadcast(&fp->cond);
+  g_mutex_unlock(&fp->mutex);
+}
+
+void
+file_prefetch_free(file_prefetch_t *fp)
+{
+  guint i;
+
+  if (fp->slots != NULL) {
+    /* The workers were started; stop them. */
+    g_mutex_lock(&fp->mutex);
+    fp->stop = TRUE;
+    g_cond_broadcast(&fp->cond);
+    g_mutex_unlock(&fp->mutex);
+
+    for (i = 0; i < fp->n_workers; i++)
+      g_thread_join(fp->workers[i].thread);
+
+    for (i = 0; i < fp->n_slots; i++) {
+      wtap_rec_cleanup(&fp->slots[i].rec);
+      ws_buffer_free(&fp->slots[i].buf);
+    }
+    g_free(fp->slots);
+    g_cond_clear(&fp->cond);
+    g_mutex_clear(&fp->mutex);
+  }
+
+  for (i = 0; i < fp->n_workers; i++)
+    wtap_close(fp->workers[i].wth);
+  g_free(fp->workers);
+  g_free(fp);
+}
+
+/*
+ * Editor modelines
+ *
+ * Local Variables:
+ * c-basic-offset: 2
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * ex: set shiftwidth=2 tabstop=8 expandtab:
+ * :indentSize=2:tabSize=8:noTabs=true:
+ */
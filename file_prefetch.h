@@ -0,0 +1,90 @@
+/* file_prefetch.h
+ * Read records of a capture file ahead of a sequential pass, using
+ * worker threads
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __FILE_PREFETCH_H__
+#define __FILE_PREFETCH_H__
+
+#include "cfile.h"
+
+#include <wiretap/wtap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Dissection isn't reentrant (packet scope, the protocol tree and most
+ * dissectors keep global state), so a pass over the frames of a file
+ * must still dissect them one at a time, in order, on one thread.
+ * What can be done elsewhere is reading the records: every worker
+ * thread opens its own wiretap handle on the file and reads frames
+ * into a window of slots ahead of the frame currently being dissected,
+ * so seeking, decompression and copying overlap with dissection.
+ *
+ * The frame sequence must not change while a prefetcher is running,
+ * i.e. it should only be used on a file that has been read completely.
+ */
+typedef struct _file_prefetch file_prefetch_t;
+
+/**
+ * Start prefetching frames 1 through frames_count of a capture file.
+ *
+ * @param cf The capture file; its frame sequence is read by the workers.
+ * @param frames_count The number of frames that will be consumed.
+ * @param n_threads The number of reader threads.
+ * @return The prefetcher, or NULL if it couldn't be started (fewer than
+ *         two threads requested, or the file couldn't be reopened), in
+ *         which case records should be read with cf_read_record().
+ */
+extern file_prefetch_t *file_prefetch_start(capture_file *cf,
+    guint32 frames_count, guint n_threads);
+
+/**
+ * Get the record for a frame.  Frames must be requested in increasing
+ * order, and the previous frame must have been released first.  Blocks
+ * until a worker has read the frame.
+ *
+ * @return TRUE and sets *rec and *buf if the frame was read, FALSE if a
+ *         worker couldn't read it (the caller should then read it itself).
+ */
+extern gboolean file_prefetch_get(file_prefetch_t *fp, guint32 framenum,
+    wtap_rec **rec, Buffer **buf);
+
+/**
+ * Release the record for a frame returned by file_prefetch_get(), making
+ * its slot available to the workers again.
+ */
+extern void file_prefetch_release(file_prefetch_t *fp, guint32 framenum);
+
+/**
+ * Stop the workers, wait for them to finish and free the prefetcher.
+ * May be called before all frames have been consumed.
+ */
+extern void file_prefetch_free(file_prefetch_t *fp);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __FILE_PREFETCH_H__ */
+
+/*
+ * Editor modelines
+ *
+ * Local Variables:
+ * c-basic-offset: 2
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * ex: set shiftwidth=2 tabstop=8 expandtab:
+ * :indentSize=2:tabSize=8:noTabs=true:
+ */
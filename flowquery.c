@@ -0,0 +1,365 @@
+/* flowquery.c
+ * Finds flows in the flow indexes dumpcap writes next to ring buffer files
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <locale.h>
+#include <errno.h>
+
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#include <glib.h>
+
+#include <ui/cmdarg_err.h>
+#include <ui/clopts_common.h>
+#include <wsutil/filesystem.h>
+#include <wsutil/privileges.h>
+#include <wsutil/inet_addr.h>
+#include <wsutil/strtoi.h>
+#include <cli_main.h>
+#include <version_info.h>
+
+#ifndef HAVE_GETOPT_LONG
+#include "wsutil/wsgetopt.h"
+#endif
+
+#include "writecap/flow_index.h"
+
+#define COMPRESSED_SUFFIX ".gz"
+
+/* The most -a and -p options; a flow has only two endpoints */
+#define MAX_ENDPOINT_FILTERS 2
+
+typedef struct {
+  guint8 ip_version;
+  guint8 addr[16];
+} addr_filter;
+
+static addr_filter addr_filters[MAX_ENDPOINT_FILTERS];
+static guint num_addr_filters;
+static guint16 port_filters[MAX_ENDPOINT_FILTERS];
+static guint num_port_filters;
+static int proto_filter = -1;
+
+static void
+print_usage(FILE *output)
+{
+  fprintf(output, "\n");
+  fprintf(output, "Usage: flowquery [options] <file> ...\n");
+  fprintf(output, "\n");
+  fprintf(output, "<file> is a capture file written by dumpcap with \"-b index:1\", or its index.\n");
+  fprintf(output, "\n");
+  fprintf(output, "Options:\n");
+  fprintf(output, "  -a <address>             only flows with this IPv4 or IPv6 address; give it\n");
+  fprintf(output, "                           twice for flows between two addresses\n");
+  fprintf(output, "  -p <port>                only flows with this TCP, UDP or SCTP port; give it\n");
+  fprintf(output, "                           twice for flows between two ports\n");
+  fprintf(output, "  -P <protocol>            only flows of this protocol: tcp, udp, sctp, icmp,\n");
+  fprintf(output, "                           icmpv6, or an IP protocol number\n");
+  fprintf(output, "  -h                       display this help and exit\n");
+  fprintf(output, "  -v                       display version info and exit\n");
+}
+
+/*
+ * General errors and warnings are reported with an console message
+ * in flowquery.
+ */
+static void
+failure_warning_message(const char *msg_format, va_list ap)
+{
+  fprintf(stderr, "flowquery: ");
+  vfprintf(stderr, msg_format, ap);
+  fprintf(stderr, "\n");
+}
+
+/*
+ * Report additional information for an error in command-line arguments.
+ */
+static void
+failure_message_cont(const char *msg_format, va_list ap)
+{
+  vfprintf(stderr, msg_format, ap);
+  fprintf(stderr, "\n");
+}
+
+static gboolean
+parse_proto(const char *str, int *proto)
+{
+  static const struct {
+    const char *name;
+    int         proto;
+  } protos[] = {
+    { "icmp",   1 },
+    { "tcp",    6 },
+    { "udp",    17 },
+    { "icmpv6", 58 },
+    { "sctp",   132 },
+  };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(protos); i++) {
+    if (g_ascii_strcasecmp(str, protos[i].name) == 0) {
+      *proto = protos[i].proto;
+      return TRUE;
+    }
+  }
+  *proto = get_natural_int(str, "protocol");
+  return *proto <= 255;
+}
+
+static gboolean
+flow_has_addr(const flow_index_entry *flow, const addr_filter *filter)
+{
+  gsize len = filter->ip_version == 4 ? 4 : 16;
+
+  return flow->ip_version == filter->ip_version &&
+         (memcmp(flow->addr_a, filter->addr, len) == 0 ||
+          memcmp(flow->addr_b, filter->addr, len) == 0);
+}
+
+static gboolean
+flow_matches(const flow_index_entry *flow)
+{
+  guint i;
+
+  if (proto_filter != -1 && flow->proto != proto_filter)
+    return FALSE;
+  for (i = 0; i < num_addr_filters; i++) {
+    if (!flow_has_addr(flow, &addr_filters[i]))
+      return FALSE;
+  }
+  for (i = 0; i < num_port_filters; i++) {
+    if (flow->port_a != port_filters[i] && flow->port_b != port_filters[i])
+      return FALSE;
+  }
+  /* Two of the same address or port mean both endpoints */
+  if (num_addr_filters == 2 &&
+      memcmp(&addr_filters[0], &addr_filters[1], sizeof addr_filters[0]) == 0 &&
+      memcmp(flow->addr_a, flow->addr_b, sizeof flow->addr_a) != 0)
+    return FALSE;
+  if (num_port_filters == 2 && port_filters[0] == port_filters[1] &&
+      flow->port_a != flow->port_b)
+    return FALSE;
+  return TRUE;
+}
+
+/*
+ * Works out the names of the index and of the capture file, given either.
+ * The capture file may have been compressed since the index was written.
+ */
+static void
+get_file_names(const char *arg, gchar **index_name, gchar **capture_name)
+{
+  gchar *base;
+  gchar *compressed;
+
+  if (g_str_has_suffix(arg, FLOW_INDEX_SUFFIX)) {
+    base = g_strndup(arg, strlen(arg) - strlen(FLOW_INDEX_SUFFIX));
+  } else if (g_str_has_suffix(arg, COMPRESSED_SUFFIX)) {
+    base = g_strndup(arg, strlen(arg) - strlen(COMPRESSED_SUFFIX));
+  } else {
+    base = g_strdup(arg);
+  }
+  *index_name = g_strconcat(base, FLOW_INDEX_SUFFIX, NULL);
+
+  compressed = g_strconcat(base, COMPRESSED_SUFFIX, NULL);
+  if (!g_file_test(base, G_FILE_TEST_EXISTS) && g_file_test(compressed, G_FILE_TEST_EXISTS)) {
+    *capture_name = compressed;
+    g_free(base);
+  } else {
+    *capture_name = base;
+    g_free(compressed);
+  }
+}
+
+static void
+print_addr(const flow_index_entry *flow, const guint8 *addr)
+{
+  gchar buf[WS_INET6_ADDRSTRLEN];
+
+  if (flow->ip_version == 4)
+    fputs(ws_inet_ntop4(addr, buf, sizeof buf), stdout);
+  else
+    fputs(ws_inet_ntop6(addr, buf, sizeof buf), stdout);
+}
+
+static void
+print_flow(const char *capture_name, const flow_index_entry *flow)
+{
+  printf("%s\t%" G_GUINT64_FORMAT "\t%u\t", capture_name, flow->first_offset, flow->proto);
+  print_addr(flow, flow->addr_a);
+  printf("\t%u\t", flow->port_a);
+  print_addr(flow, flow->addr_b);
+  printf("\t%u", flow->port_b);
+  printf("\t%" G_GUINT64_FORMAT ".%09u\t%" G_GUINT64_FORMAT ".%09u",
+         flow->first_ts / 1000000000, (guint)(flow->first_ts % 1000000000),
+         flow->last_ts / 1000000000, (guint)(flow->last_ts % 1000000000));
+  printf("\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\n", flow->packets, flow->bytes);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char     *init_progfile_dir_error;
+  gchar    *index_name, *capture_name;
+  gchar    *contents;
+  gsize     len;
+  GError   *error = NULL;
+  GArray   *flows;
+  ws_in4_addr addr4;
+  ws_in6_addr addr6;
+  guint     i, j;
+  int       opt;
+  int       overall_error_status;
+  static const struct option long_options[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"version", no_argument, NULL, 'v'},
+      {0, 0, 0, 0 }
+  };
+
+  /* Set the C-language locale to the native environment. */
+  setlocale(LC_ALL, "");
+
+  cmdarg_err_init(failure_warning_message, failure_message_cont);
+
+  /* Initialize the version information. */
+  ws_init_version_info("Flowquery (Wireshark)", NULL, NULL, NULL);
+
+  /*
+   * Get credential information for later use.
+   */
+  init_process_policies();
+
+  /*
+   * Attempt to get the pathname of the directory containing the
+   * executable file.
+   */
+  init_progfile_dir_error = init_progfile_dir(argv[0]);
+  if (init_progfile_dir_error != NULL) {
+    fprintf(stderr,
+            "flowquery: Can't get pathname of directory containing the flowquery program: %s.\n",
+            init_progfile_dir_error);
+    g_free(init_progfile_dir_error);
+  }
+
+  /* Process the options */
+  while ((opt = getopt_long(argc, argv, "a:hp:P:v", long_options, NULL)) !=-1) {
+
+    switch (opt) {
+
+      case 'a':
+        if (num_addr_filters == MAX_ENDPOINT_FILTERS) {
+          cmdarg_err("At most %u addresses can be given.", MAX_ENDPOINT_FILTERS);
+          exit(1);
+        }
+        memset(&addr_filters[num_addr_filters], 0, sizeof addr_filters[0]);
+        if (ws_inet_pton4(optarg, &addr4)) {
+          addr_filters[num_addr_filters].ip_version = 4;
+          memcpy(addr_filters[num_addr_filters].addr, &addr4, 4);
+        } else if (ws_inet_pton6(optarg, &addr6)) {
+          addr_filters[num_addr_filters].ip_version = 6;
+          memcpy(addr_filters[num_addr_filters].addr, &addr6, 16);
+        } else {
+          cmdarg_err("\"%s\" isn't an IPv4 or IPv6 address.", optarg);
+          exit(1);
+        }
+        num_addr_filters++;
+        break;
+
+      case 'h':
+        show_help_header("Find flows in the flow indexes of capture files.");
+        print_usage(stdout);
+        exit(0);
+        break;
+
+      case 'p':
+        if (num_port_filters == MAX_ENDPOINT_FILTERS) {
+          cmdarg_err("At most %u ports can be given.", MAX_ENDPOINT_FILTERS);
+          exit(1);
+        }
+        if (!ws_strtou16(optarg, NULL, &port_filters[num_port_filters])) {
+          cmdarg_err("\"%s\" isn't a port.", optarg);
+          exit(1);
+        }
+        num_port_filters++;
+        break;
+
+      case 'P':
+        if (!parse_proto(optarg, &proto_filter)) {
+          cmdarg_err("\"%s\" isn't a protocol.", optarg);
+          exit(1);
+        }
+        break;
+
+      case 'v':
+        show_version();
+        exit(0);
+        break;
+
+      case '?':              /* Bad flag - print usage message */
+        print_usage(stderr);
+        exit(1);
+        break;
+    }
+  }
+
+  if (optind >= argc) {
+    print_usage(stderr);
+    return 1;
+  }
+
+  overall_error_status = 0;
+
+  for (i = optind; i < (guint)argc; i++) {
+    get_file_names(argv[i], &index_name, &capture_name);
+    if (!g_file_get_contents(index_name, &contents, &len, &error)) {
+      cmdarg_err("%s", error->message);
+      g_clear_error(&error);
+      overall_error_status = 2;
+    } else {
+      flows = flow_index_parse((const guint8 *)contents, len);
+      if (flows == NULL) {
+        cmdarg_err("\"%s\" isn't a flow index.", index_name);
+        overall_error_status = 2;
+      } else {
+        for (j = 0; j < flows->len; j++) {
+          if (flow_matches(&g_array_index(flows, flow_index_entry, j)))
+            print_flow(capture_name, &g_array_index(flows, flow_index_entry, j));
+        }
+        g_array_free(flows, TRUE);
+      }
+      g_free(contents);
+    }
+    g_free(index_name);
+    g_free(capture_name);
+  }
+
+  free_progdirs();
+  return overall_error_status;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 2
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=2 tabstop=8 expandtab:
+ * :indentSize=2:tabSize=8:noTabs=true:
+ */
@@ -41,15 +41,45 @@
 
 #include <glib.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "ringbuffer.h"
 #include <wsutil/file_util.h>
+#include "writecap/async_writer.h"
+#include "writecap/flow_index.h"
+
 
+/* What finished files are turned into, next to the file itself */
+#define RINGBUF_COMPRESSED_SUFFIX ".gz"
+#define RINGBUF_SUMMARY_SUFFIX    ".summary"
+
+/* What's been done with a finished file */
+#define RINGBUF_COMPRESSED        0x01  /**< only name.gz is left */
+#define RINGBUF_SUMMARIZED        0x02  /**< name.summary was written */
+#define RINGBUF_INDEXED           0x04  /**< name.flowidx was written */
+
+typedef struct _rb_job rb_job;
 
 /* Ringbuffer file structure */
 typedef struct _rb_file {
   gchar         *name;
+  rb_job        *job;                /**< Work the worker thread hasn't done yet, or NULL */
+  guint          done;               /**< RINGBUF_ flags for what's been done with the file */
 } rb_file;
 
+/* A finished file, handed to the worker thread */
+struct _rb_job {
+  gchar         *name;               /**< The file as it was written */
+  gboolean       compress;           /**< TRUE if the file is to be gzipped */
+  gchar         *summary;            /**< Contents of name.summary, or NULL */
+  flow_index_t  *flow_index;         /**< Contents of name.flowidx, or NULL */
+  guint64        closes;             /**< Files the writer thread must have closed first */
+  rb_file       *rfile;              /**< The file's slot, or NULL once that's reused */
+  gboolean       drop;               /**< TRUE if the ring wrapped around to the file */
+};
+
 /** Ringbuffer data structure */
 typedef struct _ringbuf_data {
   rb_file      *files;
@@ -63,10 +93,277 @@ typedef struct _ringbuf_data {
   FILE         *pdh;
   char         *io_buffer;              /**< The IO buffer used to write to the file */
   gboolean      group_read_access;   /**< TRUE if files need to be opened with group read access */
+  gboolean      compress;            /**< TRUE if finished files are to be gzipped */
+  gchar        *summary;             /**< Summary of the current file, or NULL */
+  flow_index_t *flow_index;          /**< Flow index of the current file, or NULL */
 } ringbuf_data;
 
 static ringbuf_data rb_data;
 
+/*
+ * The worker thread compresses and summarizes finished files, so that
+ * switching files doesn't wait for that.  rb_mutex protects the queue,
+ * the jobs, and the job and done members of the files that have jobs.
+ */
+static GMutex   rb_mutex;
+static GCond    rb_cond;
+static GThread *rb_worker;
+static GQueue   rb_jobs = G_QUEUE_INIT;
+static gboolean rb_worker_stopping;
+
+
+/*
+ * Removes a ringbuffer file, in whatever form it's in now, and its summary
+ */
+static void ringbuf_unlink_file(const gchar *name, guint done)
+{
+  gchar *path;
+
+  if (done & RINGBUF_COMPRESSED) {
+    path = g_strconcat(name, RINGBUF_COMPRESSED_SUFFIX, NULL);
+    ws_unlink(path);
+    g_free(path);
+  } else {
+    ws_unlink(name);
+  }
+  if (done & RINGBUF_SUMMARIZED) {
+    path = g_strconcat(name, RINGBUF_SUMMARY_SUFFIX, NULL);
+    ws_unlink(path);
+    g_free(path);
+  }
+  if (done & RINGBUF_INDEXED) {
+    path = g_strconcat(name, FLOW_INDEX_SUFFIX, NULL);
+    ws_unlink(path);
+    g_free(path);
+  }
+}
+
+#ifdef HAVE_ZLIB
+/*
+ * Writes a gzipped copy of a file to name.gz, through a temporary file so
+ * that name.gz is always complete.  Returns 0 or an errno value.
+ */
+static int ringbuf_gzip_file(const gchar *name)
+{
+  gchar   *gz_name, *tmp_name;
+  guint8  *buf;
+  int      in_fd, out_fd;
+  gzFile   gz;
+  ssize_t  nread;
+  int      err = 0;
+
+  in_fd = ws_open(name, O_RDONLY|O_BINARY, 0000);
+  if (in_fd == -1)
+    return errno;
+
+  gz_name = g_strconcat(name, RINGBUF_COMPRESSED_SUFFIX, NULL);
+  tmp_name = g_strconcat(gz_name, ".tmp", NULL);
+  out_fd = ws_open(tmp_name, O_WRONLY|O_BINARY|O_TRUNC|O_CREAT,
+                   rb_data.group_read_access ? 0640 : 0600);
+  if (out_fd == -1) {
+    err = errno;
+    ws_close(in_fd);
+    g_free(tmp_name);
+    g_free(gz_name);
+    return err;
+  }
+  gz = gzdopen(out_fd, "wb");
+  if (gz == NULL) {
+    ws_close(out_fd);
+    ws_close(in_fd);
+    ws_unlink(tmp_name);
+    g_free(tmp_name);
+    g_free(gz_name);
+    return ENOMEM;
+  }
+
+  buf = (guint8 *)g_malloc(IO_BUF_SIZE);
+  while ((nread = ws_read(in_fd, buf, IO_BUF_SIZE)) > 0) {
+    if (gzwrite(gz, buf, (unsigned)nread) != nread) {
+      err = errno != 0 ? errno : EIO;
+      break;
+    }
+  }
+  if (nread < 0)
+    err = errno;
+  g_free(buf);
+  ws_close(in_fd);
+
+  if (gzclose(gz) != Z_OK && err == 0)
+    err = errno != 0 ? errno : EIO;
+  if (err == 0 && ws_rename(tmp_name, gz_name) != 0)
+    err = errno;
+  if (err != 0)
+    ws_unlink(tmp_name);
+  g_free(tmp_name);
+  g_free(gz_name);
+  return err;
+}
+#endif
+
+/*
+ * Writes a file that goes with a ringbuffer file, named with the given
+ * suffix.  Returns 0 or an errno value.
+ */
+static int ringbuf_write_extra_file(const gchar *name, const gchar *suffix,
+                                    const void *data, size_t len)
+{
+  gchar *path;
+  FILE  *fh;
+  int    fd;
+  int    err = 0;
+
+  path = g_strconcat(name, suffix, NULL);
+  fd = ws_open(path, O_WRONLY|O_BINARY|O_TRUNC|O_CREAT,
+               rb_data.group_read_access ? 0640 : 0600);
+  if (fd == -1) {
+    err = errno;
+  } else if ((fh = ws_fdopen(fd, "wb")) == NULL) {
+    err = errno;
+    ws_close(fd);
+  } else {
+    if (len != 0 && fwrite(data, len, 1, fh) != 1)
+      err = errno;
+    if (fclose(fh) == EOF && err == 0)
+      err = errno;
+  }
+  if (err != 0)
+    ws_unlink(path);
+  g_free(path);
+  return err;
+}
+
+/*
+ * Does what there is to do with a finished file; called by the worker
+ * thread without the lock
+ */
+static void ringbuf_finish_file(rb_job *job)
+{
+  gboolean    drop;
+  guint       done = 0;
+  GByteArray *index;
+  int         err;
+
+  /* The writer thread may not have written all of the file yet */
+  async_writer_wait_closed(job->closes);
+
+  g_mutex_lock(&rb_mutex);
+  drop = job->drop;
+  g_mutex_unlock(&rb_mutex);
+
+  if (!drop) {
+#ifdef HAVE_ZLIB
+    if (job->compress) {
+      err = ringbuf_gzip_file(job->name);
+      if (err == 0)
+        done |= RINGBUF_COMPRESSED;
+      else
+        g_warning("Couldn't compress \"%s\": %s", job->name, g_strerror(err));
+    }
+#endif
+    if (job->summary != NULL) {
+      err = ringbuf_write_extra_file(job->name, RINGBUF_SUMMARY_SUFFIX,
+                                     job->summary, strlen(job->summary));
+      if (err == 0)
+        done |= RINGBUF_SUMMARIZED;
+      else
+        g_warning("Couldn't write a summary of \"%s\": %s", job->name, g_strerror(err));
+    }
+    if (job->flow_index != NULL) {
+      index = flow_index_serialize(job->flow_index);
+      err = ringbuf_write_extra_file(job->name, FLOW_INDEX_SUFFIX, index->data, index->len);
+      g_byte_array_free(index, TRUE);
+      if (err == 0)
+        done |= RINGBUF_INDEXED;
+      else
+        g_warning("Couldn't write a flow index of \"%s\": %s", job->name, g_strerror(err));
+    }
+  }
+
+  g_mutex_lock(&rb_mutex);
+  if (done & RINGBUF_COMPRESSED)
+    ws_unlink(job->name);
+  if (job->drop) {
+    /* The ring came around to this file while we were at it */
+    ringbuf_unlink_file(job->name, done);
+  } else if (job->rfile != NULL) {
+    job->rfile->done = done;
+    job->rfile->job = NULL;
+  }
+  g_mutex_unlock(&rb_mutex);
+
+  g_free(job->name);
+  g_free(job->summary);
+  flow_index_free(job->flow_index);
+  g_free(job);
+}
+
+static gpointer ringbuf_worker_func(gpointer arg _U_)
+{
+  rb_job *job;
+
+  g_mutex_lock(&rb_mutex);
+  for (;;) {
+    while (g_queue_is_empty(&rb_jobs) && !rb_worker_stopping)
+      g_cond_wait(&rb_cond, &rb_mutex);
+    job = (rb_job *)g_queue_pop_head(&rb_jobs);
+    if (job == NULL)
+      break;
+    g_mutex_unlock(&rb_mutex);
+    ringbuf_finish_file(job);
+    g_mutex_lock(&rb_mutex);
+  }
+  g_mutex_unlock(&rb_mutex);
+  return NULL;
+}
+
+/*
+ * Hands the file that was just closed to the worker thread, if there's
+ * anything to do with it
+ */
+static void ringbuf_queue_finished_file(rb_file *rfile, gboolean compress)
+{
+  rb_job *job;
+
+  if (!compress && rb_data.summary == NULL && rb_data.flow_index == NULL)
+    return;
+
+  job = g_new0(rb_job, 1);
+  job->name = g_strdup(rfile->name);
+  job->compress = compress;
+  job->summary = rb_data.summary;
+  rb_data.summary = NULL;
+  job->flow_index = rb_data.flow_index;
+  rb_data.flow_index = NULL;
+  job->closes = async_writer_close_count();
+  job->rfile = rfile;
+
+  g_mutex_lock(&rb_mutex);
+  if (rb_worker == NULL)
+    rb_worker = g_thread_new("Ring buffer files", ringbuf_worker_func, NULL);
+  rfile->job = job;
+  g_queue_push_tail(&rb_jobs, job);
+  g_cond_signal(&rb_cond);
+  g_mutex_unlock(&rb_mutex);
+}
+
+/*
+ * Waits for the worker thread to finish the files it has been given
+ */
+static void ringbuf_stop_worker(void)
+{
+  if (rb_worker == NULL)
+    return;
+
+  g_mutex_lock(&rb_mutex);
+  rb_worker_stopping = TRUE;
+  g_cond_signal(&rb_cond);
+  g_mutex_unlock(&rb_mutex);
+  g_thread_join(rb_worker);
+  rb_worker = NULL;
+  rb_worker_stopping = FALSE;
+}
+
 
 /*
  * create the next filename and open a new binary file with that name
@@ -79,10 +376,18 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
   struct tm *tm;
 
   if (rfile->name != NULL) {
-    if (rb_data.unlimited == FALSE) {
+    g_mutex_lock(&rb_mutex);
+    if (rfile->job != NULL) {
+      /* the worker thread hasn't got to the old file yet; it'll remove it */
+      rfile->job->drop = !rb_data.unlimited;
+      rfile->job->rfile = NULL;
+      rfile->job = NULL;
+    } else if (rb_data.unlimited == FALSE) {
       /* remove old file (if any, so ignore error) */
-      ws_unlink(rfile->name);
+      ringbuf_unlink_file(rfile->name, rfile->done);
     }
+    rfile->done = 0;
+    g_mutex_unlock(&rb_mutex);
     g_free(rfile->name);
   }
 
@@ -120,7 +425,8 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
  * Initialize the ringbuffer data structures
  */
 int
-ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_access)
+ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_access,
+             gboolean compress)
 {
   unsigned int i;
   char        *pfx, *last_pathsep;
@@ -135,6 +441,9 @@ ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_acce
   rb_data.pdh = NULL;
   rb_data.io_buffer = NULL;
   rb_data.group_read_access = group_read_access;
+  rb_data.compress = compress;
+  rb_data.summary = NULL;
+  rb_data.flow_index = NULL;
 
   /* just to be sure ... */
   if (num_files <= RINGBUFFER_MAX_NUM_FILES) {
@@ -193,6 +502,8 @@ ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_acce
 
   for (i=0; i < rb_data.num_files; i++) {
     rb_data.files[i].name = NULL;
+    rb_data.files[i].job = NULL;
+    rb_data.files[i].done = 0;
   }
 
   /* create the first file */
@@ -221,11 +532,18 @@ const gchar *ringbuf_current_filename(void)
 }
 
 /*
- * Calls ws_fdopen() for the current ringbuffer file
+ * Calls ws_fdopen() for the current ringbuffer file, or hands it to the
+ * writer thread if there is one
  */
 FILE *
 ringbuf_init_libpcap_fdopen(int *err)
 {
+  if (async_writer_is_running()) {
+    /* The writer thread has buffers of its own */
+    rb_data.pdh = async_writer_fdopen(rb_data.fd, err);
+    return rb_data.pdh;
+  }
+
   rb_data.pdh = ws_fdopen(rb_data.fd, "wb");
   if (rb_data.pdh == NULL) {
     if (err != NULL) {
@@ -276,6 +594,8 @@ ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd, int *err)
   rb_data.pdh = NULL;
   rb_data.fd  = -1;
 
+  ringbuf_queue_finished_file(&rb_data.files[rb_data.curr_file_num % rb_data.num_files], rb_data.compress);
+
   /* get the next file number and open it */
 
   rb_data.curr_file_num++ /* = next_file_num*/;
@@ -314,6 +634,12 @@ ringbuf_libpcap_dump_close(gchar **save_file, int *err)
       }
       ws_close(rb_data.fd);
       ret_val = FALSE;
+    } else {
+      /*
+       * The last file is left uncompressed, as it's the one reported
+       * to whoever started the capture, to be opened.
+       */
+      ringbuf_queue_finished_file(&rb_data.files[rb_data.curr_file_num % rb_data.num_files], FALSE);
     }
     rb_data.pdh = NULL;
     rb_data.fd  = -1;
@@ -327,6 +653,27 @@ ringbuf_libpcap_dump_close(gchar **save_file, int *err)
   return ret_val;
 }
 
+/*
+ * Sets the summary to be written next to the current file once it's closed
+ */
+void
+ringbuf_set_summary(gchar *summary)
+{
+  g_free(rb_data.summary);
+  rb_data.summary = summary;
+}
+
+/*
+ * Sets the flow index to be written next to the current file once it's
+ * closed
+ */
+void
+ringbuf_set_flow_index(flow_index_t *flow_index)
+{
+  flow_index_free(rb_data.flow_index);
+  rb_data.flow_index = flow_index;
+}
+
 /*
  * Frees all memory allocated by the ringbuffer
  */
@@ -335,6 +682,12 @@ ringbuf_free(void)
 {
   unsigned int i;
 
+  ringbuf_stop_worker();
+  g_free(rb_data.summary);
+  rb_data.summary = NULL;
+  flow_index_free(rb_data.flow_index);
+  rb_data.flow_index = NULL;
+
   if (rb_data.files != NULL) {
     for (i=0; i < rb_data.num_files; i++) {
       if (rb_data.files[i].name != NULL) {
@@ -377,10 +730,12 @@ ringbuf_error_cleanup(void)
     rb_data.fd = -1;
   }
 
+  ringbuf_stop_worker();
+
   if (rb_data.files != NULL) {
     for (i=0; i < rb_data.num_files; i++) {
       if (rb_data.files[i].name != NULL) {
-        ws_unlink(rb_data.files[i].name);
+        ringbuf_unlink_file(rb_data.files[i].name, rb_data.files[i].done);
       }
     }
   }
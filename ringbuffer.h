@@ -13,6 +13,7 @@
 
 #include <stdio.h>
 #include "wiretap/wtap.h"
+#include "writecap/flow_index.h"
 
 #define RINGBUFFER_UNLIMITED_FILES 0
 /* Minimum number of ringbuffer files */
@@ -23,13 +24,16 @@
 /* Maximum number for FAT filesystems */
 #define RINGBUFFER_WARN_NUM_FILES 65535
 
-int ringbuf_init(const char *capture_name, guint num_files, gboolean group_read_access);
+int ringbuf_init(const char *capture_name, guint num_files, gboolean group_read_access,
+                 gboolean compress);
 gboolean ringbuf_is_initialized(void);
 const gchar *ringbuf_current_filename(void);
 FILE *ringbuf_init_libpcap_fdopen(int *err);
 gboolean ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd,
                              int *err);
 gboolean ringbuf_libpcap_dump_close(gchar **save_file, int *err);
+void ringbuf_set_summary(gchar *summary);
+void ringbuf_set_flow_index(flow_index_t *flow_index);
 void ringbuf_free(void);
 void ringbuf_error_cleanup(void);
 
@@ -265,8 +265,11 @@ process_packet(capture_file *cf, epan_dissect_t *edt,
       epan_dissect_prime_with_dfilter(edt, cf->dfcode);
 
     /* This is the first and only pass, so prime the epan_dissect_t
-       with the hfids postdissectors want on the first pass. */
+       with the hfids postdissectors want on the first pass, and with
+       the fields we index. */
     prime_epan_dissect_with_postdissector_wanted_hfids(edt);
+    if (cf->dfindex)
+      dfilter_index_prime_edt(cf->dfindex, edt);
 
     frame_data_set_before_dissect(&fdlocal, &cf->elapsed_time,
                                   &cf->provider.ref, cf->provider.prev_dis);
@@ -288,6 +291,9 @@ process_packet(capture_file *cf, epan_dissect_t *edt,
     frame_data_set_after_dissect(&fdlocal, &cum_bytes);
     cf->provider.prev_cap = cf->provider.prev_dis = frame_data_sequence_add(cf->provider.frames, &fdlocal);
 
+    if (edt && cf->dfindex)
+      dfilter_index_add_frame(cf->dfindex, edt, fdlocal.num);
+
     /* If we're not doing dissection then there won't be any dependent frames.
      * More importantly, edt.pi.dependent_frames won't be initialized because
      * epan hasn't been initialized.
@@ -314,8 +320,13 @@ process_packet(capture_file *cf, epan_dissect_t *edt,
 }
 
 
+/*
+ * Reads and dissects the records from where the sequential side of the
+ * file is. When tailing a file that is still being written, stops at the
+ * first record not completely written yet, leaving it for the next call.
+ */
 static int
-load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
+read_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count, gboolean tail)
 {
   int          err;
   gchar       *err_info = NULL;
@@ -325,67 +336,56 @@ load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
   epan_dissect_t *edt = NULL;
 
   {
-    /* Allocate a frame_data_sequence for all the frames. */
-    cf->provider.frames = new_frame_data_sequence();
-
-    {
-      gboolean create_proto_tree;
-
-      /*
-       * Determine whether we need to create a protocol tree.
-       * We do if:
-       *
-       *    we're going to apply a read filter;
-       *
-       *    we're going to apply a display filter;
-       *
-       *    a postdissector wants field values or protocols
-       *    on the first pass.
-       */
-      create_proto_tree =
-        (cf->rfcode != NULL || cf->dfcode != NULL || postdissectors_want_hfids());
+    gboolean create_proto_tree;
+
+    /*
+     * Determine whether we need to create a protocol tree.
+     * We do if:
+     *
+     *    we're going to apply a read filter;
+     *
+     *    we're going to apply a display filter;
+     *
+     *    a postdissector wants field values or protocols
+     *    on the first pass;
+     *
+     *    we're building a field value index.
+     */
+    create_proto_tree =
+      (cf->rfcode != NULL || cf->dfcode != NULL || postdissectors_want_hfids() ||
+       cf->dfindex != NULL);
 
-      /* We're not going to display the protocol tree on this pass,
-         so it's not going to be "visible". */
-      edt = epan_dissect_new(cf->epan, create_proto_tree, FALSE);
-    }
+    /* We're not going to display the protocol tree on this pass,
+       so it's not going to be "visible". */
+    edt = epan_dissect_new(cf->epan, create_proto_tree, FALSE);
+  }
 
-    wtap_rec_init(&rec);
-    ws_buffer_init(&buf, 1514);
-
-    while (wtap_read(cf->provider.wth, &rec, &buf, &err, &err_info, &data_offset)) {
-      if (process_packet(cf, edt, data_offset, &rec, &buf)) {
-        /* Stop reading if we have the maximum number of packets;
-         * When the -c option has not been used, max_packet_count
-         * starts at 0, which practically means, never stop reading.
-         * (unless we roll over max_packet_count ?)
-         */
-        if ( (--max_packet_count == 0) || (max_byte_count != 0 && data_offset >= max_byte_count)) {
-          err = 0; /* This is not an error */
-          break;
-        }
-      }
-    }
+  wtap_rec_init(&rec);
+  ws_buffer_init(&buf, 1514);
 
-    if (edt) {
-      epan_dissect_free(edt);
-      edt = NULL;
+  while (tail ? wtap_read_tail(cf->provider.wth, &rec, &buf, &err, &err_info, &data_offset) :
+                wtap_read(cf->provider.wth, &rec, &buf, &err, &err_info, &data_offset)) {
+    if (process_packet(cf, edt, data_offset, &rec, &buf)) {
+      /* Stop reading if we have the maximum number of packets;
+       * When the -c option has not been used, max_packet_count
+       * starts at 0, which practically means, never stop reading.
+       * (unless we roll over max_packet_count ?)
+       */
+      if ( (--max_packet_count == 0) || (max_byte_count != 0 && data_offset >= max_byte_count)) {
+        err = 0; /* This is not an error */
+        break;
+      }
     }
+  }
 
-    wtap_rec_cleanup(&rec);
-    ws_buffer_free(&buf);
-
-    /* Close the sequential I/O side, to free up memory it requires. */
-    wtap_sequential_close(cf->provider.wth);
-
-    /* Allow the protocol dissectors to free up memory that they
-     * don't need after the sequential run-through of the packets. */
-    postseq_cleanup_all_protocols();
-
-    cf->provider.prev_dis = NULL;
-    cf->provider.prev_cap = NULL;
+  if (edt) {
+    epan_dissect_free(edt);
+    edt = NULL;
   }
 
+  wtap_rec_cleanup(&rec);
+  ws_buffer_free(&buf);
+
   if (err != 0) {
     cfile_read_failure_message("sharkd", cf->filename, err, err_info);
   }
@@ -393,6 +393,47 @@ load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
   return err;
 }
 
+/*
+ * Ends the sequential run-through of the file.
+ */
+static void
+finish_cap_file(capture_file *cf)
+{
+  /* Close the sequential I/O side, to free up memory it requires. */
+  wtap_sequential_close(cf->provider.wth);
+
+  /* Allow the protocol dissectors to free up memory that they
+   * don't need after the sequential run-through of the packets. */
+  postseq_cleanup_all_protocols();
+
+  cf->provider.prev_dis = NULL;
+  cf->provider.prev_cap = NULL;
+
+  cf->state = FILE_READ_DONE;
+}
+
+static int
+load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count, gboolean tail)
+{
+  int err;
+
+  /* Allocate a frame_data_sequence for all the frames. */
+  cf->provider.frames = new_frame_data_sequence();
+
+  /* Index the configured fields, if any, so that filters on them can
+     be answered without dissecting. */
+  dfilter_index_free(cf->dfindex);
+  cf->dfindex = dfilter_index_new(prefs.gui_filter_index_fields, NULL);
+
+  err = read_cap_file(cf, max_packet_count, max_byte_count, tail);
+
+  /* Keep reading sequentially when following the file, unless it failed. */
+  if (!tail || err != 0)
+    finish_cap_file(cf);
+
+  return err;
+}
+
 cf_status_t
 cf_open(capture_file *cf, const char *fname, unsigned int type, gboolean is_tempfile, int *err)
 {
@@ -509,7 +550,63 @@ sharkd_cf_open(const char *fname, unsigned int type, gboolean is_tempfile, int *
 int
 sharkd_load_cap_file(void)
 {
-  return load_cap_file(&cfile, 0, 0);
+  return load_cap_file(&cfile, 0, 0, FALSE);
+}
+
+/*
+ * Loads what has been written of a capture file, and keeps its sequential
+ * side open, for sharkd_continue_tail() to read the records appended later.
+ */
+int
+sharkd_load_cap_file_tail(void)
+{
+  return load_cap_file(&cfile, 0, 0, TRUE);
+}
+
+/*
+ * Reads the records appended to a file loaded by sharkd_load_cap_file_tail()
+ * since it was last read. With finish, the file is taken to be complete,
+ * and is no longer followed.
+ */
+int
+sharkd_continue_tail(gboolean finish)
+{
+  int err;
+
+  if (cfile.state != FILE_READ_IN_PROGRESS)
+    return 0;
+
+  /* A record cut short now is an error */
+  if (finish)
+    wtap_cleareof(cfile.provider.wth);
+
+  err = read_cap_file(&cfile, 0, 0, !finish);
+  if (finish || err != 0)
+    finish_cap_file(&cfile);
+
+  return err;
+}
+
+gboolean
+sharkd_is_tailing(void)
+{
+  return cfile.state == FILE_READ_IN_PROGRESS;
+}
+
+/*
+ * Gives a process forked after the capture file was loaded a random
+ * access file handle of its own, so its reads don't move the file
+ * position of the other processes.
+ */
+int
+sharkd_reopen_cap_file(void)
+{
+  int err = 0;
+
+  if (cfile.provider.wth && !wtap_fdreopen(cfile.provider.wth, cfile.filename, &err))
+    return err;
+
+  return 0;
 }
 
 frame_data *
@@ -639,8 +736,12 @@ sharkd_dissect_columns(frame_data *fdata, guint32 frame_ref_num, guint32 prev_di
   return 0;
 }
 
+/*
+ * Runs the tap listeners on the frames from first_framenum on, adding to
+ * what they have from the frames before.
+ */
 int
-sharkd_retap(void)
+sharkd_retap_from(guint32 first_framenum)
 {
   guint32          framenum;
   frame_data      *fdata;
@@ -675,9 +776,7 @@ sharkd_retap(void)
   ws_buffer_init(&buf, 1514);
   epan_dissect_init(&edt, cfile.epan, create_proto_tree, FALSE);
 
-  reset_tap_listeners();
-
-  for (framenum = 1; framenum <= cfile.count; framenum++) {
+  for (framenum = first_framenum; framenum <= cfile.count; framenum++) {
     fdata = sharkd_get_frame(framenum);
 
     if (!wtap_seek_read(cfile.provider.wth, fdata->file_off, &rec, &buf, &err, &err_info))
@@ -701,8 +800,29 @@ sharkd_retap(void)
   return 0;
 }
 
+int
+sharkd_retap(void)
+{
+  reset_tap_listeners();
+
+  return sharkd_retap_from(1);
+}
+
 int
 sharkd_filter(const char *dftext, guint8 **result)
+{
+  *result = NULL;
+
+  return sharkd_filter_update(dftext, 1, result);
+}
+
+/*
+ * Brings a result of sharkd_filter() up to date with the frames read since
+ * it was made, from first_framenum on. Returns the number of the frame
+ * after the last one filtered, or -1 if the filter is invalid.
+ */
+int
+sharkd_filter_update(const char *dftext, guint32 first_framenum, guint8 **result)
 {
   dfilter_t  *dfcode = NULL;
 
@@ -714,7 +834,6 @@ sharkd_filter(const char *dftext, guint8 **result)
   char *err_info = NULL;
 
   guint8 *result_bits;
-  guint8  passed_bits;
 
   epan_dissect_t edt;
 
@@ -731,20 +850,34 @@ sharkd_filter(const char *dftext, guint8 **result)
 
   frames_count = cfile.count;
 
+  /* If the field value index can answer the filter, don't dissect. */
+  result_bits = dfilter_index_apply(dfcode, cfile.dfindex, frames_count);
+  if (result_bits) {
+    dfilter_free(dfcode);
+    g_free(*result);
+    *result = result_bits;
+    return frames_count + 1;
+  }
+
   wtap_rec_init(&rec);
   ws_buffer_init(&buf, 1514);
   epan_dissect_init(&edt, cfile.epan, TRUE, FALSE);
 
-  passed_bits = 0;
-  result_bits = (guint8 *) g_malloc(2 + (frames_count / 8));
-
-  for (framenum = 1; framenum <= frames_count; framenum++) {
-    frame_data *fdata = sharkd_get_frame(framenum);
+  if (*result) {
+    /* Keep the bits of the frames before first_framenum */
+    result_bits = (guint8 *) g_realloc(*result, 2 + (frames_count / 8));
+    result_bits[first_framenum / 8] &= (1 << (first_framenum % 8)) - 1;
+    memset(result_bits + (first_framenum / 8) + 1, 0, (2 + (frames_count / 8)) - ((first_framenum / 8) + 1));
 
-    if ((framenum & 7) == 0) {
-      result_bits[(framenum / 8) - 1] = passed_bits;
-      passed_bits = 0;
+    for (prev_dis_num = first_framenum - 1; prev_dis_num > 0; prev_dis_num--) {
+      if (result_bits[prev_dis_num / 8] & (1 << (prev_dis_num % 8)))
+        break;
     }
+  } else
+    result_bits = (guint8 *) g_malloc0(2 + (frames_count / 8));
+
+  for (framenum = first_framenum; framenum <= frames_count; framenum++) {
+    frame_data *fdata = sharkd_get_frame(framenum);
 
     if (!wtap_seek_read(cfile.provider.wth, fdata->file_off, &rec, &buf, &err, &err_info))
       break;
@@ -760,7 +893,7 @@ sharkd_filter(const char *dftext, guint8 **result)
                      fdata, NULL);
 
     if (dfilter_apply_edt(dfcode, &edt)) {
-      passed_bits |= (1 << (framenum % 8));
+      result_bits[framenum / 8] |= (1 << (framenum % 8));
       prev_dis_num = framenum;
     }
 
@@ -769,10 +902,6 @@ sharkd_filter(const char *dftext, guint8 **result)
     epan_dissect_reset(&edt);
   }
 
-  if ((framenum & 7) == 0)
-      framenum--;
-  result_bits[framenum / 8] = passed_bits;
-
   wtap_rec_cleanup(&rec);
   ws_buffer_free(&buf);
   epan_dissect_cleanup(&edt);
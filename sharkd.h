@@ -25,8 +25,14 @@ typedef void (*sharkd_dissect_func_t)(epan_dissect_t *edt, proto_tree *tree, str
 /* sharkd.c */
 cf_status_t sharkd_cf_open(const char *fname, unsigned int type, gboolean is_tempfile, int *err);
 int sharkd_load_cap_file(void);
+int sharkd_load_cap_file_tail(void);
+int sharkd_continue_tail(gboolean finish);
+gboolean sharkd_is_tailing(void);
+int sharkd_reopen_cap_file(void);
 int sharkd_retap(void);
+int sharkd_retap_from(guint32 first_framenum);
 int sharkd_filter(const char *dftext, guint8 **result);
+int sharkd_filter_update(const char *dftext, guint32 first_framenum, guint8 **result);
 frame_data *sharkd_get_frame(guint32 framenum);
 int sharkd_dissect_columns(frame_data *fdata, guint32 frame_ref_num, guint32 prev_dis_num, column_info *cinfo, gboolean dissect_color);
 int sharkd_dissect_request(guint32 framenum, guint32 frame_ref_num, guint32 prev_dis_num, sharkd_dissect_func_t cb, guint32 dissect_flags, void *data);
@@ -37,9 +43,10 @@ const char *sharkd_version(void);
 /* sharkd_daemon.c */
 int sharkd_init(int argc, char **argv);
 int sharkd_loop(void);
+gboolean sharkd_preload_handoff(const char *fname);
 
 /* sharkd_session.c */
-int sharkd_session_main(void);
+int sharkd_session_main(gboolean loaded);
 
 #endif /* __SHARKD_H */
 
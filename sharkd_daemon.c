@@ -35,11 +35,16 @@
 
 #ifndef _WIN32
 #include <sys/un.h>
+#include <sys/stat.h>
 #include <netinet/tcp.h>
 #endif
 
 #include <wsutil/strtoi.h>
 
+#include <wiretap/wtap.h>
+
+#include "ws_attributes.h"
+
 #include "sharkd.h"
 
 #ifdef _WIN32
@@ -48,11 +53,29 @@
 #else
 /* for other system support only local sockets */
 # define SHARKD_UNIX_SUPPORT
+/* capture files can be loaded once and shared by forked clients */
+# define SHARKD_PRELOAD_SUPPORT
 #endif
 
 static int _use_stdinout = 0;
 static socket_handle_t _server_fd = INVALID_SOCKET;
 
+#ifdef SHARKD_PRELOAD_SUPPORT
+/*
+ * A capture file given with -p. A process loads it before clients are
+ * accepted, and forks a session for each client that loads it; the
+ * sessions share the frame table and other first-pass state with it
+ * copy-on-write. Clients are passed to it over a socket pair.
+ */
+struct sharkd_preload
+{
+	char *fname;
+	int ctl_fd;     /* our end of the socket pair, -1 if none */
+};
+
+static GPtrArray *_preloads = NULL;
+#endif
+
 static socket_handle_t
 socket_init(char *path)
 {
@@ -157,6 +180,239 @@ socket_init(char *path)
 	return fd;
 }
 
+#ifdef SHARKD_PRELOAD_SUPPORT
+static gboolean
+sharkd_send_fd(int ctl_fd, int fd)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char byte = 0;
+	int flags = 0;
+
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&control, 0, sizeof(control));
+
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	return sendmsg(ctl_fd, &msg, flags) == 1;
+}
+
+/*
+ * Receives a descriptor sent by sharkd_send_fd(). *fd is -1 if the message
+ * didn't carry one. Returns FALSE once the socket is closed.
+ */
+static gboolean
+sharkd_recv_fd(int ctl_fd, int *fd)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char byte;
+	ssize_t ret;
+
+	memset(&msg, 0, sizeof(msg));
+
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	*fd = -1;
+	do {
+		ret = recvmsg(ctl_fd, &msg, 0);
+	} while (ret == -1 && errno == EINTR);
+
+	if (ret <= 0)
+		return FALSE;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+		memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+
+	return TRUE;
+}
+
+static gboolean
+sharkd_same_file(const char *fname1, const char *fname2)
+{
+	struct stat st1, st2;
+
+	if (!strcmp(fname1, fname2))
+		return TRUE;
+
+	if (stat(fname1, &st1) != 0 || stat(fname2, &st2) != 0)
+		return FALSE;
+
+	return st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino;
+}
+
+/*
+ * Loads a preloaded capture file, then starts a session for each client
+ * handed over on ctl_fd, until the daemon goes away.
+ */
+WS_NORETURN static void
+sharkd_preload_main(const char *fname, int ctl_fd)
+{
+	int err = 0;
+	int fd;
+
+	if (sharkd_cf_open(fname, WTAP_TYPE_AUTO, FALSE, &err) != CF_OK || (err = sharkd_load_cap_file()) != 0)
+	{
+		/* Clients which load it will do so themselves, and get the error. */
+		fprintf(stderr, "preload: cannot load %s\n", fname);
+		exit(1);
+	}
+
+	fprintf(stderr, "preload: %s loaded\n", fname);
+
+	while (sharkd_recv_fd(ctl_fd, &fd))
+	{
+		pid_t pid;
+
+		if (fd == -1)
+			continue;
+
+		pid = fork();
+		if (pid == 0)
+		{
+			close(ctl_fd);
+			/* redirect stdin, stdout to socket */
+			dup2(fd, 0);
+			dup2(fd, 1);
+			close(fd);
+
+			/*
+			 * This session can hand the socket over to an earlier
+			 * preload too, so don't read requests ahead of the one
+			 * being processed.
+			 */
+			setvbuf(stdin, NULL, _IONBF, 0);
+
+			/* The forked sessions mustn't share the file position. */
+			err = sharkd_reopen_cap_file();
+			if (err != 0)
+			{
+				fprintf(stderr, "preload: cannot reopen %s: %s\n", fname, g_strerror(err));
+				exit(1);
+			}
+
+			exit(sharkd_session_main(TRUE));
+		}
+
+		if (pid == -1)
+			fprintf(stderr, "cannot fork(): %s\n", g_strerror(errno));
+
+		close(fd);
+	}
+
+	exit(0);
+}
+
+/*
+ * Starts a process for each preloaded capture file.
+ */
+static void
+sharkd_preload_start(void)
+{
+	guint i;
+
+	for (i = 0; _preloads && i < _preloads->len; i++)
+	{
+		struct sharkd_preload *preload = (struct sharkd_preload *) g_ptr_array_index(_preloads, i);
+		int sv[2];
+		pid_t pid;
+
+		/*
+		 * Each client goes over as a single byte carrying the descriptor,
+		 * so clients handed over at the same time don't mix; a stream,
+		 * unlike datagrams, tells the process when the daemon goes away.
+		 */
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+		{
+			fprintf(stderr, "cannot socketpair(): %s\n", g_strerror(errno));
+			continue;
+		}
+
+		pid = fork();
+		if (pid == 0)
+		{
+			/*
+			 * Keep the ends to the files preloaded before this one,
+			 * so the sessions can still hand over clients to them.
+			 */
+			close(sv[0]);
+			closesocket(_server_fd);
+			sharkd_preload_main(preload->fname, sv[1]);
+		}
+
+		close(sv[1]);
+
+		if (pid == -1)
+		{
+			fprintf(stderr, "cannot fork(): %s\n", g_strerror(errno));
+			close(sv[0]);
+			continue;
+		}
+
+		preload->ctl_fd = sv[0];
+	}
+}
+#endif
+
+gboolean
+sharkd_preload_handoff(const char *fname)
+{
+#ifdef SHARKD_PRELOAD_SUPPORT
+	guint i;
+
+	for (i = 0; _preloads && i < _preloads->len; i++)
+	{
+		struct sharkd_preload *preload = (struct sharkd_preload *) g_ptr_array_index(_preloads, i);
+
+		if (preload->ctl_fd == -1 || !sharkd_same_file(preload->fname, fname))
+			continue;
+
+		/* Earlier replies must get to the client before the new session's. */
+		fflush(stdout);
+
+		if (sharkd_send_fd(preload->ctl_fd, 0))
+			return TRUE;
+
+		fprintf(stderr, "preload: cannot hand over client for %s: %s\n", fname, g_strerror(errno));
+		return FALSE;
+	}
+#else
+	(void) fname;
+#endif
+	return FALSE;
+}
+
 int
 sharkd_init(int argc, char **argv)
 {
@@ -164,10 +420,29 @@ sharkd_init(int argc, char **argv)
 	pid_t pid;
 #endif
 	socket_handle_t fd;
+	int i;
 
-	if (argc != 2)
+	/* -p options come before the socket */
+	for (i = 1; i + 1 < argc && !strcmp(argv[i], "-p"); i += 2)
 	{
-		fprintf(stderr, "Usage: %s <-|socket>\n", argv[0]);
+#ifdef SHARKD_PRELOAD_SUPPORT
+		struct sharkd_preload *preload = g_new(struct sharkd_preload, 1);
+
+		preload->fname = argv[i + 1];
+		preload->ctl_fd = -1;
+
+		if (!_preloads)
+			_preloads = g_ptr_array_new();
+		g_ptr_array_add(_preloads, preload);
+#else
+		fprintf(stderr, "-p is not supported on this platform\n");
+		return -1;
+#endif
+	}
+
+	if (i != argc - 1)
+	{
+		fprintf(stderr, "Usage: %s [-p <capture file>]... <-|socket>\n", argv[0]);
 		fprintf(stderr, "\n");
 
 		fprintf(stderr, "<socket> examples:\n");
@@ -178,6 +453,12 @@ sharkd_init(int argc, char **argv)
 		fprintf(stderr, " - tcp:127.0.0.1:4446 - listen on TCP port 4446\n");
 #endif
 		fprintf(stderr, "\n");
+#ifdef SHARKD_PRELOAD_SUPPORT
+		fprintf(stderr, "-p <capture file> - load the capture file before accepting clients; clients\n");
+		fprintf(stderr, "                    which load it get a copy without dissecting it again,\n");
+		fprintf(stderr, "                    unless they changed preferences first. May be repeated.\n");
+		fprintf(stderr, "\n");
+#endif
 		return -1;
 	}
 
@@ -185,13 +466,20 @@ sharkd_init(int argc, char **argv)
 	signal(SIGCHLD, SIG_IGN);
 #endif
 
-	if (!strcmp(argv[1], "-"))
+	if (!strcmp(argv[i], "-"))
 	{
+#ifdef SHARKD_PRELOAD_SUPPORT
+		if (_preloads)
+		{
+			fprintf(stderr, "-p can only be used with a socket\n");
+			return -1;
+		}
+#endif
 		_use_stdinout = 1;
 	}
 	else
 	{
-		fd = socket_init(argv[1]);
+		fd = socket_init(argv[i]);
 		if (fd == INVALID_SOCKET)
 			return -1;
 		_server_fd = fd;
@@ -221,9 +509,13 @@ sharkd_loop(void)
 {
 	if (_use_stdinout)
 	{
-		return sharkd_session_main();
+		return sharkd_session_main(FALSE);
 	}
 
+#ifdef SHARKD_PRELOAD_SUPPORT
+	sharkd_preload_start();
+#endif
+
 	while (1)
 	{
 #ifndef _WIN32
@@ -253,7 +545,17 @@ sharkd_loop(void)
 			dup2(fd, 1);
 			close(fd);
 
-			exit(sharkd_session_main());
+#ifdef SHARKD_PRELOAD_SUPPORT
+			/*
+			 * Loading a preloaded file hands the socket over to another
+			 * process, so don't read requests ahead of the one being
+			 * processed.
+			 */
+			if (_preloads)
+				setvbuf(stdin, NULL, _IONBF, 0);
+#endif
+
+			exit(sharkd_session_main(FALSE));
 		}
 
 		if (pid == -1)
@@ -22,6 +22,7 @@
 #include <wsutil/wsjson.h>
 #include <wsutil/ws_printf.h>
 #include <wsutil/json_dumper.h>
+#include <wsutil/cbor_writer.h>
 
 #include <file.h>
 #include <epan/epan_dissect.h>
@@ -80,6 +81,68 @@ struct sharkd_filter_item
 
 static GHashTable *filter_table = NULL;
 
+/* Set once a setconf request changed a preference; see sharkd_session_process_load(). */
+static gboolean session_prefs_changed = FALSE;
+
+/*
+ * Buckets of the graphs of the last iograph request, keyed by graph and
+ * filter, so that asking for the same graphs at another interval doesn't
+ * need a retap.
+ */
+static GHashTable *iograph_cache = NULL;
+
+static void
+sharkd_iograph_cache_clear(void)
+{
+	if (iograph_cache)
+	{
+		g_hash_table_destroy(iograph_cache);
+		iograph_cache = NULL;
+	}
+}
+
+/*
+ * Column strings of the frames listed by frames requests, for each column
+ * set, so that listing the same frames again doesn't dissect them again.
+ * A row is only used again with the same time reference and previous
+ * displayed frame, which the time columns depend on.
+ */
+struct sharkd_column_row
+{
+	guint32 frame_ref_num;
+	guint32 prev_dis_num;
+	gsize size;
+	char *col_data;  /* the column strings, one after the other */
+};
+
+static GHashTable *column_cache = NULL;  /* column set -> (frame number -> row) */
+static gsize column_cache_size = 0;      /* bytes of column strings in the cache */
+
+#define SHARKD_COLUMN_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+static void
+sharkd_column_row_free(gpointer data)
+{
+	struct sharkd_column_row *row = (struct sharkd_column_row *) data;
+
+	g_free(row->col_data);
+	g_free(row);
+}
+
+static void
+sharkd_column_cache_clear(void)
+{
+	if (column_cache)
+	{
+		g_hash_table_destroy(column_cache);
+		column_cache = NULL;
+	}
+	column_cache_size = 0;
+}
+
+/* Frames listings being paged through, by the name the client gave them. */
+static GHashTable *frames_cursors = NULL;
+
 static json_dumper dumper = {0};
 
 static const char *
@@ -168,6 +231,26 @@ sharkd_json_array_close(void)
 	json_dumper_end_array(&dumper);
 }
 
+/*
+ * Parses the "format" attribute of a request: TRUE for "cbor", FALSE for
+ * "json" or no format. Returns FALSE if the format isn't known.
+ */
+static gboolean
+sharkd_session_parse_format(const char *buf, const jsmntok_t *tokens, int count, gboolean *use_cbor)
+{
+	const char *tok_format = json_find_attr(buf, tokens, count, "format");
+
+	*use_cbor = FALSE;
+	if (!tok_format || !strcmp(tok_format, "json"))
+		return TRUE;
+	if (!strcmp(tok_format, "cbor"))
+	{
+		*use_cbor = TRUE;
+		return TRUE;
+	}
+	return FALSE;
+}
+
 static void
 sharkd_json_simple_reply(int err, const char *errmsg)
 {
@@ -531,14 +614,21 @@ sharkd_session_process_info(void)
  *
  * Input:
  *   (m) file - file to be loaded
+ *   (o) tail - set if the file is still being written; the frames written
+ *              later are read by tail requests
  *
  * Output object with attributes:
  *   (m) err - error code
+ *
+ * If the daemon preloaded the file, and the preferences weren't changed
+ * in this session, the client is handed over to a new session forked
+ * from the process holding the file, which replies instead.
  */
 static void
 sharkd_session_process_load(const char *buf, const jsmntok_t *tokens, int count)
 {
 	const char *tok_file = json_find_attr(buf, tokens, count, "file");
+	gboolean tail = (json_find_attr(buf, tokens, count, "tail") != NULL);
 	int err = 0;
 
 	fprintf(stderr, "load: filename=%s\n", tok_file);
@@ -546,15 +636,27 @@ sharkd_session_process_load(const char *buf, const jsmntok_t *tokens, int count)
 	if (!tok_file)
 		return;
 
+	/* A preloaded file is as it was when the daemon started */
+	if (!tail && !session_prefs_changed && sharkd_preload_handoff(tok_file))
+		exit(0);
+
 	if (sharkd_cf_open(tok_file, WTAP_TYPE_AUTO, FALSE, &err) != CF_OK)
 	{
 		sharkd_json_simple_reply(err, NULL);
 		return;
 	}
 
+	sharkd_iograph_cache_clear();
+	sharkd_column_cache_clear();
+	if (frames_cursors)
+	{
+		g_hash_table_destroy(frames_cursors);
+		frames_cursors = NULL;
+	}
+
 	TRY
 	{
-		err = sharkd_load_cap_file();
+		err = tail ? sharkd_load_cap_file_tail() : sharkd_load_cap_file();
 	}
 	CATCH(OutOfMemoryError)
 	{
@@ -576,6 +678,7 @@ sharkd_session_process_load(const char *buf, const jsmntok_t *tokens, int count)
  *   (m) duration - time difference between time of first frame, and last loaded frame
  *   (o) filename - capture filename
  *   (o) filesize - capture filesize
+ *   (o) tail     - true if the file is still being read, see the tail request
  */
 static void
 sharkd_session_process_status(void)
@@ -601,6 +704,9 @@ sharkd_session_process_status(void)
 			sharkd_json_value_anyf("filesize", "%" G_GINT64_FORMAT, file_size);
 	}
 
+	if (sharkd_is_tailing())
+		sharkd_json_value_anyf("tail", "true");
+
 	json_dumper_end_object(&dumper);
 	json_dumper_finish(&dumper);
 }
@@ -689,42 +795,54 @@ sharkd_session_process_analyse(void)
 	g_hash_table_destroy(analyser.protocols_set);
 }
 
-static column_info *
-sharkd_session_create_columns(column_info *cinfo, const char *buf, const jsmntok_t *tokens, int count)
-{
-	const char *columns_custom[32];
-	guint16 columns_fmt[32];
-	gint16 columns_occur[32];
+#define SHARKD_MAX_COLUMNS 32
 
-	int i, cols;
+/*
+ * Gets the column0...columnXX attributes of a request. Returns how many
+ * there are.
+ */
+static int
+sharkd_session_request_columns(const char *buf, const jsmntok_t *tokens, int count, const char *columns[SHARKD_MAX_COLUMNS])
+{
+	int i;
 
-	for (i = 0; i < 32; i++)
+	for (i = 0; i < SHARKD_MAX_COLUMNS; i++)
 	{
-		const char *tok_column;
 		char tok_column_name[64];
-		char *custom_sepa;
 
 		ws_snprintf(tok_column_name, sizeof(tok_column_name), "column%d", i);
-		tok_column = json_find_attr(buf, tokens, count, tok_column_name);
-		if (tok_column == NULL)
+		columns[i] = json_find_attr(buf, tokens, count, tok_column_name);
+		if (columns[i] == NULL)
 			break;
+	}
+
+	return i;
+}
+
+static column_info *
+sharkd_session_create_columns(column_info *cinfo, const char * const *columns, int cols)
+{
+	guint16 columns_fmt[SHARKD_MAX_COLUMNS];
+	gint16 columns_occur[SHARKD_MAX_COLUMNS];
+
+	int i;
+
+	for (i = 0; i < cols; i++)
+	{
+		const char *custom_sepa;
 
-		columns_custom[i] = NULL;
 		columns_occur[i] = 0;
 
-		if ((custom_sepa = strchr(tok_column, ':')))
+		if ((custom_sepa = strchr(columns[i], ':')))
 		{
-			*custom_sepa = '\0'; /* XXX, C abuse: discarding-const */
-
 			columns_fmt[i] = COL_CUSTOM;
-			columns_custom[i] = tok_column;
 
 			if (!ws_strtoi16(custom_sepa + 1, NULL, &columns_occur[i]))
 				return NULL;
 		}
 		else
 		{
-			if (!ws_strtou16(tok_column, NULL, &columns_fmt[i]))
+			if (!ws_strtou16(columns[i], NULL, &columns_fmt[i]))
 				return NULL;
 
 			if (columns_fmt[i] >= NUM_COL_FMTS)
@@ -736,8 +854,6 @@ sharkd_session_create_columns(column_info *cinfo, const char *buf, const jsmntok
 		}
 	}
 
-	cols = i;
-
 	col_setup(cinfo, cols);
 
 	for (i = 0; i < cols; i++)
@@ -749,7 +865,7 @@ sharkd_session_create_columns(column_info *cinfo, const char *buf, const jsmntok
 
 		if (col_item->col_fmt == COL_CUSTOM)
 		{
-			col_item->col_custom_fields = g_strdup(columns_custom[i]);
+			col_item->col_custom_fields = g_strndup(columns[i], strchr(columns[i], ':') - columns[i]);
 			col_item->col_custom_occurrence = columns_occur[i];
 		}
 
@@ -761,6 +877,160 @@ sharkd_session_create_columns(column_info *cinfo, const char *buf, const jsmntok
 	return cinfo;
 }
 
+static GHashTable *
+sharkd_column_cache_rows(const char *columns_key)
+{
+	GHashTable *rows;
+
+	/* Start again rather than grow without bound. */
+	if (column_cache_size >= SHARKD_COLUMN_CACHE_MAX_SIZE)
+		sharkd_column_cache_clear();
+
+	if (!column_cache)
+		column_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_hash_table_destroy);
+
+	rows = (GHashTable *) g_hash_table_lookup(column_cache, columns_key);
+	if (!rows)
+	{
+		rows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, sharkd_column_row_free);
+		g_hash_table_insert(column_cache, g_strdup(columns_key), rows);
+	}
+
+	return rows;
+}
+
+/*
+ * Gets the column strings of a frame, from the cache if it has them and
+ * by dissecting the frame otherwise.
+ */
+static void
+sharkd_session_frame_columns(GHashTable *rows, frame_data *fdata, guint32 ref_frame, guint32 prev_dis_num, column_info *cinfo, const char **col_data)
+{
+	struct sharkd_column_row *row;
+	const char *data;
+	char *p;
+	int col;
+
+	row = (struct sharkd_column_row *) g_hash_table_lookup(rows, GUINT_TO_POINTER(fdata->num));
+	if (!row || row->frame_ref_num != ref_frame || row->prev_dis_num != prev_dis_num)
+	{
+		sharkd_dissect_columns(fdata, ref_frame, prev_dis_num, cinfo, (fdata->color_filter == NULL));
+
+		if (row)
+		{
+			column_cache_size -= row->size;
+			g_hash_table_remove(rows, GUINT_TO_POINTER(fdata->num));
+		}
+
+		if (column_cache_size >= SHARKD_COLUMN_CACHE_MAX_SIZE)
+		{
+			for (col = 0; col < cinfo->num_cols; ++col)
+				col_data[col] = cinfo->columns[col].col_data ? cinfo->columns[col].col_data : "";
+			return;
+		}
+
+		row = g_new(struct sharkd_column_row, 1);
+		row->frame_ref_num = ref_frame;
+		row->prev_dis_num = prev_dis_num;
+		row->size = 0;
+		for (col = 0; col < cinfo->num_cols; ++col)
+			row->size += (cinfo->columns[col].col_data ? strlen(cinfo->columns[col].col_data) : 0) + 1;
+
+		row->col_data = p = (char *) g_malloc(row->size);
+		for (col = 0; col < cinfo->num_cols; ++col)
+		{
+			const char *str = cinfo->columns[col].col_data ? cinfo->columns[col].col_data : "";
+			size_t len = strlen(str) + 1;
+
+			memcpy(p, str, len);
+			p += len;
+		}
+
+		column_cache_size += row->size;
+		g_hash_table_insert(rows, GUINT_TO_POINTER(fdata->num), row);
+	}
+
+	data = row->col_data;
+	for (col = 0; col < cinfo->num_cols; ++col)
+	{
+		col_data[col] = data;
+		data += strlen(data) + 1;
+	}
+}
+
+/*
+ * Where a frames listing is: the filter, columns and time references it
+ * was started with, and the next frame to list. Frames requests with a
+ * cursor continue from where the last one with the same cursor stopped.
+ */
+struct sharkd_frames_cursor
+{
+	char *filter;           /* NULL for all frames */
+	char **columns;         /* empty for the default columns */
+	char *refs;             /* NULL if there are no time references */
+	const char *refs_pos;   /* in refs, after next_ref_frame */
+	guint32 framenum;
+	guint32 prev_dis_num;
+	guint32 current_ref_frame;
+	guint32 next_ref_frame;
+};
+
+static void
+sharkd_frames_cursor_free(gpointer data)
+{
+	struct sharkd_frames_cursor *cursor = (struct sharkd_frames_cursor *) data;
+
+	g_free(cursor->filter);
+	g_strfreev(cursor->columns);
+	g_free(cursor->refs);
+	g_free(cursor);
+}
+
+/* Rows written between flushes, so that clients get long listings as they're made. */
+#define SHARKD_FRAMES_FLUSH_ROWS 256
+
+static void
+sharkd_session_frame_cbor(GByteArray *out, guint32 framenum, const frame_data *fdata, const char **col_data, int num_cols, gboolean commented)
+{
+	int col;
+
+	cbor_write_map(out, 2 + (commented ? 1 : 0) + (fdata->ignored ? 1 : 0) + (fdata->marked ? 1 : 0) + (fdata->color_filter ? 2 : 0));
+
+	cbor_write_text(out, "c", -1);
+	cbor_write_array(out, num_cols);
+	for (col = 0; col < num_cols; ++col)
+		cbor_write_text(out, col_data[col], -1);
+
+	cbor_write_text(out, "num", -1);
+	cbor_write_uint(out, framenum);
+
+	if (commented)
+	{
+		cbor_write_text(out, "ct", -1);
+		cbor_write_bool(out, TRUE);
+	}
+
+	if (fdata->ignored)
+	{
+		cbor_write_text(out, "i", -1);
+		cbor_write_bool(out, TRUE);
+	}
+
+	if (fdata->marked)
+	{
+		cbor_write_text(out, "m", -1);
+		cbor_write_bool(out, TRUE);
+	}
+
+	if (fdata->color_filter)
+	{
+		cbor_write_text(out, "bg", -1);
+		cbor_write_uint(out, color_t_to_rgb(&fdata->color_filter->bg_color));
+		cbor_write_text(out, "fg", -1);
+		cbor_write_uint(out, color_t_to_rgb(&fdata->color_filter->fg_color));
+	}
+}
+
 /**
  * sharkd_session_process_frames()
  *
@@ -773,6 +1043,11 @@ sharkd_session_create_columns(column_info *cinfo, const char *buf, const jsmntok
  *   (o) skip=N   - skip N frames
  *   (o) limit=N  - show only N frames
  *   (o) refs  - list (comma separated) with sorted time reference frame numbers.
+ *   (o) cursor - name of a cursor kept by the server. The first request with a name starts
+ *                the listing with its filter, columns and refs; later requests with the
+ *                same name and none of those continue after the last frame listed, with
+ *                skip counted from there.
+ *   (o) format - 'json' (default) or 'cbor'
  *
  * Output array of frames with attributes:
  *   (m) c   - array of column data
@@ -782,45 +1057,50 @@ sharkd_session_create_columns(column_info *cinfo, const char *buf, const jsmntok
  *   (o) ct  - if frame is commented
  *   (o) bg  - color filter - background color in hex
  *   (o) fg  - color filter - foreground color in hex
+ *
+ * With format 'cbor', output object with attribute:
+ *   (m) cbor - base64 of a CBOR array of frames, each a map with the attributes above;
+ *              num, bg and fg are integers, and i, m and ct booleans.
+ *
+ * The column strings are cached for each set of columns, so frames listed before
+ * aren't dissected again.
  */
 static void
 sharkd_session_process_frames(const char *buf, const jsmntok_t *tokens, int count)
 {
 	const char *tok_filter = json_find_attr(buf, tokens, count, "filter");
-	const char *tok_column = json_find_attr(buf, tokens, count, "column0");
 	const char *tok_skip   = json_find_attr(buf, tokens, count, "skip");
 	const char *tok_limit  = json_find_attr(buf, tokens, count, "limit");
 	const char *tok_refs   = json_find_attr(buf, tokens, count, "refs");
+	const char *tok_cursor = json_find_attr(buf, tokens, count, "cursor");
+	const char *tok_columns[SHARKD_MAX_COLUMNS];
+	int tok_cols;
+
+	struct sharkd_frames_cursor *cursor = NULL;
+	struct sharkd_frames_cursor new_cursor;
 
 	const guint8 *filter_data = NULL;
 
 	int col;
 
-	guint32 framenum, prev_dis_num = 0;
-	guint32 current_ref_frame = 0, next_ref_frame = G_MAXUINT32;
+	guint32 framenum;
 	guint32 skip;
 	guint32 limit;
+	guint32 rows_written = 0;
 
 	column_info *cinfo = &cfile.cinfo;
 	column_info user_cinfo;
 
-	if (tok_column)
-	{
-		memset(&user_cinfo, 0, sizeof(user_cinfo));
-		cinfo = sharkd_session_create_columns(&user_cinfo, buf, tokens, count);
-		if (!cinfo)
-			return;
-	}
+	char *columns_key;
+	GHashTable *column_rows;
+	const char **col_data;
 
-	if (tok_filter)
-	{
-		const struct sharkd_filter_item *filter_item;
+	gboolean use_cbor;
+	GByteArray *frames_cbor = NULL;
+	guint32 frames_count = 0;
 
-		filter_item = sharkd_session_filter_data(tok_filter);
-		if (!filter_item)
-			return;
-		filter_data = filter_item->filtered;
-	}
+	if (!sharkd_session_parse_format(buf, tokens, count, &use_cbor))
+		return;
 
 	skip = 0;
 	if (tok_skip)
@@ -836,17 +1116,83 @@ sharkd_session_process_frames(const char *buf, const jsmntok_t *tokens, int coun
 			return;
 	}
 
-	if (tok_refs)
+	tok_cols = sharkd_session_request_columns(buf, tokens, count, tok_columns);
+
+	if (tok_cursor && frames_cursors)
 	{
-		if (!ws_strtou32(tok_refs, &tok_refs, &next_ref_frame))
-			return;
+		cursor = (struct sharkd_frames_cursor *) g_hash_table_lookup(frames_cursors, tok_cursor);
+
+		/* A new listing under the same name */
+		if (cursor && (tok_filter || tok_cols > 0 || tok_refs))
+		{
+			g_hash_table_remove(frames_cursors, tok_cursor);
+			cursor = NULL;
+		}
 	}
 
-	sharkd_json_array_open(NULL);
-	for (framenum = 1; framenum <= cfile.count; framenum++)
+	if (!cursor)
+	{
+		memset(&new_cursor, 0, sizeof(new_cursor));
+		new_cursor.framenum = 1;
+		new_cursor.next_ref_frame = G_MAXUINT32;
+
+		if (tok_refs)
+		{
+			if (!ws_strtou32(tok_refs, &tok_refs, &new_cursor.next_ref_frame))
+				return;
+		}
+
+		new_cursor.filter = g_strdup(tok_filter);
+		new_cursor.columns = g_new0(char *, tok_cols + 1);
+		for (col = 0; col < tok_cols; col++)
+			new_cursor.columns[col] = g_strdup(tok_columns[col]);
+		new_cursor.refs = g_strdup(tok_refs);
+		new_cursor.refs_pos = new_cursor.refs;
+
+		cursor = &new_cursor;
+	}
+
+	if (cursor->columns[0])
+	{
+		memset(&user_cinfo, 0, sizeof(user_cinfo));
+		cinfo = sharkd_session_create_columns(&user_cinfo, (const char * const *) cursor->columns, g_strv_length(cursor->columns));
+		if (!cinfo)
+			goto fail;
+	}
+
+	if (cursor->filter)
+	{
+		const struct sharkd_filter_item *filter_item;
+
+		filter_item = sharkd_session_filter_data(cursor->filter);
+		if (!filter_item)
+			goto fail;
+		filter_data = filter_item->filtered;
+	}
+
+	if (cursor == &new_cursor && tok_cursor)
+	{
+		if (!frames_cursors)
+			frames_cursors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, sharkd_frames_cursor_free);
+		cursor = (struct sharkd_frames_cursor *) g_memdup(&new_cursor, sizeof(new_cursor));
+		g_hash_table_insert(frames_cursors, g_strdup(tok_cursor), cursor);
+	}
+
+	columns_key = g_strjoinv("\n", cursor->columns);
+	column_rows = sharkd_column_cache_rows(columns_key);
+	g_free(columns_key);
+	col_data = g_new(const char *, cinfo->num_cols);
+
+	if (use_cbor)
+		frames_cbor = g_byte_array_new();
+	else
+		sharkd_json_array_open(NULL);
+
+	for (framenum = cursor->framenum; framenum <= cfile.count; framenum++)
 	{
 		frame_data *fdata;
 		guint32 ref_frame = (framenum != 1) ? 1 : 0;
+		gboolean commented;
 
 		if (filter_data && !(filter_data[framenum / 8] & (1 << (framenum % 8))))
 			continue;
@@ -854,86 +1200,126 @@ sharkd_session_process_frames(const char *buf, const jsmntok_t *tokens, int coun
 		if (skip)
 		{
 			skip--;
-			prev_dis_num = framenum;
+			cursor->prev_dis_num = framenum;
 			continue;
 		}
 
-		if (tok_refs)
+		if (cursor->refs)
 		{
-			if (framenum >= next_ref_frame)
+			if (framenum >= cursor->next_ref_frame)
 			{
-				current_ref_frame = next_ref_frame;
+				cursor->current_ref_frame = cursor->next_ref_frame;
 
-				if (*tok_refs != ',')
-					next_ref_frame = G_MAXUINT32;
+				if (*cursor->refs_pos != ',')
+					cursor->next_ref_frame = G_MAXUINT32;
 
-				while (*tok_refs == ',' && framenum >= next_ref_frame)
+				while (*cursor->refs_pos == ',' && framenum >= cursor->next_ref_frame)
 				{
-					current_ref_frame = next_ref_frame;
+					cursor->current_ref_frame = cursor->next_ref_frame;
 
-					if (!ws_strtou32(tok_refs + 1, &tok_refs, &next_ref_frame))
+					if (!ws_strtou32(cursor->refs_pos + 1, &cursor->refs_pos, &cursor->next_ref_frame))
 					{
-						fprintf(stderr, "sharkd_session_process_frames() wrong format for refs: %s\n", tok_refs);
+						fprintf(stderr, "sharkd_session_process_frames() wrong format for refs: %s\n", cursor->refs_pos);
 						break;
 					}
 				}
 
-				if (*tok_refs == '\0' && framenum >= next_ref_frame)
+				if (*cursor->refs_pos == '\0' && framenum >= cursor->next_ref_frame)
 				{
-					current_ref_frame = next_ref_frame;
-					next_ref_frame = G_MAXUINT32;
+					cursor->current_ref_frame = cursor->next_ref_frame;
+					cursor->next_ref_frame = G_MAXUINT32;
 				}
 			}
 
-			if (current_ref_frame)
-				ref_frame = current_ref_frame;
+			if (cursor->current_ref_frame)
+				ref_frame = cursor->current_ref_frame;
 		}
 
 		fdata = sharkd_get_frame(framenum);
-		sharkd_dissect_columns(fdata, ref_frame, prev_dis_num, cinfo, (fdata->color_filter == NULL));
+		sharkd_session_frame_columns(column_rows, fdata, ref_frame, cursor->prev_dis_num, cinfo, col_data);
 
-		json_dumper_begin_object(&dumper);
+		commented = FALSE;
+		if (fdata->has_user_comment || fdata->has_phdr_comment)
+			commented = (!fdata->has_user_comment || sharkd_get_user_comment(fdata) != NULL);
 
-		sharkd_json_array_open("c");
-		for (col = 0; col < cinfo->num_cols; ++col)
+		if (frames_cbor)
 		{
-			const col_item_t *col_item = &cinfo->columns[col];
-
-			sharkd_json_value_string(NULL, col_item->col_data);
+			sharkd_session_frame_cbor(frames_cbor, framenum, fdata, col_data, cinfo->num_cols, commented);
+			frames_count++;
 		}
-		sharkd_json_array_close();
+		else
+		{
+			json_dumper_begin_object(&dumper);
 
-		sharkd_json_value_anyf("num", "%u", framenum);
+			sharkd_json_array_open("c");
+			for (col = 0; col < cinfo->num_cols; ++col)
+				sharkd_json_value_string(NULL, col_data[col]);
+			sharkd_json_array_close();
 
-		if (fdata->has_user_comment || fdata->has_phdr_comment)
-		{
-			if (!fdata->has_user_comment || sharkd_get_user_comment(fdata) != NULL)
+			sharkd_json_value_anyf("num", "%u", framenum);
+
+			if (commented)
 				sharkd_json_value_anyf("ct", "true");
-		}
 
-		if (fdata->ignored)
-			sharkd_json_value_anyf("i", "true");
+			if (fdata->ignored)
+				sharkd_json_value_anyf("i", "true");
 
-		if (fdata->marked)
-			sharkd_json_value_anyf("m", "true");
+			if (fdata->marked)
+				sharkd_json_value_anyf("m", "true");
 
-		if (fdata->color_filter)
-		{
-			sharkd_json_value_stringf("bg", "%x", color_t_to_rgb(&fdata->color_filter->bg_color));
-			sharkd_json_value_stringf("fg", "%x", color_t_to_rgb(&fdata->color_filter->fg_color));
+			if (fdata->color_filter)
+			{
+				sharkd_json_value_stringf("bg", "%x", color_t_to_rgb(&fdata->color_filter->bg_color));
+				sharkd_json_value_stringf("fg", "%x", color_t_to_rgb(&fdata->color_filter->fg_color));
+			}
+
+			json_dumper_end_object(&dumper);
+
+			if (++rows_written % SHARKD_FRAMES_FLUSH_ROWS == 0)
+				fflush(stdout);
 		}
 
-		json_dumper_end_object(&dumper);
-		prev_dis_num = framenum;
+		cursor->prev_dis_num = framenum;
 
 		if (limit && --limit == 0)
+		{
+			framenum++;
 			break;
+		}
 	}
-	sharkd_json_array_close();
+	cursor->framenum = framenum;
+
+	if (frames_cbor)
+	{
+		/* The frames were written aside, as their count wasn't known. */
+		GByteArray *reply = g_byte_array_sized_new(frames_cbor->len + 9);
+
+		cbor_write_array(reply, frames_count);
+		g_byte_array_append(reply, frames_cbor->data, frames_cbor->len);
+
+		json_dumper_begin_object(&dumper);
+		sharkd_json_value_base64("cbor", reply->data, reply->len);
+		json_dumper_end_object(&dumper);
+
+		g_byte_array_free(reply, TRUE);
+		g_byte_array_free(frames_cbor, TRUE);
+	}
+	else
+		sharkd_json_array_close();
 	json_dumper_finish(&dumper);
 
+	g_free(col_data);
+
+fail:
 	if (cinfo != &cfile.cinfo)
 		col_cleanup(cinfo);
+
+	if (cursor == &new_cursor)
+	{
+		g_free(new_cursor.filter);
+		g_strfreev(new_cursor.columns);
+		g_free(new_cursor.refs);
+	}
 }
 
 static void
@@ -2763,6 +3149,7 @@ sharkd_follower_visit_layers_cb(const void *key _U_, void *value, void *user_dat
 struct sharkd_frame_request_data
 {
 	gboolean display_hidden;
+	gboolean use_cbor;
 };
 
 static void
@@ -2774,6 +3161,7 @@ sharkd_session_process_frame_cb(epan_dissect_t *edt, proto_tree *tree, struct ep
 
 	const struct sharkd_frame_request_data * const req_data = (const struct sharkd_frame_request_data * const) data;
 	const gboolean display_hidden = (req_data) ? req_data->display_hidden : FALSE;
+	const gboolean use_cbor = (req_data) ? req_data->use_cbor : FALSE;
 
 	json_dumper_begin_object(&dumper);
 
@@ -2787,7 +3175,18 @@ sharkd_session_process_frame_cb(epan_dissect_t *edt, proto_tree *tree, struct ep
 	if (pkt_comment)
 		sharkd_json_value_string("comment", pkt_comment);
 
-	if (tree)
+	if (tree && use_cbor)
+	{
+		cbor_tree_writer *writer = write_cbor_preamble(NULL);
+		const guint8 *tree_cbor;
+		size_t tree_cbor_len;
+
+		write_cbor_proto_tree(NULL, PF_NONE, edt, writer);
+		tree_cbor = write_cbor_get_output(writer, &tree_cbor_len);
+		sharkd_json_value_base64("cbor", tree_cbor, tree_cbor_len);
+		write_cbor_finale(writer);
+	}
+	else if (tree)
 	{
 		tvbuff_t **tvbs = NULL;
 
@@ -2918,6 +3317,7 @@ sharkd_session_process_frame_cb(epan_dissect_t *edt, proto_tree *tree, struct ep
 }
 
 #define SHARKD_IOGRAPH_MAX_ITEMS 250000 /* 250k limit of items is taken from wireshark-qt, on x86_64 sizeof(io_graph_item_t) is 152, so single graph can take max 36 MB */
+#define SHARKD_IOGRAPH_MAX_CACHED_ITEMS SHARKD_IOGRAPH_MAX_ITEMS /* of all the levels of a cached graph */
 
 struct sharkd_iograph
 {
@@ -2925,11 +3325,10 @@ struct sharkd_iograph
 	int hf_index;
 	io_graph_item_unit_t calc_type;
 	guint32 interval;
+	char *key;
 
 	/* result */
-	int space_items;
-	int num_items;
-	io_graph_item_t *items;
+	io_graph_tree_t *tree;
 	GString *error;
 };
 
@@ -2937,36 +3336,53 @@ static tap_packet_status
 sharkd_iograph_packet(void *g, packet_info *pinfo, epan_dissect_t *edt, const void *dummy _U_)
 {
 	struct sharkd_iograph *graph = (struct sharkd_iograph *) g;
-	int idx;
 	gboolean update_succeeded;
 
-	idx = get_io_graph_index(pinfo, graph->interval);
-	if (idx < 0 || idx >= SHARKD_IOGRAPH_MAX_ITEMS)
-		return TAP_PACKET_DONT_REDRAW;
-
-	if (idx + 1 > graph->num_items)
-	{
-		if (idx + 1 > graph->space_items)
-		{
-			int new_size = idx + 1024;
+	update_succeeded = io_graph_tree_update(graph->tree, pinfo, edt);
+	/* XXX - TAP_PACKET_FAILED if the item couldn't be updated, with an error message? */
+	return update_succeeded ? TAP_PACKET_REDRAW : TAP_PACKET_DONT_REDRAW;
+}
 
-			graph->items = (io_graph_item_t *) g_realloc(graph->items, sizeof(io_graph_item_t) * new_size);
-			reset_io_graph_items(&graph->items[graph->space_items], new_size - graph->space_items);
+/*
+ * Sets the calculation and field of a graph from its request, one of
+ * the graph0...graph9 attributes of iograph requests.
+ */
+static gboolean
+sharkd_iograph_setup(struct sharkd_iograph *graph, const char *tok_graph)
+{
+	const char *field_name;
+
+	if (!strcmp(tok_graph, "packets"))
+		graph->calc_type = IOG_ITEM_UNIT_PACKETS;
+	else if (!strcmp(tok_graph, "bytes"))
+		graph->calc_type = IOG_ITEM_UNIT_BYTES;
+	else if (!strcmp(tok_graph, "bits"))
+		graph->calc_type = IOG_ITEM_UNIT_BITS;
+	else if (g_str_has_prefix(tok_graph, "sum:"))
+		graph->calc_type = IOG_ITEM_UNIT_CALC_SUM;
+	else if (g_str_has_prefix(tok_graph, "frames:"))
+		graph->calc_type = IOG_ITEM_UNIT_CALC_FRAMES;
+	else if (g_str_has_prefix(tok_graph, "fields:"))
+		graph->calc_type = IOG_ITEM_UNIT_CALC_FIELDS;
+	else if (g_str_has_prefix(tok_graph, "max:"))
+		graph->calc_type = IOG_ITEM_UNIT_CALC_MAX;
+	else if (g_str_has_prefix(tok_graph, "min:"))
+		graph->calc_type = IOG_ITEM_UNIT_CALC_MIN;
+	else if (g_str_has_prefix(tok_graph, "avg:"))
+		graph->calc_type = IOG_ITEM_UNIT_CALC_AVERAGE;
+	else if (g_str_has_prefix(tok_graph, "load:"))
+		graph->calc_type = IOG_ITEM_UNIT_CALC_LOAD;
+	else
+		return FALSE;
 
-			graph->space_items = new_size;
-		}
-		else if (graph->items == NULL)
-		{
-			graph->items = (io_graph_item_t *) g_malloc(sizeof(io_graph_item_t) * graph->space_items);
-			reset_io_graph_items(graph->items, graph->space_items);
-		}
+	field_name = strchr(tok_graph, ':');
+	if (field_name)
+		field_name = field_name + 1;
 
-		graph->num_items = idx + 1;
-	}
+	graph->hf_index = -1;
+	graph->error = check_field_unit(field_name, &graph->hf_index, graph->calc_type);
 
-	update_succeeded = update_io_graph_item(graph->items, idx, pinfo, edt, graph->hf_index, graph->calc_type, graph->interval);
-	/* XXX - TAP_PACKET_FAILED if the item couldn't be updated, with an error message? */
-	return update_succeeded ? TAP_PACKET_REDRAW : TAP_PACKET_DONT_REDRAW;
+	return TRUE;
 }
 
 /**
@@ -3016,7 +3432,6 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 		const char *tok_graph;
 		const char *tok_filter;
 		char tok_format_buf[32];
-		const char *field_name;
 
 		snprintf(tok_format_buf, sizeof(tok_format_buf), "graph%d", i);
 		tok_graph = json_find_attr(buf, tokens, count, tok_format_buf);
@@ -3026,44 +3441,36 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 		snprintf(tok_format_buf, sizeof(tok_format_buf), "filter%d", i);
 		tok_filter = json_find_attr(buf, tokens, count, tok_format_buf);
 
-		if (!strcmp(tok_graph, "packets"))
-			graph->calc_type = IOG_ITEM_UNIT_PACKETS;
-		else if (!strcmp(tok_graph, "bytes"))
-			graph->calc_type = IOG_ITEM_UNIT_BYTES;
-		else if (!strcmp(tok_graph, "bits"))
-			graph->calc_type = IOG_ITEM_UNIT_BITS;
-		else if (g_str_has_prefix(tok_graph, "sum:"))
-			graph->calc_type = IOG_ITEM_UNIT_CALC_SUM;
-		else if (g_str_has_prefix(tok_graph, "frames:"))
-			graph->calc_type = IOG_ITEM_UNIT_CALC_FRAMES;
-		else if (g_str_has_prefix(tok_graph, "fields:"))
-			graph->calc_type = IOG_ITEM_UNIT_CALC_FIELDS;
-		else if (g_str_has_prefix(tok_graph, "max:"))
-			graph->calc_type = IOG_ITEM_UNIT_CALC_MAX;
-		else if (g_str_has_prefix(tok_graph, "min:"))
-			graph->calc_type = IOG_ITEM_UNIT_CALC_MIN;
-		else if (g_str_has_prefix(tok_graph, "avg:"))
-			graph->calc_type = IOG_ITEM_UNIT_CALC_AVERAGE;
-		else if (g_str_has_prefix(tok_graph, "load:"))
-			graph->calc_type = IOG_ITEM_UNIT_CALC_LOAD;
-		else
+		if (!sharkd_iograph_setup(graph, tok_graph))
 			break;
 
-		field_name = strchr(tok_graph, ':');
-		if (field_name)
-			field_name = field_name + 1;
-
 		graph->interval = interval_ms;
 
-		graph->hf_index = -1;
-		graph->error = check_field_unit(field_name, &graph->hf_index, graph->calc_type);
+		graph->key = g_strdup_printf("%s\n%s", tok_graph, tok_filter ? tok_filter : "");
+		graph->tree = NULL;
 
-		graph->space_items = 0; /* TODO, can avoid realloc()s in sharkd_iograph_packet() by calculating: capture_time / interval */
-		graph->num_items = 0;
-		graph->items = NULL;
+		if (!graph->error && iograph_cache)
+		{
+			gpointer cached_key, cached_tree;
+
+			if (g_hash_table_lookup_extended(iograph_cache, graph->key, &cached_key, &cached_tree) &&
+			    io_graph_tree_get_items((io_graph_tree_t *) cached_tree, graph->hf_index, graph->calc_type, interval_ms, 0, NULL, 0) >= 0)
+			{
+				g_hash_table_steal(iograph_cache, graph->key);
+				g_free(cached_key);
+				graph->tree = (io_graph_tree_t *) cached_tree;
+				graph_count++;
+				continue;
+			}
+		}
 
 		if (!graph->error)
+		{
+			/* Coarser levels let later requests reuse this graph */
+			graph->tree = io_graph_tree_new(interval_ms, 6, SHARKD_IOGRAPH_MAX_ITEMS);
+			io_graph_tree_reset(graph->tree, graph->hf_index, graph->calc_type);
 			graph->error = register_tap_listener("frame", graph, tok_filter, TL_REQUIRES_PROTO_TREE, NULL, sharkd_iograph_packet, NULL, NULL);
+		}
 
 		graph_count++;
 
@@ -3071,10 +3478,13 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 			is_any_ok = TRUE;
 	}
 
-	/* retap only if we have at least one ok */
+	/* retap only if we have at least one graph that isn't cached */
 	if (is_any_ok)
 		sharkd_retap();
 
+	sharkd_iograph_cache_clear();
+	iograph_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) io_graph_tree_free);
+
 	json_dumper_begin_object(&dumper);
 
 	sharkd_json_array_open("iograph");
@@ -3093,13 +3503,19 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 		{
 			int idx;
 			int next_idx = 0;
+			int num_items;
+			io_graph_item_t *items;
+
+			num_items = io_graph_tree_get_items(graph->tree, graph->hf_index, graph->calc_type, graph->interval, 0, NULL, 0);
+			items = g_new(io_graph_item_t, num_items);
+			io_graph_tree_get_items(graph->tree, graph->hf_index, graph->calc_type, graph->interval, 0, items, num_items);
 
 			sharkd_json_array_open("items");
-			for (idx = 0; idx < graph->num_items; idx++)
+			for (idx = 0; idx < num_items; idx++)
 			{
 				double val;
 
-				val = get_io_graph_item(graph->items, graph->calc_type, idx, graph->hf_index, &cfile, graph->interval, graph->num_items);
+				val = get_io_graph_item(items, graph->calc_type, idx, graph->hf_index, &cfile, graph->interval, num_items);
 
 				/* if it's zero, don't display */
 				if (val == 0.0)
@@ -3113,11 +3529,21 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 				next_idx = idx + 1;
 			}
 			sharkd_json_array_close();
+			g_free(items);
 		}
 		json_dumper_end_object(&dumper);
 
 		remove_tap_listener(graph);
-		g_free(graph->items);
+		if (graph->tree && !graph->error)
+		{
+			io_graph_tree_limit(graph->tree, SHARKD_IOGRAPH_MAX_CACHED_ITEMS);
+			g_hash_table_insert(iograph_cache, graph->key, graph->tree);
+		}
+		else
+		{
+			io_graph_tree_free(graph->tree);
+			g_free(graph->key);
+		}
 	}
 	sharkd_json_array_close();
 
@@ -3125,6 +3551,126 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 	json_dumper_finish(&dumper);
 }
 
+/*
+ * Adds the frames from first_framenum on to the cached graphs.
+ */
+static void
+sharkd_iograph_cache_update(guint32 first_framenum)
+{
+	struct sharkd_iograph *graphs;
+	int graph_count = 0;
+	GHashTableIter iter;
+	gpointer key, value;
+	int i;
+
+	if (!iograph_cache || g_hash_table_size(iograph_cache) == 0)
+		return;
+
+	graphs = g_new(struct sharkd_iograph, g_hash_table_size(iograph_cache));
+
+	g_hash_table_iter_init(&iter, iograph_cache);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		struct sharkd_iograph *graph = &graphs[graph_count];
+		const char *tok_filter = strchr((const char *) key, '\n') + 1;
+		char *tok_graph = g_strndup((const char *) key, tok_filter - 1 - (const char *) key);
+
+		graph->key = (char *) key;
+		graph->tree = (io_graph_tree_t *) value;
+		graph->error = NULL;
+
+		if (sharkd_iograph_setup(graph, tok_graph) && !graph->error)
+			graph->error = register_tap_listener("frame", graph, *tok_filter ? tok_filter : NULL, TL_REQUIRES_PROTO_TREE, NULL, sharkd_iograph_packet, NULL, NULL);
+		g_free(tok_graph);
+
+		if (graph->error)
+		{
+			/* Can't be brought up to date, so it goes */
+			g_string_free(graph->error, TRUE);
+			g_hash_table_iter_remove(&iter);
+			continue;
+		}
+
+		graph_count++;
+	}
+
+	if (graph_count > 0)
+		sharkd_retap_from(first_framenum);
+
+	for (i = 0; i < graph_count; i++)
+	{
+		remove_tap_listener(&graphs[i]);
+		io_graph_tree_limit(graphs[i].tree, SHARKD_IOGRAPH_MAX_CACHED_ITEMS);
+	}
+
+	g_free(graphs);
+}
+
+/**
+ * sharkd_session_process_tail()
+ *
+ * Process tail request - read the frames written to a file loaded with tail since
+ * it was last read
+ *
+ * Input:
+ *   (o) finish - set if the file is complete; its remaining frames are read,
+ *                and it's no longer followed
+ *
+ * Output object with attributes:
+ *   (m) err    - error code
+ *   (m) frames - count of currently loaded frames
+ *   (m) new    - count of the frames read by this request
+ *   (o) tail   - true if the file is still followed
+ *
+ * Cached filter results and graphs of previous iograph requests are brought up
+ * to date by dissecting only the new frames.
+ */
+static void
+sharkd_session_process_tail(const char *buf, const jsmntok_t *tokens, int count)
+{
+	gboolean finish = (json_find_attr(buf, tokens, count, "finish") != NULL);
+	guint32 first_framenum = cfile.count + 1;
+	int err = 0;
+
+	TRY
+	{
+		err = sharkd_continue_tail(finish);
+	}
+	CATCH(OutOfMemoryError)
+	{
+		fprintf(stderr, "tail: OutOfMemoryError\n");
+		err = ENOMEM;
+	}
+	ENDTRY;
+
+	if (cfile.count >= first_framenum)
+	{
+		GHashTableIter iter;
+		gpointer key, value;
+
+		g_hash_table_iter_init(&iter, filter_table);
+		while (g_hash_table_iter_next(&iter, &key, &value))
+		{
+			struct sharkd_filter_item *l = (struct sharkd_filter_item *) value;
+
+			/* NULL if all frames match, as the new ones do too */
+			if (l->filtered)
+				sharkd_filter_update((const char *) key, first_framenum, &l->filtered);
+		}
+
+		sharkd_iograph_cache_update(first_framenum);
+	}
+
+	json_dumper_begin_object(&dumper);
+	sharkd_json_value_anyf("err", "%d", err);
+	sharkd_json_value_anyf("frames", "%u", cfile.count);
+	sharkd_json_value_anyf("new", "%u", cfile.count - (first_framenum - 1));
+	if (sharkd_is_tailing())
+		sharkd_json_value_anyf("tail", "true");
+	json_dumper_end_object(&dumper);
+	json_dumper_finish(&dumper);
+}
+
 /**
  * sharkd_session_process_intervals()
  *
@@ -3264,6 +3810,7 @@ sharkd_session_process_intervals(char *buf, const jsmntok_t *tokens, int count)
  *   (o) color - set if output color-filter bg/fg
  *   (o) bytes - set if output frame bytes
  *   (o) hidden - set if output hidden tree fields
+ *   (o) format - 'json' (default) or 'cbor' for the tree
  *
  * Output object with attributes:
  *   (m) err   - 0 if succeed
@@ -3282,6 +3829,8 @@ sharkd_session_process_intervals(char *buf, const jsmntok_t *tokens, int count)
  *                  fnum - only for t:'framenum', frame number
  *                  g - if field is generated by Wireshark
  *                  v - if field is hidden
+ *   (o) cbor  - with format 'cbor', instead of tree: base64 of the frame tree as a
+ *               CBOR sequence, as written by tshark -T cbor (hidden fields included)
  *
  *   (o) col   - array of column data
  *   (o) bytes - base64 of frame bytes
@@ -3327,6 +3876,8 @@ sharkd_session_process_frame(char *buf, const jsmntok_t *tokens, int count)
 		dissect_flags |= SHARKD_DISSECT_FLAG_COLOR;
 
 	req_data.display_hidden = (json_find_attr(buf, tokens, count, "v") != NULL);
+	if (!sharkd_session_parse_format(buf, tokens, count, &req_data.use_cbor))
+		return;
 
 	sharkd_dissect_request(framenum, ref_frame_num, prev_dis_num, &sharkd_session_process_frame_cb, dissect_flags, &req_data);
 }
@@ -3587,6 +4138,9 @@ sharkd_session_process_setcomment(char *buf, const jsmntok_t *tokens, int count)
 
 	ret = sharkd_set_user_comment(fdata, tok_comment);
 
+	/* Columns might show the comment */
+	sharkd_column_cache_clear();
+
 	sharkd_json_simple_reply(ret, NULL);
 }
 
@@ -3619,6 +4173,12 @@ sharkd_session_process_setconf(char *buf, const jsmntok_t *tokens, int count)
 
 	ret = prefs_set_pref(pref, &errmsg);
 
+	/* Dissection might have changed */
+	sharkd_iograph_cache_clear();
+	sharkd_column_cache_clear();
+	if (ret == PREFS_SET_OK)
+		session_prefs_changed = TRUE;
+
 	sharkd_json_simple_reply(ret, errmsg);
 	g_free(errmsg);
 }
@@ -4194,6 +4754,8 @@ sharkd_session_process(char *buf, const jsmntok_t *tokens, int count)
 
 		if (!strcmp(tok_req, "load"))
 			sharkd_session_process_load(buf, tokens, count);
+		else if (!strcmp(tok_req, "tail"))
+			sharkd_session_process_tail(buf, tokens, count);
 		else if (!strcmp(tok_req, "status"))
 			sharkd_session_process_status();
 		else if (!strcmp(tok_req, "analyse"))
@@ -4250,8 +4812,13 @@ sharkd_session_process(char *buf, const jsmntok_t *tokens, int count)
 	}
 }
 
+/*
+ * Runs a session on stdin and stdout. If loaded is TRUE, the session was
+ * forked from a process holding a preloaded capture file for a client
+ * whose load request hasn't been answered yet.
+ */
 int
-sharkd_session_main(void)
+sharkd_session_main(gboolean loaded)
 {
 	char buf[2 * 1024];
 	jsmntok_t *tokens = NULL;
@@ -4268,6 +4835,12 @@ sharkd_session_main(void)
 	uat_get_table_by_name("MaxMind Database Paths")->post_update_cb();
 #endif
 
+	if (loaded)
+	{
+		sharkd_json_simple_reply(0, NULL);
+		fflush(stdout);
+	}
+
 	while (fgets(buf, sizeof(buf), stdin))
 	{
 		/* every command is line seperated JSON */
@@ -105,6 +105,11 @@ def cmd_dumpcap(program):
     return program('dumpcap')
 
 
+@fixtures.fixture(scope='session')
+def cmd_flowquery(program):
+    return program('flowquery')
+
+
 @fixtures.fixture(scope='session')
 def cmd_mergecap(program):
     return program('mergecap')
@@ -130,6 +135,11 @@ def cmd_editcap(program):
     return program('editcap')
 
 
+@fixtures.fixture(scope='session')
+def cmd_udpdump(program):
+    return program(os.path.join('extcap', 'udpdump'))
+
+
 @fixtures.fixture(scope='session')
 def cmd_wireshark(program):
     return program('wireshark')
@@ -170,6 +180,7 @@ def features(cmd_tshark, make_env):
         have_gnutls='with GnuTLS' in tshark_v,
         have_pkcs11='and PKCS #11 support' in tshark_v,
         have_brotli='with brotli' in tshark_v,
+        have_zlib='with zlib' in tshark_v,
     )
 
 
@@ -11,9 +11,13 @@
 
 import fixtures
 import glob
+import gzip
 import hashlib
 import os
+import re
+import signal
 import socket
+import struct
 import subprocess
 import subprocesstest
 import sys
@@ -302,6 +306,45 @@ def check_dumpcap_ringbuffer_stdin(cmd_dumpcap):
     return check_dumpcap_ringbuffer_stdin_real
 
 
+def sync_pipe_packet_counts(sync_pipe_str):
+    '''Returns the packet counts in what dumpcap wrote to its sync pipe.'''
+    counts = []
+    while len(sync_pipe_str) >= 4:
+        indicator = sync_pipe_str[0]
+        length = (ord(sync_pipe_str[1]) << 16) | (ord(sync_pipe_str[2]) << 8) | ord(sync_pipe_str[3])
+        message = sync_pipe_str[4:4 + length]
+        sync_pipe_str = sync_pipe_str[4 + length:]
+        if indicator == 'P':
+            counts.append(int(message.rstrip('\0')))
+    return counts
+
+
+@fixtures.fixture
+def check_dumpcap_write_buffers_stdin(cmd_dumpcap):
+    def check_dumpcap_write_buffers_stdin_real(self, direct_io=False):
+        # Similar to check_capture_stdin, as a capture child, whose parent
+        # reads the file as packets are reported.
+        testout_file = self.filename_from_id(testout_pcapng)
+        slow_dhcp_cmd = subprocesstest.cat_dhcp_command('slow')
+        capture_cmd = ' '.join((cmd_dumpcap,
+            '-Z', 'none',
+            '-i', '-',
+            '-w', testout_file,
+            '--write-buffers', '4',
+        ))
+        if direct_io:
+            capture_cmd += ' --direct-io'
+        pipe_proc = self.assertRun(slow_dhcp_cmd + ' | ' + capture_cmd, shell=True)
+        self.assertTrue(os.path.isfile(testout_file))
+        self.checkPacketCount(8, cap_file=testout_file)
+        # The packets before the pause are reported without waiting for
+        # the file to be closed.
+        packet_counts = sync_pipe_packet_counts(pipe_proc.stderr_str)
+        self.assertGreaterEqual(len(packet_counts), 2)
+        self.assertEqual(sum(packet_counts), 8)
+    return check_dumpcap_write_buffers_stdin_real
+
+
 @fixtures.fixture
 def check_dumpcap_pcapng_sections(cmd_dumpcap, cmd_tshark, capture_file):
     if sys.platform == 'win32':
@@ -520,6 +563,29 @@ class case_tshark_capture(subprocesstest.SubprocessTestCase):
         '''Capture truncated packets using TShark'''
         check_capture_snapshot_len(self, cmd=cmd_tshark)
 
+    def test_tshark_capture_temp_in_memory(self, cmd_tshark):
+        '''Capture from stdin using TShark, keeping the packets in memory'''
+        if not sys.platform.startswith('linux'):
+            fixtures.skip('--temp-in-memory is only available on Linux')
+        slow_dhcp_cmd = subprocesstest.cat_dhcp_command('slow')
+        capture_cmd = ' '.join((cmd_tshark,
+            '-i', '-',
+            '--temp-in-memory',
+            '-T', 'fields',
+            '-e', 'frame.number',
+            '-e', 'dhcp.option.dhcp',
+        ))
+        tshark_proc = self.assertRun(slow_dhcp_cmd + ' | ' + capture_cmd, shell=True)
+        # Discover, Offer, Request and ACK, twice
+        message_types = [ '1', '2', '3', '5' ] * 2
+        self.assertEqual(tshark_proc.stdout_str.splitlines(),
+            [ '{}\t{}'.format(i + 1, message_types[i]) for i in range(8) ])
+
+        # Without dissection, the packets are only counted.
+        capture_cmd = ' '.join((cmd_tshark, '-i', '-', '--temp-in-memory', '-q'))
+        tshark_proc = self.assertRun(slow_dhcp_cmd + ' | ' + capture_cmd, shell=True)
+        self.assertIn('8 packets captured', tshark_proc.stderr_str)
+
 
 @fixtures.mark_usefixtures('base_env')
 @fixtures.uses_fixtures
@@ -570,6 +636,180 @@ class case_dumpcap_ringbuffer(subprocesstest.SubprocessTestCase):
         '''Capture from stdin using Dumpcap and write multiple files until we reach a packet limit'''
         check_dumpcap_ringbuffer_stdin(self, packets=47) # Last prime before 50. Arbitrary.
 
+    def test_dumpcap_ringbuffer_compress_summary(self, cmd_dumpcap, features):
+        '''Capture from stdin using Dumpcap, compressing and summarizing each finished file of a ring buffer'''
+        if not features.have_zlib:
+            self.skipTest('Requires zlib.')
+        rb_unique = 'dhcp_rb_' + uuid.uuid4().hex[:6] # Random ID
+        testout_file = '{}.{}.pcapng'.format(self.id(), rb_unique)
+        testout_glob = '{}.{}_*'.format(self.id(), rb_unique)
+        cat100_dhcp_cmd = subprocesstest.cat_dhcp_command('cat100')
+        capture_cmd = ' '.join((cmd_dumpcap,
+            '-i', '-',
+            '-w', testout_file,
+            '-b', 'packets:10',
+            '-b', 'files:3',
+            '-b', 'compress:gzip',
+            '-b', 'summary:1',
+        ))
+        self.assertRun(cat100_dhcp_cmd + ' | ' + capture_cmd, shell=True)
+
+        rb_files = sorted(glob.glob(testout_glob))
+        self.cleanup_files.extend(rb_files)
+        # The ring came around, removing the older files along with their
+        # summaries; of the three left, all but the last one are only there
+        # compressed.
+        gz_files = [ f for f in rb_files if f.endswith('.pcapng.gz') ]
+        last_files = [ f for f in rb_files if f.endswith('.pcapng') ]
+        self.assertEqual(len(gz_files), 2)
+        self.assertEqual(len(last_files), 1)
+        pcapng_files = [ f[:-3] for f in gz_files ] + last_files
+        self.assertEqual(sorted(rb_files), sorted(gz_files + last_files + [ f + '.summary' for f in pcapng_files ]))
+        file_nums = [ int(f[len(testout_glob) - 1:].split('_')[0]) for f in pcapng_files ]
+        self.assertEqual(file_nums, list(range(file_nums[0], file_nums[0] + 3)))
+        self.assertGreaterEqual(file_nums[0], 8)
+
+        unpacked_file = self.filename_from_id('unpacked.pcapng')
+        received = 0
+        for pcapng_file in pcapng_files:
+            if pcapng_file in last_files:
+                with open(pcapng_file, 'rb') as f:
+                    data = f.read()
+            else:
+                with gzip.open(pcapng_file + '.gz', 'rb') as f:
+                    data = f.read()
+            with open(unpacked_file, 'wb') as f:
+                f.write(data)
+            packets = len([ b for b in read_pcapng_blocks(unpacked_file) if b[0] == 6 ])
+
+            with open(pcapng_file + '.summary') as f:
+                summary = dict(line.split(': ', 1) for line in f.read().splitlines())
+            self.assertEqual(os.path.basename(summary['File']), os.path.basename(pcapng_file))
+            self.assertEqual(int(summary['Packets']), packets)
+            # Every file has the time range of its packets.
+            self.assertLessEqual(float(summary['First packet']), float(summary['Last packet']))
+            if pcapng_file not in last_files:
+                # The last file also has the statistics written at the end.
+                self.assertEqual(packets, 10)
+                self.assertEqual(int(summary['Bytes']), len(data))
+            interface_counts = [ v for k, v in summary.items() if k.startswith('Interface 0 ') ]
+            self.assertEqual(len(interface_counts), 1)
+            # The counts are for the whole capture.
+            self.assertGreaterEqual(int(interface_counts[0].split()[0]), received)
+            received = int(interface_counts[0].split()[0])
+        self.assertGreaterEqual(received, 80)
+
+    def test_dumpcap_ringbuffer_summary_pcapng(self, cmd_dumpcap, capture_file):
+        '''Capture from a pcapng pipe using Dumpcap, summarizing the time range of each file of a ring buffer'''
+        rb_unique = 'dhcp_rb_' + uuid.uuid4().hex[:6] # Random ID
+        testout_file = '{}.{}.pcapng'.format(self.id(), rb_unique)
+        testout_glob = '{}.{}_*.pcapng'.format(self.id(), rb_unique)
+        capture_cmd = ' '.join((cmd_dumpcap,
+            '-i', '-',
+            '-w', testout_file,
+            '-b', 'packets:2',
+            '-b', 'summary:1',
+        ))
+        self.assertRun(subprocesstest.cat_cap_file_command(capture_file('dhcp-nanosecond.pcapng')) + ' | ' + capture_cmd, shell=True)
+
+        rb_files = sorted(glob.glob(testout_glob))
+        self.cleanup_files.extend(rb_files)
+        self.cleanup_files.extend(f + '.summary' for f in rb_files)
+        self.assertEqual(len(rb_files), 2)
+        for rb_file in rb_files:
+            blocks = read_pcapng_blocks(rb_file)
+            ts_mul = pcapng_idb_ts_mul([ body for block_type, body in blocks if block_type == 1 ][0])
+            times = []
+            for block_type, body in blocks:
+                if block_type == 6:
+                    ts_high, ts_low = struct.unpack('=II', body[4:12])
+                    ts = (ts_high << 32) | ts_low
+                    times.append('{}.{:09d}'.format(ts // ts_mul, (ts % ts_mul) * 1000000000 // ts_mul))
+            self.assertEqual(len(times), 2)
+
+            with open(rb_file + '.summary') as f:
+                summary = dict(line.split(': ', 1) for line in f.read().splitlines())
+            self.assertEqual(summary['First packet'], times[0])
+            self.assertEqual(summary['Last packet'], times[-1])
+
+
+@fixtures.mark_usefixtures('base_env')
+@fixtures.uses_fixtures
+class case_dumpcap_write_buffers(subprocesstest.SubprocessTestCase):
+    def test_dumpcap_write_buffers_stdin(self, check_dumpcap_write_buffers_stdin):
+        '''Capture from stdin using Dumpcap, writing the file from a separate thread'''
+        check_dumpcap_write_buffers_stdin(self)
+
+    def test_dumpcap_write_buffers_direct_io_stdin(self, check_dumpcap_write_buffers_stdin):
+        '''Capture from stdin using Dumpcap, writing the file from a separate thread with direct I/O'''
+        check_dumpcap_write_buffers_stdin(self, direct_io=True)
+
+
+@fixtures.mark_usefixtures('base_env')
+@fixtures.uses_fixtures
+class case_dumpcap_flow_index(subprocesstest.SubprocessTestCase):
+    def test_dumpcap_flow_index(self, cmd_dumpcap, cmd_flowquery):
+        '''Index the flows of ring buffer files written by Dumpcap and query them'''
+        rb_unique = 'dhcp_rb_' + uuid.uuid4().hex[:6] # Random ID
+        testout_file = '{}.{}.pcapng'.format(self.id(), rb_unique)
+        testout_glob = '{}.{}_*.pcapng'.format(self.id(), rb_unique)
+        cat100_dhcp_cmd = subprocesstest.cat_dhcp_command('cat100')
+        capture_cmd = ' '.join((cmd_dumpcap,
+            '-i', '-',
+            '-w', testout_file,
+            '-a', 'files:2',
+            '-b', 'packets:50',
+            '-b', 'index:1',
+        ))
+        self.assertRun(cat100_dhcp_cmd + ' | ' + capture_cmd, shell=True)
+
+        rb_files = sorted(glob.glob(testout_glob))
+        for rbf in rb_files:
+            self.cleanup_files.append(rbf)
+            self.cleanup_files.append(rbf + '.flowidx')
+        self.assertEqual(len(rb_files), 2)
+
+        for rbf in rb_files:
+            with open(rbf + '.flowidx', 'rb') as f:
+                index = f.read()
+            self.assertEqual(index[:8], b'WSFLOWIX')
+            self.assertEqual(len(index), 16 + 2 * 80)
+
+            # Each file has 25 DHCP requests and 25 replies, alternating.
+            flowquery_proc = self.assertRun((cmd_flowquery, rbf))
+            flows = [ line.split('\t') for line in flowquery_proc.stdout_str.splitlines() ]
+            self.assertEqual(len(flows), 2)
+            request, reply = flows
+            self.assertEqual(request[:7], [rbf, request[1], '17', '0.0.0.0', '68', '255.255.255.255', '67'])
+            self.assertEqual(reply[:7], [rbf, reply[1], '17', '192.168.0.1', '67', '192.168.0.10', '68'])
+            self.assertEqual(request[9:], ['25', str(25 * 314)])
+            self.assertEqual(reply[9:], ['25', str(25 * 342)])
+            self.assertLessEqual(float(request[7]), float(request[8]))
+
+            # The offsets are those of the flows' first EPBs.
+            with open(rbf, 'rb') as f:
+                data = f.read()
+            for flow in flows:
+                offset = int(flow[1])
+                self.assertEqual(struct.unpack('=I', data[offset:offset + 4])[0], 6)
+            self.assertLess(int(request[1]), int(reply[1]))
+
+            flowquery_proc = self.assertRun((cmd_flowquery, '-P', 'udp', '-a', '192.168.0.10', '-p', '68', rbf))
+            self.assertEqual(flowquery_proc.stdout_str.splitlines(), [ '\t'.join(reply) ])
+            flowquery_proc = self.assertRun((cmd_flowquery, '-P', 'tcp', rbf))
+            self.assertEqual(flowquery_proc.stdout_str, '')
+            # 68 + 65536 isn't taken for port 68.
+            self.assertRun((cmd_flowquery, '-p', '65604', rbf), expected_return=1)
+
+    def test_dumpcap_flow_index_no_ring(self, cmd_dumpcap):
+        '''Flow indexes without a ring buffer are rejected'''
+        cat100_dhcp_cmd = subprocesstest.cat_dhcp_command('cat100')
+        capture_cmd = ' '.join((cmd_dumpcap,
+            '-i', '-',
+            '-b', 'index:1',
+        ))
+        self.assertRun(cat100_dhcp_cmd + ' | ' + capture_cmd, shell=True, expected_return=1)
+
 
 @fixtures.mark_usefixtures('base_env')
 @fixtures.uses_fixtures
@@ -597,3 +837,333 @@ class case_dumpcap_pcapng_sections(subprocesstest.SubprocessTestCase):
         if sys.byteorder == 'big':
             fixtures.skip('this test is supported on little endian only')
         check_dumpcap_pcapng_sections(self, multi_input=True, multi_output=True)
+
+
+@fixtures.mark_usefixtures('base_env')
+@fixtures.uses_fixtures
+class case_dumpcap_filter_cache(subprocesstest.SubprocessTestCase):
+    def test_dumpcap_filter_cache(self, cmd_dumpcap, capture_interface, conf_path):
+        '''Cache compiled capture filters in files only when asked to'''
+        # Enough terms to take longer than the minimum compile time for
+        # a file to be written.
+        cfilter = ' or '.join('host 10.{}.{}.1'.format(i // 250, i % 250) for i in range(400))
+        cache_dir = os.path.join(conf_path, 'cfilter_cache')
+        filter_code = self.assertRun((cmd_dumpcap, '-d', '-i', capture_interface, '-f', cfilter)).stdout_str
+        self.assertFalse(os.path.exists(cache_dir))
+
+        cache_args = (cmd_dumpcap, '-d', '-i', capture_interface, '-f', cfilter, '--cache-filters')
+        self.assertEqual(self.assertRun(cache_args).stdout_str, filter_code)
+        if not glob.glob(os.path.join(cache_dir, '*')):
+            fixtures.skip('the capture filter compiled too quickly to be cached')
+        # The program read back from the file is the one compiled.
+        self.assertEqual(self.assertRun(cache_args).stdout_str, filter_code)
+
+
+@fixtures.mark_usefixtures('base_env')
+@fixtures.uses_fixtures
+class case_dumpcap_fanout(subprocesstest.SubprocessTestCase):
+    def test_dumpcap_fanout(self, cmd_dumpcap, capture_interface):
+        '''Capture on the loopback interface with two fanout sockets, twice at once'''
+        if not sys.platform.startswith('linux'):
+            fixtures.skip('--fanout is only available on Linux')
+        with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as free_sock:
+            free_sock.bind(('127.0.0.1', 0))
+            port = free_sock.getsockname()[1]
+
+        # Two captures at once, which must not share a fanout group.
+        captures = []
+        for i in range(2):
+            testout_file = self.filename_from_id('fanout{}.pcapng'.format(i))
+            dumpcap_proc = self.startProcess((cmd_dumpcap,
+                '-i', capture_interface,
+                '-p',
+                '--fanout', '2',
+                '-f', 'udp port {}'.format(port),
+                '-w', testout_file,
+                '-a', 'duration:{}'.format(capture_duration * 4),
+            ))
+            # All the sockets have joined the group, so no packet is
+            # captured twice, once the capture file is reported.
+            while True:
+                line = dumpcap_proc.stderr.readline()
+                if not line or line.startswith(b'File: '):
+                    break
+            captures.append((dumpcap_proc, testout_file))
+
+        # Many flows, so that both sockets get some.
+        datagrams = [ 'fanout test {}'.format(i).encode('ascii') for i in range(256) ]
+        senders = [ socket.socket(socket.AF_INET, socket.SOCK_DGRAM) for _ in range(32) ]
+        for i, datagram in enumerate(datagrams):
+            senders[i % len(senders)].sendto(datagram, ('127.0.0.1', port))
+        for sender in senders:
+            sender.close()
+
+        for dumpcap_proc, testout_file in captures:
+            def captured_datagrams():
+                return [ pcapng_epb_data(body) for block_type, body in read_pcapng_blocks(testout_file)
+                         if block_type == 6 ]
+            for _ in range(50):
+                if len(captured_datagrams()) >= len(datagrams):
+                    break
+                time.sleep(0.1)
+            dumpcap_proc.send_signal(signal.SIGINT)
+            self.assertWaitProcess(dumpcap_proc)
+
+            # Every datagram exactly once, on the single interface.
+            captured = captured_datagrams()
+            self.assertEqual(sorted(data[data.index(b'fanout test '):] for data in captured),
+                             sorted(datagrams))
+            self.assertEqual(len([ block_type for block_type, _ in read_pcapng_blocks(testout_file) if block_type == 1 ]), 1)
+
+            # The counts of each socket add up to the datagrams.
+            socket_counts = re.findall(r"socket (\d+): (\d+)/(\d+)", dumpcap_proc.stderr_str)
+            self.assertEqual(sorted(int(num) for num, _, _ in socket_counts), [1, 2])
+            self.assertEqual(sum(int(received) for _, received, _ in socket_counts), len(datagrams))
+            for _, received, _ in socket_counts:
+                self.assertGreater(int(received), 0)
+
+
+def flow_policy_frame(index, port, reply=False):
+    '''An Ethernet frame with a UDP datagram of a flow to or from a port, its index in the payload.'''
+    hosts = (bytes((192, 0, 2, 1)), bytes((192, 0, 2, 2)))
+    ports = (port, 53)
+    if reply:
+        hosts = hosts[::-1]
+        ports = ports[::-1]
+    return (b'\x00\x00\x5e\x00\x53\x02\x00\x00\x5e\x00\x53\x01\x08\x00'
+        + struct.pack('>BBHHHBBH4s4s', 0x45, 0, 46, 1, 0, 64, 17, 0, hosts[0], hosts[1])
+        + struct.pack('>HHHHI', ports[0], ports[1], 26, 0, index)
+        + bytes(14))
+
+
+def flow_policy_fragment_frame(index, port, ip_id, first):
+    '''An Ethernet frame with the first or the last fragment of a UDP datagram of a flow to a port, its index in the payload.'''
+    hosts = (bytes((192, 0, 2, 1)), bytes((192, 0, 2, 2)))
+    if first:
+        # More fragments; the payload is 24 bytes, and the frame is padded.
+        return (b'\x00\x00\x5e\x00\x53\x02\x00\x00\x5e\x00\x53\x01\x08\x00'
+            + struct.pack('>BBHHHBBH4s4s', 0x45, 0, 44, ip_id, 0x2000, 64, 17, 0, hosts[0], hosts[1])
+            + struct.pack('>HHHHI', port, 53, 50, 0, index)
+            + bytes(14))
+    # At offset 24, the last fragment
+    return (b'\x00\x00\x5e\x00\x53\x02\x00\x00\x5e\x00\x53\x01\x08\x00'
+        + struct.pack('>BBHHHBBH4s4s', 0x45, 0, 46, ip_id, 3, 64, 17, 0, hosts[0], hosts[1])
+        + struct.pack('>I', index)
+        + bytes(22))
+
+
+def flow_policy_arp_frame(index):
+    '''An Ethernet frame with an ARP request, its index in the target address.'''
+    return (b'\xff\xff\xff\xff\xff\xff\x00\x00\x5e\x00\x53\x01\x08\x06'
+        + struct.pack('>HHBBH6s4s6sI', 1, 0x0800, 6, 4, 1,
+                      b'\x00\x00\x5e\x00\x53\x01', bytes((192, 0, 2, 1)), bytes(6), index)
+        + bytes(18))
+
+
+@fixtures.mark_usefixtures('base_env')
+@fixtures.uses_fixtures
+class case_dumpcap_flow_policy(subprocesstest.SubprocessTestCase):
+    def run_flow_policy(self, cmd_dumpcap, frames, *options, wire_len=None):
+        '''Captures frames from a pcap pipe with flow options, returning the indexes of those written.'''
+        in_file = self.filename_from_id('flows.pcap')
+        out_file = self.filename_from_id(testout_pcapng)
+        with open(in_file, 'wb') as f:
+            f.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+            for i, frame in enumerate(frames):
+                f.write(struct.pack('<IIII', i, 0, len(frame), wire_len or len(frame)))
+                f.write(frame)
+        capture_cmd = ' '.join((cmd_dumpcap, '-i', '-', '-w', out_file) + options)
+        self.assertRun(subprocesstest.cat_cap_file_command(in_file) + ' | ' + capture_cmd, shell=True)
+        written = []
+        for block_type, body in read_pcapng_blocks(out_file):
+            if block_type != 6:
+                continue
+            self.assertEqual(struct.unpack('=I', body[16:20])[0], wire_len or len(frames[0]))
+            written.append(frames.index(pcapng_epb_data(body)))
+        return written
+
+    def test_dumpcap_flow_packets(self, cmd_dumpcap):
+        '''Only the first packets of each flow, in either direction, are written'''
+        frames = [flow_policy_arp_frame(0)]
+        for i in range(5):
+            for port in (1000, 1001, 1002):
+                frames.append(flow_policy_frame(len(frames), port, reply=(i % 2 == 1)))
+        frames.append(flow_policy_arp_frame(len(frames)))
+        self.assertEqual(self.run_flow_policy(cmd_dumpcap, frames, '--flow-packets', '2'),
+                         [0, 1, 2, 3, 4, 5, 6, 16])
+        self.assertTrue(self.grepOutput(r'^Flow policy: 9 packets left out$'))
+
+    def test_dumpcap_flow_bytes(self, cmd_dumpcap):
+        '''Packets are written until a flow reaches its byte limit on the wire'''
+        frames = []
+        for i in range(5):
+            for port in (1000, 1001):
+                frames.append(flow_policy_frame(len(frames), port))
+        # The third packet of each flow reaches 1000 bytes, and is written whole.
+        self.assertEqual(self.run_flow_policy(cmd_dumpcap, frames, '--flow-bytes', '1000', wire_len=400),
+                         [0, 1, 2, 3, 4, 5])
+        self.assertTrue(self.grepOutput(r'^Flow policy: 4 packets left out$'))
+        self.assertEqual(self.run_flow_policy(cmd_dumpcap, frames, '--flow-bytes', '1000',
+                                              '--flow-packets', '2', wire_len=400),
+                         [0, 1, 2, 3])
+
+    def test_dumpcap_flow_sample(self, cmd_dumpcap):
+        '''Either all packets of a flow are written or none are'''
+        flow_ports = range(1000, 1064)
+        frames = [flow_policy_arp_frame(0)]
+        for i in range(3):
+            for port in flow_ports:
+                frames.append(flow_policy_frame(len(frames), port, reply=(i == 1)))
+
+        def sampled_ports(written):
+            self.assertIn(0, written)
+            counts = {}
+            for index in written:
+                if index != 0:
+                    port = flow_ports[(index - 1) % len(flow_ports)]
+                    counts[port] = counts.get(port, 0) + 1
+            return counts
+
+        counts = sampled_ports(self.run_flow_policy(cmd_dumpcap, frames, '--flow-sample', '4'))
+        self.assertTrue(0 < len(counts) < len(flow_ports))
+        self.assertEqual(set(counts.values()), {3})
+        left_out = 3 * (len(flow_ports) - len(counts))
+        self.assertTrue(self.grepOutput(r'^Flow policy: {} packets left out, {} in flows not sampled$'.format(left_out, left_out)))
+
+        # The same flows are sampled, with the packet limit applied to them.
+        limited_counts = sampled_ports(self.run_flow_policy(cmd_dumpcap, frames, '--flow-sample', '4', '--flow-packets', '1'))
+        self.assertEqual(sorted(limited_counts), sorted(counts))
+        self.assertEqual(set(limited_counts.values()), {1})
+
+    def test_dumpcap_flow_fragments(self, cmd_dumpcap):
+        '''The later fragments of a datagram are in the flow of its first fragment'''
+        flow_ports = range(1000, 1064)
+        frames = []
+        for port in flow_ports:
+            frames.append(flow_policy_fragment_frame(len(frames), port, len(frames), True))
+            frames.append(flow_policy_fragment_frame(len(frames), port, len(frames) - 1, False))
+        written = self.run_flow_policy(cmd_dumpcap, frames, '--flow-sample', '4')
+        sampled = sorted(set(index // 2 for index in written))
+        self.assertTrue(0 < len(sampled) < len(flow_ports))
+        self.assertEqual(written, [ index for datagram in sampled for index in (2 * datagram, 2 * datagram + 1) ])
+
+        # The last fragment of each flow's second datagram is over the limit.
+        frames = []
+        for i in range(2):
+            for port in (1000, 1001):
+                frames.append(flow_policy_fragment_frame(len(frames), port, len(frames), True))
+                frames.append(flow_policy_fragment_frame(len(frames), port, len(frames) - 1, False))
+        self.assertEqual(self.run_flow_policy(cmd_dumpcap, frames, '--flow-packets', '3'),
+                         [0, 1, 2, 3, 4, 6])
+
+    def test_dumpcap_flow_table_eviction(self, cmd_dumpcap):
+        '''The flow that has gone longest without a packet is forgotten to make room'''
+        ports = (1000, 1001, 1002, 1003, 1000, 1004, 1001, 1000)
+        frames = [flow_policy_frame(i, port) for i, port in enumerate(ports)]
+        # 1004 takes the place of 1001, and 1001 of 1002; 1000 stays.
+        self.assertEqual(self.run_flow_policy(cmd_dumpcap, frames,
+                                              '--flow-packets', '1', '--flow-table-size', '4'),
+                         [0, 1, 2, 3, 5, 6])
+        self.assertTrue(self.grepOutput(r'^Flow policy: 2 packets left out; 2 flows forgotten for lack of room$'))
+
+
+def read_pcapng_blocks(pcapng_file):
+    '''Returns the type and body of each block of a pcapng file written on this host.'''
+    blocks = []
+    if not os.path.isfile(pcapng_file):
+        return blocks
+    with open(pcapng_file, 'rb') as f:
+        data = f.read()
+    while len(data) >= 12:
+        block_type, block_len = struct.unpack('=II', data[:8])
+        if block_len > len(data):
+            break
+        blocks.append((block_type, data[8:block_len - 4]))
+        data = data[block_len:]
+    return blocks
+
+
+def pcapng_epb_data(epb_body):
+    '''Returns the packet data of an EPB.'''
+    caplen = struct.unpack('=I', epb_body[12:16])[0]
+    return epb_body[20:20 + caplen]
+
+
+def pcapng_idb_ts_mul(idb_body):
+    '''Returns the time stamp units per second set by an IDB.'''
+    options = idb_body[8:]
+    while len(options) >= 4:
+        code, length = struct.unpack('=HH', options[:4])
+        if code == 0:
+            break
+        if code == 9:
+            tsresol = options[4]
+            return 2 ** (tsresol & 0x7f) if tsresol & 0x80 else 10 ** tsresol
+        options = options[4 + ((length + 3) & ~3):]
+    return 1000000
+
+
+@fixtures.mark_usefixtures('base_env')
+@fixtures.uses_fixtures
+class case_udpdump(subprocesstest.SubprocessTestCase):
+    def test_udpdump_loopback(self, cmd_udpdump):
+        '''Capture datagrams sent over the loopback interface using udpdump'''
+        if sys.platform == 'win32':
+            fixtures.skip('udpdump is stopped with SIGINT')
+        with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as free_sock:
+            free_sock.bind(('127.0.0.1', 0))
+            port = free_sock.getsockname()[1]
+        testout_file = self.filename_from_id(testout_pcapng)
+        start_time = time.time()
+        udpdump_proc = self.startProcess((cmd_udpdump,
+            '--extcap-interface', 'udpdump',
+            '--capture',
+            '--fifo', testout_file,
+            '--port', str(port),
+        ))
+
+        def captured_datagrams():
+            # The exported PDU header comes before the datagram.
+            return [ pcapng_epb_data(body) for block_type, body in read_pcapng_blocks(testout_file)
+                     if block_type == 6 and not pcapng_epb_data(body).endswith(b'probe') ]
+
+        # Datagrams sent before udpdump listens are lost.
+        sender = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        for _ in range(100):
+            sender.sendto(b'probe', ('127.0.0.1', port))
+            time.sleep(0.1)
+            if any(block_type == 6 for block_type, _ in read_pcapng_blocks(testout_file)):
+                break
+        datagrams = [ 'udpdump test {}'.format(i).encode('ascii') for i in range(50) ]
+        for datagram in datagrams:
+            sender.sendto(datagram, ('127.0.0.1', port))
+        sender.close()
+        for _ in range(50):
+            if len(captured_datagrams()) >= len(datagrams):
+                break
+            time.sleep(0.1)
+        udpdump_proc.send_signal(signal.SIGINT)
+        udpdump_proc.wait_and_log()
+        end_time = time.time()
+
+        captured = captured_datagrams()
+        self.assertEqual(len(captured), len(datagrams))
+        for data, datagram in zip(captured, datagrams):
+            self.assertTrue(data.endswith(datagram))
+
+        # EPBs and ISBs are time stamped in the resolution the IDB sets.
+        blocks = read_pcapng_blocks(testout_file)
+        idbs = [ body for block_type, body in blocks if block_type == 1 ]
+        self.assertEqual(len(idbs), 1)
+        ts_mul = pcapng_idb_ts_mul(idbs[0])
+        isb_count = 0
+        for block_type, body in blocks:
+            if block_type == 5:
+                isb_count += 1
+            elif block_type != 6:
+                continue
+            ts_high, ts_low = struct.unpack('=II', body[4:12])
+            ts = ((ts_high << 32) | ts_low) / ts_mul
+            self.assertGreaterEqual(ts, start_time - 1)
+            self.assertLessEqual(ts, end_time + 1)
+        self.assertGreaterEqual(isb_count, 1)
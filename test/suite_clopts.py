@@ -16,6 +16,7 @@ import subprocess
 import subprocesstest
 import fixtures
 import shutil
+import struct
 
 #glossaries = ('fields', 'protocols', 'values', 'decodes', 'defaultprefs', 'currentprefs')
 
@@ -284,6 +285,41 @@ class case_tshark_z_expert(subprocesstest.SubprocessTestCase):
         self.assertFalse(self.grepOutput('Chats'))
 
 
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_tshark_stats_interval(subprocesstest.SubprocessTestCase):
+    def snapshots(self, proc, tap):
+        snapshots = [json.loads(line) for line in proc.stdout_str.splitlines() if line.startswith('{')]
+        return [s for s in snapshots if s['tap'] == tap]
+
+    def test_tshark_stats_interval_single_window(self, cmd_tshark, capture_file):
+        proc = self.assertRun((cmd_tshark, '-q', '-z', 'conv,udp', '-z', 'io,stat,0',
+            '--stats-interval', '3600', '-r', capture_file('dhcp.pcap')))
+        convs = self.snapshots(proc, 'conv,udp')
+        self.assertEqual(len(convs), 1)
+        self.assertEqual(sum(c['rxf'] + c['txf'] for c in convs[0]['data']), 4)
+        iostat = self.snapshots(proc, 'io,stat,0')
+        self.assertEqual(len(iostat), 1)
+        self.assertEqual(iostat[0]['data']['columns'][0]['rows'][0]['frames'], 4)
+        self.assertFalse(self.grepOutput('UDP Conversations'))
+
+    def test_tshark_stats_interval_reset(self, cmd_tshark, capture_file):
+        proc = self.assertRun((cmd_tshark, '-q', '-z', 'conv,udp',
+            '--stats-interval', '0.000001', '-r', capture_file('dhcp.pcap')))
+        convs = self.snapshots(proc, 'conv,udp')
+        self.assertGreater(len(convs), 1)
+        self.assertEqual(sum(c['rxf'] + c['txf'] for s in convs for c in s['data']), 4)
+        for prev, cur in zip(convs, convs[1:]):
+            self.assertLessEqual(prev['end'], cur['start'])
+
+    def test_tshark_stats_interval_cumulative(self, cmd_tshark, capture_file):
+        proc = self.assertRun((cmd_tshark, '-q', '-z', 'conv,udp',
+            '--stats-interval', '0.000001', '--stats-cumulative',
+            '-r', capture_file('dhcp.pcap')))
+        convs = self.snapshots(proc, 'conv,udp')
+        self.assertEqual(sum(c['rxf'] + c['txf'] for c in convs[-1]['data']), 4)
+
+
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
 class case_tshark_extcap(subprocesstest.SubprocessTestCase):
@@ -305,3 +341,123 @@ class case_tshark_extcap(subprocesstest.SubprocessTestCase):
         # Ensure tshark lists 2 interfaces in the preferences
         self.assertRun((cmd_tshark, '-G', 'currentprefs'), env=test_env)
         self.assertEqual(2, self.countOutput('extcap.sampleif.test'))
+
+
+def eth_ipv4_frame(dst_host, ttl=64, checksum=0):
+    '''An Ethernet frame with an IPv4 header and padding.'''
+    return (b'\x00\x00\x5e\x00\x53\x02\x00\x00\x5e\x00\x53\x01\x08\x00'
+        + struct.pack('>BBHHHBBH4s4s', 0x45, 0, 46, 1, 0, ttl, 17, checksum,
+                      bytes((192, 0, 2, 1)), bytes((192, 0, 2, dst_host)))
+        + bytes(26))
+
+
+def write_pcap(path, frames):
+    '''Writes (time, data) pairs to a microsecond pcap file.'''
+    with open(path, 'wb') as f:
+        f.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+        for ts, data in frames:
+            usecs = round(ts * 1000000)
+            f.write(struct.pack('<IIII', usecs // 1000000, usecs % 1000000, len(data), len(data)))
+            f.write(data)
+
+
+def read_pcap(path):
+    '''Reads the (time, data) pairs from a microsecond pcap file.'''
+    with open(path, 'rb') as f:
+        contents = f.read()
+    frames = []
+    offset = 24
+    while offset < len(contents):
+        secs, usecs, caplen, _ = struct.unpack_from('<IIII', contents, offset)
+        offset += 16
+        frames.append((round(secs + usecs / 1000000, 6), contents[offset:offset + caplen]))
+        offset += caplen
+    return frames
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_editcap_dedup_clopts(subprocesstest.SubprocessTestCase):
+    def dedup(self, cmd_editcap, frames, *options):
+        '''Returns the indexes of the frames editcap keeps.'''
+        infile = self.filename_from_id('dups.pcap')
+        outfile = self.filename_from_id('dedup.pcap')
+        write_pcap(infile, frames)
+        self.assertRun((cmd_editcap, '-F', 'pcap') + options + (infile, outfile))
+        kept = read_pcap(outfile)
+        indexes = []
+        for frame in kept:
+            index = frames.index(frame, indexes[-1] + 1 if indexes else 0)
+            indexes.append(index)
+        self.assertEqual(len(kept), len(indexes))
+        return indexes
+
+    def test_editcap_dedup_default_window(self, cmd_editcap):
+        # The previous four frames are compared.
+        a, b, c, d, e = (eth_ipv4_frame(n) for n in range(2, 7))
+        frames = [(float(i), data) for i, data in enumerate((a, b, c, d, a, b, c, d, e, a))]
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-d'), [0, 1, 2, 3, 8, 9])
+        self.assertTrue(self.grepOutput(r'10 packets seen, 4 packets skipped with duplicate window of 5 packets\.'))
+
+    def test_editcap_dedup_window(self, cmd_editcap):
+        a, b = eth_ipv4_frame(2), eth_ipv4_frame(3)
+        frames = [(float(i), data) for i, data in enumerate((a, a, b, a, a, b, b))]
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-D', '2'), [0, 2, 3, 5])
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-D', '3'), [0, 2, 5])
+        # Nothing to compare with
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-D', '1'), list(range(7)))
+
+    def test_editcap_dedup_window_eviction(self, cmd_editcap):
+        # The window is a ring; the oldest frames leave it first, whether
+        # they were kept or not.
+        frames = [(float(i), eth_ipv4_frame(n)) for i, n in enumerate(
+            (2, 3, 2, 4, 5, 6, 2, 3, 7, 3))]
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-D', '4'), [0, 1, 3, 4, 5, 6, 7, 8])
+
+    def test_editcap_dedup_time_window(self, cmd_editcap):
+        a, b = eth_ipv4_frame(2), eth_ipv4_frame(3)
+        frames = [
+            (0.0, a),
+            (0.4, a),   # 0.4 s after the first
+            (0.5, b),
+            (1.0, a),   # 0.6 s after the last a
+            (1.5, a),   # exactly 0.5 s after it
+            (1.6, b),
+        ]
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-w', '0.5'), [0, 2, 3, 5])
+        self.assertTrue(self.grepOutput(r'6 packets seen, 2 packets skipped with duplicate time window equal to or less than 0\.500000000 seconds\.'))
+
+    def test_editcap_dedup_time_window_out_of_order(self, cmd_editcap):
+        a = eth_ipv4_frame(2)
+        frames = [
+            (1.0, a),
+            (0.9, a),   # not a duplicate of a later frame
+            (1.2, a),   # a duplicate of both
+            (3.0, a),
+        ]
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-w', '0.5'), [0, 1, 3])
+
+    def test_editcap_dedup_ignore_bytes(self, cmd_editcap):
+        # The same packet seen again after a router: a lower time to live,
+        # and so another header checksum.
+        frames = [
+            (0.0, eth_ipv4_frame(2, 64, 0x1234)),
+            (0.1, eth_ipv4_frame(2, 63, 0x1334)),
+            (0.2, eth_ipv4_frame(3, 63, 0x1333)),
+        ]
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-d'), [0, 1, 2])
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-d', '--ignore-bytes', '22:1'), [0, 1, 2])
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-d',
+            '--ignore-bytes', '22:1', '--ignore-bytes', '24:2'), [0, 2])
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-w', '1',
+            '--ignore-bytes', '22:4'), [0, 2])
+        # Ranges past the end of the frame are left out as far as it goes.
+        self.assertEqual(self.dedup(cmd_editcap, frames, '-D', '2',
+            '--ignore-bytes', '22:1000'), [0])
+
+    def test_editcap_dedup_ignore_bytes_invalid(self, cmd_editcap, capture_file):
+        for byte_range in ('22', '22:0', 'x:1', '22:-1'):
+            self.assertRun((cmd_editcap, '-d', '--ignore-bytes', byte_range,
+                capture_file('dhcp.pcap'), self.filename_from_id('dedup.pcap')),
+                expected_return=self.exit_command_line)
+            self.assertTrue(self.grepOutput('isn\'t a valid byte range'))
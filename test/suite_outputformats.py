@@ -10,6 +10,8 @@
 
 import json
 import os.path
+import struct
+import subprocess
 import subprocesstest
 import fixtures
 from matchers import *
@@ -61,6 +63,36 @@ class case_outputformats(subprocesstest.SubprocessTestCase):
         '''Decode some captures into ek'''
         check_outputformat("ek", expected="dhcp.ek", multiline=True)
 
+    def test_outputformat_json_grouping(self, cmd_tshark, capture_file, dirs):
+        '''Checks how the nodes of json objects are grouped by key.'''
+        baseline = open(os.path.join(dirs.baseline_dir, 'dhcp.json')).read()
+        def merge_duplicates(pairs):
+            # Values of the same key become an array, at the place of the first.
+            merged = {}
+            for key, value in pairs:
+                if key in merged:
+                    if not isinstance(merged[key], MergedValues):
+                        merged[key] = MergedValues([merged[key]])
+                    merged[key].append(value)
+                else:
+                    merged[key] = value
+            return [(key, list(value) if isinstance(value, MergedValues) else value)
+                    for key, value in merged.items()]
+        def no_duplicates(pairs):
+            self.assertEqual(len(pairs), len(set(key for key, _ in pairs)))
+            return pairs
+        # Without --no-duplicate-keys every node is kept, in tree order.
+        unique = subprocess.check_output((cmd_tshark,
+            '-r', capture_file('dhcp.pcap'), '-Tjson'), universal_newlines=True)
+        self.assertEqual(json.loads(unique, object_pairs_hook=list),
+                         json.loads(baseline, object_pairs_hook=list))
+        # The dhcp objects have more keys than are compared linearly.
+        merged = subprocess.check_output((cmd_tshark,
+            '-r', capture_file('dhcp.pcap'), '-Tjson', '--no-duplicate-keys'),
+            universal_newlines=True)
+        self.assertEqual(json.loads(merged, object_pairs_hook=no_duplicates),
+                         json.loads(baseline, object_pairs_hook=merge_duplicates))
+
     def test_outputformat_json_select_field(self, check_outputformat):
         '''Checks that the -e option works with -Tjson.'''
         check_outputformat("json", extra_args=['-eframe.number', '-c1'], expected=[
@@ -84,3 +116,198 @@ class case_outputformats(subprocesstest.SubprocessTestCase):
             {"index": {"_index": "packets-2004-12-05", "_type": "doc"}},
             {"timestamp": "1102274184317", "layers": {"frame_number": ["1"]}}
         ], multiline=True)
+
+    def test_outputformat_fields(self, cmd_tshark, capture_file):
+        '''Checks that -Tfields gives the same values without a labelled tree.'''
+        fields_args = ['-Tfields', '-eframe.number', '-eip.src', '-edhcp.option.type']
+        primed = subprocess.check_output([cmd_tshark,
+            '-r', capture_file('dhcp.pcap')] + fields_args,
+            universal_newlines=True).splitlines()
+        # A protocol's value is its label, so asking for one needs every
+        # item in the tree.
+        labelled = subprocess.check_output([cmd_tshark,
+            '-r', capture_file('dhcp.pcap')] + fields_args + ['-eudp'],
+            universal_newlines=True).splitlines()
+        self.assertEqual([line.split('\t')[:2] for line in primed], [
+            ['1', '0.0.0.0'], ['2', '192.168.0.1'],
+            ['3', '0.0.0.0'], ['4', '192.168.0.1']])
+        self.assertEqual(primed, [line.rsplit('\t', 1)[0] for line in labelled])
+
+    def test_outputformat_arrow(self, cmd_tshark, capture_file):
+        '''Checks that -Tarrow writes a complete Arrow IPC stream.'''
+        arrow_stream = subprocess.check_output((cmd_tshark,
+            '-r', capture_file('dhcp.pcap'), '-Tarrow',
+            '-eframe.number', '-eip.src', '-E', 'occurrence=f',
+            '-E', 'batch=3'))
+        names, batches = decode_arrow_stream(arrow_stream)
+        self.assertEqual(names, ['frame.number', 'ip.src'])
+        # -E batch=3 splits the 4 packets into two record batches.
+        self.assertEqual(batches, [
+            [[1, 2, 3], ['0.0.0.0', '192.168.0.1', '0.0.0.0']],
+            [[4], ['192.168.0.1']],
+        ])
+        try:
+            import pyarrow.ipc
+        except ImportError:
+            return
+        table = pyarrow.ipc.open_stream(arrow_stream).read_all()
+        self.assertEqual(table.column_names, ['frame.number', 'ip.src'])
+        self.assertEqual(table.column('frame.number').to_pylist(), [1, 2, 3, 4])
+        self.assertEqual(table.column('ip.src').to_pylist(),
+            ['0.0.0.0', '192.168.0.1', '0.0.0.0', '192.168.0.1'])
+
+    def test_outputformat_cbor(self, cmd_tshark, capture_file):
+        '''Checks the items and field values written by -Tcbor.'''
+        cbor_stream = subprocess.check_output((cmd_tshark,
+            '-r', capture_file('dhcp.pcap'), '-Tcbor'))
+        items = decode_cbor_sequence(cbor_stream)
+        self.assertEqual(items[0], ('tag', 55799, {'format': 'wireshark-tree', 'version': 1}))
+        keys = []
+        ip_src = []
+        def find_nodes(nodes, name, found):
+            for node in nodes:
+                if keys[node[0]] == name:
+                    found.append(node[1])
+                if len(node) > 2:
+                    find_nodes(node[2], name, found)
+        for frame_number, new_keys, nodes in items[1:]:
+            # Each name is only written by the first packet that has it.
+            self.assertFalse(set(new_keys) & set(keys))
+            keys += new_keys
+            find_nodes(nodes, 'ip.src', ip_src)
+        self.assertEqual([item[0] for item in items[1:]], [1, 2, 3, 4])
+        self.assertEqual(ip_src, [b'\x00\x00\x00\x00', b'\xc0\xa8\x00\x01'] * 2)
+
+
+class MergedValues(list):
+    '''The values of a json key that appears more than once in an object.'''
+
+
+def decode_cbor_sequence(data):
+    '''Decodes the CBOR data items written by -Tcbor.'''
+    pos = 0
+    def decode_item():
+        nonlocal pos
+        initial = data[pos]
+        pos += 1
+        major, info = initial >> 5, initial & 0x1f
+        if major == 7:
+            if info == 27:
+                pos += 8
+                return struct.unpack('>d', data[pos - 8:pos])[0]
+            return {20: False, 21: True, 22: None}[info]
+        if info >= 24:
+            size = 1 << (info - 24)
+            info = int.from_bytes(data[pos:pos + size], 'big')
+            pos += size
+        if major == 0:
+            return info
+        if major == 1:
+            return -1 - info
+        if major in (2, 3):
+            pos += info
+            value = data[pos - info:pos]
+            return value.decode('utf-8') if major == 3 else value
+        if major == 4:
+            return [decode_item() for _ in range(info)]
+        if major == 5:
+            return {decode_item(): decode_item() for _ in range(info)}
+        return ('tag', info, decode_item())
+    items = []
+    while pos < len(data):
+        items.append(decode_item())
+    return items
+
+
+def decode_arrow_stream(data):
+    '''Decodes the Arrow IPC stream written by -Tarrow, for Int and Utf8
+    columns. Returns the column names and the record batches, each a list
+    of columns of values, None for nulls.'''
+    def unpack(fmt, buf, pos):
+        return struct.unpack_from(fmt, buf, pos)[0]
+
+    # Flatbuffers: a table starts with the offset back to its vtable,
+    # which holds the offsets of the table's fields.
+    def fb_field(buf, table, index):
+        vtable = table - unpack('<i', buf, table)
+        if 4 + 2 * index >= unpack('<H', buf, vtable):
+            return None
+        offset = unpack('<H', buf, vtable + 4 + 2 * index)
+        return table + offset if offset else None
+
+    def fb_ref(buf, pos):
+        return pos + unpack('<I', buf, pos)
+
+    def fb_vector(buf, table, index):
+        pos = fb_ref(buf, fb_field(buf, table, index))
+        return pos + 4, unpack('<I', buf, pos)
+
+    def fb_string(buf, table, index):
+        pos, length = fb_vector(buf, table, index)
+        return buf[pos:pos + length].decode('utf-8')
+
+    def decode_column(col_type, length, buffers):
+        validity = buffers.pop(0)
+        valid = lambda row: not validity or validity[row >> 3] & (1 << (row & 7))
+        if col_type[0] == 'int':
+            values = buffers.pop(0)
+            width = col_type[1] // 8
+            return [int.from_bytes(values[row * width:(row + 1) * width], 'little', signed=col_type[2])
+                    if valid(row) else None for row in range(length)]
+        if col_type[0] == 'utf8':
+            offsets = buffers.pop(0)
+            chars = buffers.pop(0)
+            return [chars[unpack('<i', offsets, 4 * row):unpack('<i', offsets, 4 * row + 4)].decode('utf-8')
+                    if valid(row) else None for row in range(length)]
+        raise ValueError('Unexpected column type %r' % (col_type,))
+
+    names = []
+    types = []
+    batches = []
+    pos = 0
+    while True:
+        # Continuation marker, metadata length, metadata, body
+        if data[pos:pos + 4] != b'\xff\xff\xff\xff':
+            raise ValueError('No continuation marker at %d' % pos)
+        meta_len = unpack('<I', data, pos + 4)
+        pos += 8
+        if meta_len == 0:
+            break
+        meta = data[pos:pos + meta_len]
+        pos += meta_len
+        message = fb_ref(meta, 0)
+        header_type = meta[fb_field(meta, message, 1)]
+        header = fb_ref(meta, fb_field(meta, message, 2))
+        body_len_pos = fb_field(meta, message, 3)
+        body_len = unpack('<q', meta, body_len_pos) if body_len_pos else 0
+        body = data[pos:pos + body_len]
+        pos += body_len
+        if header_type == 1:
+            # Schema
+            fields, count = fb_vector(meta, header, 1)
+            for i in range(count):
+                field = fb_ref(meta, fields + 4 * i)
+                names.append(fb_string(meta, field, 0))
+                type_type = meta[fb_field(meta, field, 2)]
+                type_table = fb_ref(meta, fb_field(meta, field, 3))
+                if type_type == 2:
+                    signed_pos = fb_field(meta, type_table, 1)
+                    types.append(('int', unpack('<i', meta, fb_field(meta, type_table, 0)),
+                                  bool(signed_pos and meta[signed_pos])))
+                elif type_type == 5:
+                    types.append(('utf8',))
+                else:
+                    types.append(('other', type_type))
+        elif header_type == 3:
+            # RecordBatch
+            length = unpack('<q', meta, fb_field(meta, header, 0))
+            buffer_pos, buffer_count = fb_vector(meta, header, 2)
+            buffers = []
+            for i in range(buffer_count):
+                offset = unpack('<q', meta, buffer_pos + 16 * i)
+                size = unpack('<q', meta, buffer_pos + 16 * i + 8)
+                buffers.append(body[offset:offset + size])
+            batches.append([decode_column(col_type, length, buffers) for col_type in types])
+    if pos != len(data):
+        raise ValueError('Data after the end-of-stream marker')
+    return names, batches
@@ -9,12 +9,18 @@
 #
 '''sharkd tests'''
 
+import base64
 import json
+import os
+import re
+import socket
 import subprocess
+import time
 import unittest
 import subprocesstest
 import fixtures
 from matchers import *
+from suite_outputformats import decode_cbor_sequence
 
 
 @fixtures.fixture(scope='session')
@@ -86,6 +92,131 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
                 "filename": "dhcp.pcap", "filesize": 1400},
         ))
 
+    def test_sharkd_req_load_tail(self, check_sharkd_session, capture_file):
+        # As dumpcap might have left it, the third frame only partly written.
+        partial_pcap = os.path.abspath(self.filename_from_id('partial.pcap'))
+        with open(capture_file('dhcp.pcap'), 'rb') as src, open(partial_pcap, 'wb') as dst:
+            dst.write(src.read(812))
+        check_sharkd_session((
+            {"req": "load", "file": partial_pcap, "tail": True},
+            {"req": "status"},
+            {"req": "frames", "filter": "dhcp", "column0": "frame.number:0"},
+            {"req": "tail"},
+        ), (
+            {"err": 0},
+            MatchObject({"frames": 2, "tail": True}),
+            [
+                MatchObject({"c": ["1"], "num": 1}),
+                MatchObject({"c": ["2"], "num": 2}),
+            ],
+            {"err": 0, "frames": 2, "new": 0, "tail": True},
+        ))
+
+    def test_sharkd_req_tail_appended(self, cmd_sharkd, capture_file):
+        with open(capture_file('dhcp.pcap'), 'rb') as f:
+            dhcp_pcap = f.read()
+        partial_pcap = os.path.abspath(self.filename_from_id('partial.pcap'))
+        with open(partial_pcap, 'wb') as f:
+            f.write(dhcp_pcap[:812])
+
+        sharkd_proc = self.startProcess((cmd_sharkd, '-'), stdin=subprocess.PIPE)
+
+        def request(req):
+            # Requests are sent one at a time, the file growing in between.
+            sharkd_proc.stdin.write((json.dumps(req) + '\n').encode('utf8'))
+            sharkd_proc.stdin.flush()
+            line = sharkd_proc.stdout.readline()
+            self.assertTrue(line, 'sharkd exited early')
+            return json.loads(line.decode('utf8'))
+
+        def append(data):
+            with open(partial_pcap, 'ab') as f:
+                f.write(data)
+
+        def filtered(dfilter):
+            frames = request({"req": "frames", "filter": dfilter, "column0": "frame.number:0"})
+            return [frame["num"] for frame in frames]
+
+        iograph_req = {"req": "iograph", "graph0": "packets", "graph1": "bytes"}
+        # DHCP Request, only in the third frame
+        request_filter = 'dhcp.option.dhcp == 3'
+
+        self.assertEqual(request({"req": "load", "file": partial_pcap, "tail": True}), {"err": 0})
+        # Cache the filter results and graphs the tail requests bring up to date.
+        self.assertEqual(filtered('dhcp'), [1, 2])
+        self.assertEqual(filtered(request_filter), [])
+        self.assertEqual(request(iograph_req), {"iograph": [{"items": [2.0]}, {"items": [656.0]}]})
+        self.assertEqual(request({"req": "tail"}), {"err": 0, "frames": 2, "new": 0, "tail": True})
+
+        # The rest of the third frame, and the fourth
+        append(dhcp_pcap[812:])
+        self.assertEqual(request({"req": "tail"}), {"err": 0, "frames": 4, "new": 2, "tail": True})
+        self.assertEqual(filtered('dhcp'), [1, 2, 3, 4])
+        self.assertEqual(filtered(request_filter), [3])
+        self.assertEqual(request(iograph_req), {"iograph": [{"items": [4.0]}, {"items": [1312.0]}]})
+
+        # The first two frames again, after another tail request finding nothing
+        self.assertEqual(request({"req": "tail"}), {"err": 0, "frames": 4, "new": 0, "tail": True})
+        append(dhcp_pcap[24:812])
+        self.assertEqual(request({"req": "tail"}), {"err": 0, "frames": 6, "new": 2, "tail": True})
+        self.assertEqual(filtered('dhcp'), [1, 2, 3, 4, 5, 6])
+        self.assertEqual(filtered(request_filter), [3])
+        self.assertEqual(request(iograph_req), {"iograph": [{"items": [6.0]}, {"items": [1968.0]}]})
+        self.assertEqual(request({"req": "status"}), MatchObject({"frames": 6, "tail": True}))
+
+        sharkd_proc.stdin.write(b'{"req": "bye"}\n')
+        sharkd_proc.stdin.flush()
+        self.assertWaitProcess(sharkd_proc)
+
+    def test_sharkd_req_tail_finish(self, check_sharkd_session, capture_file):
+        check_sharkd_session((
+            {"req": "load", "file": capture_file('dhcp.pcap'), "tail": True},
+            {"req": "tail", "finish": True},
+            {"req": "status"},
+        ), (
+            {"err": 0},
+            {"err": 0, "frames": 4, "new": 0},
+            MatchObject({"frames": 4, "tail": None}),
+        ))
+
+    @unittest.skipUnless(hasattr(socket, 'AF_UNIX'), 'Requires UNIX sockets')
+    def test_sharkd_preload_handoff(self, cmd_sharkd, capture_file):
+        # Relative, as socket paths are short.
+        sock_path = self.filename_from_id('sock')
+        self.startProcess((cmd_sharkd,
+                           '-p', capture_file('dhcp.pcap'),
+                           '-p', capture_file('http.pcap'),
+                           'unix:' + sock_path))
+        for _ in range(100):
+            if os.path.exists(sock_path):
+                break
+            time.sleep(0.1)
+        # The session for http.pcap is forked from the second preload and
+        # hands the client over to the first one; the status request, sent
+        # with the loads, must reach the session that loaded dhcp.pcap.
+        requests = (
+            {"req": "load", "file": capture_file('http.pcap')},
+            {"req": "load", "file": capture_file('dhcp.pcap')},
+            {"req": "status"},
+        )
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+            sock.settimeout(30)
+            sock.connect(sock_path)
+            sock.sendall(''.join(json.dumps(x) + '\n' for x in requests).encode('utf8'))
+            output = b''
+            while output.count(b'\n') < len(requests):
+                data = sock.recv(4096)
+                if not data:
+                    break
+                output += data
+        lines = output.decode('utf8').split('\n')
+        self.assertEqual(lines[-1], '')
+        self.assertEqual([json.loads(line) for line in lines[:-1]], [
+            {"err": 0},
+            {"err": 0},
+            MatchObject({"frames": 4, "filename": "dhcp.pcap"}),
+        ])
+
     def test_sharkd_req_analyse(self, check_sharkd_session, capture_file):
         check_sharkd_session((
             {"req": "load", "file": capture_file('dhcp.pcap')},
@@ -170,6 +301,75 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
             }),
         ))
 
+    def test_sharkd_req_frames_cbor(self, run_sharkd_session, capture_file):
+        outputs = run_sharkd_session([json.dumps(x) for x in (
+            {"req": "load", "file": capture_file('dhcp.pcap')},
+            {"req": "frames"},
+            {"req": "frames", "format": "cbor"},
+        )])
+        self.assertEqual(len(outputs), 3)
+        json_frames = outputs[1]
+        self.assertEqual(list(outputs[2]), ["cbor"])
+        cbor_frames = decode_cbor_sequence(base64.b64decode(outputs[2]["cbor"]))
+        self.assertEqual(len(cbor_frames), 1)
+        cbor_frames = cbor_frames[0]
+        # The same frames, only with the colors as integers
+        self.assertEqual(len(cbor_frames), 4)
+        for frame in cbor_frames:
+            self.assertIsInstance(frame["bg"], int)
+            frame["bg"] = '%x' % frame["bg"]
+            frame["fg"] = '%x' % frame["fg"]
+        self.assertEqual(cbor_frames, json_frames)
+
+    def test_sharkd_req_frames_cursor(self, check_sharkd_session, capture_file):
+        check_sharkd_session((
+            {"req": "load", "file": capture_file('dhcp.pcap')},
+            {"req": "frames", "cursor": "c1", "column0": "frame.number:0", "limit": 2},
+            {"req": "frames", "cursor": "c1", "limit": 2},
+            {"req": "frames", "cursor": "c1", "limit": 2},
+            {"req": "frames", "cursor": "c1", "column0": "frame.number:0", "skip": 3},
+        ), (
+            {"err": 0},
+            [
+                MatchObject({"c": ["1"], "num": 1}),
+                MatchObject({"c": ["2"], "num": 2}),
+            ],
+            [
+                MatchObject({"c": ["3"], "num": 3}),
+                MatchObject({"c": ["4"], "num": 4}),
+            ],
+            [],
+            [
+                MatchObject({"c": ["4"], "num": 4}),
+            ],
+        ))
+
+    def test_sharkd_req_frames_filter_index(self, run_sharkd_session, capture_file):
+        # The frames matching filters answered from the field value index
+        # must be those matching when the frames are dissected.
+        filters = (
+            'udp.srcport == 68',
+            '!(udp.srcport == 68)',
+            'not ip.dst == 255.255.255.255',
+            'ip.src == 0.0.0.0 or udp.srcport == 67',
+            'ip.src && !udp.dstport == 68',
+            '!udp.srcport == 9999',
+        )
+
+        def frames_matching(index_fields):
+            commands = []
+            if index_fields:
+                commands.append({"req": "setconf", "name": "gui.filter_index_fields", "value": index_fields})
+            commands.append({"req": "load", "file": capture_file('dhcp.pcap')})
+            commands += [{"req": "frames", "filter": f, "column0": "frame.number:0"} for f in filters]
+            outputs = run_sharkd_session([json.dumps(x) for x in commands])
+            return [[frame["num"] for frame in frames] for frames in outputs[-len(filters):]]
+
+        dissected = frames_matching(None)
+        self.assertEqual(dissected[1], [2, 4])
+        self.assertEqual(dissected[5], [1, 2, 3, 4])
+        self.assertEqual(frames_matching('ip.src,ip.dst,udp.srcport,udp.dstport'), dissected)
+
     def test_sharkd_req_tap_invalid(self, check_sharkd_session, capture_file):
         # XXX Unrecognized taps result in an empty line, modify
         #     run_sharkd_session such that checking for it is possible.
@@ -291,6 +491,20 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
                 {"errmsg": 'Filter "garbage filter" is invalid - "filter" was unexpected in this context.'}]},
         ))
 
+    def test_sharkd_req_iograph_interval(self, check_sharkd_session, capture_file):
+        # The second and third requests are answered from the buckets of the first.
+        check_sharkd_session((
+            {"req": "load", "file": capture_file('dhcp.pcap')},
+            {"req": "iograph", "interval": 100, "graph0": "packets", "graph1": "max:udp.length", "filter1": "udp.length"},
+            {"req": "iograph", "interval": 1000, "graph0": "packets", "graph1": "max:udp.length", "filter1": "udp.length"},
+            {"req": "iograph", "interval": 3000, "graph0": "packets", "graph1": "max:udp.length", "filter1": "udp.length"},
+        ), (
+            {"err": 0},
+            {"iograph": [{"items": MatchList(MatchAny())}, {"items": MatchList(MatchAny())}]},
+            {"iograph": [{"items": [4.000000]}, {"items": [308.000000]}]},
+            {"iograph": [{"items": [4.000000]}, {"items": [308.000000]}]},
+        ))
+
     def test_sharkd_req_intervals_bad(self, check_sharkd_session, capture_file):
         check_sharkd_session((
             {"req": "load", "file": capture_file('dhcp.pcap')},
@@ -324,6 +538,60 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
             {"err": 0, "fol": [["UDP", "udp.stream eq 1"]]},
         ))
 
+    def test_sharkd_req_frame_cbor(self, run_sharkd_session, capture_file):
+        outputs = run_sharkd_session([json.dumps(x) for x in (
+            {"req": "load", "file": capture_file('dhcp.pcap')},
+            {"req": "frame", "frame": 2, "proto": True, "v": True},
+            {"req": "frame", "frame": 2, "proto": True, "v": True, "format": "cbor"},
+        )])
+        self.assertEqual(len(outputs), 3)
+        json_frame, cbor_frame = outputs[1], outputs[2]
+        json_tree = json_frame.pop("tree")
+        items = decode_cbor_sequence(base64.b64decode(cbor_frame.pop("cbor")))
+        # Everything but the tree is the same.
+        self.assertEqual(cbor_frame, json_frame)
+
+        self.assertEqual(len(items), 2)
+        self.assertEqual(items[0], ('tag', 55799, {'format': 'wireshark-tree', 'version': 1}))
+        frame_number, keys, cbor_tree = items[1]
+        self.assertEqual(frame_number, 2)
+        compared = {'keys': 0, 'values': 0, 'labels': 0}
+
+        def compare_nodes(json_nodes, cbor_nodes):
+            # The trees have the same shape, with the fields the JSON filters name.
+            self.assertEqual(len(cbor_nodes), len(json_nodes))
+            for json_node, cbor_node in zip(json_nodes, cbor_nodes):
+                key, value = keys[cbor_node[0]], cbor_node[1]
+                match = re.match(r'([\w.-]+)(?: == (\S+))?$', json_node.get("f", ""))
+                if match:
+                    self.assertEqual(key, match.group(1))
+                    compared['keys'] += 1
+                    filter_value = match.group(2)
+                    if (filter_value and type(value) is int
+                            and re.match(r'(\d+|0x[0-9a-fA-F]+)$', filter_value)):
+                        self.assertEqual(value, int(filter_value, 0))
+                        compared['values'] += 1
+                elif key == 'text' and isinstance(value, str):
+                    self.assertEqual(value, json_node["l"])
+                    compared['labels'] += 1
+                self.assertEqual(len(cbor_node) == 3, "n" in json_node)
+                if len(cbor_node) == 3:
+                    compare_nodes(json_node["n"], cbor_node[2])
+
+        compare_nodes(json_tree, cbor_tree)
+        self.assertEqual([keys[node[0]] for node in cbor_tree], ['frame', 'eth', 'ip', 'udp', 'dhcp'])
+        self.assertGreater(compared['keys'], 50)
+        self.assertGreater(compared['values'], 10)
+
+        def find_values(nodes, name):
+            for node in nodes:
+                if keys[node[0]] == name:
+                    yield node[1]
+                if len(node) == 3:
+                    yield from find_values(node[2], name)
+        # DHCP Offer
+        self.assertEqual(list(find_values(cbor_tree, 'dhcp.option.dhcp')), [2])
+
     def test_sharkd_req_frame_proto(self, check_sharkd_session, capture_file):
         # Check proto tree output (including an UTF-8 value).
         check_sharkd_session((
@@ -32,6 +32,14 @@ class case_unittests(subprocesstest.SubprocessTestCase):
         '''reassemble_test'''
         self.assertRun(program('reassemble_test'), env=base_env)
 
+    def test_unit_redissect_test(self, program, base_env):
+        '''redissect_test'''
+        self.assertRun(program('redissect_test'), env=base_env)
+
+    def test_unit_tap_test(self, program, base_env):
+        '''tap_test'''
+        self.assertRun(program('tap_test'), env=base_env)
+
     def test_unit_tvbtest(self, program, base_env):
         '''tvbtest'''
         self.assertRun(program('tvbtest'), env=base_env)
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+#
+# Measure how fast TShark writes a capture file in its machine-readable
+# output formats.
+#
+# Each format is timed for every TShark binary given, so that an older and
+# a newer build can be compared on the same capture:
+#
+#   tshark-output-bench.py -r big.pcapng /old/tshark ./run/tshark
+#
+# Wireshark - Network traffic analyzer
+# By Gerald Combs <gerald@wireshark.org>
+# Copyright 1998 Gerald Combs
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+
+import argparse
+import os
+import subprocess
+import sys
+import time
+
+# Formats and the extra arguments they're run with.
+FORMATS = {
+    'json': ['-T', 'json'],
+    'jsonraw': ['-T', 'jsonraw'],
+    'ek': ['-T', 'ek'],
+    'ek-x': ['-T', 'ek', '-x'],
+    'pdml': ['-T', 'pdml'],
+    'text-V': ['-V'],
+}
+
+
+def count_packets(tshark, capture):
+    '''Returns the number of packets in the capture.'''
+    out = subprocess.check_output([tshark, '-r', capture, '-T', 'fields', '-e', 'frame.number'])
+    return len(out.splitlines())
+
+
+def time_run(tshark, capture, args):
+    '''Runs TShark once, discarding its output, and returns the elapsed time.'''
+    with open(os.devnull, 'wb') as devnull:
+        start = time.perf_counter()
+        subprocess.check_call([tshark, '-r', capture] + args, stdout=devnull)
+        return time.perf_counter() - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare TShark output format throughput.')
+    parser.add_argument('-r', '--read-file', required=True, help='capture file to decode')
+    parser.add_argument('-f', '--format', action='append', choices=sorted(FORMATS),
+                        help='format to time (default: json, ek and ek-x); may be repeated')
+    parser.add_argument('-n', '--repeat', type=int, default=3,
+                        help='runs per measurement; the fastest is reported (default: 3)')
+    parser.add_argument('tshark', nargs='*', default=['tshark'],
+                        help='TShark binaries to compare (default: tshark)')
+    args = parser.parse_args()
+
+    formats = args.format or ['json', 'ek', 'ek-x']
+    packets = count_packets(args.tshark[0], args.read_file)
+    if packets == 0:
+        sys.stderr.write('{} has no packets\n'.format(args.read_file))
+        return 1
+
+    print('{}: {} packets, best of {} runs'.format(args.read_file, packets, args.repeat))
+    print('{:<10} {:<40} {:>10} {:>12}'.format('format', 'tshark', 'seconds', 'packets/s'))
+    for fmt in formats:
+        for tshark in args.tshark:
+            elapsed = min(time_run(tshark, args.read_file, FORMATS[fmt]) for _ in range(args.repeat))
+            print('{:<10} {:<40} {:>10.3f} {:>12.0f}'.format(
+                fmt, tshark[-40:], elapsed, packets / elapsed))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
+
+#
+# Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+#
+# Local variables:
+# c-basic-offset: 4
+# indent-tabs-mode: nil
+# End:
+#
+# vi: set shiftwidth=4 expandtab:
+# :indentSize=4:noTabs=true:
+#
@@ -12,6 +12,10 @@
 
 #include <config.h>
 
+#ifdef HAVE_MEMFD_CREATE
+#define _GNU_SOURCE /* Otherwise memfd_create() won't be declared on Linux */
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -26,6 +30,8 @@
 
 #ifdef _WIN32
 # include <winsock2.h>
+# include <io.h>     /* for _setmode */
+# include <fcntl.h>  /* for O_BINARY */
 #endif
 
 #ifndef _WIN32
@@ -36,6 +42,11 @@
 # include <sys/capability.h>
 #endif
 
+#ifdef HAVE_MEMFD_CREATE
+# include <sys/mman.h>
+# include <fcntl.h>  /* for fallocate */
+#endif
+
 #ifndef HAVE_GETOPT_LONG
 #include "wsutil/wsgetopt.h"
 #endif
@@ -144,6 +155,9 @@
 #define LONGOPT_COLOR (65536+1000)
 #define LONGOPT_NO_DUPLICATE_KEYS (65536+1001)
 #define LONGOPT_ELASTIC_MAPPING_FILTER (65536+1002)
+#define LONGOPT_STATS_INTERVAL (65536+1003)
+#define LONGOPT_STATS_CUMULATIVE (65536+1004)
+#define LONGOPT_TEMP_IN_MEMORY (65536+1005)
 
 #if 0
 #define tshark_debug(...) g_warning(__VA_ARGS__)
@@ -171,7 +185,9 @@ typedef enum {
   WRITE_FIELDS, /* User defined list of fields */
   WRITE_JSON,   /* JSON */
   WRITE_JSON_RAW,   /* JSON only raw hex */
-  WRITE_EK      /* JSON bulk insert to Elasticsearch */
+  WRITE_EK,     /* JSON bulk insert to Elasticsearch */
+  WRITE_ARROW,  /* User defined list of fields as an Arrow IPC stream */
+  WRITE_CBOR    /* Packet details as CBOR */
   /* Add CSV and the like here */
 } output_action_e;
 
@@ -181,6 +197,7 @@ static gboolean print_packet_info; /* TRUE if we're to print packet information
 static gboolean print_summary;     /* TRUE if we're to print packet summary information */
 static gboolean print_details;     /* TRUE if we're to print packet details information */
 static gboolean print_hex;         /* TRUE if we're to print hex/ascci information */
+static gboolean prime_fields;      /* TRUE if the -e fields are taken from an invisible tree */
 static gboolean line_buffered;
 static gboolean really_quiet = FALSE;
 static gchar* delimiter_char = " ";
@@ -198,7 +215,18 @@ static pf_flags protocolfilter_flags = PF_NONE;
 static gboolean no_duplicate_keys = FALSE;
 static proto_node_children_grouper_func node_children_grouper = proto_node_group_children_by_unique;
 
+/*
+ * Tap snapshots (--stats-interval): length of a window and
+ * start of the window the packets currently being processed fall into.
+ */
+static gint64 stats_interval = 0;      /* nanoseconds */
+static gboolean stats_cumulative = FALSE;
+static gboolean stats_window_started = FALSE;
+static gint64 stats_window_start;      /* nanoseconds since the epoch */
+
 static json_dumper jdumper;
+static arrow_writer *arrow_output;
+static cbor_tree_writer *cbor_output;
 
 /* The line separator used between packets, changeable via the -S option */
 static const char *separator = "";
@@ -215,6 +243,16 @@ static capture_options global_capture_opts;
 static capture_session global_capture_session;
 static info_data_t global_info_data;
 
+#ifdef HAVE_MEMFD_CREATE
+/*
+ * TRUE if, when not writing the capture to a file, dumpcap is to write
+ * it to an in-memory file rather than to a temporary file on disk.
+ */
+static gboolean temp_in_memory;
+static int temp_memfd = -1;
+static gint64 temp_memfd_released;  /* the file's been freed up to here */
+#endif
+
 #ifdef SIGINFO
 static gboolean infodelay;      /* if TRUE, don't print capture info in SIGINFO handler */
 static gboolean infoprint;      /* if TRUE, print capture info after clearing infodelay */
@@ -233,6 +271,7 @@ static void report_counts_siginfo(int);
 #endif /* HAVE_LIBPCAP */
 
 static void reset_epan_mem(capture_file *cf, epan_dissect_t *edt, gboolean tree, gboolean visual);
+static gboolean tree_is_visible(void);
 
 typedef enum {
   PROCESS_FILE_SUCCEEDED,
@@ -249,6 +288,7 @@ static void show_print_file_io_error(int err);
 static gboolean write_preamble(capture_file *cf);
 static gboolean print_packet(capture_file *cf, epan_dissect_t *edt);
 static gboolean write_finale(void);
+static void write_stats_snapshot(gboolean final);
 
 static void failure_warning_message(const char *msg_format, va_list ap);
 static void open_failure_message(const char *filename, int err,
@@ -360,6 +400,10 @@ print_usage(FILE *output)
   fprintf(output, "                           interval:NUM - create time intervals of NUM secs\n");
   fprintf(output, "                           filesize:NUM - switch to next file after NUM KB\n");
   fprintf(output, "                              files:NUM - ringbuffer: replace after NUM files\n");
+#ifdef HAVE_MEMFD_CREATE
+  fprintf(output, "  --temp-in-memory         without -w, keep the captured packets in memory\n");
+  fprintf(output, "                           rather than in a temporary file\n");
+#endif
 #endif  /* HAVE_LIBPCAP */
 #ifdef HAVE_PCAP_REMOTE
   fprintf(output, "RPCAP options:\n");
@@ -414,12 +458,12 @@ print_usage(FILE *output)
   fprintf(output, "  -P                       print packet summary even when writing to a file\n");
   fprintf(output, "  -S <separator>           the line separator to print between packets\n");
   fprintf(output, "  -x                       add output of hex and ASCII dump (Packet Bytes)\n");
-  fprintf(output, "  -T pdml|ps|psml|json|jsonraw|ek|tabs|text|fields|?\n");
+  fprintf(output, "  -T pdml|ps|psml|json|jsonraw|ek|cbor|tabs|text|fields|arrow|?\n");
   fprintf(output, "                           format of text output (def: text)\n");
-  fprintf(output, "  -j <protocolfilter>      protocols layers filter if -T ek|pdml|json selected\n");
+  fprintf(output, "  -j <protocolfilter>      protocols layers filter if -T ek|pdml|json|cbor selected\n");
   fprintf(output, "                           (e.g. \"ip ip.flags text\", filter does not expand child\n");
   fprintf(output, "                           nodes, unless child is specified also in the filter)\n");
-  fprintf(output, "  -J <protocolfilter>      top level protocol filter if -T ek|pdml|json selected\n");
+  fprintf(output, "  -J <protocolfilter>      top level protocol filter if -T ek|pdml|json|cbor selected\n");
   fprintf(output, "                           (e.g. \"http tcp\", filter which expands all child nodes)\n");
   fprintf(output, "  -e <field>               field to print if -Tfields selected (e.g. tcp.port,\n");
   fprintf(output, "                           _ws.col.Info)\n");
@@ -457,6 +501,10 @@ print_usage(FILE *output)
   fprintf(output, "                           values\n");
   fprintf(output, "  --elastic-mapping-filter <protocols> If -G elastic-mapping is specified, put only the\n");
   fprintf(output, "                           specified protocols within the mapping file\n");
+  fprintf(output, "  --stats-interval <seconds> write the conv, endpoints, io,stat and stats_tree\n");
+  fprintf(output, "                           statistics as JSON lines every <seconds> of packet time\n");
+  fprintf(output, "  --stats-cumulative       with --stats-interval, don't reset the statistics after\n");
+  fprintf(output, "                           each snapshot\n");
 
   fprintf(output, "\n");
   fprintf(output, "Miscellaneous:\n");
@@ -694,6 +742,11 @@ main(int argc, char *argv[])
     {"color", no_argument, NULL, LONGOPT_COLOR},
     {"no-duplicate-keys", no_argument, NULL, LONGOPT_NO_DUPLICATE_KEYS},
     {"elastic-mapping-filter", required_argument, NULL, LONGOPT_ELASTIC_MAPPING_FILTER},
+    {"stats-interval", required_argument, NULL, LONGOPT_STATS_INTERVAL},
+    {"stats-cumulative", no_argument, NULL, LONGOPT_STATS_CUMULATIVE},
+#if defined(HAVE_LIBPCAP) && defined(HAVE_MEMFD_CREATE)
+    {"temp-in-memory", no_argument, NULL, LONGOPT_TEMP_IN_MEMORY},
+#endif
     {0, 0, 0, 0 }
   };
   gboolean             arg_error = FALSE;
@@ -1324,11 +1377,21 @@ main(int argc, char *argv[])
         output_action = WRITE_JSON_RAW;
         print_details = TRUE;   /* Need details */
         print_summary = FALSE;  /* Don't allow summary */
+      } else if (strcmp(optarg, "arrow") == 0) {
+        output_action = WRITE_ARROW;
+        print_details = TRUE;   /* Need full tree info */
+        print_summary = FALSE;  /* Don't allow summary */
+      } else if (strcmp(optarg, "cbor") == 0) {
+        output_action = WRITE_CBOR;
+        print_details = TRUE;   /* Need details */
+        print_summary = FALSE;  /* Don't allow summary */
       }
       else {
         cmdarg_err("Invalid -T parameter \"%s\"; it must be one of:", optarg);                   /* x */
         cmdarg_err_cont("\t\"fields\"  The values of fields specified with the -e option, in a form\n"
                         "\t          specified by the -E option.\n"
+                        "\t\"arrow\"   The values of fields specified with the -e option, as an\n"
+                        "\t          Apache Arrow IPC stream with one column per field.\n"
                         "\t\"pdml\"    Packet Details Markup Language, an XML-based format for the\n"
                         "\t          details of a decoded packet. This information is equivalent to\n"
                         "\t          the packet details printed with the -V flag.\n"
@@ -1348,6 +1411,8 @@ main(int argc, char *argv[])
                         "\t\"ek\"      Packet Details, an EK JSON-based format for the bulk insert \n"
                         "\t          into elastic search cluster. This information is \n"
                         "\t          equivalent to the packet details printed with the -V flag.\n"
+                        "\t\"cbor\"    Packet Details as a binary CBOR sequence, with field names\n"
+                        "\t          written once and values in their native types.\n"
                         "\t\"text\"    Text of a human-readable one-line summary of each of the\n"
                         "\t          packets, or a multi-line view of the details of each of the\n"
                         "\t          packets, depending on whether the -V flag was specified.\n"
@@ -1453,6 +1518,23 @@ main(int argc, char *argv[])
       no_duplicate_keys = TRUE;
       node_children_grouper = proto_node_group_children_by_json_key;
       break;
+    case LONGOPT_STATS_INTERVAL:
+      stats_interval = (gint64)(get_positive_double(optarg, "statistics interval") * 1000000000.0 + 0.5);
+      if (stats_interval == 0) {
+        cmdarg_err("The statistics interval must be at least one nanosecond.");
+        exit_status = INVALID_OPTION;
+        goto clean_exit;
+      }
+      tap_snapshots_enable();
+      break;
+    case LONGOPT_STATS_CUMULATIVE:
+      stats_cumulative = TRUE;
+      break;
+#if defined(HAVE_LIBPCAP) && defined(HAVE_MEMFD_CREATE)
+    case LONGOPT_TEMP_IN_MEMORY:
+      temp_in_memory = TRUE;
+      break;
+#endif
     default:
     case '?':        /* Bad flag - print usage message */
       switch(optopt) {
@@ -1484,15 +1566,21 @@ main(int argc, char *argv[])
   }
 
   /* If we specified output fields, but not the output field type... */
-  if ((WRITE_FIELDS != output_action && WRITE_XML != output_action && WRITE_JSON != output_action && WRITE_EK != output_action) && 0 != output_fields_num_fields(output_fields)) {
+  if ((WRITE_FIELDS != output_action && WRITE_XML != output_action && WRITE_JSON != output_action && WRITE_EK != output_action && WRITE_ARROW != output_action) && 0 != output_fields_num_fields(output_fields)) {
         cmdarg_err("Output fields were specified with \"-e\", "
-            "but \"-Tek, -Tfields, -Tjson or -Tpdml\" was not specified.");
+            "but \"-Tarrow, -Tek, -Tfields, -Tjson or -Tpdml\" was not specified.");
         exit_status = INVALID_OPTION;
         goto clean_exit;
   } else if (WRITE_FIELDS == output_action && 0 == output_fields_num_fields(output_fields)) {
         cmdarg_err("\"-Tfields\" was specified, but no fields were "
                     "specified with \"-e\".");
 
+        exit_status = INVALID_OPTION;
+        goto clean_exit;
+  } else if (WRITE_ARROW == output_action && 0 == output_fields_num_fields(output_fields)) {
+        cmdarg_err("\"-Tarrow\" was specified, but no fields were "
+                    "specified with \"-e\".");
+
         exit_status = INVALID_OPTION;
         goto clean_exit;
   }
@@ -1821,6 +1909,12 @@ main(int argc, char *argv[])
       goto clean_exit;
     }
   }
+
+  /* If we're only writing the values of fields, the protocol tree
+     need only hold the items for those fields, rather than having an
+     item allocated and labelled for everything that's dissected. */
+  if (output_action == WRITE_FIELDS || output_action == WRITE_ARROW)
+    prime_fields = output_fields_can_prime(output_fields);
 #ifdef HAVE_LIBPCAP
   /* We currently don't support taps, or printing dissected packets,
      if we're writing to a pipe. */
@@ -2251,8 +2345,11 @@ main(int argc, char *argv[])
     cfile.provider.frames = NULL;
   }
 
-  if (draw_taps)
+  if (draw_taps) {
+    if (stats_window_started)
+      write_stats_snapshot(TRUE);
     draw_tap_listeners(TRUE);
+  }
   /* Memory cleanup */
   reset_tap_listeners();
   funnel_dump_all_text_windows();
@@ -2490,10 +2587,39 @@ capture(void)
   fflush(stderr);
   g_string_free(str, TRUE);
 
+#ifdef HAVE_MEMFD_CREATE
+  /* If we were asked to, have dumpcap write to a file that exists only
+     in memory, which we read the packets back from, rather than to a
+     temporary file that's written out to disk just for us to read it
+     back.
+
+     dumpcap inherits the file descriptor, so "/proc/self/fd/N" refers
+     to the same file in dumpcap as it does here. */
+  if (temp_in_memory && global_capture_opts.save_file == NULL) {
+    temp_memfd = memfd_create("tshark_capture", 0);
+    if (temp_memfd == -1) {
+      cmdarg_err("The in-memory capture file couldn't be created: %s.",
+                 g_strerror(errno));
+      return FALSE;
+    }
+    global_capture_opts.save_file = g_strdup_printf("/proc/self/fd/%d", temp_memfd);
+    temp_memfd_released = 0;
+  }
+#endif
+
   ret = sync_pipe_start(&global_capture_opts, &global_capture_session, &global_info_data, NULL);
 
-  if (!ret)
+  if (!ret) {
+#ifdef HAVE_MEMFD_CREATE
+    if (temp_memfd != -1) {
+      ws_close(temp_memfd);
+      temp_memfd = -1;
+      g_free(global_capture_opts.save_file);
+      global_capture_opts.save_file = NULL;
+    }
+#endif
     return FALSE;
+  }
 
   /*
    * Force synchronous resolution of IP addresses; we're doing only
@@ -2675,6 +2801,27 @@ capture_input_new_file(capture_session *cap_session, gchar *new_file)
 
 
 /* capture child tells us we have new packets to read */
+#ifdef HAVE_MEMFD_CREATE
+/*
+ * Frees the part of the in-memory capture file before "offset", which
+ * we've read and won't read again, so that the memory the file takes
+ * doesn't grow for as long as the capture runs.
+ */
+static void
+release_temp_memfd(gint64 offset)
+{
+#ifdef FALLOC_FL_PUNCH_HOLE
+  if (temp_memfd == -1 || offset <= temp_memfd_released)
+    return;
+  if (fallocate(temp_memfd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                temp_memfd_released, offset - temp_memfd_released) == 0)
+    temp_memfd_released = offset;
+#else
+  (void)offset;
+#endif
+}
+#endif
+
 void
 capture_input_new_packets(capture_session *cap_session, int to_read)
 {
@@ -2682,6 +2829,7 @@ capture_input_new_packets(capture_session *cap_session, int to_read)
   int           err;
   gchar        *err_info;
   gint64        data_offset;
+  gint64        last_offset = 0;
   capture_file *cf = cap_session->cf;
   gboolean      filtering_tap_listeners;
   guint         tap_flags;
@@ -2736,7 +2884,7 @@ capture_input_new_packets(capture_session *cap_session, int to_read)
        printing packet details, which is true if we're printing stuff
        ("print_packet_info" is true) and we're in verbose mode
        ("packet_details" is true). */
-    edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+    edt = epan_dissect_new(cf->epan, create_proto_tree, tree_is_visible());
 
     wtap_rec_init(&rec);
     ws_buffer_init(&buf, 1514);
@@ -2744,13 +2892,14 @@ capture_input_new_packets(capture_session *cap_session, int to_read)
     while (to_read-- && cf->provider.wth) {
       wtap_cleareof(cf->provider.wth);
       ret = wtap_read(cf->provider.wth, &rec, &buf, &err, &err_info, &data_offset);
-      reset_epan_mem(cf, edt, create_proto_tree, print_packet_info && print_details);
+      reset_epan_mem(cf, edt, create_proto_tree, tree_is_visible());
       if (ret == FALSE) {
         /* read from file failed, tell the capture child to stop */
         sync_pipe_stop(cap_session);
         wtap_close(cf->provider.wth);
         cf->provider.wth = NULL;
       } else {
+        last_offset = data_offset;
         ret = process_packet_single_pass(cf, edt, data_offset, &rec, &buf,
                                          tap_flags);
       }
@@ -2765,12 +2914,25 @@ capture_input_new_packets(capture_session *cap_session, int to_read)
     wtap_rec_cleanup(&rec);
     ws_buffer_free(&buf);
 
+#ifdef HAVE_MEMFD_CREATE
+    /* Everything before the last packet read is done with */
+    release_temp_memfd(last_offset);
+#endif
   } else {
     /*
      * Dumpcap's doing all the work; we're not doing any dissection.
      * Count all the packets it wrote.
      */
     packet_count += to_read;
+#ifdef HAVE_MEMFD_CREATE
+    /* We don't read them back, so none of them is needed */
+    if (temp_memfd != -1) {
+      ws_statb64 memfd_stat;
+
+      if (ws_fstat64(temp_memfd, &memfd_stat) == 0)
+        release_temp_memfd(memfd_stat.st_size);
+    }
+#endif
   }
 
   if (print_packet_counts) {
@@ -2869,6 +3031,13 @@ capture_input_closed(capture_session *cap_session, gchar *msg)
       ws_unlink(cf->filename);
     }
   }
+#ifdef HAVE_MEMFD_CREATE
+  if (temp_memfd != -1) {
+    /* This frees the in-memory capture file, as dumpcap has exited. */
+    ws_close(temp_memfd);
+    temp_memfd = -1;
+  }
+#endif
 #ifdef USE_BROKEN_G_MAIN_LOOP
   /*g_main_loop_quit(loop);*/
   g_main_loop_quit(loop);
@@ -3142,6 +3311,45 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
   return status;
 }
 
+static void
+write_stats_snapshot(gboolean final)
+{
+  nstime_t start, end;
+
+  start.secs = (time_t)(stats_window_start / G_GINT64_CONSTANT(1000000000));
+  start.nsecs = (int)(stats_window_start % G_GINT64_CONSTANT(1000000000));
+  end.secs = (time_t)((stats_window_start + stats_interval) / G_GINT64_CONSTANT(1000000000));
+  end.nsecs = (int)((stats_window_start + stats_interval) % G_GINT64_CONSTANT(1000000000));
+
+  /* The last snapshot covers everything that's left; nothing to reset. */
+  write_tap_snapshots(stdout, &start, &end, !final && !stats_cumulative);
+}
+
+/*
+ * If --stats-interval was given and this record falls after the current
+ * window, write the taps' snapshots for that window before the record
+ * gets tapped.  Windows are aligned on multiples of the interval, and
+ * windows without any packets are skipped.
+ */
+static void
+check_stats_window(const wtap_rec *rec)
+{
+  gint64 ts;
+
+  if (stats_interval == 0 || !(rec->presence_flags & WTAP_HAS_TS))
+    return;
+
+  ts = (gint64)rec->ts.secs * G_GINT64_CONSTANT(1000000000) + rec->ts.nsecs;
+  if (stats_window_started) {
+    /* Packets that are out of order stay in the current window. */
+    if (ts < stats_window_start + stats_interval)
+      return;
+    write_stats_snapshot(FALSE);
+  }
+  stats_window_start = ts - ts % stats_interval;
+  stats_window_started = TRUE;
+}
+
 static gboolean
 process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
                            frame_data *fdata, wtap_rec *rec,
@@ -3168,6 +3376,9 @@ process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
 
     col_custom_prime_edt(edt, &cf->cinfo);
 
+    if (prime_fields)
+      output_fields_prime_edt(output_fields, edt);
+
     /* We only need the columns if either
          1) some tap needs the columns
        or
@@ -3191,6 +3402,8 @@ process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
       fdata->need_colorize = 1;
     }
 
+    check_stats_window(rec);
+
     epan_dissect_run_with_taps(edt, cf->cd_t, rec,
                                frame_tvbuff_new_buffer(&cf->provider, fdata, buf),
                                fdata, cinfo);
@@ -3278,7 +3491,7 @@ process_cap_file_second_pass(capture_file *cf, wtap_dumper *pdh,
        printing packet details, which is true if we're printing stuff
        ("print_packet_info" is true) and we're in verbose mode
        ("packet_details" is true). */
-    edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+    edt = epan_dissect_new(cf->epan, create_proto_tree, tree_is_visible());
   }
 
   /*
@@ -3385,7 +3598,7 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
        printing packet details, which is true if we're printing stuff
        ("print_packet_info" is true) and we're in verbose mode
        ("packet_details" is true). */
-    edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+    edt = epan_dissect_new(cf->epan, create_proto_tree, tree_is_visible());
   }
 
   /*
@@ -3405,7 +3618,7 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
 
     tshark_debug("tshark: processing packet #%d", framenum);
 
-    reset_epan_mem(cf, edt, create_proto_tree, print_packet_info && print_details);
+    reset_epan_mem(cf, edt, create_proto_tree, tree_is_visible());
 
     if (process_packet_single_pass(cf, edt, data_offset, &rec, &buf, tap_flags)) {
       /* Either there's no read filtering or this packet passed the
@@ -3727,6 +3940,9 @@ process_packet_single_pass(capture_file *cf, epan_dissect_t *edt, gint64 offset,
 
     col_custom_prime_edt(edt, &cf->cinfo);
 
+    if (prime_fields)
+      output_fields_prime_edt(output_fields, edt);
+
     /* We only need the columns if either
          1) some tap needs the columns
        or
@@ -3751,6 +3967,8 @@ process_packet_single_pass(capture_file *cf, epan_dissect_t *edt, gint64 offset,
       fdata.need_colorize = 1;
     }
 
+    check_stats_window(rec);
+
     epan_dissect_run_with_taps(edt, cf->cd_t, rec,
                                frame_tvbuff_new_buffer(&cf->provider, &fdata, buf),
                                &fdata, cinfo);
@@ -3824,6 +4042,21 @@ write_preamble(capture_file *cf)
   case WRITE_EK:
     return TRUE;
 
+  case WRITE_ARROW:
+#ifdef _WIN32
+    /* The stream is binary; don't let CRLF translation mangle it. */
+    _setmode(1, O_BINARY);
+#endif
+    arrow_output = write_arrow_preamble(output_fields, stdout);
+    return !ferror(stdout);
+
+  case WRITE_CBOR:
+#ifdef _WIN32
+    _setmode(1, O_BINARY);
+#endif
+    cbor_output = write_cbor_preamble(stdout);
+    return !ferror(stdout);
+
   default:
     g_assert_not_reached();
     return FALSE;
@@ -4195,6 +4428,14 @@ print_packet(capture_file *cf, epan_dissect_t *edt)
     write_ek_proto_tree(output_fields, print_summary, print_hex, protocolfilter,
                         protocolfilter_flags, edt, &cf->cinfo, stdout);
     return !ferror(stdout);
+
+  case WRITE_ARROW:
+    write_arrow_proto_tree(output_fields, edt, &cf->cinfo, arrow_output);
+    return !ferror(stdout);
+
+  case WRITE_CBOR:
+    write_cbor_proto_tree(protocolfilter, protocolfilter_flags, edt, cbor_output);
+    return !ferror(stdout);
   }
 
   if (print_hex) {
@@ -4237,6 +4478,12 @@ write_finale(void)
   case WRITE_EK:
     return TRUE;
 
+  case WRITE_ARROW:
+    return write_arrow_finale(arrow_output);
+
+  case WRITE_CBOR:
+    return write_cbor_finale(cbor_output);
+
   default:
     g_assert_not_reached();
     return FALSE;
@@ -4368,6 +4615,16 @@ write_failure_message(const char *filename, int err)
              filename, g_strerror(err));
 }
 
+/*
+ * Whether the protocol tree is to be "visible", i.e. labelled for
+ * printing the packet details.  It needn't be if the details are
+ * only the values of the -e fields.
+ */
+static gboolean tree_is_visible(void)
+{
+  return print_packet_info && print_details && !prime_fields;
+}
+
 static void reset_epan_mem(capture_file *cf,epan_dissect_t *edt, gboolean tree, gboolean visual)
 {
   if (!epan_auto_reset || (cf->count < epan_auto_reset_count))
@@ -99,17 +99,63 @@ endpoints_draw(void *arg)
 	printf("================================================================================\n");
 }
 
+static void
+endpoints_snapshot(void *arg, json_dumper *dumper)
+{
+	conv_hash_t *hash = (conv_hash_t*)arg;
+	endpoints_t *iu = (endpoints_t *)hash->user_data;
+	hostlist_talker_t *host;
+	guint i;
+	gboolean display_port = (!strncmp(iu->type, "TCP", 3) || !strncmp(iu->type, "UDP", 3) || !strncmp(iu->type, "SCTP", 4)) ? TRUE : FALSE;
+
+	json_dumper_begin_array(dumper);
+	for (i=0; (iu->hash.conv_array && i < iu->hash.conv_array->len); i++) {
+		char *str;
+
+		host = &g_array_index(iu->hash.conv_array, hostlist_talker_t, i);
+		json_dumper_begin_object(dumper);
+
+		json_dumper_set_member_name(dumper, "host");
+		json_dumper_value_string(dumper, (str = get_conversation_address(NULL, &host->myaddress, TRUE)));
+		wmem_free(NULL, str);
+		if (display_port) {
+			json_dumper_set_member_name(dumper, "port");
+			json_dumper_value_string(dumper, (str = get_conversation_port(NULL, host->port, host->etype, TRUE)));
+			wmem_free(NULL, str);
+		}
+
+		json_dumper_set_member_name(dumper, "rxf");
+		json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, host->rx_frames);
+		json_dumper_set_member_name(dumper, "rxb");
+		json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, host->rx_bytes);
+		json_dumper_set_member_name(dumper, "txf");
+		json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, host->tx_frames);
+		json_dumper_set_member_name(dumper, "txb");
+		json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, host->tx_bytes);
+
+		json_dumper_end_object(dumper);
+	}
+	json_dumper_end_array(dumper);
+}
+
+static void
+endpoints_reset(void *arg)
+{
+	reset_hostlist_table_data((conv_hash_t*)arg);
+}
+
 void init_hostlists(struct register_ct *ct, const char *filter)
 {
 	endpoints_t *iu;
 	GString *error_string;
+	gboolean snapshot = tap_snapshots_enabled();
 
 	iu = g_new0(endpoints_t, 1);
 	iu->type = proto_get_protocol_short_name(find_protocol_by_id(get_conversation_proto_id(ct)));
 	iu->filter = g_strdup(filter);
 	iu->hash.user_data = iu;
 
-	error_string = register_tap_listener(proto_get_protocol_filter_name(get_conversation_proto_id(ct)), &iu->hash, filter, 0, NULL, get_hostlist_packet_func(ct), endpoints_draw, NULL);
+	error_string = register_tap_listener(proto_get_protocol_filter_name(get_conversation_proto_id(ct)), &iu->hash, filter, 0, NULL, get_hostlist_packet_func(ct), snapshot ? NULL : endpoints_draw, NULL);
 	if (error_string) {
 		g_free(iu);
 		cmdarg_err("Couldn't register endpoint tap: %s",
@@ -118,6 +164,13 @@ void init_hostlists(struct register_ct *ct, const char *filter)
 		exit(1);
 	}
 
+	if (snapshot) {
+		char *name = g_strdup_printf("endpoints,%s%s%s", proto_get_protocol_filter_name(get_conversation_proto_id(ct)),
+		    filter ? "," : "", filter ? filter : "");
+		register_tap_snapshot(name, &iu->hash, endpoints_snapshot, endpoints_reset);
+		g_free(name);
+	}
+
 }
 
 /*
@@ -18,6 +18,8 @@
 #include <epan/stat_tap_ui.h>
 #include "globals.h"
 
+#include <ui/cli/tshark-tap.h>
+
 #define CALC_TYPE_FRAMES 0
 #define CALC_TYPE_BYTES  1
 #define CALC_TYPE_FRAMES_AND_BYTES 2
@@ -1221,6 +1223,126 @@ iostat_draw(void *arg)
     g_free(item_in_column);
 }
 
+/* The value of a cell as iostat_draw() would show it, for snapshots. */
+static void
+iostat_snapshot_value(io_stat_t *io, io_stat_item_t *item, json_dumper *dumper)
+{
+    guint32 num;
+    int ftype;
+
+    switch (item->calc_type) {
+    case CALC_TYPE_FRAMES:
+        json_dumper_value_anyf(dumper, "%u", item->frames);
+        return;
+    case CALC_TYPE_BYTES:
+    case CALC_TYPE_COUNT:
+    case CALC_TYPE_FRAMES_AND_BYTES:
+        json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, item->counter);
+        return;
+    case CALC_TYPE_LOAD:
+        json_dumper_value_double(dumper, io->interval == G_MAXUINT64 ? 0.0 :
+                                 (double)item->counter / (double)io->interval);
+        return;
+    }
+
+    num = 1;
+    if (item->calc_type == CALC_TYPE_AVG && item->num != 0)
+        num = item->num;
+    ftype = proto_registrar_get_ftype(item->hf_index);
+    switch (ftype) {
+    case FT_FLOAT:
+        json_dumper_value_double(dumper, item->float_counter / num);
+        break;
+    case FT_DOUBLE:
+        json_dumper_value_double(dumper, item->double_counter / num);
+        break;
+    case FT_RELATIVE_TIME:
+        json_dumper_value_anyf(dumper, "%.9f", (double)(item->counter / (guint64)num) / NANOSECS_PER_SEC);
+        break;
+    case FT_INT8:
+    case FT_INT16:
+    case FT_INT24:
+    case FT_INT32:
+        json_dumper_value_anyf(dumper, "%d", (gint32)item->counter / (gint32)num);
+        break;
+    case FT_INT40:
+    case FT_INT48:
+    case FT_INT56:
+    case FT_INT64:
+        json_dumper_value_anyf(dumper, "%" G_GINT64_FORMAT, (gint64)item->counter / (gint64)num);
+        break;
+    default:
+        json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, item->counter / num);
+        break;
+    }
+}
+
+static void
+iostat_snapshot(void *arg, json_dumper *dumper)
+{
+    io_stat_t *io = (io_stat_t *)arg;
+    io_stat_item_t *item;
+    int i;
+
+    json_dumper_begin_object(dumper);
+    json_dumper_set_member_name(dumper, "interval");
+    json_dumper_value_anyf(dumper, "%.6f", io->interval == G_MAXUINT64 ? 0.0 : (double)io->interval / 1000000.0);
+    json_dumper_set_member_name(dumper, "columns");
+    json_dumper_begin_array(dumper);
+    for (i=0; i<io->num_cols; i++) {
+        json_dumper_begin_object(dumper);
+        json_dumper_set_member_name(dumper, "filter");
+        json_dumper_value_string(dumper, io->filters[i] ? io->filters[i] : "");
+        json_dumper_set_member_name(dumper, "rows");
+        json_dumper_begin_array(dumper);
+        for (item = &io->items[i]; item; item = item->next) {
+            json_dumper_begin_object(dumper);
+            json_dumper_set_member_name(dumper, "start");
+            json_dumper_value_anyf(dumper, "%.6f", (double)item->start_time / 1000000.0);
+            json_dumper_set_member_name(dumper, "frames");
+            json_dumper_value_anyf(dumper, "%u", item->frames);
+            if (item->calc_type != CALC_TYPE_FRAMES) {
+                json_dumper_set_member_name(dumper, "value");
+                iostat_snapshot_value(io, item, dumper);
+            }
+            json_dumper_end_object(dumper);
+        }
+        json_dumper_end_array(dumper);
+        json_dumper_end_object(dumper);
+    }
+    json_dumper_end_array(dumper);
+    json_dumper_end_object(dumper);
+}
+
+/*
+ * Drop the rows written by the last snapshot.  The interval packets were
+ * last seen in may not be over yet, so each column starts again with an
+ * empty row for it; that row is reported again, with what it gets from
+ * then on, by the next snapshot.
+ */
+static void
+iostat_reset(void *arg)
+{
+    io_stat_t *io = (io_stat_t *)arg;
+    io_stat_item_t *mit, *it, *next;
+    int i;
+
+    for (i=0; i<io->num_cols; i++) {
+        mit = &io->items[i];
+        mit->start_time = mit->prev->start_time;
+        for (it = mit->next; it; it = next) {
+            next = it->next;
+            g_free(it);
+        }
+        mit->next = NULL;
+        mit->prev = mit;
+        mit->frames = 0;
+        mit->num = 0;
+        mit->counter = 0;
+        mit->float_counter = 0;
+        mit->double_counter = 0;
+    }
+}
 
 static void
 register_io_tap(io_stat_t *io, int i, const char *filter)
@@ -1241,6 +1363,8 @@ register_io_tap(io_stat_t *io, int i, const char *filter)
     io->items[i].frames     = 0;
     io->items[i].counter    = 0;
     io->items[i].num        = 0;
+    io->items[i].float_counter  = 0;
+    io->items[i].double_counter = 0;
 
     io->filters[i] = filter;
     flt = filter;
@@ -1372,7 +1496,7 @@ register_io_tap(io_stat_t *io, int i, const char *filter)
     g_free(field);
 
     error_string = register_tap_listener("frame", &io->items[i], flt, TL_REQUIRES_PROTO_TREE, NULL,
-                                       iostat_packet, i ? NULL : iostat_draw, NULL);
+                                       iostat_packet, (i || tap_snapshots_enabled()) ? NULL : iostat_draw, NULL);
     if (error_string) {
         g_free(io->items);
         g_free(io);
@@ -1522,6 +1646,9 @@ iostat_init(const char *opt_arg, void *userdata _U_)
             i++;
         } while (pos);
     }
+
+    if (tap_snapshots_enabled())
+        register_tap_snapshot(opt_arg, io, iostat_snapshot, iostat_reset);
 }
 
 static stat_tap_ui iostat_ui = {
@@ -213,17 +213,73 @@ iousers_draw(void *arg)
 	printf("================================================================================\n");
 }
 
+static void
+iousers_snapshot(void *arg, json_dumper *dumper)
+{
+	conv_hash_t *hash = (conv_hash_t*)arg;
+	io_users_t *iu = (io_users_t *)hash->user_data;
+	conv_item_t *iui;
+	guint i;
+	gboolean display_ports = (!strncmp(iu->type, "TCP", 3) || !strncmp(iu->type, "UDP", 3) || !strncmp(iu->type, "SCTP", 4)) ? TRUE : FALSE;
+
+	json_dumper_begin_array(dumper);
+	for (i=0; (iu->hash.conv_array && i < iu->hash.conv_array->len); i++) {
+		char *str;
+
+		iui = &g_array_index(iu->hash.conv_array, conv_item_t, i);
+		json_dumper_begin_object(dumper);
+
+		json_dumper_set_member_name(dumper, "saddr");
+		json_dumper_value_string(dumper, (str = get_conversation_address(NULL, &iui->src_address, TRUE)));
+		wmem_free(NULL, str);
+		json_dumper_set_member_name(dumper, "daddr");
+		json_dumper_value_string(dumper, (str = get_conversation_address(NULL, &iui->dst_address, TRUE)));
+		wmem_free(NULL, str);
+		if (display_ports) {
+			json_dumper_set_member_name(dumper, "sport");
+			json_dumper_value_string(dumper, (str = get_conversation_port(NULL, iui->src_port, iui->etype, TRUE)));
+			wmem_free(NULL, str);
+			json_dumper_set_member_name(dumper, "dport");
+			json_dumper_value_string(dumper, (str = get_conversation_port(NULL, iui->dst_port, iui->etype, TRUE)));
+			wmem_free(NULL, str);
+		}
+
+		json_dumper_set_member_name(dumper, "rxf");
+		json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, iui->rx_frames);
+		json_dumper_set_member_name(dumper, "rxb");
+		json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, iui->rx_bytes);
+		json_dumper_set_member_name(dumper, "txf");
+		json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, iui->tx_frames);
+		json_dumper_set_member_name(dumper, "txb");
+		json_dumper_value_anyf(dumper, "%" G_GUINT64_FORMAT, iui->tx_bytes);
+		json_dumper_set_member_name(dumper, "start");
+		json_dumper_value_anyf(dumper, "%.9f", nstime_to_sec(&iui->start_time));
+		json_dumper_set_member_name(dumper, "stop");
+		json_dumper_value_anyf(dumper, "%.9f", nstime_to_sec(&iui->stop_time));
+
+		json_dumper_end_object(dumper);
+	}
+	json_dumper_end_array(dumper);
+}
+
+static void
+iousers_reset(void *arg)
+{
+	reset_conversation_table_data((conv_hash_t*)arg);
+}
+
 void init_iousers(struct register_ct *ct, const char *filter)
 {
 	io_users_t *iu;
 	GString *error_string;
+	gboolean snapshot = tap_snapshots_enabled();
 
 	iu = g_new0(io_users_t, 1);
 	iu->type = proto_get_protocol_short_name(find_protocol_by_id(get_conversation_proto_id(ct)));
 	iu->filter = g_strdup(filter);
 	iu->hash.user_data = iu;
 
-	error_string = register_tap_listener(proto_get_protocol_filter_name(get_conversation_proto_id(ct)), &iu->hash, filter, 0, NULL, get_conversation_packet_func(ct), iousers_draw, NULL);
+	error_string = register_tap_listener(proto_get_protocol_filter_name(get_conversation_proto_id(ct)), &iu->hash, filter, 0, NULL, get_conversation_packet_func(ct), snapshot ? NULL : iousers_draw, NULL);
 	if (error_string) {
 		g_free(iu);
 		cmdarg_err("Couldn't register conversations tap: %s",
@@ -232,6 +288,13 @@ void init_iousers(struct register_ct *ct, const char *filter)
 		exit(1);
 	}
 
+	if (snapshot) {
+		char *name = g_strdup_printf("conv,%s%s%s", proto_get_protocol_filter_name(get_conversation_proto_id(ct)),
+		    filter ? "," : "", filter ? filter : "");
+		register_tap_snapshot(name, &iu->hash, iousers_snapshot, iousers_reset);
+		g_free(name);
+	}
+
 }
 
 /*
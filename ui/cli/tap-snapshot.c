@@ -0,0 +1,95 @@
+/* tap-snapshot.c
+ * Periodic JSON snapshots of TShark taps
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include <glib.h>
+
+#include <ui/cli/tshark-tap.h>
+
+typedef struct {
+	char *name;
+	void *tapdata;
+	tap_snapshot_cb snapshot;
+	tap_reset_cb reset;
+} tap_snapshot_t;
+
+static gboolean snapshots_enabled = FALSE;
+static GSList *snapshot_list = NULL;
+
+void
+tap_snapshots_enable(void)
+{
+	snapshots_enabled = TRUE;
+}
+
+gboolean
+tap_snapshots_enabled(void)
+{
+	return snapshots_enabled;
+}
+
+void
+register_tap_snapshot(const char *name, void *tapdata,
+    tap_snapshot_cb snapshot, tap_reset_cb reset)
+{
+	tap_snapshot_t *ts;
+
+	ts = g_new(tap_snapshot_t, 1);
+	ts->name = g_strdup(name);
+	ts->tapdata = tapdata;
+	ts->snapshot = snapshot;
+	ts->reset = reset;
+	snapshot_list = g_slist_append(snapshot_list, ts);
+}
+
+void
+write_tap_snapshots(FILE *fh, const nstime_t *start, const nstime_t *end,
+    gboolean reset)
+{
+	GSList *l;
+
+	for (l = snapshot_list; l; l = l->next) {
+		tap_snapshot_t *ts = (tap_snapshot_t *)l->data;
+		json_dumper dumper = { 0 };
+
+		dumper.output_file = fh;
+		json_dumper_begin_object(&dumper);
+		json_dumper_set_member_name(&dumper, "start");
+		json_dumper_value_anyf(&dumper, "%.9f", nstime_to_sec(start));
+		json_dumper_set_member_name(&dumper, "end");
+		json_dumper_value_anyf(&dumper, "%.9f", nstime_to_sec(end));
+		json_dumper_set_member_name(&dumper, "tap");
+		json_dumper_value_string(&dumper, ts->name);
+		json_dumper_set_member_name(&dumper, "data");
+		ts->snapshot(ts->tapdata, &dumper);
+		json_dumper_end_object(&dumper);
+		json_dumper_finish(&dumper);
+
+		if (reset && ts->reset)
+			ts->reset(ts->tapdata);
+	}
+	fflush(fh);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
@@ -20,6 +20,8 @@
 #include <epan/stats_tree_priv.h>
 #include <epan/stat_tap_ui.h>
 
+#include <ui/cli/tshark-tap.h>
+
 void register_tap_listener_stats_tree_stat(void);
 
 /* actually unused */
@@ -48,6 +50,71 @@ draw_stats_tree(void *psp)
 	g_string_free(s, TRUE);
 }
 
+/* Same members as the "stats" objects of sharkd's tap request. */
+static void
+snapshot_stats_tree_nodes(const stat_node *n, json_dumper *dumper)
+{
+	stat_node *node;
+
+	json_dumper_begin_array(dumper);
+	for (node = n->children; node; node = node->next) {
+		json_dumper_begin_object(dumper);
+
+		json_dumper_set_member_name(dumper, "name");
+		json_dumper_value_string(dumper, node->name);
+		json_dumper_set_member_name(dumper, "count");
+		json_dumper_value_anyf(dumper, "%d", node->counter);
+		if (node->counter && ((node->st_flags & ST_FLG_AVERAGE) || node->rng)) {
+			switch (node->datatype) {
+			case STAT_DT_INT:
+				json_dumper_set_member_name(dumper, "avg");
+				json_dumper_value_anyf(dumper, "%.2f", ((float)node->total.int_total) / node->counter);
+				json_dumper_set_member_name(dumper, "min");
+				json_dumper_value_anyf(dumper, "%d", node->minvalue.int_min);
+				json_dumper_set_member_name(dumper, "max");
+				json_dumper_value_anyf(dumper, "%d", node->maxvalue.int_max);
+				break;
+			case STAT_DT_FLOAT:
+				json_dumper_set_member_name(dumper, "avg");
+				json_dumper_value_anyf(dumper, "%.2f", node->total.float_total / node->counter);
+				json_dumper_set_member_name(dumper, "min");
+				json_dumper_value_anyf(dumper, "%f", node->minvalue.float_min);
+				json_dumper_set_member_name(dumper, "max");
+				json_dumper_value_anyf(dumper, "%f", node->maxvalue.float_max);
+				break;
+			}
+		}
+
+		if (node->st->elapsed) {
+			json_dumper_set_member_name(dumper, "rate");
+			json_dumper_value_anyf(dumper, "%.4f", ((float)node->counter) / node->st->elapsed);
+		}
+
+		if (node->parent && node->parent->counter) {
+			json_dumper_set_member_name(dumper, "perc");
+			json_dumper_value_anyf(dumper, "%.2f", (node->counter * 100.0) / node->parent->counter);
+		} else if (node->parent == &(node->st->root)) {
+			json_dumper_set_member_name(dumper, "perc");
+			json_dumper_value_anyf(dumper, "100");
+		}
+
+		if (node->children) {
+			json_dumper_set_member_name(dumper, "sub");
+			snapshot_stats_tree_nodes(node, dumper);
+		}
+		json_dumper_end_object(dumper);
+	}
+	json_dumper_end_array(dumper);
+}
+
+static void
+snapshot_stats_tree(void *psp, json_dumper *dumper)
+{
+	stats_tree *st = (stats_tree *)psp;
+
+	snapshot_stats_tree_nodes(&st->root, dumper);
+}
+
 static void
 init_stats_tree(const char *opt_arg, void *userdata _U_)
 {
@@ -84,7 +151,7 @@ init_stats_tree(const char *opt_arg, void *userdata _U_)
 					     st->cfg->flags,
 					     stats_tree_reset,
 					     stats_tree_packet,
-					     draw_stats_tree,
+					     tap_snapshots_enabled() ? NULL : draw_stats_tree,
 					     NULL);
 
 	if (error_string) {
@@ -94,6 +161,9 @@ init_stats_tree(const char *opt_arg, void *userdata _U_)
 
 	if (cfg->init) cfg->init(st);
 
+	if (tap_snapshots_enabled())
+		register_tap_snapshot(opt_arg, st, snapshot_stats_tree, stats_tree_reset);
+
 }
 
 static void
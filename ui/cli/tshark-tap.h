@@ -10,7 +10,12 @@
 #ifndef __TSHARK_TAP_H__
 #define __TSHARK_TAP_H__
 
+#include <stdio.h>
+
 #include <epan/conversation_table.h>
+#include <epan/tap.h>
+#include <wsutil/json_dumper.h>
+#include <wsutil/nstime.h>
 
 extern void init_iousers(struct register_ct* ct, const char *filter);
 extern void init_hostlists(struct register_ct* ct, const char *filter);
@@ -18,4 +23,26 @@ extern gboolean register_srt_tables(const void *key, void *value, void *userdata
 extern gboolean register_rtd_tables(const void *key, void *value, void *userdata);
 extern gboolean register_simple_stat_tables(const void *key, void *value, void *userdata);
 
+/*
+ * Tap snapshots: instead of drawing their results once at the end of the
+ * run, taps that support it write a JSON object with their current state
+ * every time TShark closes a time window (--stats-interval).  Such taps
+ * check tap_snapshots_enabled() when they are initialized and, if it is
+ * set, register a snapshot callback instead of a draw callback.
+ */
+typedef void (*tap_snapshot_cb)(void *tapdata, json_dumper *dumper);
+
+extern void tap_snapshots_enable(void);
+extern gboolean tap_snapshots_enabled(void);
+extern void register_tap_snapshot(const char *name, void *tapdata,
+    tap_snapshot_cb snapshot, tap_reset_cb reset);
+
+/*
+ * Write one JSON line per registered snapshot tap for the window
+ * [start, end).  If reset is set, the taps' counters are reset afterwards
+ * so the next snapshot only covers the next window.
+ */
+extern void write_tap_snapshots(FILE *fh, const nstime_t *start,
+    const nstime_t *end, gboolean reset);
+
 #endif /* __TSHARK_TAP_H__ */
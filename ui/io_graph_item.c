@@ -12,6 +12,7 @@
 
 #include "config.h"
 
+#include <string.h>
 
 #include <epan/epan_dissect.h>
 
@@ -275,6 +276,308 @@ double get_io_graph_item(const io_graph_item_t *items_, io_graph_item_unit_t val
     return value;
 }
 
+typedef struct {
+    int              interval;      /* Bucket width in ms */
+    io_graph_item_t *items;
+    int              num_items;     /* Index of the last used bucket plus one */
+    int              space_items;
+    gboolean         dropped;       /* Packets fell past max_items */
+} io_graph_level_t;
+
+struct _io_graph_tree_t {
+    guint                num_levels;
+    io_graph_level_t    *levels;    /* Finest first */
+    int                  max_items;
+    int                  hf_index;
+    io_graph_item_unit_t item_unit;
+};
+
+io_graph_tree_t *io_graph_tree_new(int base_interval, guint num_levels, int max_items)
+{
+    io_graph_tree_t *tree;
+    guint i;
+
+    g_assert(base_interval > 0 && num_levels > 0 && max_items > 0);
+
+    tree = g_new0(io_graph_tree_t, 1);
+    tree->num_levels = num_levels;
+    tree->levels = g_new0(io_graph_level_t, num_levels);
+    tree->max_items = max_items;
+    tree->hf_index = -1;
+    tree->item_unit = IOG_ITEM_UNIT_PACKETS;
+
+    for (i = 0; i < num_levels; i++) {
+        tree->levels[i].interval = base_interval;
+        /* Don't bother with levels whose interval would overflow */
+        if (base_interval > G_MAXINT / 10) {
+            tree->num_levels = i + 1;
+            break;
+        }
+        base_interval *= 10;
+    }
+
+    return tree;
+}
+
+void io_graph_tree_free(io_graph_tree_t *tree)
+{
+    guint i;
+
+    if (!tree) {
+        return;
+    }
+
+    for (i = 0; i < tree->num_levels; i++) {
+        g_free(tree->levels[i].items);
+    }
+    g_free(tree->levels);
+    g_free(tree);
+}
+
+void io_graph_tree_reset(io_graph_tree_t *tree, int hf_index, io_graph_item_unit_t item_unit)
+{
+    guint i;
+
+    for (i = 0; i < tree->num_levels; i++) {
+        io_graph_level_t *level = &tree->levels[i];
+
+        reset_io_graph_items(level->items, level->space_items);
+        level->num_items = 0;
+        level->dropped = FALSE;
+    }
+    tree->hf_index = hf_index;
+    tree->item_unit = item_unit;
+}
+
+void io_graph_tree_limit(io_graph_tree_t *tree, int max_items)
+{
+    guint keep, drop, i;
+    int total = 0;
+
+    /* Keep the coarsest levels that fit */
+    for (keep = 0; keep < tree->num_levels; keep++) {
+        int level_items = tree->levels[tree->num_levels - 1 - keep].num_items;
+
+        if (keep > 0 && total + level_items > max_items) {
+            break;
+        }
+        total += level_items;
+    }
+
+    drop = tree->num_levels - keep;
+    for (i = 0; i < drop; i++) {
+        g_free(tree->levels[i].items);
+    }
+    memmove(tree->levels, &tree->levels[drop], sizeof(io_graph_level_t) * keep);
+    tree->num_levels = keep;
+
+    for (i = 0; i < keep; i++) {
+        io_graph_level_t *level = &tree->levels[i];
+
+        if (level->space_items > level->num_items) {
+            level->items = (io_graph_item_t *) g_realloc(level->items, sizeof(io_graph_item_t) * level->num_items);
+            level->space_items = level->num_items;
+        }
+    }
+}
+
+/* Make room for bucket idx of a level. */
+static void io_graph_level_grow(io_graph_level_t *level, int idx, int max_items)
+{
+    int new_size;
+
+    if (idx < level->space_items) {
+        return;
+    }
+
+    new_size = MAX(idx + 1, level->space_items * 2);
+    new_size = MAX(new_size, 1024);
+    new_size = MIN(new_size, max_items);
+
+    level->items = (io_graph_item_t *) g_realloc(level->items, sizeof(io_graph_item_t) * new_size);
+    reset_io_graph_items(&level->items[level->space_items], new_size - level->space_items);
+    level->space_items = new_size;
+}
+
+gboolean io_graph_tree_update(io_graph_tree_t *tree, packet_info *pinfo, epan_dissect_t *edt)
+{
+    gboolean updated = FALSE;
+    guint i;
+
+    /* Only the advanced units look at the protocol tree */
+    if (tree->item_unit < IOG_ITEM_UNIT_CALC_SUM) {
+        edt = NULL;
+    }
+
+    for (i = 0; i < tree->num_levels; i++) {
+        io_graph_level_t *level = &tree->levels[i];
+        int idx = get_io_graph_index(pinfo, level->interval);
+
+        if (idx < 0) {
+            continue;
+        }
+        if (idx >= tree->max_items) {
+            /* Same as tapping at this interval: the level is full */
+            io_graph_level_grow(level, tree->max_items - 1, tree->max_items);
+            level->num_items = tree->max_items;
+            level->dropped = TRUE;
+            continue;
+        }
+
+        io_graph_level_grow(level, idx, tree->max_items);
+        if (idx + 1 > level->num_items) {
+            level->num_items = idx + 1;
+        }
+        if (update_io_graph_item(level->items, idx, pinfo, edt, tree->hf_index, tree->item_unit, level->interval)) {
+            updated = TRUE;
+        }
+    }
+
+    return updated;
+}
+
+/* Add the values of src, which follows dst in time, to dst. */
+static void merge_io_graph_item(io_graph_item_t *dst, const io_graph_item_t *src, enum ftenum ftype, io_graph_item_unit_t item_unit)
+{
+    gboolean new_max = FALSE, new_min = FALSE;
+
+    if (dst->first_frame_in_invl == 0) {
+        dst->first_frame_in_invl = src->first_frame_in_invl;
+    }
+    if (src->last_frame_in_invl != 0) {
+        dst->last_frame_in_invl = src->last_frame_in_invl;
+    }
+    dst->frames += src->frames;
+    dst->bytes += src->bytes;
+
+    /* LOAD spreads times over the intervals; the totals simply add up */
+    nstime_add(&dst->time_tot, &src->time_tot);
+
+    if (src->fields == 0) {
+        return;
+    }
+
+    switch (ftype) {
+    case FT_UINT8:
+    case FT_UINT16:
+    case FT_UINT24:
+    case FT_UINT32:
+    case FT_UINT40:
+    case FT_UINT48:
+    case FT_UINT56:
+    case FT_UINT64:
+    case FT_INT8:
+    case FT_INT16:
+    case FT_INT24:
+    case FT_INT32:
+    case FT_INT40:
+    case FT_INT48:
+    case FT_INT56:
+    case FT_INT64:
+        new_max = (src->int_max > dst->int_max) || (dst->fields == 0);
+        new_min = (src->int_min < dst->int_min) || (dst->fields == 0);
+        if (new_max) {
+            dst->int_max = src->int_max;
+        }
+        if (new_min) {
+            dst->int_min = src->int_min;
+        }
+        dst->int_tot += src->int_tot;
+        break;
+    case FT_FLOAT:
+        new_max = (src->float_max > dst->float_max) || (dst->fields == 0);
+        new_min = (src->float_min < dst->float_min) || (dst->fields == 0);
+        if (new_max) {
+            dst->float_max = src->float_max;
+        }
+        if (new_min) {
+            dst->float_min = src->float_min;
+        }
+        dst->float_tot += src->float_tot;
+        break;
+    case FT_DOUBLE:
+        new_max = (src->double_max > dst->double_max) || (dst->fields == 0);
+        new_min = (src->double_min < dst->double_min) || (dst->fields == 0);
+        if (new_max) {
+            dst->double_max = src->double_max;
+        }
+        if (new_min) {
+            dst->double_min = src->double_min;
+        }
+        dst->double_tot += src->double_tot;
+        break;
+    case FT_RELATIVE_TIME:
+        new_max = (nstime_cmp(&src->time_max, &dst->time_max) > 0) || (dst->fields == 0);
+        new_min = (nstime_cmp(&src->time_min, &dst->time_min) < 0) || (dst->fields == 0);
+        if (new_max) {
+            dst->time_max = src->time_max;
+        }
+        if (new_min) {
+            dst->time_min = src->time_min;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if ((new_max && item_unit == IOG_ITEM_UNIT_CALC_MAX) ||
+        (new_min && item_unit == IOG_ITEM_UNIT_CALC_MIN)) {
+        dst->extreme_frame_in_invl = src->extreme_frame_in_invl;
+    }
+    dst->fields += src->fields;
+}
+
+int io_graph_tree_get_items(const io_graph_tree_t *tree, int hf_index, io_graph_item_unit_t item_unit,
+                            int interval, int first_idx, io_graph_item_t *items, int max_items)
+{
+    const io_graph_level_t *level = NULL;
+    enum ftenum ftype = FT_NONE;
+    int stride, num_items, i;
+    guint l;
+
+    if (hf_index != tree->hf_index || item_unit != tree->item_unit || interval <= 0 || first_idx < 0) {
+        return -1;
+    }
+
+    /* Merge as few buckets as possible */
+    for (l = tree->num_levels; l > 0; l--) {
+        if (interval % tree->levels[l - 1].interval == 0) {
+            level = &tree->levels[l - 1];
+            break;
+        }
+    }
+    if (!level) {
+        return -1;
+    }
+
+    stride = interval / level->interval;
+    if (level->dropped && stride > 1) {
+        /* The coarser buckets would be missing the dropped packets */
+        return -1;
+    }
+
+    num_items = (level->num_items + stride - 1) / stride;
+    if (hf_index >= 0) {
+        ftype = proto_registrar_get_ftype(hf_index);
+    }
+
+    reset_io_graph_items(items, max_items);
+    for (i = 0; i < max_items && first_idx + i < num_items; i++) {
+        int src_idx = (first_idx + i) * stride;
+        int src_end = MIN(src_idx + stride, level->num_items);
+
+        if (stride == 1) {
+            items[i] = level->items[src_idx];
+            continue;
+        }
+        for (; src_idx < src_end; src_idx++) {
+            merge_io_graph_item(&items[i], &level->items[src_idx], ftype, item_unit);
+        }
+    }
+
+    return num_items;
+}
+
 /*
  * Editor modelines
  *
@@ -382,6 +382,87 @@ update_io_graph_item(io_graph_item_t *items, int idx, packet_info *pinfo, epan_d
     return TRUE;
 }
 
+/*
+ * Multi-resolution I/O graph data.
+ *
+ * A tree of buckets where the first level has the given base interval and
+ * every level above it is ten times coarser. All levels are filled while
+ * tapping, so that the items for any interval that is a multiple of the
+ * base interval can later be built by merging buckets of the coarsest
+ * level that divides it, instead of retapping the whole capture.
+ *
+ * Each level holds at most max_items buckets; packets past the end of a
+ * level are dropped from that level only, just as they would be from an
+ * io_graph_item_t array tapped at that interval.
+ */
+typedef struct _io_graph_tree_t io_graph_tree_t;
+
+/** Create an empty tree.
+ *
+ * @param base_interval [in] Interval of the finest level in ms.
+ * @param num_levels [in] Number of levels.
+ * @param max_items [in] Maximum number of buckets per level.
+ * @return A new tree. Free with io_graph_tree_free().
+ */
+io_graph_tree_t *io_graph_tree_new(int base_interval, guint num_levels, int max_items);
+
+/** Free a tree.
+ *
+ * @param tree [in] The tree to free. May be NULL.
+ */
+void io_graph_tree_free(io_graph_tree_t *tree);
+
+/** Empty a tree and set the calculation its buckets are filled for.
+ *
+ * @param tree [in,out] The tree to reset.
+ * @param hf_index [in] Header field index for advanced statistics.
+ * @param item_unit [in] The type of unit to calculate. From IOG_ITEM_UNITS.
+ */
+void io_graph_tree_reset(io_graph_tree_t *tree, int hf_index, io_graph_item_unit_t item_unit);
+
+/** Limit the memory taken up by a tree that has been filled.
+ *
+ * Frees the unused space of every level, and drops the finest levels
+ * until the tree holds at most max_items buckets in all; the coarsest
+ * level is always kept. Items for intervals only the dropped levels
+ * divide can't be built from the tree any more. The tree can still be
+ * updated.
+ *
+ * @param tree [in,out] The tree to limit.
+ * @param max_items [in] Maximum number of buckets of all levels.
+ */
+void io_graph_tree_limit(io_graph_tree_t *tree, int max_items);
+
+/** Add a packet to every level of a tree.
+ *
+ * @param tree [in,out] The tree to update.
+ * @param pinfo [in] Packet containing update information.
+ * @param edt [in] Dissection information for advanced statistics. May be NULL.
+ * @return TRUE if any level was updated, otherwise FALSE.
+ */
+gboolean io_graph_tree_update(io_graph_tree_t *tree, packet_info *pinfo, epan_dissect_t *edt);
+
+/** Build the items for an interval from a tree.
+ *
+ * items[i] is set to the item for interval index first_idx + i. Items past
+ * the end of the data are reset.
+ *
+ * @param tree [in] The tree to query.
+ * @param hf_index [in] Header field index the items are wanted for.
+ * @param item_unit [in] Unit the items are wanted for.
+ * @param interval [in] Timing interval in ms.
+ * @param first_idx [in] Interval index of the first item to build.
+ * @param items [out] Array receiving the items.
+ * @param max_items [in] The number of items in the array.
+ * @return The total number of items at this interval (the index of the last
+ *         one plus one), or -1 if the tree can't provide them: the tree was
+ *         filled for another field or unit, interval isn't a multiple of the
+ *         base interval, or the level the items would be merged from
+ *         dropped packets.
+ */
+int io_graph_tree_get_items(const io_graph_tree_t *tree, int hf_index, io_graph_item_unit_t item_unit,
+                            int interval, int first_idx, io_graph_item_t *items, int max_items);
+
 
 #ifdef __cplusplus
 }
@@ -110,6 +110,8 @@ prefs_store_ext(const char * module_name, const char *pref_name, const char *pre
     {
         prefs_main_write();
         prefs_apply_all();
+        /* The module isn't flagged as changed, so the apply doesn't note it */
+        prefs_note_dissection_changed();
         prefs_to_capture_opts();
         return changed_flags;
     }
@@ -147,6 +149,8 @@ prefs_store_ext_multiple(const char * module, GHashTable * pref_values)
     {
         prefs_main_write();
         prefs_apply_all();
+        /* The module isn't flagged as changed, so the apply doesn't note it */
+        prefs_note_dissection_changed();
         prefs_to_capture_opts();
     }
 
@@ -17,6 +17,7 @@
 #include "epan/addr_resolv.h"
 #include "epan/epan_dissect.h"
 #include "epan/frame_data.h"
+#include "epan/prefs.h"
 
 #include "address_editor_frame.h"
 #include <ui_address_editor_frame.h>
@@ -158,6 +159,7 @@ void AddressEditorFrame::on_buttonBox_accepted()
         return;
     }
     on_buttonBox_rejected();
+    prefs_note_dissection_changed();
     emit redissectPackets();
 }
 
@@ -16,13 +16,18 @@
 
 #include "capture_opts.h"
 #include "ui/capture_globals.h"
+#include "caputils/capture_filter_cache.h"
+#include "wiretap/wtap.h"
 #endif
 #include "extcap.h"
 
 #include "capture_filter_syntax_worker.h"
 #include <ui/qt/widgets/syntax_line_edit.h>
 
+#include <QByteArray>
+#include <QMap>
 #include <QMutexLocker>
+#include <QPair>
 #include <QSet>
 
 // We use a global mutex to protect pcap_compile since it calls gethostbyname.
@@ -41,18 +46,28 @@ static QMutex pcap_compile_mtx_;
 #define DEBUG_SLEEP_TIME 0 // ms
 #endif
 
-#define DUMMY_SNAPLENGTH                65535
-#define DUMMY_NETMASK                   0xFF000000
+#ifdef HAVE_LIBPCAP
+// What a check needs of an interface. all_ifaces can change while a
+// filter compiles, so this is copied rather than pointed to.
+struct CheckedInterface {
+    QByteArray name;
+    gint dlt;
+    int snaplen;
+};
+#endif
 
 void CaptureFilterSyntaxWorker::start() {
 #ifdef HAVE_LIBPCAP
+    // Dead handles by link-layer header type and snapshot length, kept
+    // rather than opened again for each check.
+    QMap<QPair<gint, int>, pcap_t *> dead_handles;
+
     forever {
         QString filter;
-        QSet<gint> active_dlts;
+        QList<CheckedInterface> active_ifaces;
         QSet<guint> active_extcap;
         struct bpf_program fcode;
         pcap_t *pd;
-        int pc_err;
         enum SyntaxLineEdit::SyntaxState state = SyntaxLineEdit::Valid;
         QString err_str;
 
@@ -83,7 +98,12 @@ void CaptureFilterSyntaxWorker::start() {
                         state = SyntaxLineEdit::Deprecated;
                         err_str = "Unable to check capture filter";
                     } else {
-                        active_dlts.insert(device->active_dlt);
+                        CheckedInterface checked;
+
+                        checked.name = device->name;
+                        checked.dlt = device->active_dlt;
+                        checked.snaplen = device->has_snaplen ? device->snaplen : WTAP_MAX_PACKET_SIZE_STANDARD;
+                        active_ifaces << checked;
                     }
                 } else {
                     active_extcap.insert(if_idx);
@@ -91,32 +111,38 @@ void CaptureFilterSyntaxWorker::start() {
             }
         }
 
-        foreach (gint dlt, active_dlts.toList()) {
+        // Compile the filter with each interface's link-layer header type
+        // and snapshot length. Interfaces that share them share a
+        // program. Dead handles are compiled for without a netmask, so
+        // interfaces aren't looked up on every keystroke.
+        foreach (const CheckedInterface &checked, active_ifaces) {
+            QPair<gint, int> dead_key(checked.dlt, checked.snaplen);
+
             pcap_compile_mtx_.lock();
-            pd = pcap_open_dead(dlt, DUMMY_SNAPLENGTH);
-            if (pd == NULL)
-            {
-                //don't have ability to verify capture filter
-                break;
+            pd = dead_handles.value(dead_key);
+            if (pd == NULL) {
+                pd = pcap_open_dead(checked.dlt, checked.snaplen);
+                if (pd == NULL)
+                {
+                    //don't have ability to verify capture filter
+                    pcap_compile_mtx_.unlock();
+                    break;
+                }
+                dead_handles.insert(dead_key, pd);
             }
-#ifdef PCAP_NETMASK_UNKNOWN
-            pc_err = pcap_compile(pd, &fcode, filter.toUtf8().data(), 1 /* Do optimize */, PCAP_NETMASK_UNKNOWN);
-#else
-            pc_err = pcap_compile(pd, &fcode, filter.toUtf8().data(), 1 /* Do optimize */, 0);
-#endif
 
 #if DEBUG_SLEEP_TIME > 0
             QThread::msleep(DEBUG_SLEEP_TIME);
 #endif
 
-            if (pc_err) {
+            if (!compile_capture_filter_cached(checked.name.constData(), pd, FALSE, filter.toUtf8().constData(), &fcode)) {
                 DEBUG_SYNTAX_CHECK("unknown", "known bad");
                 state = SyntaxLineEdit::Invalid;
                 err_str = pcap_geterr(pd);
             } else {
                 DEBUG_SYNTAX_CHECK("unknown", "known good");
+                free_capture_filter_program(&fcode);
             }
-            pcap_close(pd);
 
             pcap_compile_mtx_.unlock();
 
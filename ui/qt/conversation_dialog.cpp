@@ -180,7 +180,7 @@ bool ConversationDialog::addTrafficTable(register_ct_t* table)
 
     conv_tree->trafficTreeHash()->user_data = conv_tree;
 
-    registerTapListener(proto_get_protocol_filter_name(proto_id), conv_tree->trafficTreeHash(), filter, 0,
+    registerTapListener(proto_get_protocol_filter_name(proto_id), conv_tree->trafficTreeHash(), filter, TL_IS_ADDITIVE,
                         ConversationTreeWidget::tapReset,
                         get_conversation_packet_func(table),
                         ConversationTreeWidget::tapDraw);
@@ -160,7 +160,7 @@ bool EndpointDialog::addTrafficTable(register_ct_t *table)
 
     endp_tree->trafficTreeHash()->user_data = endp_tree;
 
-    registerTapListener(proto_get_protocol_filter_name(proto_id), endp_tree->trafficTreeHash(), filter, 0,
+    registerTapListener(proto_get_protocol_filter_name(proto_id), endp_tree->trafficTreeHash(), filter, TL_IS_ADDITIVE,
                         EndpointTreeWidget::tapReset,
                         get_hostlist_packet_func(table),
                         EndpointTreeWidget::tapDraw);
@@ -583,7 +583,10 @@ void IOGraphDialog::syncGraphSettings(int row)
 
     if (visible) {
         if (retap) {
+            // The graph was tapped while hidden, so the retap may leave it
+            // alone; its plot has to be recalculated either way.
             scheduleRetap();
+            scheduleRecalc();
         } else {
             scheduleReplot();
         }
@@ -1109,6 +1112,8 @@ void IOGraphDialog::updateStatistics()
 
     if (need_retap_ && !file_closed_) {
         need_retap_ = false;
+        // Only the graphs whose filter or interval tree changed are retapped;
+        // the others are additive and already up to date.
         cap_file_.retapPackets();
         // The user might have closed the window while tapping, which means
         // we might no longer exist.
@@ -1195,8 +1200,7 @@ void IOGraphDialog::on_intervalComboBox_currentIndexChanged(int)
         for (int row = 0; row < uat_model_->rowCount(); row++) {
             IOGraph *iog = ioGraphs_.value(row, NULL);
             if (iog) {
-                iog->setInterval(interval);
-                if (iog->visible()) {
+                if (!iog->setInterval(interval) && iog->visible()) {
                     need_retap = true;
                 }
             }
@@ -1205,6 +1209,8 @@ void IOGraphDialog::on_intervalComboBox_currentIndexChanged(int)
 
     if (need_retap) {
         scheduleRetap(true);
+    } else {
+        scheduleRecalc(true);
     }
 
     updateLegend();
@@ -1554,9 +1560,12 @@ IOGraph::IOGraph(QCustomPlot *parent) :
     bars_(NULL),
     val_units_(IOG_ITEM_UNIT_FIRST),
     hf_index_(-1),
-    cur_idx_(-1)
+    cur_idx_(-1),
+    tree_(NULL)
 {
     Q_ASSERT(parent_ != NULL);
+    // 1 ms up to 100 s, which covers every entry in intervalComboBox.
+    tree_ = io_graph_tree_new(1, 6, max_io_items_);
     graph_ = parent_->addGraph(parent_->xAxis, parent_->yAxis);
     Q_ASSERT(graph_ != NULL);
 
@@ -1564,7 +1573,7 @@ IOGraph::IOGraph(QCustomPlot *parent) :
     error_string = register_tap_listener("frame",
                           this,
                           "",
-                          TL_REQUIRES_PROTO_TREE,
+                          TL_REQUIRES_PROTO_TREE|TL_IS_ADDITIVE,
                           tapReset,
                           tapPacket,
                           tapDraw,
@@ -1585,6 +1594,7 @@ IOGraph::~IOGraph() {
     if (bars_) {
         parent_->removePlottable(bars_);
     }
+    io_graph_tree_free(tree_);
 }
 
 // Construct a full filter string from the display filter and value unit / Y axis.
@@ -1629,17 +1639,22 @@ void IOGraph::setFilter(const QString &filter)
         }
     }
 
-    error_string = set_tap_dfilter(this, full_filter.toUtf8().constData());
-    if (error_string) {
-        config_err_ = error_string->str;
-        g_string_free(error_string, TRUE);
-        return;
-    } else {
-        if (filter_.compare(filter) && visible_) {
+    // Setting the tap filter makes our listener see every packet again at
+    // the next retap, so leave it alone if it hasn't changed.
+    if (full_filter != tap_filter_) {
+        error_string = set_tap_dfilter(this, full_filter.toUtf8().constData());
+        if (error_string) {
+            config_err_ = error_string->str;
+            g_string_free(error_string, TRUE);
+            tap_filter_.clear();
+            return;
+        }
+        tap_filter_ = full_filter;
+        if (visible_) {
             emit requestRetap();
         }
-        filter_ = filter;
     }
+    filter_ = filter;
 }
 
 void IOGraph::applyCurrentColor()
@@ -1841,6 +1856,7 @@ void IOGraph::clearAllData()
 {
     cur_idx_ = -1;
     reset_io_graph_items(items_, max_io_items_);
+    io_graph_tree_reset(tree_, hf_index_, val_units_);
     if (graph_) {
         graph_->data()->clear();
     }
@@ -2038,9 +2054,21 @@ void IOGraph::reloadValueUnitField()
     }
 }
 
-void IOGraph::setInterval(int interval)
+// Returns true if the items for the new interval could be built from
+// the data we already have, false if a retap is needed.
+bool IOGraph::setInterval(int interval)
 {
     interval_ = interval;
+
+    int num_items = io_graph_tree_get_items(tree_, hf_index_, val_units_, interval_, 0, items_, max_io_items_);
+    if (num_items < 0) {
+        // Our tree doesn't have this interval, or was built for other
+        // value units; see every packet again at the next retap.
+        invalidate_tap_listener(this);
+        return false;
+    }
+    cur_idx_ = MIN(num_items, max_io_items_) - 1;
+    return true;
 }
 
 // Get the value at the given interval (idx) for the current value unit.
@@ -2069,6 +2097,14 @@ tap_packet_status IOGraph::tapPacket(void *iog_ptr, packet_info *pinfo, epan_dis
         return TAP_PACKET_DONT_REDRAW;
     }
 
+    epan_dissect_t *adv_edt = NULL;
+    /* For ADVANCED mode we need to keep track of some more stuff than just frame and byte counts */
+    if (iog->val_units_ >= IOG_ITEM_UNIT_CALC_SUM) {
+        adv_edt = edt;
+    }
+
+    io_graph_tree_update(iog->tree_, pinfo, adv_edt);
+
     int idx = get_io_graph_index(pinfo, iog->interval_);
     bool recalc = false;
 
@@ -2092,12 +2128,6 @@ tap_packet_status IOGraph::tapPacket(void *iog_ptr, packet_info *pinfo, epan_dis
         iog->start_time_ = nstime_to_sec(&start_nstime);
     }
 
-    epan_dissect_t *adv_edt = NULL;
-    /* For ADVANCED mode we need to keep track of some more stuff than just frame and byte counts */
-    if (iog->val_units_ >= IOG_ITEM_UNIT_CALC_SUM) {
-        adv_edt = edt;
-    }
-
     if (!update_io_graph_item(iog->items_, idx, pinfo, adv_edt, iog->hf_index_, iog->val_units_, iog->interval_)) {
         return TAP_PACKET_DONT_REDRAW;
     }
@@ -65,7 +65,7 @@ public:
     const QString valueUnitField() { return vu_field_; }
     void setValueUnitField(const QString &vu_field);
     unsigned int movingAveragePeriod() { return moving_avg_period_; }
-    void setInterval(int interval);
+    bool setInterval(int interval);
     bool addToLegend();
     bool removeFromLegend();
     QCPGraph *graph() { return graph_; }
@@ -107,6 +107,7 @@ private:
     QCPGraph *graph_;
     QCPBars *bars_;
     QString filter_;
+    QString tap_filter_; // filter_, and vu_field_ if it's needed
     QBrush color_;
     io_graph_item_unit_t val_units_;
     QString vu_field_;
@@ -119,6 +120,9 @@ private:
     // much as is feasible.
     io_graph_item_t items_[max_io_items_];
     int cur_idx_;
+    // The same data at every interval we offer, so that changing the
+    // interval doesn't require a retap.
+    io_graph_tree_t *tree_;
 };
 
 namespace Ui {
@@ -1450,6 +1450,7 @@ void MainWindow::reloadLuaPlugins()
     wsApp->readConfigurationFiles(true);
 
     prefs_apply_all();
+    prefs_note_dissection_changed();
     fieldsChanged();
     redissectPackets();
 
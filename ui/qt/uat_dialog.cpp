@@ -11,6 +11,7 @@
 #include <ui_uat_dialog.h>
 #include "wireshark_application.h"
 
+#include "epan/prefs.h"
 #include "epan/strutil.h"
 #include "epan/uat-int.h"
 #include "ui/help_url.h"
@@ -339,6 +340,7 @@ void UatDialog::applyChanges()
     }
     if (uat_->flags & UAT_AFFECTS_DISSECTION) {
         /* Just redissect packets if we have any */
+        prefs_note_dissection_changed();
         wsApp->queueAppSignal(WiresharkApplication::PacketDissectionChanged);
     }
 }
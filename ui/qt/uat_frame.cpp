@@ -12,6 +12,7 @@
 #include <glib.h>
 
 #include <epan/filter_expressions.h>
+#include <epan/prefs.h>
 
 #include "uat_frame.h"
 #include <ui_uat_frame.h>
@@ -146,6 +147,7 @@ void UatFrame::applyChanges()
     }
     if (uat_->flags & UAT_AFFECTS_DISSECTION) {
         /* Just redissect packets if we have any */
+        prefs_note_dissection_changed();
         wsApp->queueAppSignal(WiresharkApplication::PacketDissectionChanged);
     }
 }
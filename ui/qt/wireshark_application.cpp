@@ -429,6 +429,8 @@ void WiresharkApplication::setConfigurationProfile(const gchar *profile_name, bo
 
     prefs_to_capture_opts();
     prefs_apply_all();
+    /* Everything from the profile changed, not just preferences */
+    prefs_note_dissection_changed();
 #ifdef HAVE_LIBPCAP
     update_local_interfaces();
 #endif
@@ -1358,6 +1358,33 @@ wtap_read(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
 	return TRUE;	/* success */
 }
 
+gboolean
+wtap_read_tail(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
+	gchar **err_info, gint64 *offset)
+{
+	gint64 record_start;
+
+	/* Whatever was appended since the last EOF can be read now. */
+	file_clearerr(wth->fh);
+	record_start = file_tell(wth->fh);
+
+	if (wtap_read(wth, rec, buf, err, err_info, offset))
+		return TRUE;
+
+	if (*err == WTAP_ERR_SHORT_READ) {
+		/*
+		 * The writer hasn't finished the record yet; go back to
+		 * its start, so that it's read whole by a later call.
+		 */
+		g_free(*err_info);
+		*err_info = NULL;
+		if (file_seek(wth->fh, record_start, SEEK_SET, err) == -1)
+			return FALSE;
+		*err = 0;
+	}
+	return FALSE;
+}
+
 /*
  * Read a given number of bytes from a file into a buffer or, if
  * buf is NULL, just discard them.
@@ -1796,6 +1796,17 @@ WS_DLL_PUBLIC
 gboolean wtap_read(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
     gchar **err_info, gint64 *offset);
 
+/** Read the next record in a file that is still being written, as
+ * wtap_read() does.
+ *
+ * Reading past the end of the file is not an error: if the last record
+ * is incomplete, FALSE is returned with *err set to 0, and the record is
+ * read again, in full, by a later call once it has been written.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_read_tail(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
+    gchar **err_info, gint64 *offset);
+
 /** Read the record at a specified offset in a capture file, filling in
  * *phdr and *buf.
  *
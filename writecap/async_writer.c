@@ -0,0 +1,580 @@
+/* async_writer.c
+ * Routines for writing capture files from a separate thread, so that
+ * the capture loop doesn't wait for the disk.
+ *
+ * What the pcapio routines write is copied into a pool of large buffers;
+ * a writer thread writes each buffer out once it's full.  The capture
+ * loop only waits if every buffer is full, i.e. if the disk has fallen
+ * behind by the size of the whole pool.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#ifdef HAVE_FOPENCOOKIE
+#define _GNU_SOURCE /* Otherwise fopencookie() won't be declared on Linux */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#ifdef HAVE_FOPENCOOKIE
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+
+#include <wsutil/file_util.h>
+
+#include "async_writer.h"
+
+#ifdef HAVE_FOPENCOOKIE
+
+/* Alignment of the buffers, and of their size, required by O_DIRECT */
+#define DIRECT_IO_ALIGNMENT 4096
+
+typedef struct _aw_file aw_file;
+
+/* A buffer: free, being filled by the capture loop, or queued */
+typedef struct {
+        guint8  *data;
+        gsize    len;
+        aw_file *file;
+        gboolean close;         /* close the file once this is written */
+        gsize    repeated;      /* bytes at the start already written from the previous buffer */
+        gboolean continued;     /* the file's next buffer starts with our unaligned end */
+} aw_buffer;
+
+/* A file written through the writer thread */
+struct _aw_file {
+        int        fd;
+        aw_buffer *current;     /* buffer being filled, or NULL */
+        gboolean   direct;      /* still written with O_DIRECT */
+        int        err;         /* first error writing the file, or 0 */
+};
+
+/* All of these are protected by aw_mutex */
+static GMutex             aw_mutex;
+static GCond              aw_cond;      /* a buffer was queued, written, or freed */
+static GThread           *aw_thread;
+static GQueue             aw_free = G_QUEUE_INIT;
+static GQueue             aw_queued = G_QUEUE_INIT;
+static GList             *aw_open_files;
+static gboolean           aw_busy;      /* the thread is writing a buffer */
+static gboolean           aw_stopping;
+static int                aw_err;       /* first error since async_writer_flush() or async_writer_sync() */
+static guint64            aw_closes_queued;     /* files handed to the thread to close */
+static guint64            aw_closes_done;       /* files the thread has closed */
+static guint64            aw_bytes_written;     /* bytes the thread has written out */
+static gboolean           aw_direct;
+static async_writer_stats aw_stats;
+
+/* Only used by the thread writing to the streams */
+static guint64            aw_bytes_in;          /* bytes written to the streams */
+
+static int
+aw_write_all(int fd, const guint8 *data, gsize left)
+{
+        ssize_t written;
+
+        while (left > 0) {
+                written = ws_write(fd, data, (unsigned int)left);
+                if (written < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return errno;
+                }
+                data += written;
+                left -= written;
+        }
+        return 0;
+}
+
+/* Writes a buffer out; called by the writer thread without the lock */
+static int
+aw_write_buffer(aw_buffer *buf)
+{
+        aw_file *file = buf->file;
+
+#ifdef O_DIRECT
+        if (file->direct && buf->len % DIRECT_IO_ALIGNMENT != 0) {
+                gsize aligned = buf->len - buf->len % DIRECT_IO_ALIGNMENT;
+                int flags = fcntl(file->fd, F_GETFL);
+                gint64 pos;
+                ssize_t written;
+                int err;
+
+                if (flags == -1)
+                        return errno;
+                if (!buf->continued) {
+                        /* A partial last buffer leaves the rest of the file unaligned */
+                        fcntl(file->fd, F_SETFL, flags & ~O_DIRECT);
+                        file->direct = FALSE;
+                        return aw_write_all(file->fd, buf->data, buf->len);
+                }
+
+                /*
+                 * Write the unaligned end through the page cache, so that
+                 * it can be read now, without moving the file offset; the
+                 * next buffer starts with a copy of it, and writes it
+                 * again with O_DIRECT.
+                 */
+                err = aw_write_all(file->fd, buf->data, aligned);
+                if (err != 0)
+                        return err;
+                pos = ws_lseek64(file->fd, 0, SEEK_CUR);
+                if (pos == -1 || fcntl(file->fd, F_SETFL, flags & ~O_DIRECT) == -1)
+                        return errno;
+                written = pwrite(file->fd, buf->data + aligned, buf->len - aligned, pos);
+                if (written < 0)
+                        err = errno;
+                else if ((gsize)written != buf->len - aligned)
+                        err = EIO;
+                fcntl(file->fd, F_SETFL, flags);
+                return err;
+        }
+#endif
+
+        return aw_write_all(file->fd, buf->data, buf->len);
+}
+
+static gpointer
+aw_thread_func(gpointer arg _U_)
+{
+        aw_buffer *buf;
+        aw_file *file;
+        int err;
+
+        g_mutex_lock(&aw_mutex);
+        for (;;) {
+                while (g_queue_is_empty(&aw_queued) && !aw_stopping)
+                        g_cond_wait(&aw_cond, &aw_mutex);
+                buf = (aw_buffer *)g_queue_pop_head(&aw_queued);
+                if (buf == NULL)
+                        break;
+                file = buf->file;
+                aw_busy = TRUE;
+
+                /* Once a write has failed, don't write the rest */
+                err = file->err;
+                g_mutex_unlock(&aw_mutex);
+                if (err == 0)
+                        err = aw_write_buffer(buf);
+                if (buf->close && ws_close(file->fd) != 0 && err == 0)
+                        err = errno;
+                g_mutex_lock(&aw_mutex);
+
+                if (err != 0) {
+                        if (file->err == 0)
+                                file->err = err;
+                        if (aw_err == 0)
+                                aw_err = err;
+                }
+                if (buf->close) {
+                        g_free(file);
+                        aw_closes_done++;
+                }
+                aw_stats.buffers_written++;
+                aw_bytes_written += buf->len - buf->repeated;
+                buf->len = 0;
+                buf->file = NULL;
+                buf->close = FALSE;
+                buf->repeated = 0;
+                buf->continued = FALSE;
+                g_queue_push_tail(&aw_free, buf);
+                aw_busy = FALSE;
+                g_cond_broadcast(&aw_cond);
+        }
+        g_mutex_unlock(&aw_mutex);
+        return NULL;
+}
+
+/* Takes a free buffer for a file, waiting for one if need be */
+static aw_buffer *
+aw_get_buffer_locked(aw_file *file)
+{
+        aw_buffer *buf;
+
+        if (g_queue_is_empty(&aw_free)) {
+                aw_stats.waits++;
+                do {
+                        g_cond_wait(&aw_cond, &aw_mutex);
+                } while (g_queue_is_empty(&aw_free));
+        }
+        buf = (aw_buffer *)g_queue_pop_head(&aw_free);
+        buf->file = file;
+        return buf;
+}
+
+static void
+aw_queue_locked(aw_buffer *buf)
+{
+        g_queue_push_tail(&aw_queued, buf);
+        if (aw_queued.length > aw_stats.max_queued)
+                aw_stats.max_queued = aw_queued.length;
+        g_cond_broadcast(&aw_cond);
+}
+
+/*
+ * Hands the buffer being filled for a file to the writer thread.  For a
+ * file written with O_DIRECT, a new buffer takes over the unaligned end,
+ * if one is free or "wait" is TRUE; otherwise the buffer is kept until
+ * the pool has drained.
+ */
+static void
+aw_hand_over_locked(aw_file *file, gboolean wait)
+{
+        aw_buffer *buf = file->current;
+        aw_buffer *next;
+        gsize tail;
+
+        if (buf == NULL || buf->len == buf->repeated)
+                return;
+        tail = buf->len % DIRECT_IO_ALIGNMENT;
+        if (file->direct && tail != 0) {
+                if (!wait && g_queue_is_empty(&aw_free))
+                        return;
+                next = aw_get_buffer_locked(file);
+                memcpy(next->data, buf->data + buf->len - tail, tail);
+                next->len = tail;
+                next->repeated = tail;
+                buf->continued = TRUE;
+                file->current = next;
+        } else {
+                file->current = NULL;
+        }
+        aw_queue_locked(buf);
+}
+
+static ssize_t
+aw_cookie_write(void *cookie, const char *data, size_t len)
+{
+        aw_file *file = (aw_file *)cookie;
+        aw_buffer *buf;
+        size_t done = 0;
+        size_t chunk;
+        int err;
+
+        while (done < len) {
+                if (file->current == NULL) {
+                        g_mutex_lock(&aw_mutex);
+                        err = file->err;
+                        if (err == 0)
+                                file->current = aw_get_buffer_locked(file);
+                        g_mutex_unlock(&aw_mutex);
+                        if (err != 0) {
+                                errno = err;
+                                return 0;
+                        }
+                }
+
+                /* The buffer being filled belongs to us; no need to lock */
+                buf = file->current;
+                chunk = MIN(len - done, aw_stats.buffer_size - buf->len);
+                memcpy(buf->data + buf->len, data + done, chunk);
+                buf->len += chunk;
+                done += chunk;
+
+                if (buf->len == aw_stats.buffer_size) {
+                        g_mutex_lock(&aw_mutex);
+                        aw_queue_locked(buf);
+                        file->current = NULL;
+                        g_mutex_unlock(&aw_mutex);
+                }
+        }
+        aw_bytes_in += len;
+        return (ssize_t)len;
+}
+
+static int
+aw_cookie_close(void *cookie)
+{
+        aw_file *file = (aw_file *)cookie;
+        aw_buffer *buf;
+
+        /*
+         * The last buffer, even if it's empty, tells the writer thread to
+         * close the file.  Errors writing or closing the file are reported
+         * by async_writer_sync(), as the fclose() doesn't wait for them.
+         */
+        g_mutex_lock(&aw_mutex);
+        aw_open_files = g_list_remove(aw_open_files, file);
+        buf = file->current;
+        if (buf == NULL)
+                buf = aw_get_buffer_locked(file);
+        file->current = NULL;
+        buf->close = TRUE;
+        aw_closes_queued++;
+        aw_queue_locked(buf);
+        g_mutex_unlock(&aw_mutex);
+        return 0;
+}
+
+gboolean
+async_writer_init(guint buffer_count, gsize buffer_size, gboolean direct,
+                  int *err)
+{
+        aw_buffer *buf;
+        void *data;
+        guint i;
+        int ret;
+
+        g_assert(aw_thread == NULL);
+        g_assert(buffer_count > 0);
+
+        /* Round the size up to what O_DIRECT needs */
+        buffer_size = (buffer_size + DIRECT_IO_ALIGNMENT - 1) & ~(gsize)(DIRECT_IO_ALIGNMENT - 1);
+
+        for (i = 0; i < buffer_count; i++) {
+                ret = posix_memalign(&data, DIRECT_IO_ALIGNMENT, buffer_size);
+                if (ret != 0) {
+                        *err = ret;
+                        async_writer_cleanup();
+                        return FALSE;
+                }
+                buf = g_new0(aw_buffer, 1);
+                buf->data = (guint8 *)data;
+                g_queue_push_tail(&aw_free, buf);
+        }
+        memset(&aw_stats, 0, sizeof aw_stats);
+        aw_stats.buffer_count = buffer_count;
+        aw_stats.buffer_size = buffer_size;
+        aw_direct = direct;
+        aw_stopping = FALSE;
+        aw_err = 0;
+        aw_bytes_in = 0;
+        aw_bytes_written = 0;
+
+        aw_thread = g_thread_new("Capture file writer", aw_thread_func, NULL);
+        return TRUE;
+}
+
+gboolean
+async_writer_is_running(void)
+{
+        return aw_thread != NULL;
+}
+
+FILE *
+async_writer_fdopen(int fd, int *err)
+{
+        static const cookie_io_functions_t funcs = {
+                NULL, aw_cookie_write, NULL, aw_cookie_close
+        };
+        aw_file *file;
+        FILE *fp;
+
+        g_assert(aw_thread != NULL);
+
+        file = g_new0(aw_file, 1);
+        file->fd = fd;
+#ifdef O_DIRECT
+        if (aw_direct) {
+                int flags = fcntl(fd, F_GETFL);
+
+                /* If the file system doesn't do direct I/O, just don't */
+                if (flags != -1 && fcntl(fd, F_SETFL, flags | O_DIRECT) != -1)
+                        file->direct = TRUE;
+        }
+#endif
+
+        fp = fopencookie(file, "w", funcs);
+        if (fp == NULL) {
+                *err = errno;
+                g_free(file);
+                return NULL;
+        }
+        /* The pool does the buffering */
+        setvbuf(fp, NULL, _IONBF, 0);
+
+        g_mutex_lock(&aw_mutex);
+        aw_open_files = g_list_prepend(aw_open_files, file);
+        g_mutex_unlock(&aw_mutex);
+        return fp;
+}
+
+int
+async_writer_flush(void)
+{
+        GList *l;
+        int err;
+
+        if (aw_thread == NULL)
+                return 0;
+
+        g_mutex_lock(&aw_mutex);
+        for (l = aw_open_files; l != NULL; l = l->next)
+                aw_hand_over_locked((aw_file *)l->data, FALSE);
+        err = aw_err;
+        aw_err = 0;
+        g_mutex_unlock(&aw_mutex);
+        return err;
+}
+
+guint64
+async_writer_get_bytes(guint64 *written)
+{
+        g_mutex_lock(&aw_mutex);
+        *written = aw_bytes_written;
+        g_mutex_unlock(&aw_mutex);
+        return aw_bytes_in;
+}
+
+int
+async_writer_sync(void)
+{
+        GList *l;
+        int err;
+
+        if (aw_thread == NULL)
+                return 0;
+
+        g_mutex_lock(&aw_mutex);
+        for (l = aw_open_files; l != NULL; l = l->next)
+                aw_hand_over_locked((aw_file *)l->data, TRUE);
+        while (!g_queue_is_empty(&aw_queued) || aw_busy)
+                g_cond_wait(&aw_cond, &aw_mutex);
+        err = aw_err;
+        aw_err = 0;
+        g_mutex_unlock(&aw_mutex);
+        return err;
+}
+
+guint64
+async_writer_close_count(void)
+{
+        guint64 count;
+
+        g_mutex_lock(&aw_mutex);
+        count = aw_closes_queued;
+        g_mutex_unlock(&aw_mutex);
+        return count;
+}
+
+void
+async_writer_wait_closed(guint64 count)
+{
+        g_mutex_lock(&aw_mutex);
+        /* Once the thread has stopped, everything it was given is closed */
+        while (aw_closes_done < count && aw_thread != NULL)
+                g_cond_wait(&aw_cond, &aw_mutex);
+        g_mutex_unlock(&aw_mutex);
+}
+
+void
+async_writer_get_stats(async_writer_stats *stats)
+{
+        g_mutex_lock(&aw_mutex);
+        *stats = aw_stats;
+        g_mutex_unlock(&aw_mutex);
+}
+
+void
+async_writer_cleanup(void)
+{
+        aw_buffer *buf;
+
+        if (aw_thread != NULL) {
+                g_mutex_lock(&aw_mutex);
+                aw_stopping = TRUE;
+                g_cond_broadcast(&aw_cond);
+                g_mutex_unlock(&aw_mutex);
+                /* The thread writes what's queued before it stops */
+                g_thread_join(aw_thread);
+                g_mutex_lock(&aw_mutex);
+                aw_thread = NULL;
+                g_cond_broadcast(&aw_cond);
+                g_mutex_unlock(&aw_mutex);
+        }
+
+        while ((buf = (aw_buffer *)g_queue_pop_head(&aw_free)) != NULL) {
+                free(buf->data);
+                g_free(buf);
+        }
+}
+
+#else /* HAVE_FOPENCOOKIE */
+
+gboolean
+async_writer_init(guint buffer_count _U_, gsize buffer_size _U_,
+                  gboolean direct _U_, int *err)
+{
+        *err = ENOTSUP;
+        return FALSE;
+}
+
+gboolean
+async_writer_is_running(void)
+{
+        return FALSE;
+}
+
+FILE *
+async_writer_fdopen(int fd _U_, int *err)
+{
+        *err = ENOTSUP;
+        return NULL;
+}
+
+int
+async_writer_flush(void)
+{
+        return 0;
+}
+
+guint64
+async_writer_get_bytes(guint64 *written)
+{
+        *written = 0;
+        return 0;
+}
+
+int
+async_writer_sync(void)
+{
+        return 0;
+}
+
+guint64
+async_writer_close_count(void)
+{
+        return 0;
+}
+
+void
+async_writer_wait_closed(guint64 count _U_)
+{
+}
+
+void
+async_writer_get_stats(async_writer_stats *stats)
+{
+        memset(stats, 0, sizeof *stats);
+}
+
+void
+async_writer_cleanup(void)
+{
+}
+
+#endif /* HAVE_FOPENCOOKIE */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
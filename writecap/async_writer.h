@@ -0,0 +1,99 @@
+/* async_writer.h
+ * Declarations of routines for writing capture files from a separate
+ * thread.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __ASYNC_WRITER_H__
+#define __ASYNC_WRITER_H__
+
+typedef struct {
+        guint    buffer_count;          /**< buffers in the pool */
+        gsize    buffer_size;           /**< size of each buffer */
+        guint    max_queued;            /**< most buffers ever waiting to be written */
+        guint64  buffers_written;       /**< buffers handed to write() */
+        guint64  waits;                 /**< times the capture loop waited for a free buffer */
+} async_writer_stats;
+
+/** Starts the writer thread, with a pool of buffer_count buffers of
+   (at least) buffer_size bytes.  If direct is TRUE, files are written
+   with O_DIRECT where that's supported.
+   Returns TRUE on success, FALSE on failure, with "*err" set to an
+   error code. */
+extern gboolean
+async_writer_init(guint buffer_count, gsize buffer_size, gboolean direct,
+                  int *err);
+
+/** Returns TRUE if the writer thread has been started. */
+extern gboolean
+async_writer_is_running(void);
+
+/** Returns a stream, for use with the pcapio routines, that copies what's
+   written to it into the buffer pool; full buffers are written to fd by
+   the writer thread.  Closing the stream hands the rest to the writer
+   thread, which then closes fd.
+   Returns NULL on failure, with "*err" set to an error code. */
+extern FILE *
+async_writer_fdopen(int fd, int *err);
+
+/** Hands any partly filled buffers to the writer thread without waiting
+   for them to be written.  What a file written with O_DIRECT has past
+   the last aligned block is written through the page cache, and again
+   with the next buffer, so the file keeps being written with O_DIRECT.
+   Returns the first error the writer thread got since the last call to
+   this or async_writer_sync(), or 0. */
+extern int
+async_writer_flush(void);
+
+/** Returns the number of bytes written to the streams so far, and sets
+   "*written" to the number of them the writer thread has written out;
+   it writes them in the order they were handed to it. */
+extern guint64
+async_writer_get_bytes(guint64 *written);
+
+/** Hands any partly filled buffers to the writer thread, and waits until
+   it has written everything, and closed the files that were closed.
+   Returns the first error the writer thread got since the last call to
+   this or async_writer_flush(), or 0. */
+extern int
+async_writer_sync(void);
+
+/** Returns the number of streams from async_writer_fdopen() closed so
+   far; pass it to async_writer_wait_closed() to wait until the writer
+   thread has actually closed those files. */
+extern guint64
+async_writer_close_count(void);
+
+/** Waits until the writer thread has written and closed the first
+   "count" files whose streams were closed.  Can be called from any
+   thread. */
+extern void
+async_writer_wait_closed(guint64 count);
+
+/** Gets the statistics for the buffer pool. */
+extern void
+async_writer_get_stats(async_writer_stats *stats);
+
+/** Writes everything that's still buffered and stops the writer thread. */
+extern void
+async_writer_cleanup(void);
+
+#endif /* __ASYNC_WRITER_H__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,426 @@
+/* flow_index.c
+ * Routines for indexing the flows in a capture file as it's written.
+ *
+ * Only the link-layer, IP and transport-layer headers are looked at,
+ * so that this is cheap enough to do for every packet that dumpcap
+ * writes.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <stddef.h>
+
+#include <glib.h>
+
+#include <wsutil/pint.h>
+
+#include "flow_index.h"
+
+#define FLOW_INDEX_MAGIC        "WSFLOWIX"
+#define FLOW_INDEX_VERSION      1
+#define FLOW_INDEX_HEADER_LEN   16
+#define FLOW_INDEX_RECORD_LEN   80
+
+/* The members of a flow_index_entry that identify the flow */
+#define FLOW_KEY_LEN            offsetof(flow_index_entry, first_ts)
+
+/*
+ * Link-layer header types, as pcap_datalink() returns them; where the
+ * DLT_ value differs between platforms, all of them, and the LINKTYPE_
+ * value used in files.
+ */
+#define FI_DLT_NULL             0
+#define FI_DLT_EN10MB           1
+#define FI_DLT_RAW              12
+#define FI_DLT_RAW_OPENBSD      14
+#define FI_LINKTYPE_RAW         101
+#define FI_DLT_LOOP             108
+#define FI_DLT_LINUX_SLL        113
+#define FI_DLT_IPV4             228
+#define FI_DLT_IPV6             229
+#define FI_DLT_LINUX_SLL2       276
+
+#define FI_ETHERTYPE_IP         0x0800
+#define FI_ETHERTYPE_IPv6       0x86dd
+#define FI_ETHERTYPE_VLAN       0x8100
+#define FI_ETHERTYPE_QINQ       0x88a8
+#define FI_ETHERTYPE_QINQ_OLD   0x9100
+
+#define FI_IPPROTO_HOPOPTS      0
+#define FI_IPPROTO_TCP          6
+#define FI_IPPROTO_UDP          17
+#define FI_IPPROTO_ROUTING      43
+#define FI_IPPROTO_FRAGMENT     44
+#define FI_IPPROTO_DSTOPTS      60
+#define FI_IPPROTO_SCTP         132
+
+/* Most IPv6 extension headers we skip to get to the transport layer */
+#define FI_MAX_IPV6_EXT_HDRS    8
+
+struct flow_index {
+        GHashTable *flows;      /* flow_index_entry, used as its own key */
+};
+
+guint32
+flow_index_flow_hash(const flow_index_entry *flow)
+{
+        const guint8 *p = (const guint8 *)flow;
+        guint32 hash = 2166136261U;
+        gsize i;
+
+        /* FNV-1a */
+        for (i = 0; i < FLOW_KEY_LEN; i++) {
+                hash ^= p[i];
+                hash *= 16777619U;
+        }
+        return hash;
+}
+
+gboolean
+flow_index_flow_equal(const flow_index_entry *a, const flow_index_entry *b)
+{
+        return memcmp(a, b, FLOW_KEY_LEN) == 0;
+}
+
+static guint
+fi_flow_hash(gconstpointer key)
+{
+        return flow_index_flow_hash((const flow_index_entry *)key);
+}
+
+static gboolean
+fi_flow_equal(gconstpointer a, gconstpointer b)
+{
+        return flow_index_flow_equal((const flow_index_entry *)a,
+                                     (const flow_index_entry *)b);
+}
+
+/*
+ * Finds the network-layer header, skipping VLAN tags; returns NULL if the
+ * packet isn't IPv4 or IPv6, as far as the link layer tells.
+ */
+static const guint8 *
+fi_network_layer(int linktype, const guint8 *pd, guint32 caplen, guint32 *len)
+{
+        guint32 off;
+        guint16 type = 0;       /* 0 = look at the IP version */
+
+        switch (linktype) {
+
+        case FI_DLT_EN10MB:
+                if (caplen < 14)
+                        return NULL;
+                type = pntoh16(pd + 12);
+                off = 14;
+                while ((type == FI_ETHERTYPE_VLAN || type == FI_ETHERTYPE_QINQ ||
+                        type == FI_ETHERTYPE_QINQ_OLD) && off + 4 <= caplen) {
+                        type = pntoh16(pd + off + 2);
+                        off += 4;
+                }
+                break;
+
+        case FI_DLT_LINUX_SLL:
+                if (caplen < 16)
+                        return NULL;
+                type = pntoh16(pd + 14);
+                off = 16;
+                break;
+
+        case FI_DLT_LINUX_SLL2:
+                if (caplen < 20)
+                        return NULL;
+                type = pntoh16(pd);
+                off = 20;
+                break;
+
+        case FI_DLT_NULL:
+        case FI_DLT_LOOP:
+                /* The address family's values, and byte order, vary */
+                off = 4;
+                break;
+
+        case FI_DLT_RAW:
+        case FI_DLT_RAW_OPENBSD:
+        case FI_LINKTYPE_RAW:
+        case FI_DLT_IPV4:
+        case FI_DLT_IPV6:
+                off = 0;
+                break;
+
+        default:
+                return NULL;
+        }
+
+        if (type != 0 && type != FI_ETHERTYPE_IP && type != FI_ETHERTYPE_IPv6)
+                return NULL;
+        if (off >= caplen)
+                return NULL;
+        *len = caplen - off;
+        return pd + off;
+}
+
+/*
+ * Fills in the addresses, protocol and ports of a flow, and where the
+ * packet is in a fragmented datagram, from an IP header; returns FALSE if
+ * it isn't one.
+ */
+static gboolean
+fi_parse_ip(const guint8 *ip, guint32 len, flow_index_entry *flow,
+            flow_index_fragment *frag)
+{
+        guint32 off;
+        guint8 nxt;
+        guint16 frag_off;
+        int i;
+
+        switch (ip[0] >> 4) {
+
+        case 4:
+                if (len < 20)
+                        return FALSE;
+                off = (ip[0] & 0x0f) * 4;
+                if (off < 20)
+                        return FALSE;
+                flow->ip_version = 4;
+                flow->proto = ip[9];
+                memcpy(flow->addr_a, ip + 12, 4);
+                memcpy(flow->addr_b, ip + 16, 4);
+                /* More fragments, and the fragment offset */
+                frag_off = pntoh16(ip + 6);
+                if ((frag_off & 0x3fff) != 0) {
+                        frag->fragment = TRUE;
+                        frag->first = (frag_off & 0x1fff) == 0;
+                        frag->id = pntoh16(ip + 4);
+                        /* Only the first fragment has the ports */
+                        if (!frag->first)
+                                return TRUE;
+                }
+                break;
+
+        case 6:
+                if (len < 40)
+                        return FALSE;
+                flow->ip_version = 6;
+                memcpy(flow->addr_a, ip + 8, 16);
+                memcpy(flow->addr_b, ip + 24, 16);
+                nxt = ip[6];
+                off = 40;
+                for (i = 0; i < FI_MAX_IPV6_EXT_HDRS && off + 8 <= len; i++) {
+                        if (nxt == FI_IPPROTO_HOPOPTS || nxt == FI_IPPROTO_ROUTING ||
+                            nxt == FI_IPPROTO_DSTOPTS) {
+                                nxt = ip[off];
+                                off += (ip[off + 1] + 1) * 8;
+                        } else if (nxt == FI_IPPROTO_FRAGMENT) {
+                                nxt = ip[off];
+                                /* The fragment offset, and more fragments */
+                                frag_off = pntoh16(ip + off + 2);
+                                if ((frag_off & 0xfff9) != 0) {
+                                        frag->fragment = TRUE;
+                                        frag->first = (frag_off & 0xfff8) == 0;
+                                        frag->id = pntoh32(ip + off + 4);
+                                }
+                                if (frag->fragment && !frag->first) {
+                                        flow->proto = nxt;
+                                        return TRUE;
+                                }
+                                off += 8;
+                        } else {
+                                break;
+                        }
+                }
+                flow->proto = nxt;
+                break;
+
+        default:
+                return FALSE;
+        }
+
+        if ((flow->proto == FI_IPPROTO_TCP || flow->proto == FI_IPPROTO_UDP ||
+             flow->proto == FI_IPPROTO_SCTP) && off + 4 <= len) {
+                flow->port_a = pntoh16(ip + off);
+                flow->port_b = pntoh16(ip + off + 2);
+        }
+        return TRUE;
+}
+
+/* Makes both directions of a conversation the same flow */
+static void
+fi_canonicalize(flow_index_entry *flow)
+{
+        guint8 addr[16];
+        guint16 port;
+        int cmp;
+
+        cmp = memcmp(flow->addr_a, flow->addr_b, sizeof addr);
+        if (cmp > 0 || (cmp == 0 && flow->port_a > flow->port_b)) {
+                memcpy(addr, flow->addr_a, sizeof addr);
+                memcpy(flow->addr_a, flow->addr_b, sizeof addr);
+                memcpy(flow->addr_b, addr, sizeof addr);
+                port = flow->port_a;
+                flow->port_a = flow->port_b;
+                flow->port_b = port;
+        }
+}
+
+gboolean
+flow_index_get_flow(int linktype, const guint8 *pd, guint32 caplen,
+                    flow_index_entry *flow, flow_index_fragment *frag)
+{
+        const guint8 *ip;
+        guint32 ip_len;
+        flow_index_fragment unused_frag;
+
+        /* The padding is part of the key, so it has to be zero */
+        memset(flow, 0, sizeof *flow);
+        if (frag == NULL)
+                frag = &unused_frag;
+        memset(frag, 0, sizeof *frag);
+        ip = fi_network_layer(linktype, pd, caplen, &ip_len);
+        if (ip == NULL || !fi_parse_ip(ip, ip_len, flow, frag))
+                return FALSE;
+        fi_canonicalize(flow);
+        return TRUE;
+}
+
+flow_index_t *
+flow_index_new(void)
+{
+        flow_index_t *fi = g_new(flow_index_t, 1);
+
+        fi->flows = g_hash_table_new_full(fi_flow_hash, fi_flow_equal, NULL, g_free);
+        return fi;
+}
+
+void
+flow_index_add_packet(flow_index_t *fi, int linktype, const guint8 *pd,
+                      guint32 caplen, guint32 len, guint64 ts,
+                      guint64 offset)
+{
+        flow_index_entry key;
+        flow_index_entry *flow;
+
+        if (!flow_index_get_flow(linktype, pd, caplen, &key, NULL))
+                return;
+
+        flow = (flow_index_entry *)g_hash_table_lookup(fi->flows, &key);
+        if (flow == NULL) {
+                flow = (flow_index_entry *)g_memdup(&key, sizeof key);
+                flow->first_ts = ts;
+                flow->first_offset = offset;
+                g_hash_table_insert(fi->flows, flow, flow);
+        }
+        flow->last_ts = ts;
+        flow->packets++;
+        flow->bytes += len;
+}
+
+static gint
+fi_compare_offsets(gconstpointer a, gconstpointer b)
+{
+        const flow_index_entry *fa = (const flow_index_entry *)a;
+        const flow_index_entry *fb = (const flow_index_entry *)b;
+
+        if (fa->first_offset != fb->first_offset)
+                return fa->first_offset < fb->first_offset ? -1 : 1;
+        return 0;
+}
+
+GByteArray *
+flow_index_serialize(const flow_index_t *fi)
+{
+        GByteArray *out;
+        GList *flows, *l;
+        flow_index_entry *flow;
+        guint8 rec[FLOW_INDEX_RECORD_LEN];
+
+        out = g_byte_array_sized_new(FLOW_INDEX_HEADER_LEN +
+                                     g_hash_table_size(fi->flows) * FLOW_INDEX_RECORD_LEN);
+        memcpy(rec, FLOW_INDEX_MAGIC, 8);
+        phton32(rec + 8, FLOW_INDEX_VERSION);
+        phton32(rec + 12, g_hash_table_size(fi->flows));
+        g_byte_array_append(out, rec, FLOW_INDEX_HEADER_LEN);
+
+        flows = g_list_sort(g_hash_table_get_values(fi->flows), fi_compare_offsets);
+        for (l = flows; l != NULL; l = l->next) {
+                flow = (flow_index_entry *)l->data;
+                memset(rec, 0, sizeof rec);
+                rec[0] = flow->ip_version;
+                rec[1] = flow->proto;
+                phton16(rec + 4, flow->port_a);
+                phton16(rec + 6, flow->port_b);
+                memcpy(rec + 8, flow->addr_a, 16);
+                memcpy(rec + 24, flow->addr_b, 16);
+                phton64(rec + 40, flow->first_ts);
+                phton64(rec + 48, flow->last_ts);
+                phton64(rec + 56, flow->packets);
+                phton64(rec + 64, flow->bytes);
+                phton64(rec + 72, flow->first_offset);
+                g_byte_array_append(out, rec, FLOW_INDEX_RECORD_LEN);
+        }
+        g_list_free(flows);
+        return out;
+}
+
+void
+flow_index_free(flow_index_t *fi)
+{
+        if (fi == NULL)
+                return;
+        g_hash_table_destroy(fi->flows);
+        g_free(fi);
+}
+
+GArray *
+flow_index_parse(const guint8 *data, gsize len)
+{
+        GArray *flows;
+        flow_index_entry flow;
+        const guint8 *rec;
+        guint32 count, i;
+
+        if (len < FLOW_INDEX_HEADER_LEN || memcmp(data, FLOW_INDEX_MAGIC, 8) != 0 ||
+            pntoh32(data + 8) != FLOW_INDEX_VERSION)
+                return NULL;
+        count = pntoh32(data + 12);
+        if ((len - FLOW_INDEX_HEADER_LEN) / FLOW_INDEX_RECORD_LEN < count)
+                return NULL;
+
+        flows = g_array_sized_new(FALSE, FALSE, sizeof (flow_index_entry), count);
+        for (i = 0; i < count; i++) {
+                rec = data + FLOW_INDEX_HEADER_LEN + (gsize)i * FLOW_INDEX_RECORD_LEN;
+                memset(&flow, 0, sizeof flow);
+                flow.ip_version = rec[0];
+                flow.proto = rec[1];
+                flow.port_a = pntoh16(rec + 4);
+                flow.port_b = pntoh16(rec + 6);
+                memcpy(flow.addr_a, rec + 8, 16);
+                memcpy(flow.addr_b, rec + 24, 16);
+                flow.first_ts = pntoh64(rec + 40);
+                flow.last_ts = pntoh64(rec + 48);
+                flow.packets = pntoh64(rec + 56);
+                flow.bytes = pntoh64(rec + 64);
+                flow.first_offset = pntoh64(rec + 72);
+                g_array_append_val(flows, flow);
+        }
+        return flows;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,110 @@
+/* flow_index.h
+ * Declarations of routines for indexing the flows in a capture file
+ * as it's written.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __FLOW_INDEX_H__
+#define __FLOW_INDEX_H__
+
+/*
+ * A flow index lists, for one capture file, the IPv4 and IPv6 flows in it:
+ * for each, its addresses, protocol and ports, the time stamps of its first
+ * and last packets, its packet and byte counts, and the offset in the file
+ * of its first packet.  Both directions of a conversation are one flow.
+ *
+ * The index file is a 16-byte header - the magic "WSFLOWIX", a version
+ * number and the number of flows - followed by one 80-byte record per flow,
+ * in the order of their first packets.  All numbers are in network byte
+ * order.
+ */
+
+/** Suffix of an index file, after the name of the capture file. */
+#define FLOW_INDEX_SUFFIX ".flowidx"
+
+/** A flow.  The endpoint with the lower address (or, if the addresses
+    are the same, the lower port) is endpoint "a". */
+typedef struct {
+        guint8  ip_version;     /**< 4 or 6 */
+        guint8  proto;          /**< IP protocol number */
+        guint16 port_a;         /**< TCP, UDP or SCTP port, else 0 */
+        guint16 port_b;
+        guint8  addr_a[16];     /**< an IPv4 address is in the first 4 bytes */
+        guint8  addr_b[16];
+        guint64 first_ts;       /**< nanoseconds since the Epoch */
+        guint64 last_ts;
+        guint64 packets;
+        guint64 bytes;          /**< on the wire */
+        guint64 first_offset;   /**< offset of the first packet's record in the file */
+} flow_index_entry;
+
+/** Where a packet is in a fragmented IP datagram. */
+typedef struct {
+        gboolean fragment;      /**< TRUE if the packet is a fragment of a datagram */
+        gboolean first;         /**< TRUE if it's the fragment at offset 0, with the ports */
+        guint32  id;            /**< the datagram's IPv4 or IPv6 identification */
+} flow_index_fragment;
+
+typedef struct flow_index flow_index_t;
+
+/** Creates an empty index. */
+extern flow_index_t *
+flow_index_new(void);
+
+/** Adds a packet, captured on a link of the given link-layer header
+    type (a DLT_ or LINKTYPE_ value), whose record starts at "offset"
+    in the capture file.  Packets that aren't IPv4 or IPv6 are ignored. */
+extern void
+flow_index_add_packet(flow_index_t *fi, int linktype, const guint8 *pd,
+                      guint32 caplen, guint32 len, guint64 ts,
+                      guint64 offset);
+
+/** Returns the index in the index file format. */
+extern GByteArray *
+flow_index_serialize(const flow_index_t *fi);
+
+/** Frees an index. */
+extern void
+flow_index_free(flow_index_t *fi);
+
+/** Fills in the members of "flow" that identify the flow of a packet, and
+    zeroes the others.  Only the first fragment of a datagram has the
+    ports, so the flow of a later one has none; if "frag" isn't NULL, it's
+    filled in so that the caller can tell.  Returns FALSE if the packet
+    isn't IPv4 or IPv6. */
+extern gboolean
+flow_index_get_flow(int linktype, const guint8 *pd, guint32 caplen,
+                    flow_index_entry *flow, flow_index_fragment *frag);
+
+/** Hashes the members of a flow that identify it. */
+extern guint32
+flow_index_flow_hash(const flow_index_entry *flow);
+
+/** Returns TRUE if two flows are the same flow. */
+extern gboolean
+flow_index_flow_equal(const flow_index_entry *a, const flow_index_entry *b);
+
+/** Parses the contents of an index file into an array of
+    flow_index_entry.  Returns NULL if they aren't an index. */
+extern GArray *
+flow_index_parse(const guint8 *data, gsize len);
+
+#endif /* __FLOW_INDEX_H__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,209 @@
+/* flow_policy.c
+ * Routines for deciding, flow by flow, which captured packets to write.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <glib.h>
+
+#include "flow_index.h"
+#include "flow_policy.h"
+
+/* Flows per bucket of the table */
+#define FP_WAYS 4
+
+/* Fragmented datagrams whose flow is remembered; a power of two */
+#define FP_FRAGMENTS 1024
+
+/* The flow of a fragmented datagram, as its first fragment had it */
+typedef struct {
+        flow_index_entry flow;          /* ip_version is 0 if free */
+        guint32 id;
+} fp_fragment;
+
+/*
+ * The table is an array of buckets of FP_WAYS flows each.  A flow is in
+ * the bucket its hash picks; an entry whose ip_version is 0 is free.  Of
+ * the members that don't identify the flow, "packets" and "bytes" count
+ * the flow's packets and "last_ts" is when it was last seen, in packets
+ * since the policy was created.
+ */
+struct flow_policy {
+        guint32 max_packets;
+        guint64 max_bytes;
+        guint32 sample_rate;
+        flow_index_entry *table;        /* NULL if there are no limits */
+        guint32 bucket_mask;
+        fp_fragment *fragments;         /* indexed by a hash of the datagram */
+        guint64 clock;
+        flow_policy_stats stats;
+};
+
+flow_policy_t *
+flow_policy_new(guint32 max_packets, guint64 max_bytes, guint32 sample_rate,
+                guint32 table_size)
+{
+        flow_policy_t *fp = g_new0(flow_policy_t, 1);
+        guint32 buckets;
+
+        fp->max_packets = max_packets;
+        fp->max_bytes = max_bytes;
+        fp->sample_rate = sample_rate;
+        if (max_packets != 0 || max_bytes != 0) {
+                /* A power of two, so the hash can be masked */
+                for (buckets = 1; buckets < table_size / FP_WAYS && buckets < G_MAXUINT32 / 2; buckets *= 2)
+                        ;
+                fp->table = g_new0(flow_index_entry, (gsize)buckets * FP_WAYS);
+                fp->bucket_mask = buckets - 1;
+        }
+        fp->fragments = g_new0(fp_fragment, FP_FRAGMENTS);
+        return fp;
+}
+
+/*
+ * Mixes all the bits of a flow's hash into its low bits, which choose
+ * the sample and the bucket (the "fmix32" finalizer of MurmurHash3).
+ */
+static guint32
+fp_mix(guint32 hash)
+{
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bU;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35U;
+        hash ^= hash >> 16;
+        return hash;
+}
+
+/* Finds a flow in the table, making room for it if it isn't there */
+static flow_index_entry *
+fp_lookup(flow_policy_t *fp, const flow_index_entry *flow, guint32 hash)
+{
+        flow_index_entry *bucket = &fp->table[(gsize)(hash & fp->bucket_mask) * FP_WAYS];
+        flow_index_entry *oldest = &bucket[0];
+        int i;
+
+        for (i = 0; i < FP_WAYS; i++) {
+                if (bucket[i].ip_version != 0 && flow_index_flow_equal(&bucket[i], flow))
+                        return &bucket[i];
+                if (oldest->ip_version != 0 &&
+                    (bucket[i].ip_version == 0 || bucket[i].last_ts < oldest->last_ts))
+                        oldest = &bucket[i];
+        }
+        if (oldest->ip_version != 0)
+                fp->stats.flows_forgotten++;
+        *oldest = *flow;
+        return oldest;
+}
+
+/*
+ * Gives the later fragments of a datagram the flow of its first fragment,
+ * which has the ports, so that they're sampled and limited along with it.
+ * A fragment that arrives before the first one, or after the datagram has
+ * been forgotten, stays in the flow without ports.
+ */
+static void
+fp_fragment_flow(flow_policy_t *fp, flow_index_entry *flow,
+                 const flow_index_fragment *frag)
+{
+        flow_index_entry datagram;
+        flow_index_entry remembered;
+        fp_fragment *slot;
+
+        /* The addresses and protocol, which all the fragments have */
+        datagram = *flow;
+        datagram.port_a = 0;
+        datagram.port_b = 0;
+        slot = &fp->fragments[fp_mix(flow_index_flow_hash(&datagram) ^ frag->id) & (FP_FRAGMENTS - 1)];
+
+        if (frag->first) {
+                slot->flow = *flow;
+                slot->id = frag->id;
+                return;
+        }
+        if (slot->flow.ip_version == 0 || slot->id != frag->id)
+                return;
+        remembered = slot->flow;
+        remembered.port_a = 0;
+        remembered.port_b = 0;
+        if (flow_index_flow_equal(&remembered, &datagram))
+                *flow = slot->flow;
+}
+
+gboolean
+flow_policy_keep_packet(flow_policy_t *fp, int linktype, const guint8 *pd,
+                        guint32 caplen, guint32 len)
+{
+        flow_index_entry flow;
+        flow_index_entry *entry;
+        flow_index_fragment frag;
+        guint32 hash;
+        gboolean keep;
+
+        if (!flow_index_get_flow(linktype, pd, caplen, &flow, &frag)) {
+                fp->stats.packets_kept++;
+                return TRUE;
+        }
+        if (frag.fragment)
+                fp_fragment_flow(fp, &flow, &frag);
+        hash = fp_mix(flow_index_flow_hash(&flow));
+        if (fp->sample_rate > 1) {
+                if (hash % fp->sample_rate != 0) {
+                        fp->stats.packets_sampled_out++;
+                        return FALSE;
+                }
+                /* Pick the bucket with the bits that didn't pick the sample */
+                hash /= fp->sample_rate;
+        }
+        if (fp->table == NULL) {
+                fp->stats.packets_kept++;
+                return TRUE;
+        }
+
+        entry = fp_lookup(fp, &flow, hash);
+        entry->last_ts = ++fp->clock;
+        keep = (fp->max_packets == 0 || entry->packets < fp->max_packets) &&
+               (fp->max_bytes == 0 || entry->bytes < fp->max_bytes);
+        entry->packets++;
+        entry->bytes += len;
+        if (keep)
+                fp->stats.packets_kept++;
+        else
+                fp->stats.packets_over_limit++;
+        return keep;
+}
+
+void
+flow_policy_get_stats(const flow_policy_t *fp, flow_policy_stats *stats)
+{
+        *stats = fp->stats;
+}
+
+void
+flow_policy_free(flow_policy_t *fp)
+{
+        if (fp == NULL)
+                return;
+        g_free(fp->table);
+        g_free(fp->fragments);
+        g_free(fp);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,73 @@
+/* flow_policy.h
+ * Declarations of routines for deciding, flow by flow, which captured
+ * packets to write.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __FLOW_POLICY_H__
+#define __FLOW_POLICY_H__
+
+/*
+ * A flow policy keeps only the first packets or bytes of each IPv4 or
+ * IPv6 flow, or only 1 in K flows, or both.  Packets that aren't IPv4 or
+ * IPv6 are always kept.  The later fragments of a datagram are in the flow
+ * of its first fragment, as long as they arrive after it.
+ *
+ * The flows are tracked in a table of fixed size, so that memory use
+ * doesn't grow with the number of flows.  When the table is full, the
+ * flow that has gone longest without a packet is forgotten; if it comes
+ * back, it's counted from the start again.
+ */
+
+typedef struct flow_policy flow_policy_t;
+
+typedef struct {
+        guint64 packets_kept;
+        guint64 packets_sampled_out;    /**< in flows that weren't sampled */
+        guint64 packets_over_limit;     /**< past a flow's packet or byte limit */
+        guint64 flows_forgotten;        /**< to make room in the table */
+} flow_policy_stats;
+
+/** Creates a policy.  "max_packets" and "max_bytes" are the packets and
+    bytes on the wire to keep of each flow, 0 for no limit; the packet
+    that reaches the byte limit is kept whole.  1 in "sample_rate" flows
+    is kept, chosen by a hash of the flow, so every packet of a flow is
+    kept or none is; 0 or 1 keeps every flow.  "table_size" is the most
+    flows tracked at once. */
+extern flow_policy_t *
+flow_policy_new(guint32 max_packets, guint64 max_bytes, guint32 sample_rate,
+                guint32 table_size);
+
+/** Returns TRUE if a packet, captured on a link of the given link-layer
+    header type, is to be kept, and counts it against its flow's limits. */
+extern gboolean
+flow_policy_keep_packet(flow_policy_t *fp, int linktype, const guint8 *pd,
+                        guint32 caplen, guint32 len);
+
+/** Gets the counts of packets kept and not kept so far. */
+extern void
+flow_policy_get_stats(const flow_policy_t *fp, flow_policy_stats *stats);
+
+/** Frees a policy. */
+extern void
+flow_policy_free(flow_policy_t *fp);
+
+#endif /* __FLOW_POLICY_H__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
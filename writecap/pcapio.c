@@ -611,6 +611,7 @@ pcapng_write_enhanced_packet_block(FILE* pfile,
 gboolean
 pcapng_write_interface_statistics_block(FILE* pfile,
                                         guint32 interface_id,
+                                        guint ts_mul,
                                         guint64 *bytes_written,
                                         const char *comment,   /* OPT_COMMENT           1 */
                                         guint64 isb_starttime, /* ISB_STARTTIME         2 */
@@ -669,6 +670,11 @@ pcapng_write_interface_statistics_block(FILE* pfile,
         timestamp = (guint64)(now.tv_sec) * 1000000 +
                     (guint64)(now.tv_usec);
 #endif
+        /*
+         * Convert to the interface's time stamp resolution.
+         */
+        timestamp = timestamp / 1000000 * ts_mul +
+                    timestamp % 1000000 * ts_mul / 1000000;
         block_total_length = (guint32)(sizeof(struct isb) + sizeof(guint32));
         options_length = 0;
         if (isb_ifrecv != G_MAXUINT64) {
@@ -75,9 +75,12 @@ pcapng_write_interface_description_block(FILE* pfile,
                                          guint8 tsresol,       /* IDB_TSRESOL           9 */
                                          int *err);
 
+/* The time stamp, and the start and end times, are in units of
+   1/ts_mul seconds, as set by the interface's IDB_TSRESOL */
 extern gboolean
 pcapng_write_interface_statistics_block(FILE* pfile,
                                         guint32 interface_id,
+                                        guint ts_mul,
                                         guint64 *bytes_written,
                                         const char *comment,   /* OPT_COMMENT           1 */
                                         guint64 isb_starttime, /* ISB_STARTTIME         2 */
@@ -0,0 +1,724 @@
+/* arrow_ipc.c
+ * Routines for writing tables in the Apache Arrow IPC streaming format.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "arrow_ipc.h"
+
+/*
+ * An Arrow IPC stream is a sequence of messages, each of them a
+ * continuation marker, the length of the message's metadata, the
+ * metadata (a Message flatbuffer, padded to 8 bytes) and the message
+ * body.  See https://arrow.apache.org/docs/format/Columnar.html and
+ * Schema.fbs and Message.fbs in the Arrow sources for the metadata.
+ *
+ * The flatbuffers are built front to back: a table is written before
+ * the strings, vectors and tables it refers to, and the references
+ * (unsigned offsets, which must point forward) are filled in once the
+ * objects they refer to have been written.
+ */
+
+#define ARROW_METADATA_V5           4
+
+/* MessageHeader union */
+#define ARROW_HEADER_SCHEMA         1
+#define ARROW_HEADER_RECORD_BATCH   3
+
+/* Type union */
+#define ARROW_FB_TYPE_INT           2
+#define ARROW_FB_TYPE_FLOATING      3
+#define ARROW_FB_TYPE_UTF8          5
+#define ARROW_FB_TYPE_BOOL          6
+#define ARROW_FB_TYPE_TIMESTAMP     10
+#define ARROW_FB_TYPE_LIST          12
+#define ARROW_FB_TYPE_DURATION      18
+
+#define ARROW_PRECISION_DOUBLE      2
+#define ARROW_TIME_UNIT_NANOSECOND  3
+
+/* Fields of a flatbuffer table; the largest table written has 6. */
+#define FB_MAX_FIELDS 8
+
+typedef struct {
+    guint   n_fields;
+    guint8  size[FB_MAX_FIELDS];    /* 0 if the field isn't present */
+    guint64 value[FB_MAX_FIELDS];
+    guint   pos[FB_MAX_FIELDS];     /* where the field was written */
+} fb_table;
+
+static const guint8 zeros[8];
+
+static void
+fb_align(GByteArray *buf, guint align)
+{
+    g_byte_array_append(buf, zeros, (align - buf->len % align) % align);
+}
+
+static void
+fb_put(GByteArray *buf, guint64 value, guint size)
+{
+    guint8 bytes[8];
+    guint i;
+
+    for (i = 0; i < size; i++) {
+        bytes[i] = (guint8)(value >> (8 * i));
+    }
+    g_byte_array_append(buf, bytes, size);
+}
+
+static void
+fb_set(GByteArray *buf, guint pos, guint64 value, guint size)
+{
+    guint i;
+
+    for (i = 0; i < size; i++) {
+        buf->data[pos + i] = (guint8)(value >> (8 * i));
+    }
+}
+
+static guint32
+fb_get_u32(const GByteArray *buf, guint pos)
+{
+    return (guint32)buf->data[pos] | (guint32)buf->data[pos + 1] << 8 |
+           (guint32)buf->data[pos + 2] << 16 | (guint32)buf->data[pos + 3] << 24;
+}
+
+/* Points the reference written at pos to the object at target. */
+static void
+fb_set_ref(GByteArray *buf, guint pos, guint target)
+{
+    fb_set(buf, pos, target - pos, 4);
+}
+
+static void
+fb_field(fb_table *table, guint id, guint size, guint64 value)
+{
+    table->size[id] = size;
+    table->value[id] = value;
+    if (id >= table->n_fields) {
+        table->n_fields = id + 1;
+    }
+}
+
+/* A reference to another object, filled in later with fb_set_ref(). */
+static void
+fb_field_ref(fb_table *table, guint id)
+{
+    fb_field(table, id, 4, 0);
+}
+
+/*
+ * Writes a table, preceded by its vtable, and returns its position.
+ * The fields are laid out largest first, so aligning the start of the
+ * table suitably aligns all of them.
+ */
+static guint
+fb_write_table(GByteArray *buf, fb_table *table)
+{
+    guint vtable_pos, table_pos, id, size;
+    gboolean has_8 = FALSE;
+
+    for (id = 0; id < table->n_fields; id++) {
+        if (table->size[id] == 8) {
+            has_8 = TRUE;
+        }
+    }
+
+    fb_align(buf, 2);
+    vtable_pos = buf->len;
+    fb_put(buf, 4 + 2 * table->n_fields, 2);
+    fb_put(buf, 0, 2);          /* table size, filled in below */
+    for (id = 0; id < table->n_fields; id++) {
+        fb_put(buf, 0, 2);      /* field offset, filled in below */
+    }
+
+    /* The table starts with a 4-byte offset to its vtable. */
+    fb_align(buf, 4);
+    if (has_8 && buf->len % 8 != 4) {
+        fb_put(buf, 0, 4);
+    }
+    table_pos = buf->len;
+    fb_put(buf, table_pos - vtable_pos, 4);
+
+    for (size = 8; size > 0; size /= 2) {
+        for (id = 0; id < table->n_fields; id++) {
+            if (table->size[id] != size) {
+                continue;
+            }
+            table->pos[id] = buf->len;
+            fb_set(buf, vtable_pos + 4 + 2 * id, buf->len - table_pos, 2);
+            fb_put(buf, table->value[id], size);
+        }
+    }
+    fb_set(buf, vtable_pos + 2, buf->len - table_pos, 2);
+
+    return table_pos;
+}
+
+static guint
+fb_write_string(GByteArray *buf, const char *str)
+{
+    guint pos, len = (guint)strlen(str);
+
+    fb_align(buf, 4);
+    pos = buf->len;
+    fb_put(buf, len, 4);
+    g_byte_array_append(buf, (const guint8 *)str, len + 1);
+    return pos;
+}
+
+/*
+ * Writes a vector of n references; the reference to element i, to be
+ * filled in with fb_set_ref(), is at the returned position + 4 + 4 * i.
+ */
+static guint
+fb_write_ref_vector(GByteArray *buf, guint n)
+{
+    guint pos, i;
+
+    fb_align(buf, 4);
+    pos = buf->len;
+    fb_put(buf, n, 4);
+    for (i = 0; i < n; i++) {
+        fb_put(buf, 0, 4);
+    }
+    return pos;
+}
+
+/*
+ * Writes a vector of n structs of two 64-bit integers each (FieldNode
+ * and Buffer both are).
+ */
+static guint
+fb_write_pair_vector(GByteArray *buf, const guint64 *pairs, guint n)
+{
+    guint pos, i;
+
+    fb_align(buf, 4);
+    if (buf->len % 8 != 4) {
+        fb_put(buf, 0, 4);
+    }
+    pos = buf->len;
+    fb_put(buf, n, 4);
+    for (i = 0; i < 2 * n; i++) {
+        fb_put(buf, pairs[i], 8);
+    }
+    return pos;
+}
+
+typedef struct {
+    char        *name;
+    arrow_type_e type;
+    gboolean     list;
+
+    /* The values (the lists' elements, for a list column). */
+    GByteArray  *data;          /* fixed-size values, bits or UTF-8 */
+    GByteArray  *offsets;       /* 32-bit offsets into data, for UTF-8 */
+    guint32      n_values;
+
+    /* The rows. */
+    GByteArray  *validity;
+    guint32      null_count;
+    GByteArray  *list_offsets;  /* 32-bit offsets into the values */
+    gboolean     row_has_value;
+} arrow_column;
+
+struct arrow_writer {
+    FILE        *output_file;
+    guint        batch_rows;
+    GPtrArray   *columns;
+    guint32      n_rows;
+    gboolean     schema_written;
+};
+
+static guint
+arrow_value_size(arrow_type_e type)
+{
+    switch (type) {
+    case ARROW_TYPE_INT32:
+    case ARROW_TYPE_UINT32:
+        return 4;
+    case ARROW_TYPE_INT64:
+    case ARROW_TYPE_UINT64:
+    case ARROW_TYPE_FLOAT64:
+    case ARROW_TYPE_TIMESTAMP_NS:
+    case ARROW_TYPE_DURATION_NS:
+        return 8;
+    default:
+        /* Variable size, or bits */
+        return 0;
+    }
+}
+
+static void
+bitmap_set(GByteArray *bitmap, guint32 bit, gboolean set)
+{
+    if (bit / 8 >= bitmap->len) {
+        g_byte_array_append(bitmap, zeros, 1);
+    }
+    if (set) {
+        bitmap->data[bit / 8] |= 1 << (bit % 8);
+    } else {
+        bitmap->data[bit / 8] &= ~(1 << (bit % 8));
+    }
+}
+
+static void
+arrow_column_reset(arrow_column *col)
+{
+    g_byte_array_set_size(col->data, 0);
+    g_byte_array_set_size(col->offsets, 0);
+    fb_put(col->offsets, 0, 4);
+    col->n_values = 0;
+    g_byte_array_set_size(col->validity, 0);
+    col->null_count = 0;
+    g_byte_array_set_size(col->list_offsets, 0);
+    fb_put(col->list_offsets, 0, 4);
+    col->row_has_value = FALSE;
+}
+
+arrow_writer *
+arrow_writer_new(FILE *output_file, guint batch_rows)
+{
+    arrow_writer *writer = g_new0(arrow_writer, 1);
+
+    writer->output_file = output_file;
+    writer->batch_rows = batch_rows > 0 ? batch_rows : 1;
+    writer->columns = g_ptr_array_new();
+    return writer;
+}
+
+guint
+arrow_writer_add_column(arrow_writer *writer, const char *name,
+                        arrow_type_e type, gboolean list)
+{
+    arrow_column *col = g_new0(arrow_column, 1);
+
+    g_assert(!writer->schema_written);
+
+    col->name = g_strdup(name);
+    col->type = type;
+    col->list = list;
+    col->data = g_byte_array_new();
+    col->offsets = g_byte_array_new();
+    col->validity = g_byte_array_new();
+    col->list_offsets = g_byte_array_new();
+    arrow_column_reset(col);
+    g_ptr_array_add(writer->columns, col);
+    return writer->columns->len - 1;
+}
+
+arrow_type_e
+arrow_writer_column_type(const arrow_writer *writer, guint column)
+{
+    return ((arrow_column *)g_ptr_array_index(writer->columns, column))->type;
+}
+
+gboolean
+arrow_writer_has_value(const arrow_writer *writer, guint column)
+{
+    return ((arrow_column *)g_ptr_array_index(writer->columns, column))->row_has_value;
+}
+
+/*
+ * Makes room for a value in a column.  For a column that isn't a list,
+ * a value already given in this row is replaced.
+ */
+static arrow_column *
+arrow_writer_begin_value(arrow_writer *writer, guint column)
+{
+    arrow_column *col = (arrow_column *)g_ptr_array_index(writer->columns, column);
+
+    if (col->row_has_value && !col->list) {
+        col->n_values--;
+        if (col->type == ARROW_TYPE_UTF8) {
+            /* Back to where the replaced value starts */
+            g_byte_array_set_size(col->offsets, (col->n_values + 1) * 4);
+            g_byte_array_set_size(col->data,
+                fb_get_u32(col->offsets, col->n_values * 4));
+        } else if (col->type != ARROW_TYPE_BOOL) {
+            g_byte_array_set_size(col->data,
+                col->n_values * arrow_value_size(col->type));
+        }
+    }
+    col->row_has_value = TRUE;
+    return col;
+}
+
+static void
+arrow_column_put_fixed(arrow_column *col, guint64 value)
+{
+    fb_put(col->data, value, arrow_value_size(col->type));
+    col->n_values++;
+}
+
+void
+arrow_writer_value_int(arrow_writer *writer, guint column, gint64 value)
+{
+    arrow_column_put_fixed(arrow_writer_begin_value(writer, column), (guint64)value);
+}
+
+void
+arrow_writer_value_uint(arrow_writer *writer, guint column, guint64 value)
+{
+    arrow_column_put_fixed(arrow_writer_begin_value(writer, column), value);
+}
+
+void
+arrow_writer_value_double(arrow_writer *writer, guint column, double value)
+{
+    guint64 bits;
+
+    memcpy(&bits, &value, sizeof bits);
+    arrow_column_put_fixed(arrow_writer_begin_value(writer, column), bits);
+}
+
+void
+arrow_writer_value_bool(arrow_writer *writer, guint column, gboolean value)
+{
+    arrow_column *col = arrow_writer_begin_value(writer, column);
+
+    bitmap_set(col->data, col->n_values, value);
+    col->n_values++;
+}
+
+void
+arrow_writer_value_string(arrow_writer *writer, guint column, const char *value)
+{
+    arrow_column *col = arrow_writer_begin_value(writer, column);
+
+    g_byte_array_append(col->data, (const guint8 *)value, (guint)strlen(value));
+    fb_put(col->offsets, col->data->len, 4);
+    col->n_values++;
+}
+
+/* Adds a null value to a column that isn't a list. */
+static void
+arrow_column_put_null(arrow_column *col)
+{
+    switch (col->type) {
+    case ARROW_TYPE_UTF8:
+        fb_put(col->offsets, col->data->len, 4);
+        break;
+    case ARROW_TYPE_BOOL:
+        bitmap_set(col->data, col->n_values, FALSE);
+        break;
+    default:
+        g_byte_array_append(col->data, zeros, arrow_value_size(col->type));
+        break;
+    }
+    col->n_values++;
+}
+
+static void
+arrow_write_message(arrow_writer *writer, GByteArray *metadata,
+                    GByteArray *body)
+{
+    guint8 prefix[8];
+
+    /* The metadata is padded so that the body is 8-byte aligned. */
+    fb_align(metadata, 8);
+    memset(prefix, 0xFF, 4);    /* continuation marker */
+    prefix[4] = (guint8)metadata->len;
+    prefix[5] = (guint8)(metadata->len >> 8);
+    prefix[6] = (guint8)(metadata->len >> 16);
+    prefix[7] = (guint8)(metadata->len >> 24);
+    fwrite(prefix, 1, sizeof prefix, writer->output_file);
+    fwrite(metadata->data, 1, metadata->len, writer->output_file);
+    if (body && body->len) {
+        fwrite(body->data, 1, body->len, writer->output_file);
+    }
+}
+
+/*
+ * Starts a Message flatbuffer in buf; the returned position is that of
+ * the reference to the header table, to be filled in by the caller.
+ */
+static guint
+arrow_begin_message(GByteArray *buf, guint header_type, guint64 body_length)
+{
+    fb_table message = { 0 };
+    guint pos;
+
+    fb_put(buf, 0, 4);      /* root table */
+    fb_field(&message, 0, 2, ARROW_METADATA_V5);
+    fb_field(&message, 1, 1, header_type);
+    fb_field_ref(&message, 2);
+    fb_field(&message, 3, 8, body_length);
+    pos = fb_write_table(buf, &message);
+    fb_set_ref(buf, 0, pos);
+    return message.pos[2];
+}
+
+static void
+arrow_write_type(GByteArray *buf, guint ref, arrow_type_e type)
+{
+    fb_table table = { 0 };
+    guint pos;
+
+    switch (type) {
+    case ARROW_TYPE_INT32:
+    case ARROW_TYPE_UINT32:
+    case ARROW_TYPE_INT64:
+    case ARROW_TYPE_UINT64:
+        fb_field(&table, 0, 4, arrow_value_size(type) * 8);
+        fb_field(&table, 1, 1, type == ARROW_TYPE_INT32 || type == ARROW_TYPE_INT64);
+        break;
+    case ARROW_TYPE_FLOAT64:
+        fb_field(&table, 0, 2, ARROW_PRECISION_DOUBLE);
+        break;
+    case ARROW_TYPE_TIMESTAMP_NS:
+        fb_field(&table, 0, 2, ARROW_TIME_UNIT_NANOSECOND);
+        fb_field_ref(&table, 1);
+        break;
+    case ARROW_TYPE_DURATION_NS:
+        fb_field(&table, 0, 2, ARROW_TIME_UNIT_NANOSECOND);
+        break;
+    default:
+        /* Utf8, Bool and List have no fields */
+        break;
+    }
+    pos = fb_write_table(buf, &table);
+    fb_set_ref(buf, ref, pos);
+    if (type == ARROW_TYPE_TIMESTAMP_NS) {
+        fb_set_ref(buf, table.pos[1], fb_write_string(buf, "UTC"));
+    }
+}
+
+static guint
+arrow_fb_type(arrow_type_e type)
+{
+    switch (type) {
+    case ARROW_TYPE_BOOL:
+        return ARROW_FB_TYPE_BOOL;
+    case ARROW_TYPE_INT32:
+    case ARROW_TYPE_UINT32:
+    case ARROW_TYPE_INT64:
+    case ARROW_TYPE_UINT64:
+        return ARROW_FB_TYPE_INT;
+    case ARROW_TYPE_FLOAT64:
+        return ARROW_FB_TYPE_FLOATING;
+    case ARROW_TYPE_TIMESTAMP_NS:
+        return ARROW_FB_TYPE_TIMESTAMP;
+    case ARROW_TYPE_DURATION_NS:
+        return ARROW_FB_TYPE_DURATION;
+    default:
+        return ARROW_FB_TYPE_UTF8;
+    }
+}
+
+/* Writes a Field table, and points the reference at ref to it. */
+static void
+arrow_write_field(GByteArray *buf, guint ref, const char *name,
+                  arrow_type_e type, gboolean list)
+{
+    fb_table field = { 0 };
+    guint children;
+
+    fb_field_ref(&field, 0);                                /* name */
+    fb_field(&field, 1, 1, TRUE);                           /* nullable */
+    fb_field(&field, 2, 1, list ? ARROW_FB_TYPE_LIST : arrow_fb_type(type));
+    fb_field_ref(&field, 3);                                /* type */
+    fb_field_ref(&field, 5);                                /* children */
+    fb_set_ref(buf, ref, fb_write_table(buf, &field));
+
+    fb_set_ref(buf, field.pos[0], fb_write_string(buf, name));
+    if (list) {
+        /* An empty List table */
+        fb_table list_type = { 0 };
+        fb_set_ref(buf, field.pos[3], fb_write_table(buf, &list_type));
+    } else {
+        arrow_write_type(buf, field.pos[3], type);
+    }
+    children = fb_write_ref_vector(buf, list ? 1 : 0);
+    fb_set_ref(buf, field.pos[5], children);
+    if (list) {
+        arrow_write_field(buf, children + 4, "item", type, FALSE);
+    }
+}
+
+static void
+arrow_write_schema(arrow_writer *writer)
+{
+    GByteArray *buf = g_byte_array_new();
+    fb_table schema = { 0 };
+    guint header_ref, fields, i;
+
+    header_ref = arrow_begin_message(buf, ARROW_HEADER_SCHEMA, 0);
+    fb_field(&schema, 0, 2, 0);     /* little endian */
+    fb_field_ref(&schema, 1);       /* fields */
+    fb_set_ref(buf, header_ref, fb_write_table(buf, &schema));
+
+    fields = fb_write_ref_vector(buf, writer->columns->len);
+    fb_set_ref(buf, schema.pos[1], fields);
+    for (i = 0; i < writer->columns->len; i++) {
+        arrow_column *col = (arrow_column *)g_ptr_array_index(writer->columns, i);
+        arrow_write_field(buf, fields + 4 + 4 * i, col->name, col->type, col->list);
+    }
+
+    arrow_write_message(writer, buf, NULL);
+    g_byte_array_free(buf, TRUE);
+    writer->schema_written = TRUE;
+}
+
+/* Appends a buffer to the body of a record batch, and describes it. */
+static void
+arrow_body_add(GByteArray *body, GArray *buffers, const void *data, guint len)
+{
+    guint64 offset = body->len, length = len;
+
+    g_array_append_val(buffers, offset);
+    g_array_append_val(buffers, length);
+    if (len) {
+        g_byte_array_append(body, (const guint8 *)data, len);
+    }
+    fb_align(body, 8);
+}
+
+static void
+arrow_body_add_values(GByteArray *body, GArray *buffers, arrow_column *col)
+{
+    /* The values of a list are never null: no validity bitmap. */
+    if (col->list) {
+        arrow_body_add(body, buffers, NULL, 0);
+    }
+    if (col->type == ARROW_TYPE_UTF8) {
+        arrow_body_add(body, buffers, col->offsets->data, col->offsets->len);
+    }
+    arrow_body_add(body, buffers, col->data->data, col->data->len);
+}
+
+static void
+arrow_write_batch(arrow_writer *writer)
+{
+    GByteArray *buf, *body;
+    GArray *nodes, *buffers;
+    fb_table batch = { 0 };
+    guint header_ref, i;
+    guint64 value;
+
+    if (!writer->schema_written) {
+        arrow_write_schema(writer);
+    }
+    if (writer->n_rows == 0) {
+        return;
+    }
+
+    /* Field nodes and buffers are in depth-first order. */
+    body = g_byte_array_new();
+    nodes = g_array_new(FALSE, FALSE, sizeof(guint64));
+    buffers = g_array_new(FALSE, FALSE, sizeof(guint64));
+    for (i = 0; i < writer->columns->len; i++) {
+        arrow_column *col = (arrow_column *)g_ptr_array_index(writer->columns, i);
+
+        value = writer->n_rows;
+        g_array_append_val(nodes, value);
+        value = col->null_count;
+        g_array_append_val(nodes, value);
+        arrow_body_add(body, buffers, col->validity->data, col->validity->len);
+        if (col->list) {
+            arrow_body_add(body, buffers, col->list_offsets->data,
+                           col->list_offsets->len);
+            value = col->n_values;
+            g_array_append_val(nodes, value);
+            value = 0;
+            g_array_append_val(nodes, value);
+        }
+        arrow_body_add_values(body, buffers, col);
+        arrow_column_reset(col);
+    }
+
+    buf = g_byte_array_new();
+    header_ref = arrow_begin_message(buf, ARROW_HEADER_RECORD_BATCH, body->len);
+    fb_field(&batch, 0, 8, writer->n_rows);     /* length */
+    fb_field_ref(&batch, 1);                    /* nodes */
+    fb_field_ref(&batch, 2);                    /* buffers */
+    fb_set_ref(buf, header_ref, fb_write_table(buf, &batch));
+    fb_set_ref(buf, batch.pos[1],
+               fb_write_pair_vector(buf, (guint64 *)nodes->data, nodes->len / 2));
+    fb_set_ref(buf, batch.pos[2],
+               fb_write_pair_vector(buf, (guint64 *)buffers->data, buffers->len / 2));
+
+    arrow_write_message(writer, buf, body);
+
+    g_byte_array_free(buf, TRUE);
+    g_byte_array_free(body, TRUE);
+    g_array_free(nodes, TRUE);
+    g_array_free(buffers, TRUE);
+    writer->n_rows = 0;
+}
+
+void
+arrow_writer_end_row(arrow_writer *writer)
+{
+    guint i;
+
+    for (i = 0; i < writer->columns->len; i++) {
+        arrow_column *col = (arrow_column *)g_ptr_array_index(writer->columns, i);
+
+        bitmap_set(col->validity, writer->n_rows, col->row_has_value);
+        if (!col->row_has_value) {
+            col->null_count++;
+            if (!col->list) {
+                arrow_column_put_null(col);
+            }
+        }
+        if (col->list) {
+            fb_put(col->list_offsets, col->n_values, 4);
+        }
+        col->row_has_value = FALSE;
+    }
+    writer->n_rows++;
+
+    if (writer->n_rows >= writer->batch_rows) {
+        arrow_write_batch(writer);
+    }
+}
+
+gboolean
+arrow_writer_finish(arrow_writer *writer)
+{
+    static const guint8 end_of_stream[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0 };
+    gboolean ok;
+    guint i;
+
+    arrow_write_batch(writer);
+    fwrite(end_of_stream, 1, sizeof end_of_stream, writer->output_file);
+    ok = !ferror(writer->output_file);
+
+    for (i = 0; i < writer->columns->len; i++) {
+        arrow_column *col = (arrow_column *)g_ptr_array_index(writer->columns, i);
+
+        g_free(col->name);
+        g_byte_array_free(col->data, TRUE);
+        g_byte_array_free(col->offsets, TRUE);
+        g_byte_array_free(col->validity, TRUE);
+        g_byte_array_free(col->list_offsets, TRUE);
+        g_free(col);
+    }
+    g_ptr_array_free(writer->columns, TRUE);
+    g_free(writer);
+    return ok;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
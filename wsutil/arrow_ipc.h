@@ -0,0 +1,129 @@
+/* arrow_ipc.h
+ * Routines for writing tables in the Apache Arrow IPC streaming format.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __ARROW_IPC_H__
+#define __ARROW_IPC_H__
+
+#include "ws_symbol_export.h"
+#include <glib.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Writes rows of typed columns as an Arrow IPC stream: a schema message,
+ * a record batch message for every batch_rows rows, and an end-of-stream
+ * marker. Only what's needed to write a stream is implemented; there's
+ * no dependency on the Arrow libraries.
+ *
+ * Example:
+ *
+ *  arrow_writer *writer = arrow_writer_new(stdout, 4096);
+ *  arrow_writer_add_column(writer, "frame.len", ARROW_TYPE_UINT32, FALSE);
+ *  arrow_writer_add_column(writer, "ip.src", ARROW_TYPE_UTF8, TRUE);
+ *  arrow_writer_value_uint(writer, 0, 60);
+ *  arrow_writer_value_string(writer, 1, "192.0.2.1");
+ *  arrow_writer_end_row(writer);
+ *  arrow_writer_finish(writer);
+ *
+ * All columns are nullable; a column that gets no value in a row is null
+ * in that row.  A list column holds all of the values given to it in a
+ * row; for any other column, the last value given in a row is kept.
+ */
+typedef enum {
+    ARROW_TYPE_UTF8,
+    ARROW_TYPE_BOOL,
+    ARROW_TYPE_INT32,
+    ARROW_TYPE_UINT32,
+    ARROW_TYPE_INT64,
+    ARROW_TYPE_UINT64,
+    ARROW_TYPE_FLOAT64,
+    ARROW_TYPE_TIMESTAMP_NS,    /* nanoseconds since the Epoch, UTC */
+    ARROW_TYPE_DURATION_NS      /* nanoseconds */
+} arrow_type_e;
+
+typedef struct arrow_writer arrow_writer;
+
+/**
+ * Creates a writer. Columns must be added before any value is written.
+ * @param batch_rows the number of rows in a record batch (the last batch
+ *                   may have fewer).
+ */
+WS_DLL_PUBLIC arrow_writer *
+arrow_writer_new(FILE *output_file, guint batch_rows);
+
+/**
+ * Adds a column of the given type, or of lists of values of the given type
+ * if list is TRUE. Returns the index of the column.
+ */
+WS_DLL_PUBLIC guint
+arrow_writer_add_column(arrow_writer *writer, const char *name,
+                        arrow_type_e type, gboolean list);
+
+WS_DLL_PUBLIC arrow_type_e
+arrow_writer_column_type(const arrow_writer *writer, guint column);
+
+/** Returns TRUE if the column got a value in the current row. */
+WS_DLL_PUBLIC gboolean
+arrow_writer_has_value(const arrow_writer *writer, guint column);
+
+/*
+ * Values for integer, timestamp and duration columns. Values that don't
+ * fit the column's type are truncated.
+ */
+WS_DLL_PUBLIC void
+arrow_writer_value_int(arrow_writer *writer, guint column, gint64 value);
+
+WS_DLL_PUBLIC void
+arrow_writer_value_uint(arrow_writer *writer, guint column, guint64 value);
+
+WS_DLL_PUBLIC void
+arrow_writer_value_double(arrow_writer *writer, guint column, double value);
+
+WS_DLL_PUBLIC void
+arrow_writer_value_bool(arrow_writer *writer, guint column, gboolean value);
+
+/** The value must be valid UTF-8. */
+WS_DLL_PUBLIC void
+arrow_writer_value_string(arrow_writer *writer, guint column, const char *value);
+
+/**
+ * Finishes the current row, writing a record batch if it's full.
+ */
+WS_DLL_PUBLIC void
+arrow_writer_end_row(arrow_writer *writer);
+
+/**
+ * Writes the remaining rows and the end of the stream, and frees the
+ * writer. Returns FALSE if writing failed.
+ */
+WS_DLL_PUBLIC gboolean
+arrow_writer_finish(arrow_writer *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ARROW_IPC_H__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,162 @@
+/* cbor_writer.c
+ * Routines for encoding data as CBOR (RFC 7049).
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "cbor_writer.h"
+
+#include <string.h>
+
+/* Major types */
+#define CBOR_UINT       0
+#define CBOR_NINT       1
+#define CBOR_BYTES      2
+#define CBOR_TEXT       3
+#define CBOR_ARRAY      4
+#define CBOR_MAP        5
+#define CBOR_TAG        6
+#define CBOR_SIMPLE     7
+
+/* Simple values and the additional information for a double */
+#define CBOR_FALSE      20
+#define CBOR_TRUE       21
+#define CBOR_NULL       22
+#define CBOR_FLOAT64    27
+
+/*
+ * Writes the initial byte of an item, with the argument in the shortest
+ * form that holds it.
+ */
+static void
+cbor_write_head(GByteArray *out, guint8 major, guint64 value)
+{
+    guint8 head[9];
+    guint len;
+    guint i;
+
+    major <<= 5;
+    if (value < 24) {
+        head[0] = major | (guint8)value;
+        len = 1;
+    } else if (value <= G_MAXUINT8) {
+        head[0] = major | 24;
+        len = 2;
+    } else if (value <= G_MAXUINT16) {
+        head[0] = major | 25;
+        len = 3;
+    } else if (value <= G_MAXUINT32) {
+        head[0] = major | 26;
+        len = 5;
+    } else {
+        head[0] = major | 27;
+        len = 9;
+    }
+
+    /* The argument follows in network byte order */
+    for (i = len - 1; i > 0; i--) {
+        head[i] = (guint8)value;
+        value >>= 8;
+    }
+    g_byte_array_append(out, head, len);
+}
+
+void
+cbor_write_uint(GByteArray *out, guint64 value)
+{
+    cbor_write_head(out, CBOR_UINT, value);
+}
+
+void
+cbor_write_int(GByteArray *out, gint64 value)
+{
+    if (value >= 0) {
+        cbor_write_head(out, CBOR_UINT, (guint64)value);
+    } else {
+        /* -1 - n, computed without overflowing for G_MININT64 */
+        cbor_write_head(out, CBOR_NINT, ~(guint64)value);
+    }
+}
+
+void
+cbor_write_bytes(GByteArray *out, const guint8 *data, size_t len)
+{
+    cbor_write_head(out, CBOR_BYTES, len);
+    g_byte_array_append(out, data, (guint)len);
+}
+
+void
+cbor_write_text(GByteArray *out, const char *text, gssize len)
+{
+    if (len < 0)
+        len = strlen(text);
+    cbor_write_head(out, CBOR_TEXT, len);
+    g_byte_array_append(out, (const guint8 *)text, (guint)len);
+}
+
+void
+cbor_write_array(GByteArray *out, guint64 count)
+{
+    cbor_write_head(out, CBOR_ARRAY, count);
+}
+
+void
+cbor_write_map(GByteArray *out, guint64 count)
+{
+    cbor_write_head(out, CBOR_MAP, count);
+}
+
+void
+cbor_write_tag(GByteArray *out, guint64 tag)
+{
+    cbor_write_head(out, CBOR_TAG, tag);
+}
+
+void
+cbor_write_bool(GByteArray *out, gboolean value)
+{
+    guint8 item = (CBOR_SIMPLE << 5) | (value ? CBOR_TRUE : CBOR_FALSE);
+
+    g_byte_array_append(out, &item, 1);
+}
+
+void
+cbor_write_null(GByteArray *out)
+{
+    guint8 item = (CBOR_SIMPLE << 5) | CBOR_NULL;
+
+    g_byte_array_append(out, &item, 1);
+}
+
+void
+cbor_write_double(GByteArray *out, double value)
+{
+    guint8 item[9];
+    guint64 bits;
+    guint i;
+
+    memcpy(&bits, &value, sizeof bits);
+    item[0] = (CBOR_SIMPLE << 5) | CBOR_FLOAT64;
+    for (i = 8; i > 0; i--) {
+        item[i] = (guint8)bits;
+        bits >>= 8;
+    }
+    g_byte_array_append(out, item, sizeof item);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
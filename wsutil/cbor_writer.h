@@ -0,0 +1,88 @@
+/* cbor_writer.h
+ * Routines for encoding data as CBOR (RFC 7049).
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __CBOR_WRITER_H__
+#define __CBOR_WRITER_H__
+
+#include "ws_symbol_export.h"
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Each function appends one data item, or the head of an array or map, to
+ * the output. Arrays and maps have a definite length; after the head come
+ * count items (count pairs for maps).
+ *
+ * Example, encoding {"a": [1, -2]}:
+ *
+ *  GByteArray *out = g_byte_array_new();
+ *  cbor_write_map(out, 1);
+ *  cbor_write_text(out, "a", -1);
+ *  cbor_write_array(out, 2);
+ *  cbor_write_uint(out, 1);
+ *  cbor_write_int(out, -2);
+ */
+
+WS_DLL_PUBLIC void
+cbor_write_uint(GByteArray *out, guint64 value);
+
+WS_DLL_PUBLIC void
+cbor_write_int(GByteArray *out, gint64 value);
+
+WS_DLL_PUBLIC void
+cbor_write_bytes(GByteArray *out, const guint8 *data, size_t len);
+
+/**
+ * Writes a text string, which must be valid UTF-8. If len is negative, text
+ * is NUL-terminated.
+ */
+WS_DLL_PUBLIC void
+cbor_write_text(GByteArray *out, const char *text, gssize len);
+
+WS_DLL_PUBLIC void
+cbor_write_array(GByteArray *out, guint64 count);
+
+WS_DLL_PUBLIC void
+cbor_write_map(GByteArray *out, guint64 count);
+
+/** Writes a tag, which applies to the item written next. */
+WS_DLL_PUBLIC void
+cbor_write_tag(GByteArray *out, guint64 tag);
+
+WS_DLL_PUBLIC void
+cbor_write_bool(GByteArray *out, gboolean value);
+
+WS_DLL_PUBLIC void
+cbor_write_null(GByteArray *out);
+
+WS_DLL_PUBLIC void
+cbor_write_double(GByteArray *out, double value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CBOR_WRITER_H__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -14,6 +14,7 @@
 #include "json_dumper.h"
 
 #include <math.h>
+#include <string.h>
 
 /*
  * json_dumper.state[current_depth] describes a nested element:
@@ -42,11 +43,85 @@ enum json_dumper_change {
     JSON_DUMPER_FINISH,
 };
 
+/*
+ * Output goes through these, which collect it in the output buffer if
+ * there is one.
+ */
+static void
+json_dumper_write(json_dumper *dumper, const char *data, size_t len)
+{
+    if (!dumper->output_buffer) {
+        fwrite(data, 1, len, dumper->output_file);
+        return;
+    }
+    if (len > dumper->output_buffer_size - dumper->output_buffer_used) {
+        json_dumper_flush(dumper);
+        if (len > dumper->output_buffer_size) {
+            fwrite(data, 1, len, dumper->output_file);
+            return;
+        }
+    }
+    memcpy(dumper->output_buffer + dumper->output_buffer_used, data, len);
+    dumper->output_buffer_used += len;
+}
+
+static inline void
+json_dumper_putc(json_dumper *dumper, char c)
+{
+    if (!dumper->output_buffer) {
+        fputc(c, dumper->output_file);
+        return;
+    }
+    if (dumper->output_buffer_used == dumper->output_buffer_size) {
+        json_dumper_flush(dumper);
+    }
+    dumper->output_buffer[dumper->output_buffer_used++] = c;
+}
+
+static inline void
+json_dumper_puts(json_dumper *dumper, const char *str)
+{
+    json_dumper_write(dumper, str, strlen(str));
+}
+
+static gboolean
+json_dumper_vprintf_buffered(json_dumper *dumper, const char *format, va_list ap)
+{
+    gsize avail = dumper->output_buffer_size - dumper->output_buffer_used;
+    va_list ap_copy;
+    int len;
+
+    va_copy(ap_copy, ap);
+    len = g_vsnprintf(dumper->output_buffer + dumper->output_buffer_used, (gulong)avail, format, ap_copy);
+    va_end(ap_copy);
+    if (len < 0 || (gsize)len >= avail) {
+        /* Didn't fit; anything written past output_buffer_used is ignored. */
+        return FALSE;
+    }
+    dumper->output_buffer_used += len;
+    return TRUE;
+}
+
 static void
-json_puts_string(FILE *fp, const char *str, gboolean dot_to_underscore)
+json_dumper_vprintf(json_dumper *dumper, const char *format, va_list ap)
+{
+    if (dumper->output_buffer) {
+        if (json_dumper_vprintf_buffered(dumper, format, ap)) {
+            return;
+        }
+        json_dumper_flush(dumper);
+        if (json_dumper_vprintf_buffered(dumper, format, ap)) {
+            return;
+        }
+    }
+    vfprintf(dumper->output_file, format, ap);
+}
+
+static void
+json_puts_string(json_dumper *dumper, const char *str, gboolean dot_to_underscore)
 {
     if (!str) {
-        fputs("null", fp);
+        json_dumper_puts(dumper, "null");
         return;
     }
 
@@ -55,25 +130,38 @@ json_puts_string(FILE *fp, const char *str, gboolean dot_to_underscore)
         "u0010", "u0011", "u0012", "u0013", "u0014", "u0015", "u0016", "u0017", "u0018", "u0019", "u001a", "u001b", "u001c", "u001d", "u001e", "u001f"
     };
 
-    fputc('"', fp);
+    /* Characters that don't need escaping are written in runs. */
+    int run_start = 0;
+
+    json_dumper_putc(dumper, '"');
     for (int i = 0; str[i]; i++) {
+        const char *escaped;
+        char replacement[2];
+
         if ((guint)str[i] < 0x20) {
-            fputc('\\', fp);
-            fputs(json_cntrl[(guint)str[i]], fp);
+            escaped = json_cntrl[(guint)str[i]];
         } else if (i > 0 && str[i - 1] == '<' && str[i] == '/') {
             // Convert </script> to <\/script> to avoid breaking web pages.
-            fputs("\\/", fp);
+            escaped = "/";
+        } else if (str[i] == '\\' || str[i] == '"') {
+            replacement[0] = str[i];
+            replacement[1] = '\0';
+            escaped = replacement;
+        } else if (dot_to_underscore && str[i] == '.') {
+            json_dumper_write(dumper, str + run_start, i - run_start);
+            json_dumper_putc(dumper, '_');
+            run_start = i + 1;
+            continue;
         } else {
-            if (str[i] == '\\' || str[i] == '"') {
-                fputc('\\', fp);
-            }
-            if (dot_to_underscore && str[i] == '.')
-                fputc('_', fp);
-            else
-                fputc(str[i], fp);
+            continue;
         }
+        json_dumper_write(dumper, str + run_start, i - run_start);
+        json_dumper_putc(dumper, '\\');
+        json_dumper_puts(dumper, escaped);
+        run_start = i + 1;
     }
-    fputc('"', fp);
+    json_dumper_puts(dumper, str + run_start);
+    json_dumper_putc(dumper, '"');
 }
 
 /**
@@ -100,6 +188,7 @@ json_dumper_bad(json_dumper *dumper, enum json_dumper_change change,
         /* Console output can be slow, disable log calls to speed up fuzzing. */
         return;
     }
+    json_dumper_flush(dumper);
     fflush(dumper->output_file);
     g_error("Bad json_dumper state: %s; change=%d type=%d depth=%d prev/curr/next state=%02x %02x %02x",
             what, change, type, dumper->current_depth, states[0], states[1], states[2]);
@@ -167,12 +256,12 @@ json_dumper_check_state(json_dumper *dumper, enum json_dumper_change change, enu
 }
 
 static void
-print_newline_indent(const json_dumper *dumper, int depth)
+print_newline_indent(json_dumper *dumper, int depth)
 {
     if ((dumper->flags & JSON_DUMPER_FLAGS_PRETTY_PRINT)) {
-        fputc('\n', dumper->output_file);
+        json_dumper_putc(dumper, '\n');
         for (int i = 0; i < depth; i++) {
-            fputs("  ", dumper->output_file);
+            json_dumper_write(dumper, "  ", 2);
         }
     }
 }
@@ -208,7 +297,7 @@ prepare_token(json_dumper *dumper)
     }
 
     if (dumper->state[dumper->current_depth]) {
-        fputc(',', dumper->output_file);
+        json_dumper_putc(dumper, ',');
     }
     print_newline_indent(dumper, dumper->current_depth);
 }
@@ -218,13 +307,13 @@ prepare_token(json_dumper *dumper)
  * necessary, it is preceded by newline and indentation).
  */
 static void
-finish_token(const json_dumper *dumper, char close_char)
+finish_token(json_dumper *dumper, char close_char)
 {
     // if the object/array was non-empty, add a newline and indentation.
     if (dumper->state[dumper->current_depth]) {
         print_newline_indent(dumper, dumper->current_depth - 1);
     }
-    fputc(close_char, dumper->output_file);
+    json_dumper_putc(dumper, close_char);
 }
 
 void
@@ -235,7 +324,7 @@ json_dumper_begin_object(json_dumper *dumper)
     }
 
     prepare_token(dumper);
-    fputc('{', dumper->output_file);
+    json_dumper_putc(dumper, '{');
 
     dumper->state[dumper->current_depth] = JSON_DUMPER_TYPE_OBJECT;
     ++dumper->current_depth;
@@ -250,10 +339,10 @@ json_dumper_set_member_name(json_dumper *dumper, const char *name)
     }
 
     prepare_token(dumper);
-    json_puts_string(dumper->output_file, name, dumper->flags & JSON_DUMPER_DOT_TO_UNDERSCORE);
-    fputc(':', dumper->output_file);
+    json_puts_string(dumper, name, dumper->flags & JSON_DUMPER_DOT_TO_UNDERSCORE);
+    json_dumper_putc(dumper, ':');
     if ((dumper->flags & JSON_DUMPER_FLAGS_PRETTY_PRINT)) {
-        fputc(' ', dumper->output_file);
+        json_dumper_putc(dumper, ' ');
     }
 
     dumper->state[dumper->current_depth - 1] |= JSON_DUMPER_HAS_NAME;
@@ -279,7 +368,7 @@ json_dumper_begin_array(json_dumper *dumper)
     }
 
     prepare_token(dumper);
-    fputc('[', dumper->output_file);
+    json_dumper_putc(dumper, '[');
 
     dumper->state[dumper->current_depth] = JSON_DUMPER_TYPE_ARRAY;
     ++dumper->current_depth;
@@ -306,7 +395,7 @@ json_dumper_value_string(json_dumper *dumper, const char *value)
     }
 
     prepare_token(dumper);
-    json_puts_string(dumper->output_file, value, FALSE);
+    json_puts_string(dumper, value, FALSE);
 
     dumper->state[dumper->current_depth] = JSON_DUMPER_TYPE_VALUE;
 }
@@ -321,9 +410,9 @@ json_dumper_value_double(json_dumper *dumper, double value)
     prepare_token(dumper);
     gchar buffer[G_ASCII_DTOSTR_BUF_SIZE] = { 0 };
     if (isfinite(value) && g_ascii_dtostr(buffer, G_ASCII_DTOSTR_BUF_SIZE, value) && buffer[0]) {
-        fputs(buffer, dumper->output_file);
+        json_dumper_puts(dumper, buffer);
     } else {
-        fputs("null", dumper->output_file);
+        json_dumper_puts(dumper, "null");
     }
 
     dumper->state[dumper->current_depth] = JSON_DUMPER_TYPE_VALUE;
@@ -337,7 +426,7 @@ json_dumper_value_va_list(json_dumper *dumper, const char *format, va_list ap)
     }
 
     prepare_token(dumper);
-    vfprintf(dumper->output_file, format, ap);
+    json_dumper_vprintf(dumper, format, ap);
 
     dumper->state[dumper->current_depth] = JSON_DUMPER_TYPE_VALUE;
 }
@@ -359,11 +448,21 @@ json_dumper_finish(json_dumper *dumper)
         return FALSE;
     }
 
-    fputc('\n', dumper->output_file);
+    json_dumper_putc(dumper, '\n');
+    json_dumper_flush(dumper);
     dumper->state[0] = 0;
     return TRUE;
 }
 
+void
+json_dumper_flush(json_dumper *dumper)
+{
+    if (dumper->output_buffer_used > 0) {
+        fwrite(dumper->output_buffer, 1, dumper->output_buffer_used, dumper->output_file);
+        dumper->output_buffer_used = 0;
+    }
+}
+
 void
 json_dumper_begin_base64(json_dumper *dumper)
 {
@@ -376,7 +475,7 @@ json_dumper_begin_base64(json_dumper *dumper)
 
     prepare_token(dumper);
 
-    fputc('"', dumper->output_file);
+    json_dumper_putc(dumper, '"');
 
     dumper->state[dumper->current_depth] = JSON_DUMPER_TYPE_BASE64;
     ++dumper->current_depth;
@@ -396,7 +495,7 @@ json_dumper_write_base64(json_dumper* dumper, const guchar *data, size_t len)
     while (len > 0) {
         gsize chunk_size = len < CHUNK_SIZE ? len : CHUNK_SIZE;
         gsize output_size = g_base64_encode_step(data, chunk_size, FALSE, buf, &dumper->base64_state, &dumper->base64_save);
-        fwrite(buf, 1, output_size, dumper->output_file);
+        json_dumper_write(dumper, buf, output_size);
         data += chunk_size;
         len -= chunk_size;
     }
@@ -415,9 +514,9 @@ json_dumper_end_base64(json_dumper *dumper)
     gsize wrote;
 
     wrote = g_base64_encode_close(FALSE, buf, &dumper->base64_state, &dumper->base64_save);
-    fwrite(buf, 1, wrote, dumper->output_file);
+    json_dumper_write(dumper, buf, wrote);
 
-    fputc('"', dumper->output_file);
+    json_dumper_putc(dumper, '"');
 
     --dumper->current_depth;
 }
@@ -46,6 +46,11 @@ extern "C" {
  *  json_dumper_end_array(&dumper);
  *  json_dumper_end_object(&dumper);
  *  json_dumper_finish(&dumper);
+ *
+ * By default every token is written to output_file as it's produced. When
+ * a lot of small values are written, set output_buffer to have them
+ * collected there instead; the buffer is written out when it's full and by
+ * json_dumper_flush() and json_dumper_finish().
  */
 
 /** Maximum object/array nesting depth. */
@@ -60,6 +65,10 @@ typedef struct json_dumper {
     gint    base64_state;
     gint    base64_save;
     guint8  state[JSON_DUMPER_MAX_DEPTH];
+    gchar  *output_buffer;      /**< Optional output buffer. */
+    gsize   output_buffer_size; /**< Size of output_buffer. */
+    /* for internal use, initialize with zeroes. */
+    gsize   output_buffer_used;
 } json_dumper;
 
 WS_DLL_PUBLIC void
@@ -114,6 +123,13 @@ json_dumper_write_base64(json_dumper *dumper, const guchar *data, size_t len);
 WS_DLL_PUBLIC gboolean
 json_dumper_finish(json_dumper *dumper);
 
+/**
+ * Writes anything collected in the output buffer to the output file.
+ * Does nothing if there is no output buffer.
+ */
+WS_DLL_PUBLIC void
+json_dumper_flush(json_dumper *dumper);
+
 #ifdef __cplusplus
 }
 #endif